@@ -0,0 +1,76 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Benchmark suite of the high-fanout block representation.
+Operation names match the dynamic_path suite, so that both can be compared row by row.
+*/
+
+#include "bench_common.h"
+#include "block_path.h"
+
+#pragma mark block_path suite
+
+template <typename VType>
+static void bench_block_path(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    const std::string suite = "block_path";
+    std::vector<VType> costs = bench_costs<VType>(size, distribution, config.seed);
+    block_path<VType> paths(costs);
+    uint32_t root = static_cast<uint32_t>(size);
+
+    std::mt19937_64 rng(config.seed + 1);
+    std::uniform_int_distribution<uint32_t> vertex_distribution(0, static_cast<uint32_t>(size));
+    std::vector<uint32_t> picks(config.samples);
+    for (auto& v : picks) {
+        v = vertex_distribution(rng);
+    }
+
+    auto run = [&](const std::string& operation, auto&& f) {
+        bench_recorder recorder(suite, operation, type, distribution, size);
+        for (uint32_t v : picks) {
+            recorder.time([&] { f(v); });
+        }
+        recorder.report();
+    };
+
+    run("path", [&](uint32_t v) { bench_keep(paths.path(v)); });
+    run("before", [&](uint32_t v) { bench_keep(paths.before(v)); });
+    run("after", [&](uint32_t v) { bench_keep(paths.after(v)); });
+    run("pcost_before", [&](uint32_t v) { bench_keep(paths.pcost_before(v)); });
+    run("pcost_after", [&](uint32_t v) { bench_keep(paths.pcost_after(v)); });
+    run("pmincost_before", [&](uint32_t) { bench_keep(paths.pmincost_before(root)); });
+    run("pmincost_after", [&](uint32_t) { bench_keep(paths.pmincost_after(root)); });
+    run("pupdate", [&](uint32_t) { paths.pupdate(root, VType(1)); });
+
+    bench_recorder split_before_recorder(suite, "split_before", type, distribution, size);
+    bench_recorder split_after_recorder(suite, "split_after", type, distribution, size);
+    bench_recorder concatenate_recorder(suite, "concatenate", type, distribution, size);
+    uint32_t p;
+    uint32_t q;
+    VType x;
+    for (uint32_t v : picks) {
+        split_before_recorder.time([&] { paths.split_before(v, p, q, x); });
+        concatenate_recorder.time([&] { root = paths.concatenate(p, q, x); });
+        split_after_recorder.time([&] { paths.split_after(v, p, q, x); });
+        concatenate_recorder.time([&] { root = paths.concatenate(p, q, x); });
+    }
+    split_before_recorder.report();
+    split_after_recorder.report();
+    concatenate_recorder.report();
+
+    bench_recorder vectorize_recorder(suite, "vectorize", type, distribution, size);
+    std::vector<VType> output;
+    for (std::size_t i = 0; i < std::min<std::size_t>(config.samples, 10); ++i) {
+        vectorize_recorder.time([&] { paths.vectorize(root, output); });
+    }
+    vectorize_recorder.report();
+}
+
+void bench_suite_block_path(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    if (type == "float") {
+        bench_block_path<float>(config, type, distribution, size);
+    } else if (type == "double") {
+        bench_block_path<double>(config, type, distribution, size);
+    } else if (type == "int") {
+        bench_block_path<int>(config, type, distribution, size);
+    }
+}
@@ -0,0 +1,151 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Common utilities for the dynamic path benchmark suites
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+/**
+ * \brief Benchmark parameters parsed from the command line.
+ */
+struct bench_config {
+    std::vector<std::size_t> sizes;
+    std::vector<std::string> types;
+    std::vector<std::string> distributions;
+    std::vector<std::string> suites;
+    // Number of timed samples per operation and size.
+    std::size_t samples = 1000;
+    // Scratch file for the memory-mapped node storage. Empty to skip it.
+    std::string scratch_file;
+    // Number of streamed costs of the sliding window benchmarks.
+    std::size_t stream = 1000000;
+    std::uint64_t seed = 42;
+};
+
+/**
+ * \brief Peak resident set size of the process in KiB.
+ */
+inline long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * \brief Collects per-sample latencies of one operation and prints one CSV record.
+ */
+class bench_recorder {
+  public:
+    bench_recorder(std::string suite, std::string operation, std::string type, std::string distribution, std::size_t size)
+        : m_suite(std::move(suite)), m_operation(std::move(operation)), m_type(std::move(type)),
+          m_distribution(std::move(distribution)), m_size(size) {}
+
+    /**
+     * \brief Time a single call of `f` and record it.
+     */
+    template <typename F>
+    void time(F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        record(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    /**
+     * \brief Record one sample, covering `ops` operations, in nanoseconds.
+     */
+    void record(double ns, std::size_t ops = 1) {
+        m_samples.push_back(ns / static_cast<double>(ops));
+        m_total_ns += ns;
+        m_ops += ops;
+    }
+
+    /**
+     * \brief Print the CSV record: see `print_header`.
+     */
+    void report() {
+        if (m_samples.empty()) {
+            return;
+        }
+        std::sort(m_samples.begin(), m_samples.end());
+        std::cout << m_suite << ',' << m_operation << ',' << m_type << ',' << m_distribution << ',' << m_size << ','
+                  << m_ops << ',' << m_total_ns / static_cast<double>(m_ops) << ',' << percentile(0.5) << ','
+                  << percentile(0.99) << ',' << peak_rss_kb() << '\n';
+        m_samples.clear();
+        m_total_ns = 0;
+        m_ops = 0;
+    }
+
+    static void print_header() {
+        std::cout << "suite,operation,type,distribution,size,ops,ns_per_op,p50_ns,p99_ns,peak_rss_kb\n";
+    }
+
+  private:
+    double percentile(double q) const {
+        auto rank = static_cast<std::size_t>(q * static_cast<double>(m_samples.size() - 1) + 0.5);
+        return m_samples[rank];
+    }
+
+    std::string m_suite;
+    std::string m_operation;
+    std::string m_type;
+    std::string m_distribution;
+    std::size_t m_size;
+    std::vector<double> m_samples;
+    double m_total_ns = 0;
+    std::size_t m_ops = 0;
+};
+
+/**
+ * \brief Edge costs of the given distribution.
+ *
+ * "uniform": i.i.d. uniform costs; "sorted": non-decreasing costs; "adversarial": two alternating values, so that
+ * half of the edges tie for the minimum and every minimum descent has to resolve ties.
+ */
+template <typename VType>
+std::vector<VType> bench_costs(std::size_t n, const std::string& distribution, std::uint64_t seed) {
+    std::vector<VType> costs(n);
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (distribution == "adversarial") {
+            costs[i] = static_cast<VType>(i % 2);
+        } else {
+            costs[i] = static_cast<VType>(uniform(rng));
+        }
+    }
+    if (distribution == "sorted") {
+        std::sort(costs.begin(), costs.end());
+    }
+    return costs;
+}
+
+// Keep a value alive so that the compiler cannot drop the benchmarked call.
+template <typename T>
+inline void bench_keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using bench_suite = void (*)(const bench_config&, const std::string& type, const std::string& distribution, std::size_t size);
+
+// Suites, one per bench_*.cpp file.
+void bench_suite_dynamic_path(const bench_config&, const std::string&, const std::string&, std::size_t);
+void bench_suite_dp_array(const bench_config&, const std::string&, const std::string&, std::size_t);
+void bench_suite_leafless_path(const bench_config&, const std::string&, const std::string&, std::size_t);
+void bench_suite_block_path(const bench_config&, const std::string&, const std::string&, std::size_t);
+void bench_suite_dp_multi_array(const bench_config&, const std::string&, const std::string&, std::size_t);
+void bench_suite_euler_tour_forest(const bench_config&, const std::string&, const std::string&, std::size_t);
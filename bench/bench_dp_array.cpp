@@ -0,0 +1,528 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Benchmark suite of the dp_array methods, on the heap, on the memory-mapped node storage and in segment tree mode.
+*/
+
+#include "bench_common.h"
+#include "dp_array.h"
+
+#if defined(__linux__) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Minimum of a sliding window of `size` edges over `config.stream` streamed costs, reported per streamed cost:
+// dp_array used as a deque against the classic monotone deque of window minimum candidates.
+template <typename VType>
+static void bench_sliding_window(const bench_config& config, const std::string& suite, const std::string& type,
+                                 const std::string& distribution, std::size_t size) {
+    auto stream = [&](auto&& f) {
+        std::mt19937_64 rng(config.seed + 2);
+        std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < config.stream; ++i) {
+            f(i, static_cast<VType>(uniform(rng)));
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    dp_array<VType> window(std::vector<VType>{});
+    VType dp_array_sum = VType(0);
+    int min_index;
+    double ns = stream([&](std::size_t, VType w) {
+        window.push_back(w);
+        if (window.edge_num() > size) {
+            window.pop_front();
+        }
+        dp_array_sum += *window.min_cost_first(0, min_index);
+    });
+    bench_recorder dp_array_recorder(suite, "sliding_window_min", type, distribution, size);
+    dp_array_recorder.record(ns, config.stream);
+    dp_array_recorder.report();
+
+    std::deque<std::pair<std::size_t, VType>> candidates;
+    VType monotone_sum = VType(0);
+    ns = stream([&](std::size_t i, VType w) {
+        while (!candidates.empty() && !(candidates.back().second < w)) {
+            candidates.pop_back();
+        }
+        candidates.emplace_back(i, w);
+        if (candidates.front().first + size <= i) {
+            candidates.pop_front();
+        }
+        monotone_sum += candidates.front().second;
+    });
+    bench_recorder monotone_recorder(suite, "sliding_window_min_monotone", type, distribution, size);
+    monotone_recorder.record(ns, config.stream);
+    monotone_recorder.report();
+
+    if (dp_array_sum != monotone_sum) {
+        std::cerr << "sliding window minima differ: " << dp_array_sum << " vs " << monotone_sum << "\n";
+    }
+}
+
+// Random inserts and erases, against inserting into the cost vector and constructing the dp_array from scratch.
+// Also times a range minimum once the vertices are indexed by their position in the tree.
+template <typename VType>
+static void bench_insert_erase(const bench_config& config, const std::string& suite, const std::string& type,
+                               const std::string& distribution, std::size_t size, const std::vector<VType>& costs) {
+    dp_array<VType> dynamic_array(costs);
+    std::mt19937_64 rng(config.seed + 3);
+    auto pick = [&](std::size_t bound) { return std::uniform_int_distribution<int>(0, static_cast<int>(bound))(rng); };
+
+    bench_recorder insert_recorder(suite, "insert", type, distribution, size);
+    for (std::size_t i = 0; i < config.samples; ++i) {
+        int i_k = pick(dynamic_array.edge_num());
+        insert_recorder.time([&] { dynamic_array.insert(i_k, VType(1)); });
+    }
+    insert_recorder.report();
+
+    int min_index;
+    bench_recorder positional_recorder(suite, "min_cost_first_range_positional", type, distribution, size);
+    for (std::size_t i = 0; i < config.samples; ++i) {
+        int i_k = pick(dynamic_array.edge_num() - 1);
+        int i_l = pick(dynamic_array.edge_num() - 1);
+        positional_recorder.time([&] { bench_keep(dynamic_array.min_cost_first(std::min(i_k, i_l), std::max(i_k, i_l) + 1, min_index)); });
+    }
+    positional_recorder.report();
+
+    bench_recorder erase_recorder(suite, "erase", type, distribution, size);
+    for (std::size_t i = 0; i < config.samples; ++i) {
+        int i_k = pick(dynamic_array.edge_num() - 1);
+        erase_recorder.time([&] { bench_keep(dynamic_array.erase(i_k)); });
+    }
+    erase_recorder.report();
+
+    // Rebuilding is O(n): repeat it only for small sizes.
+    std::vector<VType> rebuilt_costs = costs;
+    bench_recorder rebuild_recorder(suite, "insert_rebuild", type, distribution, size);
+    std::size_t rebuild_samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 10000000 / size));
+    for (std::size_t i = 0; i < rebuild_samples; ++i) {
+        int i_k = pick(rebuilt_costs.size());
+        rebuild_recorder.time([&] {
+            rebuilt_costs.insert(rebuilt_costs.begin() + i_k, VType(1));
+            dp_array<VType> rebuilt_array(rebuilt_costs);
+            bench_keep(rebuilt_array.edge_num());
+        });
+        rebuilt_costs.erase(rebuilt_costs.begin() + i_k);
+    }
+    rebuild_recorder.report();
+}
+
+// Splits at random positions and appends back, against vectorizing both parts and constructing the joined dp_array.
+// Also times the first append of two freshly constructed dp_arrays, which drops their flat indices.
+template <typename VType>
+static void bench_append(const bench_config& config, const std::string& suite, const std::string& type,
+                         const std::string& distribution, std::size_t size, const std::vector<VType>& costs) {
+    dp_array<VType> joined(costs);
+    dp_array<VType> tail(std::vector<VType>{});
+    std::mt19937_64 rng(config.seed + 4);
+    auto pick = [&](std::size_t bound) { return std::uniform_int_distribution<int>(0, static_cast<int>(bound))(rng); };
+
+    bench_recorder split_off_recorder(suite, "split_off", type, distribution, size);
+    bench_recorder append_recorder(suite, "append", type, distribution, size);
+    std::optional<VType> cost;
+    for (std::size_t i = 0; i < config.samples; ++i) {
+        int i_k = pick(size - 1);
+        split_off_recorder.time([&] { cost = joined.split_off(i_k, tail); });
+        append_recorder.time([&] { joined.append(std::move(tail), *cost); });
+    }
+    split_off_recorder.report();
+    append_recorder.report();
+
+    // Construction is O(n): repeat it only for small sizes.
+    std::size_t rebuild_samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 10000000 / size));
+    bench_recorder indexed_recorder(suite, "append_indexed", type, distribution, size);
+    for (std::size_t i = 0; i < rebuild_samples; ++i) {
+        dp_array<VType> head_array(costs);
+        dp_array<VType> tail_array(costs);
+        indexed_recorder.time([&] { head_array.append(std::move(tail_array), VType(1)); });
+    }
+    indexed_recorder.report();
+
+    std::vector<VType> head_costs;
+    std::vector<VType> tail_costs;
+    bench_recorder rebuild_recorder(suite, "append_rebuild", type, distribution, size);
+    for (std::size_t i = 0; i < rebuild_samples; ++i) {
+        cost = joined.split_off(pick(size - 1), tail);
+        rebuild_recorder.time([&] {
+            // An empty part does not vectorize and counts as a single vertex.
+            head_costs.clear();
+            tail_costs.clear();
+            joined.vectorize(head_costs);
+            tail.vectorize(tail_costs);
+            head_costs.push_back(*cost);
+            head_costs.insert(head_costs.end(), tail_costs.begin(), tail_costs.end());
+            joined = dp_array<VType>(head_costs);
+            tail = dp_array<VType>(std::vector<VType>{});
+        });
+    }
+    rebuild_recorder.report();
+}
+
+// Transactions of T random edits aborted by a rollback of their undo log, against the copy a transaction would
+// otherwise take: vectorizing the costs at its start and constructing the dp_array again at its abort.
+template <typename VType>
+static void bench_transaction(const bench_config& config, const std::string& suite, const std::string& type,
+                              const std::string& distribution, std::size_t size, const std::vector<VType>& costs) {
+    dp_array<VType> dynamic_array(costs);
+    std::mt19937_64 rng(config.seed + 5);
+    auto pick = [&](std::size_t bound) { return std::uniform_int_distribution<int>(0, static_cast<int>(bound))(rng); };
+    auto random_edit = [&]() {
+        int n = static_cast<int>(dynamic_array.edge_num());
+        int i_k = pick(std::max(n - 1, 0));
+        int op = n < 2 ? 1 : pick(3);
+        if (op == 0) {
+            dynamic_array.update_constant(i_k, i_k + 1 + pick(n - i_k - 1), VType(1));
+        } else if (op == 1) {
+            dynamic_array.insert(i_k, VType(1));
+        } else if (op == 2) {
+            dynamic_array.erase(i_k);
+        } else {
+            int i_l = std::min(i_k + pick(16), n);
+            int i_m = pick(n + 1) - 1;
+            dynamic_array.move_range(i_k, i_l, i_m < i_k || i_m > i_l ? i_m : i_k - 1, VType(1), VType(1), VType(1));
+        }
+    };
+
+    for (std::size_t edits : {10, 100, 1000, 10000}) {
+        // The edits themselves are not timed: bound their total number.
+        std::size_t samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 1000000 / edits));
+        bench_recorder rollback_recorder(suite, "rollback_T" + std::to_string(edits), type, distribution, size);
+        for (std::size_t i = 0; i < samples; ++i) {
+            dynamic_array.begin_transaction();
+            for (std::size_t j = 0; j < edits; ++j) {
+                random_edit();
+            }
+            rollback_recorder.time([&] { dynamic_array.rollback(0); });
+            dynamic_array.commit();
+        }
+        rollback_recorder.report();
+
+        // Construction is O(n): repeat it only for small sizes.
+        samples = std::max<std::size_t>(1, std::min<std::size_t>(samples, 10000000 / size));
+        bench_recorder rebuild_recorder(suite, "rebuild_T" + std::to_string(edits), type, distribution, size);
+        std::vector<VType> snapshot;
+        for (std::size_t i = 0; i < samples; ++i) {
+            double ns = 0.0;
+            auto start = std::chrono::steady_clock::now();
+            dynamic_array.vectorize(snapshot);
+            ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            for (std::size_t j = 0; j < edits; ++j) {
+                random_edit();
+            }
+            start = std::chrono::steady_clock::now();
+            dynamic_array = dp_array<VType>(snapshot);
+            ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            rebuild_recorder.record(ns);
+        }
+        rebuild_recorder.report();
+    }
+}
+
+template <typename VType>
+static void bench_export_delta(const bench_config& config, const std::string& suite, const std::string& type,
+                               const std::string& distribution, std::size_t size, const std::vector<VType>& costs) {
+    dp_array<VType> dynamic_array(costs);
+    dynamic_array.track_changes();
+    std::mt19937_64 rng(config.seed + 6);
+    std::uniform_int_distribution<int> index_distribution(0, static_cast<int>(size) - 1);
+    std::vector<std::pair<int, int>> runs;
+    std::vector<VType> delta;
+    dynamic_array.export_delta(runs, delta);
+
+    // Batches of single-edge updates touching 1 and 10 per mille of the edges.
+    for (std::size_t permille : {1, 10}) {
+        std::size_t batch = std::max<std::size_t>(1, size * permille / 1000);
+        // The updates themselves are not timed: bound their total number.
+        std::size_t samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 100000000 / size / permille));
+        bench_recorder export_recorder(suite, "export_delta_permille" + std::to_string(permille), type, distribution, size);
+        for (std::size_t i = 0; i < samples; ++i) {
+            for (std::size_t j = 0; j < batch; ++j) {
+                int i_k = index_distribution(rng);
+                dynamic_array.update_constant(i_k, i_k + 1, VType(1));
+            }
+            export_recorder.time([&] { dynamic_array.export_delta(runs, delta); });
+        }
+        export_recorder.report();
+    }
+}
+
+#if defined(__linux__) && defined(__GLIBC__)
+// Field of /proc/self/status in KiB, e.g. "VmRSS:" or "VmHWM:".
+static long proc_status_kb(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size(), field) == 0) {
+            return std::stol(line.substr(field.size()));
+        }
+    }
+    return -1;
+}
+#endif
+
+// Run `build`, which returns its latency in nanoseconds, `samples` times in a child process and record the latencies
+// per edge. Returns the growth of the peak resident set size of the child in KiB, i.e. the memory of the builds alone
+// (the child starts with the resident pages of the parent), or -1 on failure.
+template <typename F>
+static long bench_in_child(bench_recorder& recorder, std::size_t samples, std::size_t size, F&& build) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+#if defined(__linux__) && defined(__GLIBC__)
+        // Return the free heap memory inherited from the parent to the system, which the builds would otherwise reuse
+        // unnoticed, and restart the peak from the pages left.
+        malloc_trim(0);
+        std::ofstream("/proc/self/clear_refs") << "5";
+        long start_rss = proc_status_kb("VmRSS:");
+#else
+        long start_rss = peak_rss_kb();
+#endif
+        for (std::size_t i = 0; i < samples; ++i) {
+            double ns = build();
+            bench_keep(write(fds[1], &ns, sizeof(ns)));
+        }
+#if defined(__linux__) && defined(__GLIBC__)
+        long rss = proc_status_kb("VmHWM:") - start_rss;
+#else
+        long rss = peak_rss_kb() - start_rss;
+#endif
+        bench_keep(write(fds[1], &rss, sizeof(rss)));
+        _exit(0);
+    }
+
+    close(fds[1]);
+    long rss = -1;
+    if (pid > 0) {
+        double ns;
+        for (std::size_t i = 0; i < samples && read(fds[0], &ns, sizeof(ns)) == sizeof(ns); ++i) {
+            recorder.record(ns, size);
+        }
+        if (read(fds[0], &rss, sizeof(rss)) != sizeof(rss)) {
+            rss = -1;
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    close(fds[0]);
+    return rss;
+}
+
+// Construction from a materialized vector against the streaming constructors, from a generator and from binary and
+// text files, each in a child process to report the memory it takes on stderr.
+template <typename VType>
+static void bench_streaming_build(const bench_config& config, const std::string& suite, const std::string& type,
+                                  const std::string& distribution, std::size_t size, const std::vector<VType>& costs) {
+    const std::string binary_file = config.scratch_file + ".costs.bin";
+    const std::string text_file = config.scratch_file + ".costs.txt";
+    if (!config.scratch_file.empty()) {
+        std::FILE* binary = std::fopen(binary_file.c_str(), "wb");
+        if (binary) {
+            bench_keep(std::fwrite(costs.data(), sizeof(VType), size, binary));
+            std::fclose(binary);
+        }
+        std::ofstream text(text_file);
+        text.precision(std::numeric_limits<VType>::max_digits10);
+        for (VType cost : costs) {
+            text << cost << '\n';
+        }
+    }
+
+    auto timed = [](auto&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::unique_ptr<dp_array<VType>> array;
+    std::map<std::string, std::function<double()>> builds;
+    builds["build_vector"] = [&] {
+        std::vector<VType> input = bench_costs<VType>(size, distribution, config.seed);
+        double ns = timed([&] { array = std::make_unique<dp_array<VType>>(input); });
+        array.reset();
+        return ns;
+    };
+    // Uniform costs drawn on the fly whatever the distribution: the build does not depend on them.
+    builds["build_generator"] = [&] {
+        std::mt19937_64 rng(config.seed);
+        std::uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+        std::size_t i = 0;
+        std::function<bool(VType&)> next = [&](VType& cost) {
+            if (i == size) {
+                return false;
+            }
+            cost = static_cast<VType>(uniform(rng));
+            ++i;
+            return true;
+        };
+        double ns = timed([&] { array = std::make_unique<dp_array<VType>>(next); });
+        array.reset();
+        return ns;
+    };
+    bool ok;
+    if (!config.scratch_file.empty()) {
+        builds["build_file_binary"] = [&] {
+            double ns = timed([&] { array = std::make_unique<dp_array<VType>>(binary_file, dp_array_file_format::binary, ok); });
+            array.reset();
+            return ns;
+        };
+        builds["build_file_text"] = [&] {
+            double ns = timed([&] { array = std::make_unique<dp_array<VType>>(text_file, dp_array_file_format::text, ok); });
+            array.reset();
+            return ns;
+        };
+    }
+
+    // Construction is O(n): repeat it only for small sizes.
+    std::size_t build_samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 10000000 / size));
+    std::string peak_rss;
+    for (const auto& build : builds) {
+        bench_recorder recorder(suite, build.first, type, distribution, size);
+        long rss = bench_in_child(recorder, build_samples, size, build.second);
+        recorder.report();
+        peak_rss += ' ' + build.first + ' ' + std::to_string(rss);
+    }
+    std::cerr << "# " << suite << ',' << type << ',' << distribution << ',' << size << ": peak RSS growth in KiB of"
+              << peak_rss << '\n';
+    if (!config.scratch_file.empty()) {
+        std::remove(binary_file.c_str());
+        std::remove(text_file.c_str());
+    }
+}
+
+template <typename VType>
+static void bench_dp_array(const bench_config& config, const std::string& suite, const std::string& type,
+                           const std::string& distribution, std::size_t size, dp_array_mode mode,
+                           mmap_node_storage<VType>* storage) {
+    std::vector<VType> costs = bench_costs<VType>(size, distribution, config.seed);
+
+    // Construction is O(n): repeat it only for small sizes.
+    bench_recorder construct_recorder(suite, "construct", type, distribution, size);
+    std::size_t construct_samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 10000000 / size));
+    for (std::size_t i = 1; i < construct_samples; ++i) {
+        construct_recorder.time([&] { dp_array<VType> dynamic_array(costs, mode, storage); });
+    }
+    auto start = std::chrono::steady_clock::now();
+    dp_array<VType> dynamic_array(costs, mode, storage);
+    construct_recorder.record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    construct_recorder.report();
+
+    std::mt19937_64 rng(config.seed + 1);
+    std::uniform_int_distribution<int> index_distribution(0, static_cast<int>(size) - 1);
+    std::vector<std::pair<int, int>> picks(config.samples);
+    for (auto& pick : picks) {
+        int i_k = index_distribution(rng);
+        int i_l = index_distribution(rng);
+        pick = {std::min(i_k, i_l), std::max(i_k, i_l) + 1};
+    }
+
+    auto run = [&](const std::string& operation, auto&& f) {
+        bench_recorder recorder(suite, operation, type, distribution, size);
+        for (const auto& pick : picks) {
+            recorder.time([&] { f(pick.first, pick.second); });
+        }
+        recorder.report();
+    };
+
+    int min_index;
+    run("edge_cost", [&](int i_k, int) { bench_keep(dynamic_array.edge_cost(i_k)); });
+    run("update_constant", [&](int i_k, int) { dynamic_array.update_constant(i_k, VType(1)); });
+    run("update_constant_range", [&](int i_k, int i_l) { dynamic_array.update_constant(i_k, i_l, VType(1)); });
+    run("min_cost_first", [&](int i_k, int) { bench_keep(dynamic_array.min_cost_first(i_k, min_index)); });
+    run("min_cost_first_range", [&](int i_k, int i_l) { bench_keep(dynamic_array.min_cost_first(i_k, i_l, min_index)); });
+    run("min_cost_last", [&](int i_k, int) { bench_keep(dynamic_array.min_cost_last(i_k, min_index)); });
+    run("min_cost_last_range", [&](int i_k, int i_l) { bench_keep(dynamic_array.min_cost_last(i_k, i_l, min_index)); });
+
+    if (mode == dp_array_mode::dynamic) {
+        // VType(1.001) is 1 for integer types, whose costs must not overflow.
+        const VType factor = VType(1.001);
+        run("assign_range", [&](int i_k, int i_l) { dynamic_array.assign_range(i_k, i_l, VType(i_k % 100)); });
+        run("affine_range", [&](int i_k, int i_l) { dynamic_array.affine_range(i_k, i_l, factor, VType(1)); });
+
+        // The same updates one edge at a time are O((i_l - i_k) log n): repeat them only for small sizes.
+        std::size_t elementwise_samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 10000000 / size));
+        bench_recorder assign_recorder(suite, "assign_range_elementwise", type, distribution, size);
+        bench_recorder affine_recorder(suite, "affine_range_elementwise", type, distribution, size);
+        for (std::size_t i = 0; i < elementwise_samples; ++i) {
+            int i_k = picks[i].first;
+            int i_l = picks[i].second;
+            assign_recorder.time([&] {
+                for (int j = i_k; j < i_l; ++j) {
+                    dynamic_array.update_constant(j, j + 1, VType(i_k % 100) - *dynamic_array.edge_cost(j));
+                }
+            });
+            affine_recorder.time([&] {
+                for (int j = i_k; j < i_l; ++j) {
+                    VType cost = *dynamic_array.edge_cost(j);
+                    dynamic_array.update_constant(j, j + 1, factor * cost + VType(1) - cost);
+                }
+            });
+        }
+        assign_recorder.report();
+        affine_recorder.report();
+    }
+
+    bench_recorder vectorize_recorder(suite, "vectorize", type, distribution, size);
+    std::vector<VType> output;
+    for (std::size_t i = 0; i < std::min<std::size_t>(config.samples, 10); ++i) {
+        vectorize_recorder.time([&] { dynamic_array.vectorize(output); });
+    }
+    vectorize_recorder.report();
+
+    if (!config.scratch_file.empty() && !storage && mode == dp_array_mode::dynamic) {
+        const std::string snapshot_file = config.scratch_file + ".snapshot";
+        bench_recorder save_recorder(suite, "save", type, distribution, size);
+        save_recorder.time([&] { dynamic_array.save(snapshot_file); });
+        save_recorder.report();
+        bench_recorder load_recorder(suite, "load", type, distribution, size);
+        load_recorder.time([&] { dynamic_array.load(snapshot_file); });
+        load_recorder.report();
+        std::remove(snapshot_file.c_str());
+    }
+
+    if (mode == dp_array_mode::dynamic && !storage) {
+        bench_sliding_window<VType>(config, suite, type, distribution, size);
+        bench_insert_erase<VType>(config, suite, type, distribution, size, costs);
+        bench_append<VType>(config, suite, type, distribution, size, costs);
+        bench_transaction<VType>(config, suite, type, distribution, size, costs);
+        bench_export_delta<VType>(config, suite, type, distribution, size, costs);
+        bench_streaming_build<VType>(config, suite, type, distribution, size, costs);
+    }
+}
+
+template <typename VType>
+static void bench_dp_array(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    bench_dp_array<VType>(config, "dp_array", type, distribution, size, dp_array_mode::dynamic, nullptr);
+    bench_dp_array<VType>(config, "dp_array_segment_tree", type, distribution, size, dp_array_mode::segment_tree, nullptr);
+    if (!config.scratch_file.empty()) {
+        // Room for two live arrays (the one being constructed and the benchmarked one).
+        mmap_node_storage<VType> storage(config.scratch_file, 4 * size + 16);
+        if (storage.is_open()) {
+            bench_dp_array<VType>(config, "dp_array_mmap", type, distribution, size, dp_array_mode::dynamic, &storage);
+        }
+    }
+}
+
+void bench_suite_dp_array(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    if (type == "float") {
+        bench_dp_array<float>(config, type, distribution, size);
+    } else if (type == "double") {
+        bench_dp_array<double>(config, type, distribution, size);
+    } else if (type == "int") {
+        bench_dp_array<int>(config, type, distribution, size);
+    }
+}
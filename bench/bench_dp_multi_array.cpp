@@ -0,0 +1,126 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Benchmark suite of the multi-lane dp_multi_array, against K separate dp_arrays going through the same operations.
+Every sample covers all K lanes: operation names end with _K<lanes>_multi or _K<lanes>_separate.
+*/
+
+#include "bench_common.h"
+#include "dp_array.h"
+#include "dp_multi_array.h"
+
+#include <memory>
+
+#pragma mark dp_multi_array suite
+
+// Separate dp_arrays above this many edges in total are skipped, as they take 2 TreeNodes per edge and lane.
+static constexpr std::size_t separate_max_edges = 4000000;
+
+template <typename VType>
+static void bench_dp_multi_array(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    const std::string suite = "dp_multi_array";
+    for (std::size_t lanes : {4, 8, 16}) {
+        const std::string suffix = "_K" + std::to_string(lanes);
+        std::vector<std::vector<VType>> costs(lanes);
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            costs[lane] = bench_costs<VType>(size, distribution, config.seed + lane);
+        }
+
+        // The same random (sub-)paths and split vertices for both variants.
+        std::mt19937_64 rng(config.seed + 1);
+        std::uniform_int_distribution<int> index_distribution(0, static_cast<int>(size) - 1);
+        std::vector<std::pair<int, int>> picks(config.samples);
+        for (auto& pick : picks) {
+            int i = index_distribution(rng);
+            int j = index_distribution(rng);
+            pick = std::make_pair(std::min(i, j), std::max(i, j) + 1);
+        }
+        std::vector<VType> w(lanes, VType(1));
+
+        dp_multi_array<VType> multi(costs);
+        std::cerr << "# " << suite << ',' << type << ',' << distribution << ',' << size << ": bytes per vertex and lane "
+                  << static_cast<double>(multi.memory_bytes()) / static_cast<double>((size + 1) * lanes) << " (TreeNode "
+                  << static_cast<double>((2 * size + 1) * sizeof(TreeNode<VType>)) / static_cast<double>(size + 1)
+                  << ")\n";
+
+        bench_recorder multi_split_recorder(suite, "split_append" + suffix + "_multi", type, distribution, size);
+        dp_multi_array<VType> tail(lanes);
+        std::vector<VType> x;
+        for (const auto& pick : picks) {
+            multi_split_recorder.time([&] {
+                multi.split_off(pick.first, tail, x);
+                multi.append(std::move(tail), x);
+            });
+        }
+        multi_split_recorder.report();
+
+        bench_recorder multi_update_recorder(suite, "update_constant" + suffix + "_multi", type, distribution, size);
+        for (const auto& pick : picks) {
+            multi_update_recorder.time([&] { multi.update_constant(pick.first, pick.second, w); });
+        }
+        multi_update_recorder.report();
+
+        bench_recorder multi_min_recorder(suite, "min_cost_first" + suffix + "_multi", type, distribution, size);
+        int min_index;
+        for (const auto& pick : picks) {
+            multi_min_recorder.time([&] {
+                for (std::size_t lane = 0; lane < lanes; ++lane) {
+                    bench_keep(multi.min_cost_first(lane, pick.first, pick.second, min_index));
+                }
+            });
+        }
+        multi_min_recorder.report();
+
+        if (size * lanes > separate_max_edges) {
+            std::cerr << "# " << suite << ',' << type << ',' << distribution << ',' << size << ": separate dp_arrays of "
+                      << lanes << " lanes skipped\n";
+            continue;
+        }
+        std::vector<std::unique_ptr<dp_array<VType>>> separate;
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            separate.push_back(std::make_unique<dp_array<VType>>(costs[lane]));
+        }
+
+        bench_recorder separate_split_recorder(suite, "split_append" + suffix + "_separate", type, distribution, size);
+        dp_array<VType> separate_tail(std::vector<VType>{});
+        for (const auto& pick : picks) {
+            separate_split_recorder.time([&] {
+                for (auto& array : separate) {
+                    std::optional<VType> cost = array->split_off(pick.first, separate_tail);
+                    array->append(std::move(separate_tail), *cost);
+                }
+            });
+        }
+        separate_split_recorder.report();
+
+        bench_recorder separate_update_recorder(suite, "update_constant" + suffix + "_separate", type, distribution, size);
+        for (const auto& pick : picks) {
+            separate_update_recorder.time([&] {
+                for (std::size_t lane = 0; lane < lanes; ++lane) {
+                    separate[lane]->update_constant(pick.first, pick.second, w[lane]);
+                }
+            });
+        }
+        separate_update_recorder.report();
+
+        bench_recorder separate_min_recorder(suite, "min_cost_first" + suffix + "_separate", type, distribution, size);
+        for (const auto& pick : picks) {
+            separate_min_recorder.time([&] {
+                for (auto& array : separate) {
+                    bench_keep(array->min_cost_first(pick.first, pick.second, min_index));
+                }
+            });
+        }
+        separate_min_recorder.report();
+    }
+}
+
+void bench_suite_dp_multi_array(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    if (type == "float") {
+        bench_dp_multi_array<float>(config, type, distribution, size);
+    } else if (type == "double") {
+        bench_dp_multi_array<double>(config, type, distribution, size);
+    } else if (type == "int") {
+        bench_dp_multi_array<int>(config, type, distribution, size);
+    }
+}
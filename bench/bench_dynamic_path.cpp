@@ -0,0 +1,290 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Benchmark suite of the dynamic path operations.
+
+Usage: bench_dynamic_path [--max-size=N] [--sizes=N1,N2,...] [--types=float,double,int]
+                          [--distributions=uniform,sorted,adversarial] [--suites=S1,S2,...]
+                          [--samples=N] [--scratch=FILE] [--seed=N] [--stream=N]
+
+Prints one CSV record per (suite, operation, type, distribution, size).
+*/
+
+#include "bench_common.h"
+#include "dynamic_path.h"
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+#pragma mark dynamic_path_ops suite
+
+template <typename VType>
+static void bench_dynamic_path(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    const std::string suite = "dynamic_path";
+    dynamic_path_ops<VType> ops;
+    std::vector<VType> costs = bench_costs<VType>(size, distribution, config.seed);
+
+    // Same construction scheme as dp_array.
+    std::vector<TreeNode<VType>*> vertices(size + 1);
+    vertices[0] = ops.gen_new_node(true, 0);
+    TreeNode<VType>* root = vertices[0];
+    ops.set_balance(dynamic_path_balance::deferred);
+    for (std::size_t i = 0; i < size; ++i) {
+        vertices[i + 1] = ops.gen_new_node(true, static_cast<int>(i + 1));
+        root = ops.concatenate(root, vertices[i + 1], costs[i]);
+    }
+    root = ops.rebuild(root);
+    ops.set_balance(dynamic_path_balance::eager);
+
+    std::mt19937_64 rng(config.seed + 1);
+    std::uniform_int_distribution<std::size_t> vertex_distribution(0, size);
+    std::vector<TreeNode<VType>*> picks(config.samples);
+    for (auto& v : picks) {
+        v = vertices[vertex_distribution(rng)];
+    }
+
+    auto run = [&](const std::string& operation, auto&& f) {
+        bench_recorder recorder(suite, operation, type, distribution, size);
+        for (TreeNode<VType>* v : picks) {
+            recorder.time([&] { f(v); });
+        }
+        recorder.report();
+    };
+
+    run("path", [&](TreeNode<VType>* v) { bench_keep(ops.path(v)); });
+    run("before", [&](TreeNode<VType>* v) { bench_keep(ops.before(v)); });
+    run("after", [&](TreeNode<VType>* v) { bench_keep(ops.after(v)); });
+    run("pcost_before", [&](TreeNode<VType>* v) { bench_keep(ops.pcost_before(v)); });
+    run("pcost_after", [&](TreeNode<VType>* v) { bench_keep(ops.pcost_after(v)); });
+    run("pmincost_before", [&](TreeNode<VType>*) { bench_keep(ops.pmincost_before(root)); });
+    run("pmincost_after", [&](TreeNode<VType>*) { bench_keep(ops.pmincost_after(root)); });
+    // Enumeration of the 16 smallest edges, by rank and by threshold.
+    std::vector<std::pair<TreeNode<VType>*, VType>> edges;
+    std::vector<VType> smallest(costs);
+    std::size_t k = std::min<std::size_t>(16, size);
+    std::nth_element(smallest.begin(), smallest.begin() + (k - 1), smallest.end());
+    VType threshold = smallest[k - 1];
+    run("pmincost_k", [&](TreeNode<VType>*) { ops.pmincost_k(root, k, edges); bench_keep(edges.data()); });
+    run("pcost_below", [&](TreeNode<VType>*) { ops.pcost_below(root, threshold, edges); bench_keep(edges.data()); });
+    run("pupdate", [&](TreeNode<VType>*) { ops.pupdate(root, VType(1)); });
+
+    // Split at random vertices and concatenate back, timing both halves separately.
+    bench_recorder split_before_recorder(suite, "split_before", type, distribution, size);
+    bench_recorder split_after_recorder(suite, "split_after", type, distribution, size);
+    bench_recorder concatenate_recorder(suite, "concatenate", type, distribution, size);
+    TreeNode<VType>* p;
+    TreeNode<VType>* q;
+    VType x;
+    for (TreeNode<VType>* v : picks) {
+        split_before_recorder.time([&] { ops.split_before(v, p, q, x); });
+        concatenate_recorder.time([&] { root = ops.concatenate(p, q, x); });
+        split_after_recorder.time([&] { ops.split_after(v, p, q, x); });
+        concatenate_recorder.time([&] { root = ops.concatenate(p, q, x); });
+    }
+    split_before_recorder.report();
+    split_after_recorder.report();
+    concatenate_recorder.report();
+
+    // Move random sub-paths of up to 64 vertices after a random vertex outside of them, with `splice` and with the
+    // equivalent hand-written splits and concatenations.
+    std::vector<std::tuple<std::size_t, std::size_t, std::size_t>> moves(config.samples);
+    for (auto& move : moves) {
+        std::size_t a = vertex_distribution(rng);
+        std::size_t b = std::min(size, a + vertex_distribution(rng) % 64);
+        std::size_t m = vertex_distribution(rng) % (size - (b - a));
+        move = {a, b, m < a ? m : m + (b - a + 1)};
+    }
+    for (bool manual : {false, true}) {
+        bench_recorder splice_recorder(suite, manual ? "splice_manual" : "splice", type, distribution, size);
+        for (const auto& move : moves) {
+            TreeNode<VType>* u = ops.vertex_at(root, std::get<0>(move));
+            TreeNode<VType>* v = ops.vertex_at(root, std::get<1>(move));
+            TreeNode<VType>* w = ops.vertex_at(root, std::get<2>(move));
+            splice_recorder.time([&] {
+                if (!manual) {
+                    ops.splice(u, v, w, VType(1), VType(2), VType(3), root, q);
+                    return;
+                }
+                // Cut the sub-path q out, close the gap, split after w and insert q there.
+                TreeNode<VType>* r;
+                ops.split_before(u, p, q, x);
+                ops.split_after(v, q, r, x);
+                ops.concatenate(p, r, VType(1));
+                ops.split_after(w, p, r, x);
+                root = ops.concatenate(ops.concatenate(p, q, VType(2)), r, VType(3));
+            });
+        }
+        splice_recorder.report();
+    }
+
+    // Age the tree by moving random sub-paths until neighbor vertices are far apart in memory, then time queries
+    // before and after its relayout.
+    for (std::size_t i = 0; i < size / 16; ++i) {
+        std::size_t a = vertex_distribution(rng);
+        std::size_t b = std::min(size, a + vertex_distribution(rng) % 64);
+        std::size_t m = vertex_distribution(rng) % (size - (b - a));
+        ops.splice(ops.vertex_at(root, a), ops.vertex_at(root, b), ops.vertex_at(root, m < a ? m : m + (b - a + 1)),
+                   VType(1), VType(2), VType(3), root, q);
+    }
+    for (const char* stage : {"_aged", "_relaid"}) {
+        run(std::string("path") + stage, [&](TreeNode<VType>* v) { bench_keep(ops.path(v)); });
+        run(std::string("pcost_after") + stage, [&](TreeNode<VType>* v) { bench_keep(ops.pcost_after(v)); });
+        run(std::string("pmincost_before") + stage, [&](TreeNode<VType>*) { bench_keep(ops.pmincost_before(root)); });
+        if (stage == std::string("_aged")) {
+            bench_recorder relayout_recorder(suite, "relayout", type, distribution, size);
+            relayout_recorder.time([&] { root = ops.relayout(root); });
+            relayout_recorder.report();
+        }
+    }
+
+    // O(n) per call: a few samples are enough.
+    bench_recorder vectorize_recorder(suite, "vectorize", type, distribution, size);
+    std::vector<VType> output;
+    for (std::size_t i = 0; i < std::min<std::size_t>(config.samples, 10); ++i) {
+        vectorize_recorder.time([&] { ops.vectorize(root, output); });
+    }
+    vectorize_recorder.report();
+
+    // Sequential scans of the whole path, reported per step.
+    bench_recorder walk_after_recorder(suite, "walk_after", type, distribution, size);
+    bench_recorder walk_before_recorder(suite, "walk_before", type, distribution, size);
+    for (std::size_t i = 0; i < std::min<std::size_t>(config.samples, 10); ++i) {
+        auto start = std::chrono::steady_clock::now();
+        for (TreeNode<VType>* v = ops.head(root); v; v = ops.after(v)) {
+            bench_keep(v);
+        }
+        walk_after_recorder.record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(), size + 1);
+        start = std::chrono::steady_clock::now();
+        for (TreeNode<VType>* v = ops.tail(root); v; v = ops.before(v)) {
+            bench_keep(v);
+        }
+        walk_before_recorder.record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(), size + 1);
+    }
+    walk_after_recorder.report();
+    walk_before_recorder.report();
+
+    // Building a whole path by appends, reported per append, in both balance modes.
+    for (dynamic_path_balance balance : {dynamic_path_balance::eager, dynamic_path_balance::deferred}) {
+        bench_recorder append_recorder(suite, balance == dynamic_path_balance::eager ? "append_eager" : "append_deferred",
+                                       type, distribution, size);
+        dynamic_path_ops<VType> builder;
+        builder.set_balance(balance);
+        for (std::size_t i = 0; i < std::min<std::size_t>(config.samples, 3); ++i) {
+            std::vector<TreeNode<VType>*> nodes(size + 1);
+            for (std::size_t j = 0; j <= size; ++j) {
+                nodes[j] = builder.gen_new_node(true, static_cast<int>(j));
+            }
+            TreeNode<VType>* path = nodes[0];
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t j = 0; j < size; ++j) {
+                path = builder.concatenate(path, nodes[j + 1], costs[j]);
+            }
+            append_recorder.record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(), size);
+            builder.clearall(path);
+        }
+        append_recorder.report();
+    }
+
+    ops.clearall(root);
+}
+
+void bench_suite_dynamic_path(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    if (type == "float") {
+        bench_dynamic_path<float>(config, type, distribution, size);
+    } else if (type == "double") {
+        bench_dynamic_path<double>(config, type, distribution, size);
+    } else if (type == "int") {
+        bench_dynamic_path<int>(config, type, distribution, size);
+    }
+}
+
+#pragma mark Driver
+
+static std::vector<std::string> split_list(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+int main(int argc, const char * argv[]) {
+    const std::map<std::string, bench_suite> suites = {
+        {"dynamic_path", bench_suite_dynamic_path},
+        {"dp_array", bench_suite_dp_array},
+        {"leafless_path", bench_suite_leafless_path},
+        {"block_path", bench_suite_block_path},
+        {"dp_multi_array", bench_suite_dp_multi_array},
+        {"euler_tour_forest", bench_suite_euler_tour_forest},
+    };
+
+    bench_config config;
+    config.types = {"float", "double", "int"};
+    config.distributions = {"uniform", "sorted", "adversarial"};
+    std::size_t max_size = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--max-size") {
+            max_size = std::stoull(value);
+        } else if (key == "--sizes") {
+            for (const auto& item : split_list(value)) {
+                config.sizes.push_back(static_cast<std::size_t>(std::stod(item)));
+            }
+        } else if (key == "--types") {
+            config.types = split_list(value);
+        } else if (key == "--distributions") {
+            config.distributions = split_list(value);
+        } else if (key == "--suites") {
+            config.suites = split_list(value);
+        } else if (key == "--samples") {
+            config.samples = std::stoull(value);
+        } else if (key == "--scratch") {
+            config.scratch_file = value;
+        } else if (key == "--seed") {
+            config.seed = std::stoull(value);
+        } else if (key == "--stream") {
+            config.stream = static_cast<std::size_t>(std::stod(value));
+        } else {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (config.sizes.empty()) {
+        for (std::size_t size = 1000; size <= max_size; size *= 10) {
+            config.sizes.push_back(size);
+        }
+    }
+    if (config.suites.empty()) {
+        for (const auto& suite : suites) {
+            config.suites.push_back(suite.first);
+        }
+    }
+
+    bench_recorder::print_header();
+    for (const auto& name : config.suites) {
+        auto suite = suites.find(name);
+        if (suite == suites.end()) {
+            std::cerr << "Unknown suite " << name << "\n";
+            return 1;
+        }
+        for (std::size_t size : config.sizes) {
+            for (const auto& type : config.types) {
+                for (const auto& distribution : config.distributions) {
+                    suite->second(config, type, distribution, size);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
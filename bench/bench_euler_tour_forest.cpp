@@ -0,0 +1,160 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Benchmark suite of the Euler-tour tree layer euler_tour_forest on random forests, against a union-find rebuilt after
+every cut, the baseline for connectivity under edge deletions.
+*/
+
+#include "bench_common.h"
+#include "euler_tour_forest.h"
+
+#include <numeric>
+
+#pragma mark euler_tour_forest suite
+
+namespace {
+
+// Union-find with path halving and union by size.
+class union_find {
+  public:
+    explicit union_find(std::size_t n) : m_parent(n), m_size(n, 1) { std::iota(m_parent.begin(), m_parent.end(), 0); }
+
+    int find(int v) {
+        while (m_parent[v] != v) {
+            m_parent[v] = m_parent[m_parent[v]];
+            v = m_parent[v];
+        }
+        return v;
+    }
+
+    void unite(int u, int v) {
+        u = find(u);
+        v = find(v);
+        if (u == v) {
+            return;
+        }
+        if (m_size[u] < m_size[v]) {
+            std::swap(u, v);
+        }
+        m_parent[v] = u;
+        m_size[u] += m_size[v];
+    }
+
+  private:
+    std::vector<int> m_parent;
+    std::vector<int> m_size;
+};
+
+}  // namespace
+
+template <typename VType>
+static void bench_euler_tour_forest(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    const std::string suite = "euler_tour_forest";
+    const int n = static_cast<int>(size);
+    std::vector<VType> values = bench_costs<VType>(size, distribution, config.seed);
+
+    // Random recursive forest: every vertex but the first links to a random earlier vertex, except one in 16 that
+    // starts a new tree.
+    std::mt19937_64 rng(config.seed + 1);
+    std::vector<std::pair<int, int>> edges;
+    for (int v = 1; v < n; ++v) {
+        if (rng() % 16 != 0) {
+            edges.emplace_back(static_cast<int>(rng() % v), v);
+        }
+    }
+    std::shuffle(edges.begin(), edges.end(), rng);
+
+    euler_tour_forest<VType> forest(values);
+    bench_recorder build_recorder(suite, "link_build", type, distribution, size);
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& edge : edges) {
+        forest.link(edge.first, edge.second);
+    }
+    build_recorder.record(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(),
+                          std::max<std::size_t>(1, edges.size()));
+    build_recorder.report();
+    if (edges.empty()) {
+        return;
+    }
+
+    std::uniform_int_distribution<int> vertex_distribution(0, n - 1);
+    std::vector<std::pair<int, int>> pairs(config.samples);
+    std::vector<std::pair<int, int>> picks(config.samples);
+    for (std::size_t i = 0; i < config.samples; ++i) {
+        pairs[i] = std::make_pair(vertex_distribution(rng), vertex_distribution(rng));
+        picks[i] = edges[rng() % edges.size()];
+    }
+
+    bench_recorder connected_recorder(suite, "connected", type, distribution, size);
+    for (const auto& pair : pairs) {
+        connected_recorder.time([&] { bench_keep(forest.connected(pair.first, pair.second)); });
+    }
+    connected_recorder.report();
+
+    // Every cut is undone by the link that follows it.
+    bench_recorder cut_recorder(suite, "cut", type, distribution, size);
+    bench_recorder link_recorder(suite, "link", type, distribution, size);
+    for (const auto& pick : picks) {
+        cut_recorder.time([&] { forest.cut(pick.first, pick.second); });
+        link_recorder.time([&] { forest.link(pick.first, pick.second); });
+    }
+    cut_recorder.report();
+    link_recorder.report();
+
+    bench_recorder reroot_recorder(suite, "reroot", type, distribution, size);
+    for (const auto& pair : pairs) {
+        reroot_recorder.time([&] { forest.reroot(pair.first); });
+    }
+    reroot_recorder.report();
+
+    bench_recorder min_recorder(suite, "subtree_min", type, distribution, size);
+    int min_vertex;
+    for (const auto& pick : picks) {
+        min_recorder.time([&] { bench_keep(forest.subtree_min(pick.second, pick.first, min_vertex)); });
+    }
+    min_recorder.report();
+
+    bench_recorder add_recorder(suite, "subtree_add", type, distribution, size);
+    for (const auto& pick : picks) {
+        add_recorder.time([&] { forest.subtree_add(pick.second, pick.first, VType(1)); });
+    }
+    add_recorder.report();
+
+    // Baseline: a union-find has no cut, so the connectivity after a cut comes from a rebuild over all the remaining
+    // edges. O(n) per cut: repeat it only for small sizes.
+    union_find components(size);
+    for (const auto& edge : edges) {
+        components.unite(edge.first, edge.second);
+    }
+    bench_recorder find_recorder(suite, "connected_union_find", type, distribution, size);
+    for (const auto& pair : pairs) {
+        find_recorder.time([&] { bench_keep(components.find(pair.first) == components.find(pair.second)); });
+    }
+    find_recorder.report();
+
+    std::size_t rebuild_samples = std::max<std::size_t>(1, std::min<std::size_t>(config.samples, 20000000 / size));
+    bench_recorder rebuild_recorder(suite, "cut_rebuild_union_find", type, distribution, size);
+    for (std::size_t i = 0; i < rebuild_samples; ++i) {
+        const auto& pick = picks[i];
+        rebuild_recorder.time([&] {
+            union_find rebuilt(size);
+            for (const auto& edge : edges) {
+                if (edge != pick) {
+                    rebuilt.unite(edge.first, edge.second);
+                }
+            }
+            bench_keep(rebuilt.find(pick.first) == rebuilt.find(pick.second));
+        });
+    }
+    rebuild_recorder.report();
+}
+
+void bench_suite_euler_tour_forest(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    if (type == "float") {
+        bench_euler_tour_forest<float>(config, type, distribution, size);
+    } else if (type == "double") {
+        bench_euler_tour_forest<double>(config, type, distribution, size);
+    } else if (type == "int") {
+        bench_euler_tour_forest<int>(config, type, distribution, size);
+    }
+}
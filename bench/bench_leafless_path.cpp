@@ -0,0 +1,120 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Benchmark suite of the leaf-less dynamic path representation.
+Operation names match the dynamic_path suite, so that both can be compared row by row.
+*/
+
+#include "bench_common.h"
+#include "dynamic_path.h"
+#include "leafless_path.h"
+
+#pragma mark leafless_path suite
+
+template <typename VType>
+static void bench_leafless_path(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    const std::string suite = "leafless_path";
+    using ref = typename leafless_path<VType>::ref;
+    std::vector<VType> costs = bench_costs<VType>(size, distribution, config.seed);
+
+    // Same construction scheme as the dynamic_path suite.
+    leafless_path<VType> paths(static_cast<uint32_t>(size + 1));
+    ref root = paths.path(0);
+    std::size_t reBalanceInterval = std::max<std::size_t>(1, std::min<std::size_t>(1000, size / 10));
+    for (std::size_t i = 0; i < size; ++i) {
+        root = paths.concatenate(root, paths.path(static_cast<uint32_t>(i + 1)), costs[i], i % reBalanceInterval == 0 || i + 1 == size);
+    }
+
+    // Bytes per vertex of both representations. TreeNodes are counted without the allocator overhead.
+    std::cerr << "# " << suite << ',' << type << ',' << distribution << ',' << size << ": bytes per vertex "
+              << static_cast<double>(paths.memory_bytes()) / static_cast<double>(size + 1) << " (TreeNode "
+              << static_cast<double>((2 * size + 1) * sizeof(TreeNode<VType>)) / static_cast<double>(size + 1) << ")\n";
+
+    std::mt19937_64 rng(config.seed + 1);
+    std::uniform_int_distribution<uint32_t> vertex_distribution(0, static_cast<uint32_t>(size));
+    std::vector<uint32_t> picks(config.samples);
+    for (auto& v : picks) {
+        v = vertex_distribution(rng);
+    }
+
+    auto run = [&](const std::string& operation, auto&& f) {
+        bench_recorder recorder(suite, operation, type, distribution, size);
+        for (uint32_t v : picks) {
+            recorder.time([&] { f(v); });
+        }
+        recorder.report();
+    };
+
+    run("path", [&](uint32_t v) { bench_keep(paths.path(v)); });
+    run("before", [&](uint32_t v) { bench_keep(paths.before(v)); });
+    run("after", [&](uint32_t v) { bench_keep(paths.after(v)); });
+    run("pcost_before", [&](uint32_t v) { bench_keep(paths.pcost_before(v)); });
+    run("pcost_after", [&](uint32_t v) { bench_keep(paths.pcost_after(v)); });
+    run("pmincost_before", [&](uint32_t) { bench_keep(paths.pmincost_before(root)); });
+    run("pmincost_after", [&](uint32_t) { bench_keep(paths.pmincost_after(root)); });
+
+    bench_recorder split_before_recorder(suite, "split_before", type, distribution, size);
+    bench_recorder split_after_recorder(suite, "split_after", type, distribution, size);
+    bench_recorder concatenate_recorder(suite, "concatenate", type, distribution, size);
+    ref p;
+    ref q;
+    VType x;
+    for (uint32_t v : picks) {
+        split_before_recorder.time([&] { paths.split_before(v, p, q, x); });
+        concatenate_recorder.time([&] { root = paths.concatenate(p, q, x); });
+        split_after_recorder.time([&] { paths.split_after(v, p, q, x); });
+        concatenate_recorder.time([&] { root = paths.concatenate(p, q, x); });
+    }
+    split_before_recorder.report();
+    split_after_recorder.report();
+    concatenate_recorder.report();
+
+    // A forest of short paths of 1 to 63 edges, all in trees, then in the hybrid mode where they are all flat.
+    for (int threshold : {0, leafless_path<VType>::flat_max_edges}) {
+        const std::string suffix = threshold == 0 ? "_short_tree" : "_short_flat";
+        leafless_path<VType> forest(static_cast<uint32_t>(size + 1));
+        forest.set_flat_threshold(threshold);
+        std::mt19937_64 forest_rng(config.seed + 2);
+        for (std::size_t i = 0; i <= size;) {
+            std::size_t edges = std::min<std::size_t>(1 + forest_rng() % 63, size - i);
+            ref r = forest.path(static_cast<uint32_t>(i));
+            for (std::size_t j = 1; j <= edges; ++j) {
+                r = forest.concatenate(r, forest.path(static_cast<uint32_t>(i + j)), costs[(i + j - 1) % size]);
+            }
+            i += edges + 1;
+        }
+        std::cerr << "# " << suite << ',' << type << ',' << distribution << ',' << size << ": bytes per vertex "
+                  << static_cast<double>(forest.memory_bytes()) / static_cast<double>(size + 1) << " (" << suffix.substr(1)
+                  << ")\n";
+
+        run("path" + suffix, [&](uint32_t v) { bench_keep(forest.path(v)); });
+        run("pcost_after" + suffix, [&](uint32_t v) { bench_keep(forest.pcost_after(v)); });
+        run("pmincost_before" + suffix, [&](uint32_t v) { bench_keep(forest.pmincost_before(forest.path(v))); });
+        run("pupdate" + suffix, [&](uint32_t v) {
+            ref r = forest.path(v);
+            if (!leafless_path<VType>::is_vertex(r)) {
+                forest.pupdate(r, VType(1));
+            }
+        });
+        bench_recorder split_recorder(suite, "split_before" + suffix, type, distribution, size);
+        bench_recorder concatenate_recorder(suite, "concatenate" + suffix, type, distribution, size);
+        for (uint32_t v : picks) {
+            split_recorder.time([&] { forest.split_before(v, p, q, x); });
+            if (p != leafless_path<VType>::null_ref) {
+                concatenate_recorder.time([&] { forest.concatenate(p, q, x); });
+            }
+        }
+        split_recorder.report();
+        concatenate_recorder.report();
+    }
+}
+
+void bench_suite_leafless_path(const bench_config& config, const std::string& type, const std::string& distribution, std::size_t size) {
+    if (type == "float") {
+        bench_leafless_path<float>(config, type, distribution, size);
+    } else if (type == "double") {
+        bench_leafless_path<double>(config, type, distribution, size);
+    } else if (type == "int") {
+        bench_leafless_path<int>(config, type, distribution, size);
+    }
+}
@@ -5,11 +5,23 @@
 //  Created by ChengLu on 8/29/21.
 //
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include "block_path.h"
 #include "dp_array.h"
+#include "dp_multi_array.h"
+#include "dp_trace.h"
+#include "euler_tour_forest.h"
+#include "leafless_path.h"
 #include <iostream>
+#include <iterator>
 #include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -28,6 +40,21 @@ bool vertex_inorder(const dynamic_path_ops<VType>& tree_ops, TreeNode<VType>* ro
     return true;
 }
 
+// Walk the path from head to tail with `after` and back with `before`.
+template <typename VType>
+bool vertex_links(const dynamic_path_ops<VType>& tree_ops, TreeNode<VType>* root, const std::vector<int>& reference) {
+    std::vector<int> forward;
+    for (TreeNode<VType>* v = tree_ops.head(root); v; v = tree_ops.after(v)) {
+        forward.push_back(v->node_index);
+    }
+    std::vector<int> backward;
+    for (TreeNode<VType>* v = tree_ops.tail(root); v; v = tree_ops.before(v)) {
+        backward.push_back(v->node_index);
+    }
+    std::reverse(backward.begin(), backward.end());
+    return forward == reference && backward == reference;
+}
+
 template <typename VType>
 bool cost_inorder(const dynamic_path_ops<VType>& tree_ops, TreeNode<VType>* root, const std::vector<VType>& reference) {
     std::vector<VType> vector_path;
@@ -102,6 +129,14 @@ void dynamic_path_unit_tests() {
         assert(!root->external);
     }
 
+    // tree_shape
+    dynamic_path_shape shape = tree_ops.tree_shape(root);
+    assert(shape.vertices == edge_num + 1);
+    assert(shape.edges == edge_num);
+    assert(shape.height == root->height);
+    assert(shape.ideal_height == 6);
+    assert(shape.height >= shape.ideal_height);
+
     // path
     for (const auto p: external_nodes) {
         assert(tree_ops.path(p) == root);
@@ -130,13 +165,13 @@ void dynamic_path_unit_tests() {
     }
 
     // pcost_before
-    assert(isnan(tree_ops.pcost_before(external_nodes[0])));
+    assert(std::isnan(tree_ops.pcost_before(external_nodes[0])));
     for (std::size_t i = 1; i < external_nodes.size(); ++i) {
         assert(tree_ops.pcost_before(external_nodes[i]) == static_cast<double>(i - 1));
     }
 
     // pcost_after
-    assert(isnan(tree_ops.pcost_after(external_nodes[external_nodes.size() - 1])));
+    assert(std::isnan(tree_ops.pcost_after(external_nodes[external_nodes.size() - 1])));
     for (std::size_t i = 0; i < external_nodes.size() - 1; ++i) {
         assert(tree_ops.pcost_after(external_nodes[i]) == static_cast<double>(i));
     }
@@ -155,7 +190,7 @@ void dynamic_path_unit_tests() {
     tree_ops.split_before(external_nodes[0], p, q, cost);
     assert(p == nullptr);
     assert(root == q);
-    assert(isnan(cost));
+    assert(std::isnan(cost));
     // Non-trivial cases
     for (std::size_t i = 1; i < external_nodes.size(); ++i) {
         tree_ops.split_before(external_nodes[i], p, q, cost);
@@ -177,7 +212,7 @@ void dynamic_path_unit_tests() {
     tree_ops.split_after(external_nodes[external_nodes.size() - 1], p, q, cost);
     assert(root == p);
     assert(q == nullptr);
-    assert(isnan(cost));
+    assert(std::isnan(cost));
     // Non-trivial cases
     for (std::size_t i = 0; i < external_nodes.size() - 1; ++i) {
         tree_ops.split_after(external_nodes[i], p, q, cost);
@@ -267,6 +302,695 @@ void dynamic_path_unit_tests() {
     assert(cost_inorder(tree_ops, root, original_array));
     tree_ops.clearall(root);
 
+    // Vertex links across splits and concatenations: move the sub-path (4, 9) to the end, then (0, 12) to the end.
+    root = tree_ops.gen_new_node(true, 0);
+    external_nodes[0] = root;
+    for (std::size_t i = 0; i < edge_num; ++i) {
+        external_nodes[i + 1] = tree_ops.gen_new_node(true, static_cast<int>(i) + 1);
+        root = tree_ops.concatenate(root, external_nodes[i + 1], original_array[i]);
+    }
+    assert(vertex_links(tree_ops, root, original_index_array));
+    std::vector<int> moved_index_array(original_index_array);
+    for (auto range : {std::make_pair(4, 9), std::make_pair(0, 12)}) {
+        tree_ops.split_before(external_nodes[range.first], p, q, cost);
+        tree_ops.split_after(external_nodes[range.second], q, r, cost2);
+        assert(vertex_links(tree_ops, q, std::vector<int>(moved_index_array.begin() + range.first,
+                                                           moved_index_array.begin() + range.second + 1)));
+        root = tree_ops.concatenate(tree_ops.concatenate(p, r, cost), q, cost2);
+        std::rotate(moved_index_array.begin() + range.first, moved_index_array.begin() + range.second + 1,
+                    moved_index_array.end());
+        std::rotate(external_nodes.begin() + range.first, external_nodes.begin() + range.second + 1, external_nodes.end());
+        assert(vertex_inorder(tree_ops, root, moved_index_array));
+        assert(vertex_links(tree_ops, root, moved_index_array));
+    }
+    tree_ops.clearall(root);
+
+    {
+        // Random splices between a few paths against reference vertex and cost lists, in both balance modes.
+        // Reversals only start in the second half, where the vertex links of a single vertex per path are checked,
+        // so that the splices meet the vertices below pending reversals.
+        auto rng = std::default_random_engine {};
+        std::vector<TreeNode<double>*> nodes;
+        std::vector<TreeNode<double>*> roots;
+        std::vector<std::vector<int>> vertices;
+        std::vector<std::vector<double>> costs;
+        for (int path_index = 0; path_index < 3; ++path_index) {
+            vertices.emplace_back();
+            costs.emplace_back();
+            roots.push_back(nullptr);
+            for (int i = 0; i < 40; ++i) {
+                nodes.push_back(tree_ops.gen_new_node(true, static_cast<int>(nodes.size())));
+                vertices.back().push_back(nodes.back()->node_index);
+                if (roots.back()) {
+                    costs.back().push_back(static_cast<double>(rng() % 50));
+                }
+                roots.back() = tree_ops.concatenate(roots.back(), nodes.back(), roots.back() ? costs.back().back() : 0.0);
+            }
+        }
+        for (int round = 0; round < 3000; ++round) {
+            tree_ops.set_balance(rng() % 2 ? dynamic_path_balance::eager : dynamic_path_balance::deferred);
+            if (round >= 1500 && rng() % 4 == 0) {
+                std::size_t s = rng() % roots.size();
+                tree_ops.reverse(roots[s]);
+                std::reverse(vertices[s].begin(), vertices[s].end());
+                std::reverse(costs[s].begin(), costs[s].end());
+            }
+
+            std::size_t s = rng() % roots.size();
+            std::size_t a = rng() % vertices[s].size();
+            std::size_t b = a + rng() % std::min<std::size_t>(vertices[s].size() - a, 12);
+            double x = static_cast<double>(rng() % 50);
+            double y = static_cast<double>(rng() % 50);
+            double z = static_cast<double>(rng() % 50);
+            // Target: a vertex of another path, a vertex of the same path outside [a, b], or none.
+            std::size_t t = rng() % (roots.size() + 1);
+            std::size_t j = 0;
+            if (t == s && vertices[s].size() == b - a + 1) {
+                continue;
+            }
+            if (t < roots.size()) {
+                do {
+                    j = rng() % vertices[t].size();
+                } while (t == s && a <= j && j <= b);
+            }
+
+            // Reference: cut [a, b] out of path s, then insert it after vertex j of path t.
+            std::vector<int> moved(vertices[s].begin() + a, vertices[s].begin() + b + 1);
+            std::vector<double> moved_costs(costs[s].begin() + a, costs[s].begin() + b);
+            int w_index = t < roots.size() ? vertices[t][j] : -1;
+            if (a > 0 && b + 1 < vertices[s].size()) {
+                costs[s][a - 1] = x;
+                costs[s].erase(costs[s].begin() + a, costs[s].begin() + b + 1);
+            } else if (a > 0) {
+                costs[s].erase(costs[s].begin() + (a - 1), costs[s].end());
+            } else {
+                costs[s].erase(costs[s].begin(), costs[s].begin() + std::min(b + 1, costs[s].size()));
+            }
+            vertices[s].erase(vertices[s].begin() + a, vertices[s].begin() + b + 1);
+
+            TreeNode<double>* p = nullptr;
+            TreeNode<double>* q = nullptr;
+            tree_ops.splice(nodes[moved.front()], nodes[moved.back()], w_index < 0 ? nullptr : nodes[w_index], x, y, z, p, q);
+            if (t < roots.size()) {
+                std::size_t k = std::find(vertices[t].begin(), vertices[t].end(), w_index) - vertices[t].begin();
+                if (k + 1 < vertices[t].size()) {
+                    costs[t][k] = z;
+                }
+                costs[t].insert(costs[t].begin() + k, moved_costs.begin(), moved_costs.end());
+                costs[t].insert(costs[t].begin() + k, y);
+                vertices[t].insert(vertices[t].begin() + k + 1, moved.begin(), moved.end());
+                roots[t] = p;
+                if (t != s) {
+                    roots[s] = q;
+                } else {
+                    assert(q == nullptr);
+                }
+            } else {
+                roots[s] = q;
+                roots.push_back(p);
+                vertices.push_back(moved);
+                costs.push_back(moved_costs);
+            }
+            if (vertices[s].empty()) {
+                assert(roots[s] == nullptr);
+                roots.erase(roots.begin() + s);
+                vertices.erase(vertices.begin() + s);
+                costs.erase(costs.begin() + s);
+            }
+            // Keep a few paths around.
+            if (roots.size() > 4) {
+                roots[0] = tree_ops.concatenate(roots[0], roots.back(), 7.0);
+                costs[0].push_back(7.0);
+                costs[0].insert(costs[0].end(), costs.back().begin(), costs.back().end());
+                vertices[0].insert(vertices[0].end(), vertices.back().begin(), vertices.back().end());
+                roots.pop_back();
+                vertices.pop_back();
+                costs.pop_back();
+            }
+
+            for (std::size_t i = 0; i < roots.size(); ++i) {
+                assert(tree_ops.path(nodes[vertices[i].front()]) == roots[i]);
+                assert(vertex_inorder(tree_ops, roots[i], vertices[i]));
+                assert(cost_inorder(tree_ops, roots[i], costs[i]));
+                if (round < 1500) {
+                    assert(vertex_links(tree_ops, roots[i], vertices[i]));
+                } else {
+                    std::size_t k = rng() % vertices[i].size();
+                    TreeNode<double>* v = nodes[vertices[i][k]];
+                    assert(tree_ops.before(v) == (k > 0 ? nodes[vertices[i][k - 1]] : nullptr));
+                    assert(tree_ops.after(v) == (k + 1 < vertices[i].size() ? nodes[vertices[i][k + 1]] : nullptr));
+                }
+                assert(roots[i]->size == static_cast<int>(vertices[i].size()));
+                dynamic_path_shape shape = tree_ops.tree_shape(roots[i]);
+                assert(shape.height <= 2 * shape.ideal_height + 1);
+                if (!costs[i].empty()) {
+                    auto min_it = std::min_element(costs[i].begin(), costs[i].end());
+                    assert(tree_ops.pmincost_before(roots[i])->node_index == vertices[i][min_it - costs[i].begin() + 1]);
+                }
+            }
+        }
+        for (std::size_t i = 0; i < roots.size(); ++i) {
+            assert(vertex_links(tree_ops, roots[i], vertices[i]));
+        }
+        tree_ops.set_balance(dynamic_path_balance::eager);
+        for (TreeNode<double>* path_root : roots) {
+            tree_ops.clearall(path_root);
+        }
+    }
+
+    // Lazy reversal
+    std::vector<double> reverse_costs(edge_num);
+    root = tree_ops.gen_new_node(true, 0);
+    external_nodes[0] = root;
+    for (std::size_t i = 0; i < edge_num; ++i) {
+        reverse_costs[i] = static_cast<double>((i * 7) % edge_num);
+        p = tree_ops.gen_new_node(true, static_cast<int>(i) + 1);
+        external_nodes[i + 1] = p;
+        root = tree_ops.concatenate(root, p, reverse_costs[i]);
+    }
+    tree_ops.reverse(root);
+    std::reverse(external_nodes.begin(), external_nodes.end());
+    std::vector<int> reverse_index_array(original_index_array.rbegin(), original_index_array.rend());
+    std::reverse(reverse_costs.begin(), reverse_costs.end());
+    assert(tree_ops.head(root)->node_index == edge_num);
+    assert(tree_ops.tail(root)->node_index == 0);
+    assert(tree_ops.before(external_nodes[0]) == nullptr);
+    assert(tree_ops.after(external_nodes[edge_num]) == nullptr);
+    for (std::size_t i = 1; i < external_nodes.size(); ++i) {
+        assert(tree_ops.before(external_nodes[i]) == external_nodes[i - 1]);
+        assert(tree_ops.after(external_nodes[i - 1]) == external_nodes[i]);
+        assert(tree_ops.pcost_before(external_nodes[i]) == reverse_costs[i - 1]);
+        assert(tree_ops.pcost_after(external_nodes[i - 1]) == reverse_costs[i - 1]);
+    }
+    assert(vertex_inorder(tree_ops, root, reverse_index_array));
+    assert(cost_inorder(tree_ops, root, reverse_costs));
+    subpathAllCorrect(tree_ops, root, external_nodes, reverse_costs, reverse_index_array);
+
+    // Reverse the sub-path (5, 15) inside the reversed path.
+    tree_ops.split_before(external_nodes[5], p, q, cost);
+    tree_ops.split_after(external_nodes[15], q, r, cost2);
+    tree_ops.reverse(q);
+    assert(tree_ops.head(q) == external_nodes[15]);
+    assert(tree_ops.tail(q) == external_nodes[5]);
+    q = tree_ops.concatenate(q, r, cost2);
+    root = tree_ops.concatenate(p, q, cost);
+    std::reverse(external_nodes.begin() + 5, external_nodes.begin() + 16);
+    std::reverse(reverse_index_array.begin() + 5, reverse_index_array.begin() + 16);
+    std::reverse(reverse_costs.begin() + 5, reverse_costs.begin() + 15);
+    assert(vertex_inorder(tree_ops, root, reverse_index_array));
+    assert(cost_inorder(tree_ops, root, reverse_costs));
+    subpathAllCorrect(tree_ops, root, external_nodes, reverse_costs, reverse_index_array);
+
+    // Rank and select through the pending reversals.
+    for (std::size_t i = 0; i < external_nodes.size(); ++i) {
+        assert(tree_ops.vertex_at(root, i) == external_nodes[i]);
+        assert(tree_ops.position(external_nodes[i]) == i);
+    }
+    assert(tree_ops.vertex_at(root, external_nodes.size()) == nullptr);
+
+    // Reversing twice restores the path.
+    tree_ops.reverse(root);
+    tree_ops.reverse(root);
+    tree_ops.pupdate(root, 2);
+    for (auto& c : reverse_costs) {
+        c += 2;
+    }
+    subpathAllCorrect(tree_ops, root, external_nodes, reverse_costs, reverse_index_array);
+
+    // Threshold and top-k enumeration of the edges of the path with pending reversals.
+    std::vector<std::pair<TreeNode<double>*, double>> edges;
+    std::vector<double> sorted_costs(reverse_costs);
+    std::sort(sorted_costs.begin(), sorted_costs.end());
+    for (double threshold : {sorted_costs.front(), sorted_costs[edge_num / 3], sorted_costs.back() + 1}) {
+        tree_ops.pcost_below(root, threshold, edges);
+        std::size_t e = 0;
+        for (std::size_t i = 0; i < reverse_costs.size(); ++i) {
+            if (reverse_costs[i] < threshold) {
+                assert(e < edges.size());
+                assert(edges[e].first->node_index == reverse_index_array[i]);
+                assert(edges[e].second == reverse_costs[i]);
+                ++e;
+            }
+        }
+        assert(e == edges.size());
+    }
+    for (std::size_t k : {std::size_t(0), std::size_t(1), edge_num / 2, edge_num + 5}) {
+        tree_ops.pmincost_k(root, k, edges);
+        assert(edges.size() == std::min(k, edge_num));
+        for (std::size_t i = 0; i < edges.size(); ++i) {
+            assert(edges[i].second == sorted_costs[i]);
+            assert(tree_ops.pcost_after(edges[i].first) == edges[i].second);
+        }
+    }
+
+    // Minimum cost edges of a snapshot restored with a pending reversal.
+    tree_ops.reverse(root);
+    std::reverse(reverse_index_array.begin(), reverse_index_array.end());
+    std::reverse(reverse_costs.begin(), reverse_costs.end());
+    const std::string snapshot_file = "dynamic_path_snapshot.bin";
+    bool saved = tree_ops.save(root, snapshot_file);
+    assert(saved);
+    std::vector<TreeNode<double>*> loaded_nodes;
+    bool loaded_ok;
+    TreeNode<double>* loaded = tree_ops.load(snapshot_file, loaded_nodes, loaded_ok);
+    std::remove(snapshot_file.c_str());
+    assert(loaded_ok);
+    std::vector<int> loaded_index_array;
+    for (TreeNode<double>* v : loaded_nodes) {
+        loaded_index_array.push_back(v->node_index);
+    }
+    assert(loaded_index_array == reverse_index_array);
+    assert(vertex_links(tree_ops, loaded, reverse_index_array));
+    auto min_it = std::min_element(reverse_costs.begin(), reverse_costs.end());
+    auto last_min_it = std::min_element(reverse_costs.rbegin(), reverse_costs.rend());
+    for (TreeNode<double>* r : {root, loaded}) {
+        assert(tree_ops.pmincost_before(r)->node_index == reverse_index_array[min_it - reverse_costs.begin() + 1]);
+        assert(tree_ops.pmincost_after(r)->node_index == reverse_index_array[reverse_costs.rend() - last_min_it - 1]);
+    }
+    tree_ops.clearall(loaded);
+    tree_ops.clearall(root);
+
+    {
+        // A snapshot of a path with a reversed sub-path, whose pending reversal is below the root.
+        std::vector<TreeNode<double>*> nodes;
+        TreeNode<double>* whole = nullptr;
+        for (int i = 0; i < 14; ++i) {
+            nodes.push_back(tree_ops.gen_new_node(true, i));
+            whole = tree_ops.concatenate(whole, nodes.back(), static_cast<double>(i % 5));
+        }
+        TreeNode<double>* head_part;
+        TreeNode<double>* middle;
+        TreeNode<double>* tail_part;
+        double x;
+        double y;
+        tree_ops.split_before(nodes[3], head_part, middle, x);
+        tree_ops.split_after(nodes[10], middle, tail_part, y);
+        tree_ops.reverse(middle);
+        whole = tree_ops.concatenate(tree_ops.concatenate(head_part, middle, x), tail_part, y);
+        std::vector<int> expected = {0, 1, 2, 10, 9, 8, 7, 6, 5, 4, 3, 11, 12, 13};
+        saved = tree_ops.save(whole, snapshot_file);
+        assert(saved);
+        loaded = tree_ops.load(snapshot_file, loaded_nodes, loaded_ok);
+        std::remove(snapshot_file.c_str());
+        assert(loaded_ok);
+        loaded_index_array.clear();
+        for (TreeNode<double>* v : loaded_nodes) {
+            loaded_index_array.push_back(v->node_index);
+        }
+        std::vector<int> loaded_vertices;
+        tree_ops.vectorizeVertex(loaded, loaded_vertices);
+        assert(loaded_index_array == expected && loaded_vertices == expected);
+        assert(vertex_links(tree_ops, loaded, expected));
+        tree_ops.clearall(loaded);
+
+        // Corrupt node and vertex counts in the header, which the checksum does not cover, fail cleanly.
+        for (uint64_t count : {uint64_t(1) << 61, uint64_t(1) << 40, uint64_t(27), uint64_t(0)}) {
+            saved = tree_ops.save(whole, snapshot_file);
+            assert(saved);
+            {
+                std::fstream patch(snapshot_file, std::ios::in | std::ios::out | std::ios::binary);
+                // node_count and vertex_count follow the 8-byte magic, the version and the value tag.
+                patch.seekp(16);
+                patch.write(reinterpret_cast<const char*>(&count), sizeof(count));
+                patch.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            }
+            loaded = tree_ops.load(snapshot_file, loaded_nodes, loaded_ok);
+            std::remove(snapshot_file.c_str());
+            assert(!loaded_ok && loaded == nullptr && loaded_nodes.empty());
+        }
+        tree_ops.clearall(whole);
+    }
+
+    // Deferred balance mode: paths built by appends and prepends stay within twice the ideal height.
+    dynamic_path_ops<double> deferred_ops;
+    deferred_ops.set_balance(dynamic_path_balance::deferred);
+    assert(deferred_ops.balance() == dynamic_path_balance::deferred);
+    const int deferred_num = 5000;
+    std::vector<TreeNode<double>*> deferred_nodes(deferred_num);
+    std::vector<int> deferred_index_array;
+    std::vector<double> deferred_costs;
+    TreeNode<double>* front = nullptr;
+    TreeNode<double>* back = nullptr;
+    for (int i = 0; i < deferred_num; ++i) {
+        deferred_nodes[i] = deferred_ops.gen_new_node(true, i);
+        TreeNode<double>*& grown = i % 2 ? front : back;
+        grown = i % 2 ? deferred_ops.concatenate(deferred_nodes[i], front, double(i % 17))
+                      : deferred_ops.concatenate(back, deferred_nodes[i], double(i % 13));
+        if (i % 1000 == 998) {
+            // Reverse on the way, so that rebuilds meet pending reversals.
+            deferred_ops.reverse(grown);
+        }
+        dynamic_path_shape deferred_shape = deferred_ops.tree_shape(grown);
+        assert(deferred_shape.height <= 2 * deferred_shape.ideal_height);
+    }
+    back = deferred_ops.concatenate(front, back, 3);
+    deferred_ops.vectorizeVertex(back, deferred_index_array);
+    deferred_ops.vectorize(back, deferred_costs);
+    assert(deferred_index_array.size() == std::size_t(deferred_num) && deferred_costs.size() == std::size_t(deferred_num - 1));
+    TreeNode<double>* rebuilt = deferred_ops.rebuild(back);
+    dynamic_path_shape rebuilt_shape = deferred_ops.tree_shape(rebuilt);
+    assert(rebuilt_shape.height == rebuilt_shape.ideal_height);
+    std::vector<int> rebuilt_index_array;
+    std::vector<double> rebuilt_costs;
+    deferred_ops.vectorizeVertex(rebuilt, rebuilt_index_array);
+    deferred_ops.vectorize(rebuilt, rebuilt_costs);
+    assert(rebuilt_index_array == deferred_index_array);
+    assert(rebuilt_costs == deferred_costs);
+    for (int i = 1; i < deferred_num; ++i) {
+        assert(deferred_ops.after(deferred_nodes[deferred_index_array[i - 1]]) == deferred_nodes[deferred_index_array[i]]);
+    }
+    auto deferred_min = std::min_element(deferred_costs.begin(), deferred_costs.end());
+    assert(deferred_ops.pmincost_before(rebuilt)->node_index == deferred_index_array[deferred_min - deferred_costs.begin() + 1]);
+    // Split pieces are settled too.
+    deferred_ops.split_before(deferred_nodes[deferred_index_array[deferred_num / 3]], p, q, cost);
+    for (TreeNode<double>* part : {p, q}) {
+        dynamic_path_shape part_shape = deferred_ops.tree_shape(part);
+        assert(part_shape.height <= 2 * part_shape.ideal_height);
+    }
+    assert(cost == deferred_costs[deferred_num / 3 - 1]);
+    deferred_ops.clearall(p);
+    deferred_ops.clearall(q);
+
+    {
+        // Relayout of a path aged by random splits and concatenations, whole and by slices interleaved with other
+        // operations: same vertices, costs and links, handles kept, and minimal height once complete.
+        auto rng = std::default_random_engine {};
+        const int relayout_num = 700;
+        std::vector<TreeNode<double>*> relayout_nodes(relayout_num);
+        std::vector<int> relayout_index_array(relayout_num);
+        std::vector<double> relayout_costs(relayout_num - 1);
+        TreeNode<double>* aged = nullptr;
+        for (int i = 0; i < relayout_num; ++i) {
+            relayout_nodes[i] = tree_ops.gen_new_node(true, i);
+            relayout_index_array[i] = i;
+            if (aged) {
+                relayout_costs[i - 1] = static_cast<double>(rng() % 100);
+            }
+            aged = tree_ops.concatenate(aged, relayout_nodes[i], aged ? relayout_costs[i - 1] : 0.0);
+        }
+        auto age = [&] {
+            // Move a random inner sub-path to the end.
+            std::size_t a = 1 + rng() % (relayout_num - 2);
+            std::size_t b = a + rng() % (relayout_num - 1 - a);
+            double x;
+            double y;
+            TreeNode<double>* r;
+            tree_ops.split_before(relayout_nodes[relayout_index_array[a]], p, q, x);
+            tree_ops.split_after(relayout_nodes[relayout_index_array[b]], q, r, y);
+            aged = tree_ops.concatenate(tree_ops.concatenate(p, r, y), q, x);
+            std::vector<double> moved_costs(relayout_costs.begin() + a, relayout_costs.begin() + b);
+            relayout_costs.erase(relayout_costs.begin() + a, relayout_costs.begin() + b + 1);
+            relayout_costs[a - 1] = y;
+            relayout_costs.push_back(x);
+            relayout_costs.insert(relayout_costs.end(), moved_costs.begin(), moved_costs.end());
+            std::rotate(relayout_index_array.begin() + a, relayout_index_array.begin() + b + 1, relayout_index_array.end());
+        };
+        auto check = [&] {
+            assert(tree_ops.path(relayout_nodes[0]) == aged);
+            assert(vertex_inorder(tree_ops, aged, relayout_index_array));
+            assert(vertex_links(tree_ops, aged, relayout_index_array));
+            assert(cost_inorder(tree_ops, aged, relayout_costs));
+            auto min_it = std::min_element(relayout_costs.begin(), relayout_costs.end());
+            assert(tree_ops.pmincost_before(aged)->node_index == relayout_index_array[min_it - relayout_costs.begin() + 1]);
+            for (int i : {0, relayout_num / 2, relayout_num - 1}) {
+                assert(tree_ops.vertex_at(aged, i) == relayout_nodes[relayout_index_array[i]]);
+            }
+        };
+        for (int round = 0; round < 4; ++round) {
+            for (int i = 0; i < 200; ++i) {
+                age();
+            }
+            check();
+            if (round % 2 == 0) {
+                aged = tree_ops.relayout(aged);
+            } else {
+                std::size_t cursor = 0;
+                std::size_t budget = round == 1 ? 1 : 37;
+                while (!tree_ops.relayout_step(aged, cursor, budget)) {
+                    // The slices leave a valid path behind them.
+                    check();
+                    if (round == 3 && rng() % 4 == 0) {
+                        age();
+                    }
+                }
+            }
+            check();
+            dynamic_path_shape relaid_shape = tree_ops.tree_shape(aged);
+            assert(relaid_shape.height == relaid_shape.ideal_height || round == 3);
+            assert(relaid_shape.height <= 2 * relaid_shape.ideal_height);
+        }
+        TreeNode<double>* single = tree_ops.gen_new_node(true, 0);
+        assert(tree_ops.relayout(single) == single);
+        std::size_t single_cursor = 0;
+        bool single_done = tree_ops.relayout_step(single, single_cursor, 4);
+        assert(single_done);
+        tree_ops.clearall(single);
+        tree_ops.clearall(aged);
+    }
+
+    {
+        // Random assignments, affine and constant updates of sub-paths with reversals, against reference vectors of
+        // vertices and edge costs. The first and last minimum cost edges are checked after every step.
+        auto rng = std::default_random_engine {};
+        dynamic_path_ops<int> scaled_ops;
+        std::vector<TreeNode<int>*> vertices;
+        std::vector<int> costs;
+        TreeNode<int>* scaled = nullptr;
+        for (int i = 0; i < 40; ++i) {
+            vertices.push_back(scaled_ops.gen_new_node(true, i));
+            if (scaled) {
+                costs.push_back(static_cast<int>(rng() % 20));
+            }
+            scaled = scaled_ops.concatenate(scaled, vertices.back(), scaled ? costs.back() : 0);
+        }
+        assert(!scaled_ops.paffine(scaled, 0, 1) && !scaled_ops.paffine(scaled, -1, 1));
+        for (int round = 0; round < 400; ++round) {
+            if (rng() % 5 == 0) {
+                scaled_ops.reverse(scaled);
+                std::reverse(vertices.begin(), vertices.end());
+                std::reverse(costs.begin(), costs.end());
+            }
+            std::size_t a = rng() % (vertices.size() - 1);
+            std::size_t b = a + 1 + rng() % (vertices.size() - a - 1);
+            TreeNode<int>* p = nullptr;
+            TreeNode<int>* q = nullptr;
+            TreeNode<int>* r = nullptr;
+            int x;
+            int y;
+            scaled_ops.split_before(vertices[a], p, q, x);
+            scaled_ops.split_after(vertices[b], q, r, y);
+            int op = static_cast<int>(rng() % 3);
+            int c = static_cast<int>(rng() % 20);
+            bool updated = true;
+            if (op == 0) {
+                updated = scaled_ops.passign(q, c);
+                std::fill(costs.begin() + a, costs.begin() + b, c);
+            } else if (op == 1) {
+                int factor = 1 + static_cast<int>(rng() % 2);
+                updated = scaled_ops.paffine(q, factor, c - 10);
+                for (std::size_t i = a; i < b; ++i) {
+                    costs[i] = factor * costs[i] + c - 10;
+                }
+            } else {
+                scaled_ops.pupdate(q, c - 10);
+                for (std::size_t i = a; i < b; ++i) {
+                    costs[i] += c - 10;
+                }
+            }
+            assert(updated);
+            scaled = scaled_ops.concatenate(scaled_ops.concatenate(p, q, x), r, y);
+            // Keep the costs small.
+            if (*std::max_element(costs.begin(), costs.end()) > 100000) {
+                bool assigned = scaled_ops.passign(scaled, 1);
+                assert(assigned);
+                std::fill(costs.begin(), costs.end(), 1);
+            }
+
+            assert(cost_inorder(scaled_ops, scaled, costs));
+            std::size_t first = std::min_element(costs.begin(), costs.end()) - costs.begin();
+            std::size_t last = costs.size() - 1 - (std::min_element(costs.rbegin(), costs.rend()) - costs.rbegin());
+            assert(scaled_ops.pmincost_before(scaled) == vertices[first + 1]);
+            assert(scaled_ops.pmincost_after(scaled) == vertices[last]);
+            std::size_t i = rng() % costs.size();
+            assert(scaled_ops.pcost_after(vertices[i]) == costs[i]);
+
+            // Random disjoint ranges of edge positions.
+            std::vector<std::pair<std::size_t, std::size_t>> ranges;
+            std::vector<int> range_costs;
+            std::vector<int> range_reference;
+            for (std::size_t begin = rng() % 8; begin < costs.size(); begin += 1 + rng() % 8) {
+                std::size_t end = std::min(costs.size(), begin + 1 + rng() % 6);
+                ranges.emplace_back(begin, end);
+                range_reference.insert(range_reference.end(), costs.begin() + begin, costs.begin() + end);
+                begin = end;
+            }
+            scaled_ops.vectorize_ranges(scaled, ranges, range_costs);
+            assert(range_costs == range_reference);
+        }
+        std::vector<int> index_reference;
+        for (TreeNode<int>* v : vertices) {
+            index_reference.push_back(v->node_index);
+        }
+        subpathAllCorrect(scaled_ops, scaled, vertices, costs, index_reference);
+
+        // Enumerations and snapshots see through pending scalings.
+        bool assigned = scaled_ops.passign(scaled, 5);
+        bool scaled_up = scaled_ops.paffine(scaled, 3, -1);
+        assert(assigned && scaled_up);
+        std::vector<std::pair<TreeNode<int>*, int>> edges;
+        scaled_ops.pcost_below(scaled, 15, edges);
+        assert(edges.size() == costs.size() && edges.front().second == 14 && edges.front().first == vertices[0]);
+        scaled_ops.pmincost_k(scaled, 3, edges);
+        assert(edges.size() == 3 && edges.back().second == 14);
+        const std::string scaled_file = "dynamic_path_scaled.bin";
+        bool saved = scaled_ops.save(scaled, scaled_file);
+        std::vector<TreeNode<int>*> loaded_nodes;
+        bool loaded_ok;
+        TreeNode<int>* loaded = scaled_ops.load(scaled_file, loaded_nodes, loaded_ok);
+        std::remove(scaled_file.c_str());
+        assert(saved && loaded_ok && cost_inorder(scaled_ops, loaded, std::vector<int>(costs.size(), 14)));
+        scaled_ops.clearall(loaded);
+        scaled_ops.clearall(scaled);
+    }
+
+    {
+        // Random transactions of updates, reversals, splits, concatenations and splices over a few paths, rolled back
+        // to a savepoint in the middle and then to the start, against snapshots of all paths.
+        auto rng = std::default_random_engine {};
+        dynamic_path_ops<int> txn_ops;
+        std::vector<TreeNode<int>*> nodes;
+        for (int path_index = 0; path_index < 3; ++path_index) {
+            TreeNode<int>* root = nullptr;
+            for (int i = 0; i < 30; ++i) {
+                nodes.push_back(txn_ops.gen_new_node(true, static_cast<int>(nodes.size())));
+                root = txn_ops.concatenate(root, nodes.back(), static_cast<int>(rng() % 50));
+            }
+        }
+        // Vertices and costs of every path, ordered by their head vertex.
+        auto snapshot = [&]() {
+            std::vector<std::pair<std::vector<int>, std::vector<int>>> paths;
+            for (TreeNode<int>* v : nodes) {
+                TreeNode<int>* root = txn_ops.path(v);
+                if (txn_ops.head(root) == v) {
+                    paths.emplace_back();
+                    txn_ops.vectorizeVertex(root, paths.back().first);
+                    txn_ops.vectorize(root, paths.back().second);
+                }
+            }
+            std::sort(paths.begin(), paths.end());
+            return paths;
+        };
+        auto random_edit = [&]() {
+            TreeNode<int>* v = nodes[rng() % nodes.size()];
+            TreeNode<int>* p = nullptr;
+            TreeNode<int>* q = nullptr;
+            int cost;
+            int op = static_cast<int>(rng() % 5);
+            if (op == 0 && !txn_ops.path(v)->external) {
+                txn_ops.pupdate(txn_ops.path(v), static_cast<int>(rng() % 20) - 10);
+            } else if (op == 1) {
+                txn_ops.reverse(txn_ops.path(v));
+            } else if (op == 2) {
+                txn_ops.split_before(v, p, q, cost);
+            } else if (op == 3) {
+                TreeNode<int>* w = nodes[rng() % nodes.size()];
+                if (txn_ops.path(v) != txn_ops.path(w)) {
+                    txn_ops.concatenate(txn_ops.path(v), txn_ops.path(w), static_cast<int>(rng() % 50));
+                }
+            } else {
+                // Sub-path from v to a vertex after it, moved after a vertex outside of it, or to a path of its own.
+                TreeNode<int>* u = v;
+                for (int steps = static_cast<int>(rng() % 5); steps > 0 && txn_ops.after(u); --steps) {
+                    u = txn_ops.after(u);
+                }
+                TreeNode<int>* w = rng() % 4 == 0 ? nullptr : nodes[rng() % nodes.size()];
+                if (w && txn_ops.path(w) == txn_ops.path(v) &&
+                    txn_ops.position(v) <= txn_ops.position(w) && txn_ops.position(w) <= txn_ops.position(u)) {
+                    return;
+                }
+                txn_ops.splice(v, u, w, static_cast<int>(rng() % 50), static_cast<int>(rng() % 50),
+                               static_cast<int>(rng() % 50), p, q);
+            }
+        };
+
+        assert(!txn_ops.in_transaction() && !txn_ops.rollback(0));
+        for (int round = 0; round < 20; ++round) {
+            auto start = snapshot();
+            std::size_t begin = txn_ops.begin_transaction();
+            assert(txn_ops.in_transaction() && begin == 0);
+            for (int i = 0; i < 30; ++i) {
+                random_edit();
+            }
+            auto middle = snapshot();
+            std::size_t savepoint = txn_ops.savepoint();
+            for (int i = 0; i < 30; ++i) {
+                random_edit();
+            }
+            assert(!txn_ops.rollback(txn_ops.savepoint() + 1));
+            bool undone = txn_ops.rollback(savepoint);
+            assert(undone && snapshot() == middle && txn_ops.savepoint() == savepoint);
+            if (round % 2 == 0) {
+                undone = txn_ops.rollback(begin);
+                assert(undone && snapshot() == start);
+            } else {
+                // Committed edits stay.
+                txn_ops.commit();
+                assert(!txn_ops.in_transaction() && txn_ops.savepoint() == 0 && snapshot() == middle);
+            }
+        }
+        txn_ops.commit();
+        std::vector<TreeNode<int>*> roots;
+        for (TreeNode<int>* v : nodes) {
+            TreeNode<int>* root = txn_ops.path(v);
+            if (txn_ops.head(root) == v) {
+                roots.push_back(root);
+            }
+        }
+        for (TreeNode<int>* root : roots) {
+            txn_ops.clearall(root);
+        }
+    }
+
+#ifdef DYNAMIC_PATH_STATS
+    // Structural counters
+    const dynamic_path_stats& stats = tree_ops.stats();
+    assert(stats.live_nodes() == 0);
+    assert(stats.node_bytes == 0);
+    assert(stats.constructs > 0 && stats.destroys > 0);
+    assert(stats.splits > 0 && stats.split_destroys >= stats.splits);
+    {
+        // Splits along a path: each construct_ call they make is counted once.
+        std::vector<TreeNode<double>*> split_nodes;
+        for (int i = 0; i < 33; ++i) {
+            split_nodes.push_back(tree_ops.gen_new_node(true, i));
+        }
+        for (std::size_t i = 0; i + 1 < split_nodes.size(); ++i) {
+            TreeNode<double>* left = tree_ops.path(split_nodes[i]);
+            TreeNode<double>* right = tree_ops.path(split_nodes[i + 1]);
+            tree_ops.concatenate(left, right, static_cast<double>(i));
+        }
+        for (std::size_t i = 0; i + 1 < split_nodes.size(); ++i) {
+            TreeNode<double>* root = tree_ops.path(split_nodes[i]);
+            // Every other split is at the edge of the root.
+            TreeNode<double>* v = i % 2 == 0 ? tree_ops.vertex_at(root, root->bleft->size - 1) : split_nodes[i];
+            uint64_t constructs = stats.constructs;
+            uint64_t split_constructs = stats.split_constructs;
+            TreeNode<double>* p;
+            TreeNode<double>* q;
+            double cost;
+            tree_ops.split_after(v, p, q, cost);
+            assert(stats.split_constructs - split_constructs == stats.constructs - constructs);
+            tree_ops.concatenate(p, q, cost);
+        }
+        tree_ops.clearall(tree_ops.path(split_nodes[0]));
+    }
+    assert(stats.rotate_left + stats.rotate_right > 0);
+    assert(stats.root_walks > 0 && stats.root_walk_max > 0);
+    assert(stats.relayouts > 0 && stats.relayout_nodes > 0);
+    tree_ops.reset_stats();
+    assert(tree_ops.stats().constructs == 0);
+#endif
+
     std::cout << "All unit tests of dynamic_path_ops passed!\n";
 }
 
@@ -385,9 +1109,1251 @@ void dp_array_unit_tests() {
     dp_array<double> dynamic_array2(original_array);
     subpathAllCorrect(dynamic_array2, original_array);
 
+    // Snapshot round trip
+    const std::string snapshot_file = "dp_array_snapshot.bin";
+    bool saved = dynamic_array2.save(snapshot_file);
+    assert(saved);
+    dp_array<double> dynamic_array3(std::vector<double>{1.0});
+    bool loaded = dynamic_array3.load(snapshot_file);
+    assert(loaded);
+    assert(dynamic_array3.edge_num() == edge_num);
+    assert(dynamic_array3 == original_array);
+    subpathAllCorrect(dynamic_array3, original_array);
+    dp_array<float> wrong_type(std::vector<float>{1.0f});
+    assert(!wrong_type.load(snapshot_file));
+    {
+        // A corrupt vertex count in the header is reported, not thrown.
+        std::fstream patch(snapshot_file, std::ios::in | std::ios::out | std::ios::binary);
+        const uint64_t count = uint64_t(1) << 61;
+        patch.seekp(16);
+        patch.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        patch.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    assert(!dynamic_array3.load(snapshot_file));
+    assert(dynamic_array3 == original_array);
+    std::remove(snapshot_file.c_str());
+    assert(!dynamic_array3.load(snapshot_file));
+    assert(dynamic_array3.edge_num() == edge_num);
+
+    // Out-of-core node storage
+    {
+        mmap_node_storage<double> storage("dp_array_nodes.scratch", 2 * edge_num + 1);
+        assert(storage.is_open());
+        dp_array<double> dynamic_array4(original_array, &storage);
+        assert(storage.size() == storage.capacity());
+        assert(dynamic_array4 == original_array);
+        subpathAllCorrect(dynamic_array4, original_array);
+        dynamic_array4.update_constant(3, 9, -2.5);
+        for (std::size_t i = 3; i < 9; ++i) {
+            original_array[i] -= 2.5;
+        }
+        assert(dynamic_array4 == original_array);
+        subpathAllCorrect(dynamic_array4, original_array);
+    }
+
+    // Segment tree mode
+    {
+        dp_array<double> static_array(original_array, dp_array_mode::segment_tree);
+        assert(static_array.mode() == dp_array_mode::segment_tree);
+        assert(static_array.edge_num() == edge_num);
+        assert(static_array.vertex_num() == edge_num + 1);
+        assert(static_array == original_array);
+        subpathAllCorrect(static_array, original_array);
+        assert(!static_array.save(snapshot_file));
+        assert(!static_array.edge_cost(static_cast<int>(edge_num)));
+        assert(!static_array.min_cost_first(3, 3, min_index));
+        assert(!static_array.min_cost_last(0, static_cast<int>(edge_num) + 1, min_index));
+
+        // Same results and tie-breaking as the dynamic mode, on costs with many ties.
+        auto rng = std::default_random_engine {};
+        std::vector<int> costs(1000);
+        for (std::size_t i = 0; i < costs.size(); ++i) {
+            costs[i] = static_cast<int>(rng() % 4);
+        }
+        dp_array<int> dynamic_ints(costs);
+        dp_array<int> static_ints(costs, dp_array_mode::segment_tree);
+        for (int round = 0; round < 2000; ++round) {
+            int i_k = static_cast<int>(rng() % costs.size());
+            int i_l = i_k + 1 + static_cast<int>(rng() % (costs.size() - i_k));
+            int w = static_cast<int>(rng() % 5) - 2;
+            int dynamic_index = -1;
+            int static_index = -2;
+            switch (rng() % 6) {
+                case 0:
+                    dynamic_ints.update_constant(i_k, w);
+                    static_ints.update_constant(i_k, w);
+                    break;
+                case 1:
+                    dynamic_ints.update_constant(i_k, i_l, w);
+                    static_ints.update_constant(i_k, i_l, w);
+                    break;
+                case 2:
+                    assert(dynamic_ints.min_cost_first(i_k, dynamic_index) == static_ints.min_cost_first(i_k, static_index));
+                    assert(dynamic_index == static_index);
+                    break;
+                case 3:
+                    assert(dynamic_ints.min_cost_first(i_k, i_l, dynamic_index) == static_ints.min_cost_first(i_k, i_l, static_index));
+                    assert(dynamic_index == static_index);
+                    break;
+                case 4:
+                    assert(dynamic_ints.min_cost_last(i_k, dynamic_index) == static_ints.min_cost_last(i_k, static_index));
+                    assert(dynamic_index == static_index);
+                    break;
+                default:
+                    assert(dynamic_ints.min_cost_last(i_k, i_l, dynamic_index) == static_ints.min_cost_last(i_k, i_l, static_index));
+                    assert(dynamic_index == static_index);
+                    break;
+            }
+        }
+        std::vector<int> dynamic_output;
+        std::vector<int> static_output;
+        bool vectorized = dynamic_ints.vectorize(dynamic_output);
+        vectorized = static_ints.vectorize(static_output) && vectorized;
+        assert(vectorized);
+        assert(dynamic_output == static_output);
+
+        // Enumeration queries: same edges in both modes, checked against the vectorized costs.
+        std::vector<std::pair<int, int>> dynamic_edges;
+        std::vector<std::pair<int, int>> static_edges;
+        assert(!dynamic_ints.edges_below(5, 5, 0, dynamic_edges));
+        assert(!static_ints.min_cost_k(static_cast<int>(costs.size()), 3, static_edges));
+        for (int round = 0; round < 200; ++round) {
+            int i_k = static_cast<int>(rng() % costs.size());
+            int i_l = i_k + 1 + static_cast<int>(rng() % (costs.size() - i_k));
+            int threshold = static_cast<int>(rng() % 12) - 6;
+            bool reported = dynamic_ints.edges_below(i_k, i_l, threshold, dynamic_edges);
+            reported = static_ints.edges_below(i_k, i_l, threshold, static_edges) && reported;
+            assert(reported);
+            assert(dynamic_edges == static_edges);
+            std::size_t e = 0;
+            for (int i = i_k; i < i_l; ++i) {
+                if (dynamic_output[i] < threshold) {
+                    assert(dynamic_edges[e++] == std::make_pair(i, dynamic_output[i]));
+                }
+            }
+            assert(e == dynamic_edges.size());
+
+            std::size_t k = rng() % 40;
+            reported = dynamic_ints.min_cost_k(i_k, i_l, k, dynamic_edges);
+            reported = static_ints.min_cost_k(i_k, i_l, k, static_edges) && reported;
+            assert(reported);
+            std::vector<int> range(dynamic_output.begin() + i_k, dynamic_output.begin() + i_l);
+            std::sort(range.begin(), range.end());
+            range.resize(std::min(k, range.size()));
+            for (const auto* reported : {&dynamic_edges, &static_edges}) {
+                assert(reported->size() == range.size());
+                for (std::size_t i = 0; i < range.size(); ++i) {
+                    int index = (*reported)[i].first;
+                    assert(i_k <= index && index < i_l);
+                    assert((*reported)[i].second == range[i] && dynamic_output[index] == range[i]);
+                }
+            }
+        }
+        bool reported = dynamic_ints.min_cost_k(0, costs.size(), dynamic_edges);
+        assert(reported);
+        assert(dynamic_edges.size() == costs.size());
+        assert(!static_ints.push_back(1) && !static_ints.pop_front());
+    }
+
+    {
+        // Deque API: random pushes and pops at both ends against a reference deque of edge costs.
+        auto rng = std::default_random_engine {};
+        dp_array<int> window(std::vector<int>{});
+        std::deque<int> reference;
+        std::optional<int> popped = window.pop_back();
+        assert(!popped && !window.pop_front());
+        bool pushed;
+        for (int round = 0; round < 20000; ++round) {
+            int w = static_cast<int>(rng() % 100);
+            switch (rng() % (reference.size() < 300 ? 4 : 5)) {
+                case 0:
+                    pushed = window.push_back(w);
+                    assert(pushed);
+                    reference.push_back(w);
+                    break;
+                case 1:
+                    pushed = window.push_front(w);
+                    assert(pushed);
+                    reference.push_front(w);
+                    break;
+                case 2:
+                    popped = window.pop_back();
+                    assert(popped == (reference.empty() ? std::optional<int>() : reference.back()));
+                    if (!reference.empty()) {
+                        reference.pop_back();
+                    }
+                    break;
+                default:
+                    popped = window.pop_front();
+                    assert(popped == (reference.empty() ? std::optional<int>() : reference.front()));
+                    if (!reference.empty()) {
+                        reference.pop_front();
+                    }
+                    break;
+            }
+            assert(window.edge_num() == reference.size());
+            assert(window.vertex_num() == (reference.empty() ? 0 : reference.size() + 1));
+            if (round % 97 == 0 && !reference.empty()) {
+                std::vector<int> output;
+                bool vectorized = window.vectorize(output);
+                assert(vectorized);
+                assert(std::equal(output.begin(), output.end(), reference.begin(), reference.end()));
+                int i_k = static_cast<int>(rng() % reference.size());
+                int min_index = -1;
+                auto min_it = std::min_element(reference.begin() + i_k, reference.end());
+                assert(window.min_cost_first(i_k, min_index) == *min_it);
+                assert(min_index == min_it - reference.begin());
+                assert(window.edge_cost(i_k) == reference[i_k]);
+            }
+        }
+        // Sliding window minimum.
+        dp_array<int> sliding(std::vector<int>{});
+        std::vector<int> stream(5000);
+        for (auto& value : stream) {
+            value = static_cast<int>(rng() % 1000);
+        }
+        const std::size_t width = 64;
+        int min_index = -1;
+        for (std::size_t i = 0; i < stream.size(); ++i) {
+            sliding.push_back(stream[i]);
+            if (sliding.edge_num() > width) {
+                sliding.pop_front();
+            }
+            std::size_t first = i + 1 > width ? i + 1 - width : 0;
+            assert(sliding.min_cost_first(0, min_index) == *std::min_element(stream.begin() + first, stream.begin() + i + 1));
+        }
+        assert(sliding.tree_shape().height <= 2 * sliding.tree_shape().ideal_height);
+    }
+
+    {
+        // Inserts and erases at random positions against a reference vector of edge costs.
+        auto rng = std::default_random_engine {};
+        dp_array<int> edited(std::vector<int>{3, 1, 4, 1, 5});
+        std::vector<int> reference{3, 1, 4, 1, 5};
+        assert(!edited.insert(-1, 0) && !edited.insert(6, 0) && !edited.erase(5));
+        for (int round = 0; round < 600; ++round) {
+            int w = static_cast<int>(rng() % 100);
+            if (reference.empty() || rng() % 3 != 0) {
+                int i_k = static_cast<int>(rng() % (reference.size() + 1));
+                bool inserted = edited.insert(i_k, w);
+                assert(inserted);
+                reference.insert(reference.begin() + i_k, w);
+            } else {
+                int i_k = static_cast<int>(rng() % reference.size());
+                std::optional<int> erased = edited.erase(i_k);
+                assert(erased == reference[i_k]);
+                reference.erase(reference.begin() + i_k);
+            }
+            assert(edited.edge_num() == reference.size());
+            if (round % 7 == 0 && reference.size() > 1) {
+                assert(edited == reference);
+                int i_k = static_cast<int>(rng() % reference.size());
+                int i_l = i_k + 1 + static_cast<int>(rng() % (reference.size() - i_k));
+                int min_index = -1;
+                auto min_it = std::min_element(reference.begin() + i_k, reference.begin() + i_l);
+                assert(edited.min_cost_first(i_k, i_l, min_index) == *min_it);
+                assert(min_index == min_it - reference.begin());
+                assert(edited.edge_cost(i_l - 1) == reference[i_l - 1]);
+            }
+        }
+        subpathAllCorrect(edited, reference);
+
+        // Moves of random (sub-)paths, after a vertex or to the head.
+        assert(!edited.move_range(3, 5, 4, 0, 0, 0) && !edited.move_range(5, 3, 0, 0, 0, 0) && !edited.move_range(0, 1, -2, 0, 0, 0));
+        for (int round = 0; round < 300; ++round) {
+            int n = static_cast<int>(reference.size()) + 1;
+            int a = static_cast<int>(rng() % n);
+            int b = a + static_cast<int>(rng() % std::min(n - a, 10));
+            int m = static_cast<int>(rng() % (n + 1)) - 1;
+            if (a <= m && m <= b) {
+                continue;
+            }
+            int x = static_cast<int>(rng() % 100);
+            int y = static_cast<int>(rng() % 100);
+            int z = static_cast<int>(rng() % 100);
+            bool moved = edited.move_range(a, b, m, x, y, z);
+            assert(moved);
+
+            std::vector<int> moved_costs(reference.begin() + a, reference.begin() + b);
+            std::vector<int> rest(reference.begin(), reference.begin() + std::max(a - 1, 0));
+            if (a > 0 && b < n - 1) {
+                rest.push_back(x);
+            }
+            rest.insert(rest.end(), reference.begin() + std::min(b + 1, n - 1), reference.end());
+            int rest_n = n - (b - a + 1);
+            int m_rest = m < a ? m : m - (b - a + 1);
+            reference.assign(rest.begin(), rest.begin() + std::max(m_rest, 0));
+            if (m_rest >= 0) {
+                reference.push_back(y);
+            }
+            reference.insert(reference.end(), moved_costs.begin(), moved_costs.end());
+            if (m_rest < rest_n - 1) {
+                reference.push_back(z);
+                reference.insert(reference.end(), rest.begin() + m_rest + 1, rest.end());
+            }
+            assert(edited == reference);
+        }
+        subpathAllCorrect(edited, reference);
+
+        // A snapshot of positionally indexed vertices loads back positionally indexed.
+        const std::string edited_file = "dp_array_edited.bin";
+        bool saved = edited.save(edited_file);
+        dp_array<int> reloaded(std::vector<int>{1});
+        bool loaded = reloaded.load(edited_file);
+        std::remove(edited_file.c_str());
+        assert(saved && loaded);
+        assert(reloaded == reference);
+        bool pushed = reloaded.push_front(7);
+        std::optional<int> popped = reloaded.pop_back();
+        assert(pushed && popped == reference.back() && reloaded.edge_cost(0) == 7);
+    }
+
+    {
+        // Splits into random parts and appends in another order, against reference vectors of edge costs.
+        auto rng = std::default_random_engine {};
+        std::vector<int> reference(300);
+        for (int& cost : reference) {
+            cost = static_cast<int>(rng() % 100);
+        }
+        dp_array<int> joined(reference);
+        dp_array<int> other(std::vector<int>{});
+        dp_array<int> static_ints(reference, dp_array_mode::segment_tree);
+        assert(!joined.append(std::move(joined), 0) && !joined.split_off(0, joined));
+        assert(!joined.append(std::move(static_ints), 0) && !static_ints.split_off(0, other));
+        assert(!joined.split_off(-1, other) && !joined.split_off(300, other));
+        {
+            mmap_node_storage<int> storage("dp_array_append.scratch", 16);
+            dp_array<int> stored(std::vector<int>{1, 2}, &storage);
+            assert(!joined.append(std::move(stored), 0) && !joined.split_off(0, stored));
+            assert(stored == std::vector<int>({1, 2}));
+        }
+        std::remove("dp_array_append.scratch");
+
+        // An empty dp_array does not vectorize.
+        auto matches = [](const dp_array<int>& part, const std::vector<int>& costs) {
+            return costs.empty() ? part.vertex_num() == 0 : part == costs;
+        };
+        for (int round = 0; round < 200; ++round) {
+            int i_k = static_cast<int>(rng() % reference.size());
+            std::optional<int> cost = joined.split_off(i_k, other);
+            assert(cost == reference[i_k]);
+            std::vector<int> head(reference.begin(), reference.begin() + i_k);
+            std::vector<int> tail(reference.begin() + i_k + 1, reference.end());
+            assert(matches(joined, head) && matches(other, tail));
+
+            // Swap both parts around a new edge, or put them back.
+            int w = static_cast<int>(rng() % 100);
+            bool appended;
+            if (rng() % 2 == 0) {
+                appended = other.append(std::move(joined), w);
+                std::swap(joined, other);
+                reference = tail;
+                reference.push_back(w);
+                reference.insert(reference.end(), head.begin(), head.end());
+            } else {
+                appended = joined.append(std::move(other), *cost);
+            }
+            assert(appended && other.edge_num() == 0 && joined == reference);
+            if (round % 20 == 0) {
+                subpathAllCorrect(joined, reference);
+                int i_l = static_cast<int>(rng() % reference.size());
+                std::optional<int> erased = joined.erase(i_l);
+                bool inserted = joined.insert(i_l, *erased + 1);
+                ++reference[i_l];
+                assert(inserted && joined == reference);
+            }
+        }
+        // Parts left with a single vertex are empty, and an empty dp_array appends as a single vertex.
+        std::optional<int> first = joined.split_off(0, other);
+        assert(first == reference[0] && joined.vertex_num() == 0 && other.edge_num() == reference.size() - 1);
+        bool prepended = joined.append(std::move(other), *first);
+        std::optional<int> last = joined.split_off(static_cast<int>(reference.size()) - 1, other);
+        assert(prepended && last == reference.back() && other.vertex_num() == 0);
+        bool pushed = joined.append(std::move(other), *last);
+        assert(pushed && joined == reference);
+
+        // Relayout of the aged path: same costs, minimal height.
+        bool relaid = joined.relayout();
+        assert(relaid && joined == reference);
+        assert(joined.tree_shape().height == joined.tree_shape().ideal_height);
+        subpathAllCorrect(joined, reference);
+        assert(!other.relayout() && !static_ints.relayout());
+
+#ifdef DYNAMIC_PATH_STATS
+        // The TreeNodes are accounted to the dp_array holding them.
+        assert(joined.stats().live_nodes() == 2 * joined.vertex_num() - 1);
+        assert(other.stats().live_nodes() == 0);
+#endif
+    }
+
+    {
+        // Range assignments and affine updates mixed with constant updates and moves, against a reference vector.
+        auto rng = std::default_random_engine {};
+        std::vector<int> reference(60);
+        for (int& cost : reference) {
+            cost = static_cast<int>(rng() % 100);
+        }
+        dp_array<int> edited(reference);
+        int n = static_cast<int>(reference.size());
+        assert(!edited.assign_range(3, 3, 0) && !edited.assign_range(0, n + 1, 0) && !edited.affine_range(0, 5, 0, 1));
+        for (int round = 0; round < 300; ++round) {
+            int i_k = static_cast<int>(rng() % n);
+            int i_l = i_k + 1 + static_cast<int>(rng() % (n - i_k));
+            int c = static_cast<int>(rng() % 100);
+            int op = static_cast<int>(rng() % 4);
+            bool updated = true;
+            if (op == 0) {
+                updated = edited.assign_range(i_k, i_l, c);
+                std::fill(reference.begin() + i_k, reference.begin() + i_l, c);
+            } else if (op == 1) {
+                int factor = 1 + static_cast<int>(rng() % 3);
+                updated = edited.affine_range(i_k, i_l, factor, c - 50);
+                for (int i = i_k; i < i_l; ++i) {
+                    reference[i] = factor * reference[i] + c - 50;
+                }
+            } else if (op == 2) {
+                edited.update_constant(i_k, i_l, c - 50);
+                for (int i = i_k; i < i_l; ++i) {
+                    reference[i] += c - 50;
+                }
+            } else {
+                // Move the head vertex after the tail, connected by an edge of the cost of its former edge.
+                updated = edited.move_range(0, 0, n, 0, reference.front(), 0);
+                std::rotate(reference.begin(), reference.begin() + 1, reference.end());
+            }
+            assert(updated);
+            if (*std::max_element(reference.begin(), reference.end()) > 100000) {
+                bool assigned = edited.assign_range(0, n, 0);
+                assert(assigned);
+                std::fill(reference.begin(), reference.end(), 0);
+            }
+            assert(edited == reference);
+        }
+        subpathAllCorrect(edited, reference);
+        dp_array<int> static_ints(reference, dp_array_mode::segment_tree);
+        assert(!static_ints.assign_range(0, 2, 1) && !static_ints.affine_range(0, 2, 2, 1));
+    }
+
+    {
+        // Random transactions of edits rolled back to a savepoint in the middle and then to the start, against
+        // snapshots of the edge costs.
+        auto rng = std::default_random_engine {};
+        std::vector<int> reference(60);
+        for (int& cost : reference) {
+            cost = static_cast<int>(rng() % 100);
+        }
+        dp_array<int> edited(reference);
+        dp_array<int> other(std::vector<int>{1});
+        auto costs = [](const dp_array<int>& array) {
+            std::vector<int> output;
+            if (array.edge_num() > 0) {
+                array.vectorize(output);
+            }
+            return output;
+        };
+        auto random_edit = [&]() {
+            int n = static_cast<int>(edited.edge_num());
+            int i = n > 0 ? static_cast<int>(rng() % n) : 0;
+            int w = static_cast<int>(rng() % 100);
+            int op = static_cast<int>(rng() % 9);
+            if (op == 0 && n > 0) {
+                edited.update_constant(i, i + 1 + static_cast<int>(rng() % (n - i)), w - 50);
+            } else if (op == 1 && n > 0) {
+                edited.update_constant(i, w - 50);
+            } else if (op == 2) {
+                edited.push_back(w);
+            } else if (op == 3) {
+                edited.push_front(w);
+            } else if (op == 4) {
+                edited.pop_back();
+            } else if (op == 5) {
+                edited.pop_front();
+            } else if (op == 6) {
+                edited.insert(static_cast<int>(rng() % (n + 1)), w);
+            } else if (op == 7) {
+                edited.erase(i);
+            } else if (n > 0) {
+                int a = static_cast<int>(rng() % (n + 1));
+                int b = a + static_cast<int>(rng() % std::min(n + 1 - a, 8));
+                int m = static_cast<int>(rng() % (n + 2)) - 1;
+                edited.move_range(a, b, m, w, static_cast<int>(rng() % 100), static_cast<int>(rng() % 100));
+            }
+        };
+
+        assert(!edited.in_transaction() && !edited.rollback(0));
+        for (int round = 0; round < 40; ++round) {
+            std::vector<int> start = costs(edited);
+            std::size_t begin = edited.begin_transaction();
+            for (int i = 0; i < 40; ++i) {
+                random_edit();
+            }
+            std::vector<int> middle = costs(edited);
+            std::size_t savepoint = edited.savepoint();
+            for (int i = 0; i < 40; ++i) {
+                random_edit();
+            }
+            // Edits that cannot be undone by index fail during a transaction.
+            assert(!edited.append(std::move(other), 0) && !other.append(std::move(edited), 0));
+            assert(!edited.split_off(0, other) && !edited.load("dp_array_missing.bin"));
+            bool undone = edited.rollback(savepoint);
+            assert(undone && costs(edited) == middle);
+            if (round % 2 == 0) {
+                undone = edited.rollback(begin);
+                assert(undone && costs(edited) == start);
+                edited.commit();
+            } else {
+                edited.commit();
+                assert(!edited.in_transaction() && costs(edited) == middle);
+            }
+            if (edited.edge_num() > 0) {
+                subpathAllCorrect(edited, costs(edited));
+            }
+        }
+
+        // Updates of the segment_tree mode roll back as well, and moving a dp_array ends its transaction.
+        dp_array<int> static_ints(reference, dp_array_mode::segment_tree);
+        static_ints.begin_transaction();
+        static_ints.update_constant(3, 40, 5);
+        static_ints.update_constant(10, -2);
+        assert(!static_ints.push_back(1) && static_ints.savepoint() == 2);
+        bool undone = static_ints.rollback(0);
+        assert(undone && static_ints == reference);
+        static_ints.update_constant(0, 1);
+        dp_array<int> moved(std::move(static_ints));
+        assert(!moved.in_transaction() && !static_ints.in_transaction() && !moved.rollback(0));
+    }
+
+    {
+        // Random batches of edits exported with export_delta into a mirror of the edge costs.
+        auto rng = std::default_random_engine {};
+        std::vector<int> reference(80);
+        for (int& cost : reference) {
+            cost = static_cast<int>(rng() % 100);
+        }
+        dp_array<int> tracked(reference);
+        dp_array<int> other(std::vector<int>{1, 2, 3});
+        std::vector<std::pair<int, int>> runs;
+        std::vector<int> delta;
+        bool exported = tracked.export_delta(runs, delta);
+        assert(!exported && runs.empty());
+        tracked.track_changes();
+        exported = tracked.export_delta(runs, delta);
+        assert(exported && runs == (std::vector<std::pair<int, int>>{{0, 80}}) && delta == reference);
+        tracked.update_constant(5, 8, 1);
+        tracked.update_constant(20, 30, 1);
+        tracked.assign_range(7, 12, 4);
+        exported = tracked.export_delta(runs, delta);
+        assert(exported && runs == (std::vector<std::pair<int, int>>{{5, 12}, {20, 30}}) && delta.size() == 17);
+        exported = tracked.export_delta(runs, delta);
+        assert(exported && runs.empty() && delta.empty());
+
+        std::vector<int> mirror;
+        tracked.vectorize(mirror);
+        auto apply = [&](dp_array<int>& array, std::vector<int>& copy) {
+            bool ok = array.export_delta(runs, delta);
+            assert(ok);
+            copy.resize(array.edge_num());
+            std::size_t next = 0;
+            for (std::size_t r = 0; r < runs.size(); ++r) {
+                assert(runs[r].first < runs[r].second && (r == 0 || runs[r - 1].second < runs[r].first));
+                std::copy(delta.begin() + next, delta.begin() + next + (runs[r].second - runs[r].first),
+                          copy.begin() + runs[r].first);
+                next += runs[r].second - runs[r].first;
+            }
+            assert(next == delta.size());
+            std::vector<int> costs;
+            if (array.edge_num() > 0) {
+                array.vectorize(costs);
+            }
+            return costs == copy;
+        };
+        for (int batch = 0; batch < 300; ++batch) {
+            std::size_t savepoint = tracked.begin_transaction();
+            for (int i = 0; i < 5; ++i) {
+                int n = static_cast<int>(tracked.edge_num());
+                int a = n > 0 ? static_cast<int>(rng() % n) : 0;
+                int b = a + 1 + (n > 0 ? static_cast<int>(rng() % std::min(n - a, 10)) : 0);
+                int w = static_cast<int>(rng() % 100);
+                int op = static_cast<int>(rng() % 8);
+                if (op == 0 && n > 0) {
+                    tracked.update_constant(a, b, w - 50);
+                } else if (op == 1) {
+                    tracked.push_back(w);
+                } else if (op == 2 && n < 40) {
+                    tracked.insert(static_cast<int>(rng() % (n + 1)), w);
+                } else if (op == 3 && n > 10) {
+                    tracked.erase(a);
+                } else if (op == 4 && n > 10) {
+                    tracked.pop_front();
+                } else if (op == 5 && n > 0) {
+                    int m = static_cast<int>(rng() % (n + 2)) - 1;
+                    tracked.move_range(a, b - 1, m, w, w + 1, w + 2);
+                } else if (op == 6) {
+                    tracked.update_constant(a, 1);
+                } else {
+                    tracked.pop_back();
+                }
+            }
+            if (batch % 3 == 0) {
+                bool undone = tracked.rollback(savepoint);
+                assert(undone);
+            }
+            tracked.commit();
+            int n = static_cast<int>(tracked.edge_num());
+            if (batch % 7 == 0 && n > 1) {
+                int a = static_cast<int>(rng() % (n - 1));
+                bool ok = tracked.assign_range(a, a + 1 + static_cast<int>(rng() % (n - 1 - a)), 3);
+                ok = ok && tracked.affine_range(0, n, 2, -1);
+                assert(ok);
+            }
+            if (batch % 11 == 0 && n > 2) {
+                other.track_changes();
+                std::optional<int> x = tracked.split_off(static_cast<int>(rng() % (n - 1)), other);
+                std::vector<int> other_mirror;
+                bool same = x && apply(other, other_mirror);
+                assert(same);
+                bool appended = tracked.append(std::move(other), *x);
+                assert(appended && other.edge_num() == 0);
+            }
+            bool same = apply(tracked, mirror);
+            assert(same);
+        }
+
+        // Segment tree mode, and moves that take the tracked changes along.
+        dp_array<int> static_ints(reference, dp_array_mode::segment_tree);
+        static_ints.track_changes();
+        std::vector<int> static_mirror;
+        bool same = apply(static_ints, static_mirror);
+        assert(same && static_mirror == reference);
+        static_ints.update_constant(10, 20, 3);
+        static_ints.update_constant(70, -1);
+        dp_array<int> moved(std::move(static_ints));
+        exported = static_ints.export_delta(runs, delta);
+        same = apply(moved, static_mirror);
+        assert(!exported && same && runs == (std::vector<std::pair<int, int>>{{10, 20}, {70, 80}}));
+        moved.track_changes(false);
+        exported = moved.export_delta(runs, delta);
+        assert(!exported);
+    }
+
+    {
+        // Streaming constructors around the chunk boundaries, from every source of the same costs.
+        const std::size_t chunk = dp_array<int>::stream_chunk_size;
+        const std::string binary_file = "dp_array_costs.bin";
+        const std::string text_file = "dp_array_costs.txt";
+        std::mt19937 rng(29);
+        for (std::size_t n : {std::size_t(0), std::size_t(1), chunk - 1, chunk, chunk + 1, 2 * chunk + 7}) {
+            std::vector<int> reference(n);
+            for (int& cost : reference) {
+                cost = static_cast<int>(rng() % 2001) - 1000;
+            }
+            std::ofstream(binary_file, std::ios::binary)
+                .write(reinterpret_cast<const char*>(reference.data()), static_cast<std::streamsize>(n * sizeof(int)));
+            std::ostringstream text;
+            for (std::size_t i = 0; i < n; ++i) {
+                text << reference[i] << (i % 10 == 9 ? '\n' : ' ');
+            }
+            std::ofstream(text_file) << text.str();
+
+            std::size_t next_index = 0;
+            std::istringstream stream(text.str());
+            bool binary_ok;
+            bool text_ok;
+            std::vector<dp_array<int>> streamed;
+            streamed.emplace_back(reference.data(), n);
+            streamed.emplace_back(std::function<bool(int&)>([&](int& cost) {
+                if (next_index == n) {
+                    return false;
+                }
+                cost = reference[next_index++];
+                return true;
+            }));
+            streamed.emplace_back(std::istream_iterator<int>(stream), std::istream_iterator<int>());
+            streamed.emplace_back(binary_file, dp_array_file_format::binary, binary_ok);
+            streamed.emplace_back(text_file, dp_array_file_format::text, text_ok);
+            assert(binary_ok && text_ok);
+            for (dp_array<int>& array : streamed) {
+                // An empty input gives the empty dp_array of the vector constructor, without a head vertex.
+                assert(array.edge_num() == n && (n == 0 ? array.vertex_num() == 0 : array == reference));
+                if (n > 0) {
+                    // Indexed as by the vector constructor, and balanced.
+                    int min_index;
+                    auto min_it = std::min_element(reference.begin(), reference.end());
+                    assert(array.min_cost_first(0, static_cast<int>(n), min_index) == *min_it);
+                    assert(min_index == min_it - reference.begin());
+                    dynamic_path_shape shape = array.tree_shape();
+                    assert(shape.height == shape.ideal_height);
+                    array.insert(static_cast<int>(n / 2), 5);
+                    array.push_back(7);
+                    assert(array.edge_num() == n + 2 && array.edge_cost(static_cast<int>(n) + 1) == 7);
+                }
+            }
+        }
+        std::deque<int> small{3, 1, 4, 1, 5, 9, 2, 6};
+        dp_array<int> from_deque(small.begin(), small.end());
+        subpathAllCorrect(from_deque, std::vector<int>(small.begin(), small.end()));
+
+        // Files that are missing, end with a partial cost or hold something else than costs.
+        bool ok;
+        std::ofstream(binary_file, std::ios::binary).write("\1\2\3\4\5\6", 6);
+        dp_array<int> partial(binary_file, dp_array_file_format::binary, ok);
+        assert(!ok && partial.edge_num() == 0);
+        std::ofstream(text_file) << "1 2\n3 x 4\n";
+        dp_array<double> garbage(text_file, dp_array_file_format::text, ok);
+        assert(!ok && garbage.edge_num() == 0);
+        bool pushed = garbage.push_back(2.5);
+        assert(pushed && garbage.edge_num() == 1 && garbage.edge_cost(0) == 2.5);
+        // A bad token at the very end of the file is not dropped either.
+        for (const char* text : {"1 2 -", "1 2 +", "1e", "1 2 3 1e"}) {
+            std::ofstream(text_file) << text;
+            dp_array<double> truncated(text_file, dp_array_file_format::text, ok);
+            assert(!ok && truncated.edge_num() == 0);
+        }
+        std::ofstream(text_file) << "0.5 -1.25\n1e3";
+        dp_array<double> doubles(text_file, dp_array_file_format::text, ok);
+        assert(ok && doubles == (std::vector<double>{0.5, -1.25, 1e3}));
+        std::remove(binary_file.c_str());
+        std::remove(text_file.c_str());
+        dp_array<double> missing(text_file, dp_array_file_format::text, ok);
+        assert(!ok && missing.edge_num() == 0);
+    }
+
     std::cout << "All unit tests of dp_array passed!\n";
 }
 
+void dp_trace_unit_tests() {
+    // Latency histogram
+    dp_latency_histogram histogram;
+    assert(histogram.count() == 0 && histogram.percentile(0.5) == 0);
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        histogram.record(ns);
+    }
+    assert(histogram.count() == 1000);
+    assert(histogram.max() == 1000);
+    assert(fabs(histogram.mean() - 500.5) < 1e-9);
+    // Buckets keep 5 significant bits.
+    assert(fabs(static_cast<double>(histogram.percentile(0.5)) - 500.0) <= 500.0 / 16);
+    assert(fabs(static_cast<double>(histogram.percentile(0.99)) - 990.0) <= 990.0 / 16);
+    assert(histogram.percentile(1.0) <= 1000);
+    histogram.record(uint64_t(1) << 40);
+    assert(histogram.percentile(1.0) == uint64_t(1) << 40);
+
+#ifdef DYNAMIC_PATH_TRACE
+    // Spans of dp_array and dynamic_path_ops
+    dp_tracer& tracer = dp_tracer::instance();
+    tracer.reset();
+    tracer.set_ring_capacity(8);
+    std::vector<double> costs = {3, 1, 2, 5};
+    dp_array<double> dynamic_array(costs);
+    assert(tracer.histogram(dp_trace_op::concatenate).count() == 0);
+    tracer.set_enabled(true);
+    int min_index;
+    dynamic_array.min_cost_first(0, min_index);
+    dynamic_array.update_constant(1, 3, 1.0);
+    tracer.set_enabled(false);
+    dynamic_array.update_constant(1, 3, 1.0);
+    assert(tracer.histogram(dp_trace_op::array_min_cost_first).count() == 1);
+    assert(tracer.histogram(dp_trace_op::array_update_constant).count() == 1);
+    assert(tracer.histogram(dp_trace_op::split_before).count() == 2);
+    assert(tracer.histogram(dp_trace_op::pmincost_before).count() == 1);
+    // The ring buffer keeps the last events, ending with the end of update_constant.
+    std::vector<dp_trace_event> events = tracer.events();
+    assert(events.size() == 8);
+    assert(events.back().op == dp_trace_op::array_update_constant && !events.back().begin);
+    const std::string trace_file = "dp_trace.json";
+    bool dumped = tracer.dump_trace(trace_file);
+    assert(dumped);
+    // The dumped timestamps must keep the nanosecond resolution of the events.
+    std::ifstream trace_in(trace_file);
+    std::string trace_text((std::istreambuf_iterator<char>(trace_in)), std::istreambuf_iterator<char>());
+    trace_in.close();
+    std::vector<double> trace_ts;
+    for (std::size_t pos = trace_text.find("\"ts\":"); pos != std::string::npos;
+         pos = trace_text.find("\"ts\":", pos + 1)) {
+        trace_ts.push_back(std::stod(trace_text.substr(pos + 5)));
+    }
+    assert(trace_ts.size() == events.size());
+    for (std::size_t i = 0; i < trace_ts.size(); ++i) {
+        assert(fabs(trace_ts[i] * 1000.0 - static_cast<double>(events[i].timestamp_ns)) < 0.5);
+        if (i > 0) {
+            assert(trace_ts[i - 1] <= trace_ts[i]);
+            assert((trace_ts[i - 1] != trace_ts[i]) == (events[i - 1].timestamp_ns != events[i].timestamp_ns));
+        }
+    }
+    std::remove(trace_file.c_str());
+    tracer.reset();
+    tracer.set_ring_capacity(1 << 16);
+#endif
+
+    std::cout << "All unit tests of dp_trace passed!\n";
+}
+
+void leafless_path_unit_tests() {
+    // Same path as dynamic_path_unit_tests: 20 edges with costs {0, 1, 2, ..., 19}
+    uint32_t edge_num = 20;
+    leafless_path<double> paths(edge_num + 1);
+    typedef leafless_path<double>::ref ref;
+    ref root = paths.path(0);
+    assert(leafless_path<double>::is_vertex(root));
+    for (uint32_t i = 0; i < edge_num; ++i) {
+        root = paths.concatenate(root, paths.path(i + 1), static_cast<double>(i));
+        assert(!leafless_path<double>::is_vertex(root));
+    }
+    assert(paths.live_nodes() == edge_num);
+
+    for (uint32_t i = 0; i <= edge_num; ++i) {
+        assert(paths.path(i) == root);
+        assert(paths.before(i) == (i == 0 ? leafless_path<double>::null_vertex : i - 1));
+        assert(paths.after(i) == (i == edge_num ? leafless_path<double>::null_vertex : i + 1));
+        assert(i == 0 ? std::isnan(paths.pcost_before(i)) : paths.pcost_before(i) == i - 1);
+        assert(i == edge_num ? std::isnan(paths.pcost_after(i)) : paths.pcost_after(i) == i);
+    }
+    assert(paths.head(root) == 0 && paths.tail(root) == edge_num);
+    assert(paths.pmincost_before(root) == 1);
+    assert(paths.pmincost_after(root) == 0);
+    paths.pupdate(root, 1.0);
+    assert(paths.pcost_after(10) == 11.0);
+
+    // Split in the middle and in reverse order, then concatenate back
+    ref p;
+    ref q;
+    double x;
+    paths.split_before(8, p, q, x);
+    assert(x == 8.0);
+    assert(paths.tail(p) == 7 && paths.head(q) == 8);
+    assert(paths.path(3) == p && paths.path(15) == q);
+    paths.split_after(15, p, q, x);
+    assert(x == 16.0);
+    assert(paths.head(paths.path(15)) == 8 && paths.tail(paths.path(15)) == 15 && paths.head(q) == 16);
+    // Reorder as 8..15, 0..7, 16..20
+    root = paths.concatenate(paths.path(8), paths.path(0), 0.5);
+    root = paths.concatenate(root, q, -1.0);
+    std::vector<uint32_t> vertices;
+    paths.vectorizeVertex(root, vertices);
+    for (uint32_t i = 0; i <= edge_num; ++i) {
+        assert(vertices[i] == (i < 8 ? i + 8 : i < 16 ? i - 8 : i));
+    }
+    std::vector<double> costs;
+    paths.vectorize(root, costs);
+    assert(costs.size() == edge_num && costs[7] == 0.5 && costs[15] == -1.0 && costs[16] == 17.0);
+    assert(paths.pmincost_before(root) == 16 && paths.pmincost_after(root) == 7);
+    assert(paths.live_nodes() == edge_num);
+
+    // Split off singletons
+    paths.split_before(0, p, q, x);
+    paths.split_after(0, p, q, x);
+    assert(paths.path(0) == leafless_path<double>::vertex_ref(0) && std::isnan(paths.pcost_after(0)));
+    assert(paths.live_nodes() == edge_num - 2);
+    uint32_t v = paths.add_vertex();
+    assert(v == edge_num + 1 && paths.num_vertices() == edge_num + 2);
+    root = paths.concatenate(paths.path(20), leafless_path<double>::vertex_ref(v), 3.0);
+    assert(paths.after(20) == v && paths.pcost_before(v) == 3.0);
+
+    {
+        // Hybrid mode: random splits, concatenations and updates against reference vertex and cost lists, with the
+        // paths moving between flat arrays and trees around a threshold of 8 edges.
+        auto rng = std::default_random_engine {};
+        const uint32_t hybrid_num = 200;
+        leafless_path<double> hybrid(hybrid_num);
+        hybrid.set_flat_threshold(8);
+        assert(hybrid.flat_threshold() == 8);
+        std::vector<std::vector<uint32_t>> vertices;
+        std::vector<std::vector<double>> costs;
+        for (uint32_t i = 0; i < hybrid_num; ++i) {
+            vertices.push_back({i});
+            costs.emplace_back();
+        }
+        for (int round = 0; round < 3000; ++round) {
+            std::size_t s = rng() % vertices.size();
+            if (rng() % 2 == 0 && vertices.size() > 1) {
+                // Concatenate two paths, mostly short ones.
+                std::size_t t = rng() % vertices.size();
+                if (t == s || vertices[s].size() + vertices[t].size() > (rng() % 4 == 0 ? 100 : 12)) {
+                    continue;
+                }
+                double x = static_cast<double>(rng() % 50);
+                ref joined = hybrid.concatenate(hybrid.path(vertices[s][0]), hybrid.path(vertices[t][0]), x);
+                assert(leafless_path<double>::is_flat(joined) == (vertices[s].size() + vertices[t].size() <= 9));
+                costs[s].push_back(x);
+                costs[s].insert(costs[s].end(), costs[t].begin(), costs[t].end());
+                vertices[s].insert(vertices[s].end(), vertices[t].begin(), vertices[t].end());
+                vertices.erase(vertices.begin() + t);
+                costs.erase(costs.begin() + t);
+            } else if (rng() % 3 == 0) {
+                if (!costs[s].empty()) {
+                    hybrid.pupdate(hybrid.path(vertices[s][0]), 1.0);
+                    for (double& cost : costs[s]) {
+                        cost += 1.0;
+                    }
+                }
+            } else if (vertices[s].size() > 1) {
+                // Split before a random vertex.
+                std::size_t i = 1 + rng() % (vertices[s].size() - 1);
+                hybrid.split_before(vertices[s][i], p, q, x);
+                assert(x == costs[s][i - 1]);
+                assert(leafless_path<double>::is_flat(p) == (i > 1 && i <= 9));
+                vertices.emplace_back(vertices[s].begin() + i, vertices[s].end());
+                costs.emplace_back(costs[s].begin() + i, costs[s].end());
+                vertices[s].resize(i);
+                costs[s].resize(i - 1);
+            }
+
+            std::size_t edges = 0;
+            for (std::size_t i = 0; i < vertices.size(); ++i) {
+                ref r = hybrid.path(vertices[i][0]);
+                edges += costs[i].size();
+                assert(hybrid.head(r) == vertices[i].front() && hybrid.tail(r) == vertices[i].back());
+                std::vector<uint32_t> hybrid_vertices;
+                std::vector<double> hybrid_costs;
+                hybrid.vectorizeVertex(r, hybrid_vertices);
+                if (costs[i].empty()) {
+                    assert(r == leafless_path<double>::vertex_ref(vertices[i][0]));
+                    continue;
+                }
+                hybrid.vectorize(r, hybrid_costs);
+                assert(hybrid_vertices == vertices[i] && hybrid_costs == costs[i]);
+                for (std::size_t j = 0; j < vertices[i].size(); ++j) {
+                    uint32_t u = vertices[i][j];
+                    assert(hybrid.path(u) == r);
+                    assert(hybrid.before(u) == (j == 0 ? leafless_path<double>::null_vertex : vertices[i][j - 1]));
+                    assert(hybrid.after(u) == (j + 1 == vertices[i].size() ? leafless_path<double>::null_vertex : vertices[i][j + 1]));
+                    assert(j == 0 ? std::isnan(hybrid.pcost_before(u)) : hybrid.pcost_before(u) == costs[i][j - 1]);
+                    assert(j + 1 == vertices[i].size() ? std::isnan(hybrid.pcost_after(u)) : hybrid.pcost_after(u) == costs[i][j]);
+                }
+                auto min_it = std::min_element(costs[i].begin(), costs[i].end());
+                auto last_min_it = std::min_element(costs[i].rbegin(), costs[i].rend());
+                assert(hybrid.pmincost_before(r) == vertices[i][min_it - costs[i].begin() + 1]);
+                assert(hybrid.pmincost_after(r) == vertices[i][costs[i].rend() - last_min_it - 1]);
+            }
+            assert(hybrid.live_nodes() == edges);
+        }
+    }
+
+    std::cout << "All unit tests of leafless_path passed!\n";
+}
+
+template <typename VType>
+void block_path_tests() {
+    // 1000 edges with costs i % 7 from the bulk constructor: several levels of blocks, ties everywhere.
+    uint32_t edge_num = 1000;
+    std::vector<VType> original_array(edge_num);
+    for (uint32_t i = 0; i < edge_num; ++i) {
+        original_array[i] = static_cast<VType>(i % 7);
+    }
+    block_path<VType> paths(original_array);
+    uint32_t root = paths.path(0);
+    assert(root == edge_num && paths.height(root) == 2);
+    assert(paths.head(root) == 0 && paths.tail(root) == edge_num);
+    for (uint32_t i = 0; i <= edge_num; ++i) {
+        assert(paths.path(i) == root);
+        assert(paths.before(i) == (i == 0 ? block_path<VType>::null_vertex : i - 1));
+        assert(paths.after(i) == (i == edge_num ? block_path<VType>::null_vertex : i + 1));
+        if (i > 0) assert(paths.pcost_before(i) == original_array[i - 1]);
+        if (i < edge_num) assert(paths.pcost_after(i) == original_array[i]);
+    }
+    // Minimum cost 0 at edges 0, 7, ..., 994.
+    assert(paths.pmincost_before(root) == 1);
+    assert(paths.pmincost_after(root) == 994);
+    paths.pupdate(root, VType(2));
+    assert(paths.pcost_after(500) == original_array[500] + VType(2));
+
+    // Split around vertex 500 and glue the pieces back in the order (501..1000, 0..500).
+    uint32_t p;
+    uint32_t q;
+    VType x;
+    paths.split_after(500, p, q, x);
+    assert(p == 500 && q == edge_num && x == original_array[500] + VType(2));
+    assert(paths.head(p) == 0 && paths.head(q) == 501);
+    paths.pupdate(q, VType(-2));
+    root = paths.concatenate(q, p, VType(10));
+    assert(root == 500 && paths.pcost_after(edge_num) == VType(10));
+    assert(paths.pmincost_before(root) == 505 && paths.pmincost_after(root) == 994);
+    std::vector<uint32_t> vertices;
+    paths.vectorizeVertex(root, vertices);
+    std::vector<VType> costs;
+    paths.vectorize(root, costs);
+    assert(vertices.size() == edge_num + 1 && costs.size() == edge_num);
+    for (uint32_t i = 0; i <= edge_num; ++i) {
+        assert(vertices[i] == (i + 501) % (edge_num + 1));
+    }
+    assert(costs[0] == original_array[501] && costs[499] == VType(10) && costs[500] == original_array[0] + VType(2));
+
+    // Split off vertices one by one from the head, then concatenate singletons back.
+    for (uint32_t v = 501; v <= edge_num; ++v) {
+        paths.split_before(paths.after(v), p, q, x);
+        assert(p == v && q == 500 && paths.path(v) == v && paths.head(q) == v + 1 - (v == edge_num ? edge_num + 1 : 0));
+    }
+    root = edge_num;
+    for (uint32_t v = edge_num; v > 501; --v) {
+        root = paths.concatenate(v - 1, root, VType(1));
+    }
+    paths.split_before(0, p, q, x);
+    assert(p == block_path<VType>::null_vertex && q == 500);
+    assert(paths.head(root) == 501 && paths.pmincost_after(root) == edge_num - 1 && paths.height(root) <= 3);
+}
+
+void block_path_unit_tests() {
+    block_path_tests<double>();
+    block_path_tests<float>();
+    block_path_tests<int>();
+
+    std::cout << "All unit tests of block_path passed!\n";
+}
+
+template <typename VType>
+void dp_multi_array_tests(std::size_t lanes) {
+    // Random splits, appends and updates of K lanes against one reference vector of edge costs per lane.
+    auto rng = std::default_random_engine {};
+    std::vector<std::vector<VType>> reference(lanes, std::vector<VType>(300));
+    for (auto& costs : reference) {
+        for (VType& cost : costs) {
+            cost = static_cast<VType>(rng() % 100);
+        }
+    }
+    dp_multi_array<VType> joined(reference);
+    dp_multi_array<VType> other(lanes);
+    dp_multi_array<VType> narrow(lanes + 1);
+    std::vector<VType> x;
+    assert(joined.lanes() == lanes && joined.edge_num() == 300 && joined.vertex_num() == 301 && joined.height() == 10);
+    assert(dp_multi_array<VType>(std::vector<std::vector<VType>>{{1, 2}, {3}}).vertex_num() == 0);
+    assert(!joined.append(std::move(joined), x) && !joined.append(std::move(narrow), std::vector<VType>(lanes)));
+    assert(!joined.split_off(0, joined, x) && !joined.split_off(0, narrow, x));
+    assert(!joined.split_off(-1, other, x) && !joined.split_off(300, other, x));
+    int min_index;
+    assert(!joined.edge_cost(lanes, 0) && !joined.edge_cost(0, 300));
+    assert(!joined.min_cost_first(lanes, 0, 1, min_index) && !joined.min_cost_last(0, 1, 1, min_index));
+    assert(!other.vectorize(0, x) && !joined.vectorize(lanes, x));
+
+    auto matches = [&](const dp_multi_array<VType>& part, std::size_t begin, std::size_t end) {
+        if (begin == end) {
+            return part.vertex_num() == 0;
+        }
+        std::vector<VType> costs;
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            bool vectorized = part.vectorize(lane, costs);
+            if (!vectorized || !std::equal(costs.begin(), costs.end(), reference[lane].begin() + begin,
+                                           reference[lane].begin() + end) || costs.size() != end - begin) {
+                return false;
+            }
+        }
+        return true;
+    };
+    // Minimums, first and last, and threshold queries of random (sub-)paths of every lane.
+    auto queries_match = [&](const dp_multi_array<VType>& path) {
+        std::vector<std::pair<int, VType>> edges;
+        for (int round = 0; round < 20; ++round) {
+            int i_k = static_cast<int>(rng() % path.edge_num());
+            int i_l = i_k + 1 + static_cast<int>(rng() % (path.edge_num() - i_k));
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                const std::vector<VType>& costs = reference[lane];
+                auto first = std::min_element(costs.begin() + i_k, costs.begin() + i_l);
+                auto last = std::min_element(std::make_reverse_iterator(costs.begin() + i_l),
+                                             std::make_reverse_iterator(costs.begin() + i_k));
+                int first_index;
+                int last_index;
+                std::optional<VType> first_cost = path.min_cost_first(lane, i_k, i_l, first_index);
+                std::optional<VType> last_cost = path.min_cost_last(lane, i_k, i_l, last_index);
+                if (first_cost != *first || first_index != first - costs.begin() || last_cost != *last ||
+                    last_index != costs.rend() - last - 1 || path.edge_cost(lane, i_k) != costs[i_k]) {
+                    return false;
+                }
+                VType threshold = static_cast<VType>(rng() % 40);
+                bool reported = path.edges_below(lane, i_k, i_l, threshold, edges);
+                std::size_t below = 0;
+                for (int i = i_k; i < i_l; ++i) {
+                    if (costs[i] < threshold) {
+                        if (below >= edges.size() || edges[below] != std::make_pair(i, costs[i])) {
+                            return false;
+                        }
+                        ++below;
+                    }
+                }
+                if (!reported || below != edges.size()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    assert(matches(joined, 0, 300) && queries_match(joined));
+
+    for (int round = 0; round < 200; ++round) {
+        int i_k = static_cast<int>(rng() % joined.edge_num());
+        bool split = joined.split_off(i_k, other, x);
+        assert(split && x.size() == lanes);
+        std::size_t n = reference[0].size();
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            assert(x[lane] == reference[lane][i_k]);
+        }
+        assert(joined.edge_num() == static_cast<std::size_t>(i_k) && other.edge_num() == n - i_k - 1);
+
+        // Swap both parts around new edges, or put them back.
+        bool appended;
+        if (rng() % 2 == 0) {
+            std::vector<VType> w(lanes);
+            for (std::size_t lane = 0; lane < lanes; ++lane) {
+                w[lane] = static_cast<VType>(rng() % 100);
+                std::vector<VType>& costs = reference[lane];
+                std::vector<VType> swapped(costs.begin() + i_k + 1, costs.end());
+                swapped.push_back(w[lane]);
+                swapped.insert(swapped.end(), costs.begin(), costs.begin() + i_k);
+                costs = swapped;
+            }
+            appended = other.append(std::move(joined), w);
+            std::swap(joined, other);
+        } else {
+            appended = joined.append(std::move(other), x);
+        }
+        assert(appended && other.vertex_num() == 0 && matches(joined, 0, n));
+
+        // One lane, then all lanes of a random (sub-)path.
+        int i_l = i_k + 1 + static_cast<int>(rng() % (n - i_k));
+        std::size_t lane = rng() % lanes;
+        joined.update_constant(lane, i_k, i_l, VType(3));
+        std::vector<VType> w(lanes);
+        for (std::size_t l = 0; l < lanes; ++l) {
+            w[l] = static_cast<VType>(l + 1);
+        }
+        joined.update_constant(i_l - 1, static_cast<int>(n), w);
+        for (int i = i_k; i < i_l; ++i) {
+            reference[lane][i] += VType(3);
+        }
+        for (std::size_t l = 0; l < lanes; ++l) {
+            for (std::size_t i = i_l - 1; i < n; ++i) {
+                reference[l][i] += w[l];
+            }
+        }
+        assert(matches(joined, 0, n));
+        if (round % 20 == 0) {
+            assert(queries_match(joined));
+        }
+    }
+    assert(joined.height() <= 2 * 10);
+
+    // Parts left with a single vertex are empty, and an empty multi-array appends as a single vertex.
+    bool split = joined.split_off(0, other, x);
+    assert(split && joined.vertex_num() == 0 && other.edge_num() == 299);
+    bool prepended = joined.append(std::move(other), x);
+    split = joined.split_off(299, other, x);
+    assert(prepended && split && other.vertex_num() == 0 && x[0] == reference[0][299]);
+    bool pushed = joined.append(std::move(other), x);
+    assert(pushed && matches(joined, 0, 300) && queries_match(joined));
+    assert(joined.memory_bytes() >= 300 * lanes * 2 * sizeof(VType));
+}
+
+void dp_multi_array_unit_tests() {
+    dp_multi_array_tests<int>(1);
+    dp_multi_array_tests<int>(8);
+    dp_multi_array_tests<double>(5);
+    dp_multi_array_tests<float>(16);
+
+    std::cout << "All unit tests of dp_multi_array passed!\n";
+}
+
+template <typename VType>
+void euler_tour_forest_tests() {
+    // Random links, cuts, reroots and subtree updates against a reference forest of adjacency lists.
+    auto rng = std::default_random_engine {};
+    const int n = 60;
+    std::vector<VType> values(n);
+    for (VType& value : values) {
+        value = static_cast<VType>(rng() % 100);
+    }
+    euler_tour_forest<VType> forest(values);
+    std::vector<std::vector<int>> adjacent(n);
+    assert(forest.vertex_num() == n && forest.tree_size(7) == 1 && forest.root(7) == 7);
+    assert(!forest.link(3, 3) && !forest.link(-1, 3) && !forest.link(3, n) && !forest.cut(3, 4));
+    assert(!forest.connected(3, 4) && !forest.value(n) && forest.root(-1) == -1 && !forest.reroot(n));
+    int min_vertex;
+    assert(!forest.subtree_min(3, 4, min_vertex) && !forest.subtree_add(n, -1, VType(1)));
+
+    // Vertices of the subtree of v away from p, or of the whole tree of v if p is -1.
+    auto component = [&](int v, int p) {
+        std::vector<int> vertices;
+        std::vector<std::pair<int, int>> stack = {{v, p}};
+        while (!stack.empty()) {
+            auto [u, from] = stack.back();
+            stack.pop_back();
+            vertices.push_back(u);
+            for (int w : adjacent[u]) {
+                if (w != from) {
+                    stack.push_back({w, u});
+                }
+            }
+        }
+        return vertices;
+    };
+    auto neighbour = [&](int v) { return adjacent[v].empty() ? -1 : adjacent[v][rng() % adjacent[v].size()]; };
+
+    for (int i = 0; i < 3000; ++i) {
+        int u = static_cast<int>(rng() % n);
+        int v = static_cast<int>(rng() % n);
+        int op = static_cast<int>(rng() % 5);
+        bool connected = false;
+        for (int w : component(u, -1)) {
+            connected = connected || w == v;
+        }
+        assert(forest.connected(u, v) == connected);
+        if (op == 0 || op == 1) {
+            bool linked = forest.link(u, v);
+            assert(linked == !connected);
+            if (linked) {
+                adjacent[u].push_back(v);
+                adjacent[v].push_back(u);
+                assert(forest.root(u) == u && forest.root(v) == u);
+            }
+        } else if (op == 2) {
+            int w = neighbour(u);
+            bool cut = forest.cut(u, w);
+            assert(cut == (w != -1));
+            if (cut) {
+                adjacent[u].erase(std::find(adjacent[u].begin(), adjacent[u].end(), w));
+                adjacent[w].erase(std::find(adjacent[w].begin(), adjacent[w].end(), u));
+                assert(!forest.connected(u, w) && !forest.cut(w, u));
+            }
+        } else if (op == 3) {
+            int p = rng() % 2 ? neighbour(u) : -1;
+            VType x = static_cast<VType>(rng() % 7) - static_cast<VType>(3);
+            bool added = forest.subtree_add(u, p, x);
+            assert(added);
+            for (int w : component(u, p)) {
+                values[w] += x;
+            }
+        } else {
+            bool rerooted = forest.reroot(u);
+            assert(rerooted && forest.root(u) == u && forest.root(component(u, -1).back()) == u);
+        }
+
+        int p = neighbour(v);
+        std::vector<int> subtree = component(v, p);
+        VType min_value = values[subtree[0]];
+        for (int w : subtree) {
+            min_value = std::min(min_value, values[w]);
+        }
+        std::optional<VType> found = forest.subtree_min(v, p, min_vertex);
+        assert(found && *found == min_value && values[min_vertex] == min_value);
+        assert(std::find(subtree.begin(), subtree.end(), min_vertex) != subtree.end());
+        assert(p == -1 || forest.root(v) == p);
+        assert(forest.tree_size(v) == component(v, -1).size() && *forest.value(v) == values[v]);
+    }
+
+    // Tours: 2 tokens per vertex and 2 per edge, starting with the root twice, and every edge down and back up.
+    for (int v = 0; v < n; ++v) {
+        std::vector<int> tour;
+        forest.euler_tour(v, tour);
+        assert(tour.size() == 4 * forest.tree_size(v) - 2 && tour[0] == forest.root(v) && tour[1] == tour[0]);
+        assert(tour.back() == tour[0]);
+    }
+}
+
+void euler_tour_forest_unit_tests() {
+    euler_tour_forest_tests<int>();
+    euler_tour_forest_tests<double>();
+    euler_tour_forest_tests<float>();
+
+    std::cout << "All unit tests of euler_tour_forest passed!\n";
+}
+
 void time_benchmarking() {
     // Large data test.
     std::size_t maxNum = 100000000;
@@ -476,6 +2442,16 @@ int main(int argc, const char * argv[]) {
 
     dp_array_unit_tests();
 
+    dp_trace_unit_tests();
+
+    leafless_path_unit_tests();
+
+    block_path_unit_tests();
+
+    dp_multi_array_unit_tests();
+
+    euler_tour_forest_unit_tests();
+
     time_benchmarking();
 
     return 0;
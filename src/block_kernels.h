@@ -0,0 +1,241 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the block kernels of block_path: min, threshold search and add over short contiguous arrays
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Values within this tolerance of a minimum tie with it, as `close_to_zero` of dynamic_path_ops.
+template <typename VType>
+inline VType block_tie_tolerance() {
+    return std::is_floating_point<VType>::value ? static_cast<VType>(1e-6) : VType(0);
+}
+
+/**
+ * \brief Minimum of a[0, n). n must be positive.
+ */
+template <typename VType>
+inline VType block_min(const VType* a, int n) {
+    VType m = a[0];
+    for (int i = 1; i < n; ++i) {
+        m = a[i] < m ? a[i] : m;
+    }
+    return m;
+}
+
+/**
+ * \brief Add x to every value of a[0, n).
+ */
+template <typename VType>
+inline void block_add(VType* a, int n, VType x) {
+    for (int i = 0; i < n; ++i) {
+        a[i] += x;
+    }
+}
+
+/**
+ * \brief Index of the first value of a[0, n) not greater than t. n if there is none.
+ */
+template <typename VType>
+inline int block_find_first_le(const VType* a, int n, VType t) {
+    for (int i = 0; i < n; ++i) {
+        if (a[i] <= t) return i;
+    }
+    return n;
+}
+
+/**
+ * \brief Index of the last value of a[0, n) not greater than t. -1 if there is none.
+ */
+template <typename VType>
+inline int block_find_last_le(const VType* a, int n, VType t) {
+    for (int i = n - 1; i >= 0; --i) {
+        if (a[i] <= t) return i;
+    }
+    return -1;
+}
+
+#if defined(__AVX2__)
+
+// AVX2 specializations. Vectors may overlap the previous one at the end of a block, which is harmless for min.
+
+template <>
+inline double block_min<double>(const double* a, int n) {
+    if (n < 4) {
+        double m = a[0];
+        for (int i = 1; i < n; ++i) m = a[i] < m ? a[i] : m;
+        return m;
+    }
+    __m256d m = _mm256_loadu_pd(a);
+    int i = 4;
+    for (; i + 4 <= n; i += 4) {
+        m = _mm256_min_pd(m, _mm256_loadu_pd(a + i));
+    }
+    // Overlapping last vector instead of a scalar tail.
+    m = _mm256_min_pd(m, _mm256_loadu_pd(a + n - 4));
+    __m128d h = _mm_min_pd(_mm256_castpd256_pd128(m), _mm256_extractf128_pd(m, 1));
+    h = _mm_min_sd(h, _mm_unpackhi_pd(h, h));
+    return _mm_cvtsd_f64(h);
+}
+
+template <>
+inline float block_min<float>(const float* a, int n) {
+    if (n < 8) {
+        float m = a[0];
+        for (int i = 1; i < n; ++i) m = a[i] < m ? a[i] : m;
+        return m;
+    }
+    __m256 m = _mm256_loadu_ps(a);
+    for (int i = 8; i + 8 <= n; i += 8) {
+        m = _mm256_min_ps(m, _mm256_loadu_ps(a + i));
+    }
+    m = _mm256_min_ps(m, _mm256_loadu_ps(a + n - 8));
+    __m128 h = _mm_min_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    h = _mm_min_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_min_ss(h, _mm_shuffle_ps(h, h, 1));
+    return _mm_cvtss_f32(h);
+}
+
+template <>
+inline int block_min<int>(const int* a, int n) {
+    if (n < 8) {
+        int m = a[0];
+        for (int i = 1; i < n; ++i) m = a[i] < m ? a[i] : m;
+        return m;
+    }
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    for (int i = 8; i + 8 <= n; i += 8) {
+        m = _mm256_min_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+    }
+    m = _mm256_min_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + n - 8)));
+    __m128i h = _mm_min_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    h = _mm_min_epi32(h, _mm_shuffle_epi32(h, 0x4e));
+    h = _mm_min_epi32(h, _mm_shuffle_epi32(h, 0xb1));
+    return _mm_cvtsi128_si32(h);
+}
+
+template <>
+inline uint32_t block_min<uint32_t>(const uint32_t* a, int n) {
+    if (n < 8) {
+        uint32_t m = a[0];
+        for (int i = 1; i < n; ++i) m = a[i] < m ? a[i] : m;
+        return m;
+    }
+    __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    for (int i = 8; i + 8 <= n; i += 8) {
+        m = _mm256_min_epu32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+    }
+    m = _mm256_min_epu32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + n - 8)));
+    __m128i h = _mm_min_epu32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    h = _mm_min_epu32(h, _mm_shuffle_epi32(h, 0x4e));
+    h = _mm_min_epu32(h, _mm_shuffle_epi32(h, 0xb1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(h));
+}
+
+// Bit i of the mask is set if lane i of the vector at a + i0 is not greater than t.
+static inline unsigned block_le_mask(const double* a, int i0, __m256d t) {
+    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i0), t, _CMP_LE_OQ)));
+}
+
+static inline unsigned block_le_mask(const float* a, int i0, __m256 t) {
+    return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(a + i0), t, _CMP_LE_OQ)));
+}
+
+static inline unsigned block_le_mask(const int* a, int i0, __m256i t) {
+    __m256i gt = _mm256_cmpgt_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i0)), t);
+    return ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(gt))) & 0xffu;
+}
+
+template <>
+inline int block_find_first_le<double>(const double* a, int n, double t) {
+    __m256d vt = _mm256_set1_pd(t);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        unsigned mask = block_le_mask(a, i, vt);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < n; ++i) {
+        if (a[i] <= t) return i;
+    }
+    return n;
+}
+
+template <>
+inline int block_find_last_le<double>(const double* a, int n, double t) {
+    __m256d vt = _mm256_set1_pd(t);
+    int i = n;
+    for (; i >= 4; i -= 4) {
+        unsigned mask = block_le_mask(a, i - 4, vt);
+        if (mask) return i - 4 + 31 - __builtin_clz(mask);
+    }
+    for (--i; i >= 0; --i) {
+        if (a[i] <= t) return i;
+    }
+    return -1;
+}
+
+template <>
+inline int block_find_first_le<float>(const float* a, int n, float t) {
+    __m256 vt = _mm256_set1_ps(t);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned mask = block_le_mask(a, i, vt);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < n; ++i) {
+        if (a[i] <= t) return i;
+    }
+    return n;
+}
+
+template <>
+inline int block_find_last_le<float>(const float* a, int n, float t) {
+    __m256 vt = _mm256_set1_ps(t);
+    int i = n;
+    for (; i >= 8; i -= 8) {
+        unsigned mask = block_le_mask(a, i - 8, vt);
+        if (mask) return i - 8 + 31 - __builtin_clz(mask);
+    }
+    for (--i; i >= 0; --i) {
+        if (a[i] <= t) return i;
+    }
+    return -1;
+}
+
+template <>
+inline int block_find_first_le<int>(const int* a, int n, int t) {
+    __m256i vt = _mm256_set1_epi32(t);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned mask = block_le_mask(a, i, vt);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < n; ++i) {
+        if (a[i] <= t) return i;
+    }
+    return n;
+}
+
+template <>
+inline int block_find_last_le<int>(const int* a, int n, int t) {
+    __m256i vt = _mm256_set1_epi32(t);
+    int i = n;
+    for (; i >= 8; i -= 8) {
+        unsigned mask = block_le_mask(a, i - 8, vt);
+        if (mask) return i - 8 + 31 - __builtin_clz(mask);
+    }
+    for (--i; i >= 0; --i) {
+        if (a[i] <= t) return i;
+    }
+    return -1;
+}
+
+#endif  // __AVX2__
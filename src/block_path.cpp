@@ -0,0 +1,799 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in block_path.h
+*/
+
+#include "block_path.h"
+
+#include "block_kernels.h"
+
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#pragma mark Public functions
+
+template <typename VType>
+block_path<VType>::block_path(uint32_t num_vertices)
+    : m_leaf(num_vertices, nullptr), m_slot(num_vertices, 0), m_root(num_vertices, nullptr) {}
+
+template <typename VType>
+block_path<VType>::block_path(const std::vector<VType>& costs) : block_path(static_cast<uint32_t>(costs.size() + 1)) {
+    if (costs.empty()) {
+        return;
+    }
+
+    // Bottom-up build. Every level is cut into the fewest nodes, with sizes evened out so that all of them
+    // hold at least half of the capacity.
+    std::vector<node*> level_nodes;
+    auto groups = [](std::size_t total, std::size_t capacity) { return (total + capacity - 1) / capacity; };
+    std::size_t total = costs.size();
+    std::size_t num_groups = groups(total, leaf_capacity);
+    for (std::size_t g = 0, begin = 0; g < num_groups; ++g) {
+        std::size_t end = total * (g + 1) / num_groups;
+        leaf* l = new_leaf_();
+        for (std::size_t i = begin; i < end; ++i) {
+            l->cost[l->count] = costs[i];
+            l->vertex[l->count] = static_cast<uint32_t>(i);
+            ++l->count;
+        }
+        reindex_(l, 0);
+        refresh_(l);
+        level_nodes.push_back(l);
+        begin = end;
+    }
+
+    for (int level = 1; level_nodes.size() > 1; ++level) {
+        std::vector<node*> parents;
+        total = level_nodes.size();
+        num_groups = groups(total, inner_capacity);
+        for (std::size_t g = 0, begin = 0; g < num_groups; ++g) {
+            std::size_t end = total * (g + 1) / num_groups;
+            inner* n = new_inner_(level);
+            for (std::size_t i = begin; i < end; ++i) {
+                set_child_(n, n->count++, level_nodes[i]);
+            }
+            refresh_(n);
+            parents.push_back(n);
+            begin = end;
+        }
+        level_nodes.swap(parents);
+    }
+
+    uint32_t tail_vertex = static_cast<uint32_t>(costs.size());
+    level_nodes[0]->tail = tail_vertex;
+    m_root[tail_vertex] = level_nodes[0];
+}
+
+template <typename VType>
+block_path<VType>::~block_path() {
+    for (uint32_t t = 0; t < m_root.size(); ++t) {
+        if (!m_leaf[t] && m_root[t]) {
+            free_tree_(m_root[t]);
+        }
+    }
+}
+
+template <typename VType>
+uint32_t block_path<VType>::num_vertices() const {
+    return static_cast<uint32_t>(m_leaf.size());
+}
+
+template <typename VType>
+uint32_t block_path<VType>::path(uint32_t v) const {
+    if (v >= m_leaf.size()) {
+        return null_vertex;
+    }
+
+    if (!m_leaf[v]) {
+        // v is a tail.
+        return v;
+    }
+
+    const node* n = m_leaf[v];
+    while (n->parent) {
+        n = n->parent;
+    }
+    return n->tail;
+}
+
+template <typename VType>
+uint32_t block_path<VType>::head(uint32_t p) const {
+    if (p >= m_leaf.size()) {
+        return null_vertex;
+    }
+
+    // Must be a tail.
+    assert(!m_leaf[p]);
+
+    const node* n = m_root[p];
+    if (!n) {
+        return p;
+    }
+    while (n->level > 0) {
+        n = as_inner_(n)->child[0];
+    }
+    return as_leaf_(n)->vertex[0];
+}
+
+template <typename VType>
+uint32_t block_path<VType>::tail(uint32_t p) const {
+    return p;
+}
+
+template <typename VType>
+uint32_t block_path<VType>::before(uint32_t v) const {
+    if (v >= m_leaf.size()) {
+        return null_vertex;
+    }
+
+    const leaf* l = m_leaf[v];
+    int slot;
+    if (l) {
+        slot = m_slot[v];
+        if (!prev_entry_(l, slot)) {
+            return null_vertex;
+        }
+    } else {
+        // The tail comes after the last entry.
+        const node* n = m_root[v];
+        if (!n) {
+            return null_vertex;
+        }
+        while (n->level > 0) {
+            n = as_inner_(n)->child[n->count - 1];
+        }
+        l = as_leaf_(n);
+        slot = l->count - 1;
+    }
+    return l->vertex[slot];
+}
+
+template <typename VType>
+uint32_t block_path<VType>::after(uint32_t v) const {
+    if (v >= m_leaf.size() || !m_leaf[v]) {
+        return null_vertex;
+    }
+
+    const leaf* l = m_leaf[v];
+    int slot = m_slot[v];
+    if (!next_entry_(l, slot)) {
+        // v owns the last entry: the tail comes next.
+        return path(v);
+    }
+    return l->vertex[slot];
+}
+
+template <typename VType>
+VType block_path<VType>::pcost_before(uint32_t v) const {
+    uint32_t u = before(v);
+    if (u == null_vertex) {
+        return static_cast<VType>(NAN);
+    }
+    return entry_cost_(m_leaf[u], m_slot[u]);
+}
+
+template <typename VType>
+VType block_path<VType>::pcost_after(uint32_t v) const {
+    if (v >= m_leaf.size() || !m_leaf[v]) {
+        return static_cast<VType>(NAN);
+    }
+    return entry_cost_(m_leaf[v], m_slot[v]);
+}
+
+template <typename VType>
+uint32_t block_path<VType>::pmincost_before(uint32_t p) const {
+    if (p >= m_leaf.size() || !m_root[p]) {
+        return null_vertex;
+    }
+
+    const leaf* l;
+    int slot;
+    min_entry_(m_root[p], true, l, slot);
+    if (!next_entry_(l, slot)) {
+        return p;
+    }
+    return l->vertex[slot];
+}
+
+template <typename VType>
+uint32_t block_path<VType>::pmincost_after(uint32_t p) const {
+    if (p >= m_leaf.size() || !m_root[p]) {
+        return null_vertex;
+    }
+
+    const leaf* l;
+    int slot;
+    min_entry_(m_root[p], false, l, slot);
+    return l->vertex[slot];
+}
+
+template <typename VType>
+void block_path<VType>::pupdate(uint32_t p, VType x) {
+    // Must be a path with at least one edge.
+    assert(p < m_leaf.size() && !m_leaf[p] && m_root[p]);
+
+    node* root = m_root[p];
+    root->add += x;
+    root->min += x;
+}
+
+template <typename VType>
+uint32_t block_path<VType>::concatenate(uint32_t p, uint32_t q, VType x) {
+    if (p == null_vertex) {
+        return q;
+    } else if (q == null_vertex) {
+        return p;
+    }
+
+    // Both must be tails.
+    assert(!m_leaf[p] && !m_leaf[q]);
+
+    // The tail of p gets the entry of the new edge.
+    leaf* e = new_leaf_();
+    e->cost[0] = x;
+    e->vertex[0] = p;
+    e->count = 1;
+    reindex_(e, 0);
+    refresh_(e);
+
+    node* root = join_(join_(m_root[p], e), m_root[q]);
+    m_root[p] = nullptr;
+    root->tail = q;
+    m_root[q] = root;
+    return q;
+}
+
+template <typename VType>
+void block_path<VType>::split_before(uint32_t v, uint32_t& p, uint32_t& q, VType& x) {
+    uint32_t u = before(v);
+    if (u == null_vertex) {
+        p = null_vertex;
+        q = path(v);
+        x = static_cast<VType>(NAN);
+        return;
+    }
+
+    split_after(u, p, q, x);
+}
+
+template <typename VType>
+void block_path<VType>::split_after(uint32_t v, uint32_t& p, uint32_t& q, VType& y) {
+    if (v >= m_leaf.size()) {
+        return;
+    }
+
+    if (!m_leaf[v]) {
+        p = v;
+        q = null_vertex;
+        y = static_cast<VType>(NAN);
+        return;
+    }
+
+    uint32_t t = path(v);
+    node* left;
+    node* right;
+    cut_(v, left, right, y);
+
+    p = v;
+    m_root[v] = left;
+    if (left) {
+        left->tail = v;
+    }
+
+    q = t;
+    m_root[t] = right;
+    if (right) {
+        right->tail = t;
+    }
+}
+
+template <typename VType>
+void block_path<VType>::vectorize(uint32_t p, std::vector<VType>& vector_path) const {
+    if (p >= m_leaf.size()) {
+        return;
+    }
+
+    vector_path.clear();
+
+    if (m_root[p]) {
+        collect_(m_root[p], VType(0), &vector_path, nullptr);
+    }
+}
+
+template <typename VType>
+void block_path<VType>::vectorizeVertex(uint32_t p, std::vector<uint32_t>& vector_vertices) const {
+    if (p >= m_leaf.size()) {
+        return;
+    }
+
+    vector_vertices.clear();
+
+    if (m_root[p]) {
+        collect_(m_root[p], VType(0), nullptr, &vector_vertices);
+    }
+    vector_vertices.push_back(p);
+}
+
+template <typename VType>
+int block_path<VType>::height(uint32_t p) const {
+    if (p >= m_leaf.size() || !m_root[p]) {
+        return 0;
+    }
+    return m_root[p]->level + 1;
+}
+
+#pragma mark Private functions
+
+template <typename VType>
+typename block_path<VType>::leaf* block_path<VType>::new_leaf_() const {
+    leaf* l = new leaf;
+    l->parent = nullptr;
+    l->level = 0;
+    l->count = 0;
+    l->add = 0;
+    l->min = 0;
+    l->tail = null_vertex;
+    return l;
+}
+
+template <typename VType>
+typename block_path<VType>::inner* block_path<VType>::new_inner_(int level) const {
+    inner* n = new inner;
+    n->parent = nullptr;
+    n->level = level;
+    n->count = 0;
+    n->add = 0;
+    n->min = 0;
+    n->tail = null_vertex;
+    return n;
+}
+
+template <typename VType>
+void block_path<VType>::free_tree_(node* n) {
+    if (n->level == 0) {
+        delete as_leaf_(n);
+        return;
+    }
+
+    inner* in = as_inner_(n);
+    for (int i = 0; i < in->count; ++i) {
+        free_tree_(in->child[i]);
+    }
+    delete in;
+}
+
+template <typename VType>
+void block_path<VType>::push_(node* n) const {
+    if (n->add == VType(0)) return;
+
+    if (n->level == 0) {
+        leaf* l = as_leaf_(n);
+        block_add(l->cost, l->count, n->add);
+    } else {
+        inner* in = as_inner_(n);
+        for (int i = 0; i < in->count; ++i) {
+            in->child[i]->add += n->add;
+            in->child[i]->min += n->add;
+        }
+        block_add(in->cmin, in->count, n->add);
+    }
+    n->add = 0;
+}
+
+template <typename VType>
+void block_path<VType>::refresh_(node* n) const {
+    if (n->level == 0) {
+        leaf* l = as_leaf_(n);
+        n->min = n->add + block_min(l->cost, l->count);
+    } else {
+        inner* in = as_inner_(n);
+        n->min = n->add + block_min(in->cmin, in->count);
+    }
+}
+
+template <typename VType>
+void block_path<VType>::refresh_up_(node* n) const {
+    while (true) {
+        refresh_(n);
+        if (!n->parent) {
+            return;
+        }
+        inner* parent = as_inner_(n->parent);
+        parent->cmin[child_index_(n)] = n->min;
+        n = parent;
+    }
+}
+
+template <typename VType>
+int block_path<VType>::child_index_(const node* n) const {
+    const inner* parent = as_inner_(n->parent);
+    for (int i = 0; i < parent->count; ++i) {
+        if (parent->child[i] == n) return i;
+    }
+    // Should not reach this step.
+    assert(false);
+    return -1;
+}
+
+template <typename VType>
+void block_path<VType>::set_child_(inner* n, int i, node* child) const {
+    n->child[i] = child;
+    n->cmin[i] = child->min;
+    child->parent = n;
+}
+
+template <typename VType>
+void block_path<VType>::reindex_(leaf* l, int from) {
+    for (int i = from; i < l->count; ++i) {
+        m_leaf[l->vertex[i]] = l;
+        m_slot[l->vertex[i]] = static_cast<uint16_t>(i);
+    }
+}
+
+template <typename VType>
+bool block_path<VType>::prev_entry_(const leaf*& l, int& slot) const {
+    if (slot > 0) {
+        --slot;
+        return true;
+    }
+
+    const node* n = l;
+    while (n->parent) {
+        int i = child_index_(n);
+        const inner* parent = as_inner_(n->parent);
+        if (i > 0) {
+            n = parent->child[i - 1];
+            while (n->level > 0) {
+                n = as_inner_(n)->child[n->count - 1];
+            }
+            l = as_leaf_(n);
+            slot = l->count - 1;
+            return true;
+        }
+        n = parent;
+    }
+    return false;
+}
+
+template <typename VType>
+bool block_path<VType>::next_entry_(const leaf*& l, int& slot) const {
+    if (slot + 1 < l->count) {
+        ++slot;
+        return true;
+    }
+
+    const node* n = l;
+    while (n->parent) {
+        int i = child_index_(n);
+        const inner* parent = as_inner_(n->parent);
+        if (i + 1 < parent->count) {
+            n = parent->child[i + 1];
+            while (n->level > 0) {
+                n = as_inner_(n)->child[0];
+            }
+            l = as_leaf_(n);
+            slot = 0;
+            return true;
+        }
+        n = parent;
+    }
+    return false;
+}
+
+template <typename VType>
+VType block_path<VType>::entry_cost_(const leaf* l, int slot) const {
+    VType cost = l->cost[slot];
+    for (const node* n = l; n; n = n->parent) {
+        cost += n->add;
+    }
+    return cost;
+}
+
+template <typename VType>
+void block_path<VType>::min_entry_(const node* root, bool first, const leaf*& l, int& slot) const {
+    const VType tolerance = block_tie_tolerance<VType>();
+    const node* n = root;
+    // All the children of a node share its offset, so they are compared on their own minimums.
+    while (n->level > 0) {
+        const inner* in = as_inner_(n);
+        VType threshold = block_min(in->cmin, in->count) + tolerance;
+        int i = first ? block_find_first_le(in->cmin, in->count, threshold) : block_find_last_le(in->cmin, in->count, threshold);
+        n = in->child[i];
+    }
+
+    l = as_leaf_(n);
+    VType threshold = block_min(l->cost, l->count) + tolerance;
+    slot = first ? block_find_first_le(l->cost, l->count, threshold) : block_find_last_le(l->cost, l->count, threshold);
+}
+
+template <typename VType>
+void block_path<VType>::collect_(const node* n, VType base, std::vector<VType>* costs, std::vector<uint32_t>* vertices) const {
+    base += n->add;
+    if (n->level == 0) {
+        const leaf* l = as_leaf_(n);
+        for (int i = 0; i < l->count; ++i) {
+            if (costs) costs->push_back(l->cost[i] + base);
+            if (vertices) vertices->push_back(l->vertex[i]);
+        }
+        return;
+    }
+
+    const inner* in = as_inner_(n);
+    for (int i = 0; i < in->count; ++i) {
+        collect_(in->child[i], base, costs, vertices);
+    }
+}
+
+template <typename VType>
+void block_path<VType>::merge_(node* left, node* right) {
+    assert(left->level == right->level && left->count + right->count <= capacity_(left));
+    push_(left);
+    push_(right);
+
+    if (left->level == 0) {
+        leaf* l = as_leaf_(left);
+        leaf* r = as_leaf_(right);
+        int from = l->count;
+        std::copy(r->cost, r->cost + r->count, l->cost + from);
+        std::copy(r->vertex, r->vertex + r->count, l->vertex + from);
+        l->count += r->count;
+        reindex_(l, from);
+        delete r;
+    } else {
+        inner* l = as_inner_(left);
+        inner* r = as_inner_(right);
+        for (int i = 0; i < r->count; ++i) {
+            set_child_(l, l->count++, r->child[i]);
+        }
+        delete r;
+    }
+    refresh_(left);
+}
+
+template <typename VType>
+void block_path<VType>::redistribute_(node* left, node* right) {
+    assert(left->level == right->level);
+    push_(left);
+    push_(right);
+
+    int total = left->count + right->count;
+    int left_count = total / 2;
+    if (left->level == 0) {
+        leaf* l = as_leaf_(left);
+        leaf* r = as_leaf_(right);
+        if (l->count > left_count) {
+            // Move the last entries of l to the front of r.
+            int moved = l->count - left_count;
+            std::copy_backward(r->cost, r->cost + r->count, r->cost + r->count + moved);
+            std::copy_backward(r->vertex, r->vertex + r->count, r->vertex + r->count + moved);
+            std::copy(l->cost + left_count, l->cost + l->count, r->cost);
+            std::copy(l->vertex + left_count, l->vertex + l->count, r->vertex);
+        } else {
+            // Move the first entries of r to the end of l.
+            int moved = left_count - l->count;
+            std::copy(r->cost, r->cost + moved, l->cost + l->count);
+            std::copy(r->vertex, r->vertex + moved, l->vertex + l->count);
+            std::copy(r->cost + moved, r->cost + r->count, r->cost);
+            std::copy(r->vertex + moved, r->vertex + r->count, r->vertex);
+        }
+        int from = std::min(l->count, left_count);
+        l->count = left_count;
+        r->count = total - left_count;
+        reindex_(l, from);
+        reindex_(r, 0);
+    } else {
+        inner* l = as_inner_(left);
+        inner* r = as_inner_(right);
+        node* children[2 * inner_capacity + 2];
+        std::copy(l->child, l->child + l->count, children);
+        std::copy(r->child, r->child + r->count, children + l->count);
+        l->count = 0;
+        r->count = 0;
+        for (int i = 0; i < total; ++i) {
+            if (i < left_count) {
+                set_child_(l, l->count++, children[i]);
+            } else {
+                set_child_(r, r->count++, children[i]);
+            }
+        }
+    }
+    refresh_(left);
+    refresh_(right);
+}
+
+template <typename VType>
+void block_path<VType>::insert_child_(inner* n, int i, node* child) const {
+    assert(n->count <= inner_capacity);
+    for (int j = n->count; j > i; --j) {
+        n->child[j] = n->child[j - 1];
+        n->cmin[j] = n->cmin[j - 1];
+    }
+    set_child_(n, i, child);
+    ++n->count;
+}
+
+template <typename VType>
+typename block_path<VType>::node* block_path<VType>::fix_overflow_(node* n) {
+    while (n->count > capacity_(n)) {
+        inner* a = as_inner_(n);
+        push_(a);
+        inner* b = new_inner_(a->level);
+        int keep = (a->count + 1) / 2;
+        for (int i = keep; i < a->count; ++i) {
+            set_child_(b, b->count++, a->child[i]);
+        }
+        a->count = keep;
+        refresh_(a);
+        refresh_(b);
+
+        if (!a->parent) {
+            inner* root = new_inner_(a->level + 1);
+            set_child_(root, 0, a);
+            set_child_(root, 1, b);
+            root->count = 2;
+            refresh_(root);
+            return root;
+        }
+
+        inner* parent = as_inner_(a->parent);
+        int i = child_index_(a);
+        parent->cmin[i] = a->min;
+        insert_child_(parent, i + 1, b);
+        n = parent;
+    }
+
+    refresh_up_(n);
+    while (n->parent) {
+        n = n->parent;
+    }
+    return n;
+}
+
+template <typename VType>
+typename block_path<VType>::node* block_path<VType>::join_(node* a, node* b) {
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->level == b->level) {
+        if (a->count + b->count <= capacity_(a)) {
+            merge_(a, b);
+            return a;
+        }
+        if (a->count < min_fill_(a) || b->count < min_fill_(b)) {
+            redistribute_(a, b);
+        }
+        inner* root = new_inner_(a->level + 1);
+        set_child_(root, 0, a);
+        set_child_(root, 1, b);
+        root->count = 2;
+        refresh_(root);
+        return root;
+    }
+
+    if (a->level > b->level) {
+        // Hang b below the right spine of a, whose offsets are pushed down first.
+        node* p = a;
+        push_(p);
+        while (p->level > b->level + 1) {
+            p = as_inner_(p)->child[p->count - 1];
+            push_(p);
+        }
+        inner* parent = as_inner_(p);
+        node* c = parent->child[parent->count - 1];
+        if (b->count < min_fill_(b)) {
+            if (c->count + b->count <= capacity_(c)) {
+                merge_(c, b);
+                refresh_up_(c);
+                return a;
+            }
+            redistribute_(c, b);
+            parent->cmin[parent->count - 1] = c->min;
+        }
+        insert_child_(parent, parent->count, b);
+        return fix_overflow_(parent);
+    }
+
+    // Hang a below the left spine of b.
+    node* p = b;
+    push_(p);
+    while (p->level > a->level + 1) {
+        p = as_inner_(p)->child[0];
+        push_(p);
+    }
+    inner* parent = as_inner_(p);
+    node* c = parent->child[0];
+    if (a->count < min_fill_(a)) {
+        if (a->count + c->count <= capacity_(c)) {
+            merge_(a, c);
+            set_child_(parent, 0, a);
+            refresh_up_(parent);
+            return b;
+        }
+        redistribute_(a, c);
+        parent->cmin[0] = c->min;
+    }
+    insert_child_(parent, 0, a);
+    return fix_overflow_(parent);
+}
+
+template <typename VType>
+typename block_path<VType>::node* block_path<VType>::make_root_(inner* n, int from, int to) const {
+    if (from >= to) {
+        return nullptr;
+    }
+
+    if (to - from == 1) {
+        node* child = n->child[from];
+        child->parent = nullptr;
+        return child;
+    }
+
+    inner* root = new_inner_(n->level);
+    for (int i = from; i < to; ++i) {
+        set_child_(root, root->count++, n->child[i]);
+    }
+    refresh_(root);
+    return root;
+}
+
+template <typename VType>
+void block_path<VType>::cut_(uint32_t v, node*& left, node*& right, VType& cost) {
+    leaf* l = m_leaf[v];
+    int slot = m_slot[v];
+
+    // Push the offsets down to the leaf block, so that the pieces below need no adjustment.
+    std::vector<node*> ancestors;
+    std::vector<int> index;
+    for (node* n = l; n->parent; n = n->parent) {
+        ancestors.push_back(n->parent);
+        index.push_back(child_index_(n));
+    }
+    for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+        push_(*it);
+    }
+    push_(l);
+
+    cost = l->cost[slot];
+    m_leaf[v] = nullptr;
+
+    // Pieces of the leaf block
+    right = nullptr;
+    if (slot + 1 < l->count) {
+        leaf* r = new_leaf_();
+        r->count = l->count - slot - 1;
+        std::copy(l->cost + slot + 1, l->cost + l->count, r->cost);
+        std::copy(l->vertex + slot + 1, l->vertex + l->count, r->vertex);
+        reindex_(r, 0);
+        refresh_(r);
+        right = r;
+    }
+    l->count = slot;
+    l->parent = nullptr;
+    if (slot > 0) {
+        refresh_(l);
+        left = l;
+    } else {
+        delete l;
+        left = nullptr;
+    }
+
+    // Every ancestor falls apart into the children before and after the cut, which are joined to the pieces.
+    for (std::size_t i = 0; i < ancestors.size(); ++i) {
+        inner* n = as_inner_(ancestors[i]);
+        node* left_siblings = make_root_(n, 0, index[i]);
+        node* right_siblings = make_root_(n, index[i] + 1, n->count);
+        delete n;
+        left = join_(left_siblings, left);
+        right = join_(right, right_siblings);
+    }
+}
+
+#pragma mark Instantiations
+
+template class block_path<double>;
+template class block_path<float>;
+template class block_path<uint32_t>;
+template class block_path<int>;
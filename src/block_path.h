@@ -0,0 +1,241 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the high-fanout dynamic path representation with contiguous leaf blocks
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Dynamic paths over vertex ids, stored as B+trees of edge cost blocks.
+ *
+ * \note Every vertex but the tail of its path owns one entry (vertex id, cost of the edge after it). Entries are kept
+ * in path order in leaf blocks of up to `leaf_capacity` contiguous costs, under internal nodes of up to
+ * `inner_capacity` children whose subtree minimums are stored contiguously too. Each node carries a lazy offset
+ * added to its whole subtree, so `pupdate` is O(1) and minimum searches scan short arrays (with AVX2 when the library
+ * is built for it, see DYNAMIC_PATH_NATIVE) instead of chasing one pointer per edge.
+ * A path is identified by its tail vertex. Like leafless_path, this class holds the states of all its paths.
+ */
+template <typename VType>
+class block_path {
+  public:
+    static constexpr int leaf_capacity = 64;
+    static constexpr int inner_capacity = 16;
+    // Returned by the vertex queries when there is no such vertex.
+    static constexpr uint32_t null_vertex = UINT32_MAX;
+
+    /**
+     * \brief Create `num_vertices` singleton paths, with vertex ids 0, 1, ..., num_vertices - 1.
+     *
+     * \param[in] num_vertices Number of vertices.
+     */
+    explicit block_path(uint32_t num_vertices);
+
+    /**
+     * \brief Create the path (0, 1, ..., costs.size()) with full leaf blocks, where edge (i, i+1) has cost costs[i].
+     *
+     * \param[in] costs Edge costs of the path.
+     */
+    explicit block_path(const std::vector<VType>& costs);
+
+    ~block_path();
+
+    block_path(const block_path&) = delete;
+    block_path& operator=(const block_path&) = delete;
+
+    /**
+     * \brief Number of vertices.
+     */
+    uint32_t num_vertices() const;
+
+    /**
+     * \brief Return the path containing vertex v.
+     *
+     * \param[in] v Vertex id.
+     * \return The path, i.e. its tail vertex.
+     */
+    uint32_t path(uint32_t v) const;
+
+    /**
+     * \brief Return the head vertex (first path vertex) of a path.
+     *
+     * \param[in] p Path (tail vertex).
+     * \return Vertex id of the head of the path.
+     */
+    uint32_t head(uint32_t p) const;
+
+    /**
+     * \brief Return the tail vertex (last path vertex) of a path, which is the path itself.
+     */
+    uint32_t tail(uint32_t p) const;
+
+    /**
+     * \brief Return the vertex before v on `path(v)`. `null_vertex` if v is the head of the path.
+     */
+    uint32_t before(uint32_t v) const;
+
+    /**
+     * \brief Return the vertex after v on `path(v)`. `null_vertex` if v is the tail of the path.
+     */
+    uint32_t after(uint32_t v) const;
+
+    /**
+     * \brief Return the cost of edge (before(v), v). NaN (Not-A-Number) if v is the head of the path.
+     */
+    VType pcost_before(uint32_t v) const;
+
+    /**
+     * \brief Return the cost of edge (v, after(v)). NaN (Not-A-Number) if v is the tail of the path.
+     */
+    VType pcost_after(uint32_t v) const;
+
+    /**
+     * \brief Return the vertex v in p such that (before(v), v) is the minimum cost edge closest to head(p).
+     *
+     * \param[in] p Path (tail vertex).
+     * \return Vertex id v. `null_vertex` if p is a singleton vertex.
+     */
+    uint32_t pmincost_before(uint32_t p) const;
+
+    /**
+     * \brief Return the vertex v in p such that (v, after(v)) is the minimum cost edge closest to tail(p).
+     *
+     * \param[in] p Path (tail vertex).
+     * \return Vertex id v. `null_vertex` if p is a singleton vertex.
+     */
+    uint32_t pmincost_after(uint32_t p) const;
+
+    /**
+     * \brief Add a constant value to every edge of a path in O(1).
+     *
+     * \param[in] p Path (tail vertex). Must have at least one edge.
+     * \param[in] x Constant (no restriction in sign) to be added to every edge of the path.
+     */
+    void pupdate(uint32_t p, VType x);
+
+    /**
+     * \brief Concatenate paths p and q by adding the edge (tail(p), head(q)) of cost x.
+     *
+     * \param[in] p Path (tail vertex). `null_vertex` for an empty path.
+     * \param[in] q Path (tail vertex). `null_vertex` for an empty path.
+     * \param[in] x Cost of edge (tail(p), head(q)).
+     * \return The concatenated path. If q is `null_vertex`, returns p; if p is `null_vertex`, returns q.
+     */
+    uint32_t concatenate(uint32_t p, uint32_t q, VType x);
+
+    /**
+     * \brief Split `path(v)` into (up to) two parts by deleting the edge (before(v), v).
+     *
+     * \note If v == head(path(v)), p is `null_vertex` and x is NaN (Not-A-Number).
+     *
+     * \param[in] v Vertex id pivoted for the split.
+     * \param[out] p Sub-path consisting of all vertices from head(path(v)) to before(v).
+     * \param[out] q Sub-path consisting of all vertices from v to tail(path(v)).
+     * \param[out] x Cost of the deleted edge (before(v), v).
+     */
+    void split_before(uint32_t v, uint32_t& p, uint32_t& q, VType& x);
+
+    /**
+     * \brief Split `path(v)` into (up to) two parts by deleting the edge (v, after(v)).
+     *
+     * \note If v == tail(path(v)), q is `null_vertex` and y is NaN (Not-A-Number).
+     *
+     * \param[in] v Vertex id pivoted for the split.
+     * \param[out] p Sub-path consisting of all vertices from head(path(v)) to v.
+     * \param[out] q Sub-path consisting of all vertices from after(v) to tail(path(v)).
+     * \param[out] y Cost of the deleted edge (v, after(v)).
+     */
+    void split_after(uint32_t v, uint32_t& p, uint32_t& q, VType& y);
+
+    /**
+     * \brief Serialize the edge costs of a path, from head to tail.
+     */
+    void vectorize(uint32_t p, std::vector<VType>& vector_path) const;
+
+    /**
+     * \brief Serialize the vertex ids of a path, from head to tail.
+     */
+    void vectorizeVertex(uint32_t p, std::vector<uint32_t>& vector_vertices) const;
+
+    /**
+     * \brief Number of levels of the B+tree of a path, 0 for a singleton vertex.
+     */
+    int height(uint32_t p) const;
+
+  private:
+    struct node {
+        node* parent;
+        int level;  // 0 for leaf blocks.
+        int count;  // Entries of a leaf block, children of an internal node.
+        VType add;  // Lazy offset of the whole subtree.
+        VType min;  // Minimum of the subtree, including `add` but not the offsets of the ancestors.
+        uint32_t tail;  // Valid only for roots: tail vertex of the path.
+    };
+
+    struct leaf : node {
+        VType cost[leaf_capacity];
+        uint32_t vertex[leaf_capacity];
+    };
+
+    struct inner : node {
+        // One spare slot: a node may overflow by one child before it is split.
+        VType cmin[inner_capacity + 1];  // cmin[i] == child[i]->min
+        node* child[inner_capacity + 1];
+    };
+
+    static leaf* as_leaf_(node* n) { return static_cast<leaf*>(n); }
+    static inner* as_inner_(node* n) { return static_cast<inner*>(n); }
+    static const leaf* as_leaf_(const node* n) { return static_cast<const leaf*>(n); }
+    static const inner* as_inner_(const node* n) { return static_cast<const inner*>(n); }
+    static int capacity_(const node* n) { return n->level == 0 ? leaf_capacity : inner_capacity; }
+    // Non-root nodes hold at least half of the capacity.
+    static int min_fill_(const node* n) { return capacity_(n) / 2; }
+
+    leaf* new_leaf_() const;
+    inner* new_inner_(int level) const;
+    void free_tree_(node* n);
+    // Apply the lazy offset of an internal node to its children, or of a leaf block to its costs.
+    void push_(node* n) const;
+    // Recompute the minimum of a node from its costs or children minimums.
+    void refresh_(node* n) const;
+    // Refresh n and propagate its minimum to all of its ancestors.
+    void refresh_up_(node* n) const;
+    int child_index_(const node* n) const;
+    void set_child_(inner* n, int i, node* child) const;
+    // Record the location of the entries of a leaf block from position `from` on.
+    void reindex_(leaf* l, int from);
+    // Leaf block and slot of the entry before / after a given entry. false if there is none.
+    bool prev_entry_(const leaf*& l, int& slot) const;
+    bool next_entry_(const leaf*& l, int& slot) const;
+    // Cost of an entry, with the offsets of all the ancestors.
+    VType entry_cost_(const leaf* l, int slot) const;
+    // Entry with the minimum cost closest to the head (first) or to the tail (last) of the tree.
+    void min_entry_(const node* root, bool first, const leaf*& l, int& slot) const;
+    // Append the costs (with the offset `base` of the ancestors) and / or the vertices of a subtree in path order.
+    void collect_(const node* n, VType base, std::vector<VType>* costs, std::vector<uint32_t>* vertices) const;
+
+    // Move all the entries or children of `right` to the end of `left` and free `right`.
+    void merge_(node* left, node* right);
+    // Even out the entries or children of two adjacent nodes of the same level.
+    void redistribute_(node* left, node* right);
+    // Insert `child` at position i of n, which may then overflow by one.
+    void insert_child_(inner* n, int i, node* child) const;
+    // Split the overflowing ancestors of n. Returns the root of the tree.
+    node* fix_overflow_(node* n);
+    // Join two trees (roots or nullptr), all the entries of `a` going before those of `b`.
+    node* join_(node* a, node* b);
+    // Root of a tree holding the children [from, to) of n, or nullptr if the range is empty.
+    node* make_root_(inner* n, int from, int to) const;
+    // Remove the entry of vertex v, splitting its tree into the entries before and after it.
+    void cut_(uint32_t v, node*& left, node*& right, VType& cost);
+
+    // Leaf block and slot of the entry of every vertex. nullptr for tails.
+    std::vector<leaf*> m_leaf;
+    std::vector<uint16_t> m_slot;
+    // Root of the tree of every path, indexed by the tail vertex. nullptr for singletons.
+    std::vector<node*> m_root;
+};
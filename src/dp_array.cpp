@@ -6,39 +6,90 @@ Implementation of the functions in dp_array.h
 
 #include "dp_array.h"
 
+#include "dp_trace.h"
+
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
 
 #pragma mark Public functions
 
 template <typename VType>
-dp_array<VType>::dp_array(const std::vector<VType>& input) {
+dp_array<VType>::dp_array(const std::vector<VType>& input, mmap_node_storage<VType>* storage)
+    : dp_array(input, dp_array_mode::dynamic, storage) {}
+
+template <typename VType>
+dp_array<VType>::dp_array(const std::vector<VType>& input, dp_array_mode mode, mmap_node_storage<VType>* storage)
+    : m_mode(mode), m_dp_ops(storage) {
     if (input.empty()) {
         return;
     }
 
-    // Compute re-balance interval.
-    std::size_t reBalanceInterval = 1000;
-    if (input.size() / 10 < reBalanceInterval) {
-        reBalanceInterval = input.size() / 10;
-    }
-    if (reBalanceInterval == 0) {
-        reBalanceInterval = 1;
+    if (m_mode == dp_array_mode::segment_tree) {
+        m_segment_tree = eytzinger_segment_tree<VType>(input);
+        return;
     }
 
-    m_external_nodes.push_back(m_dp_ops.gen_new_node(true, 0));
-    m_root = m_external_nodes[0];
-    bool reBalance = false;
-    for (std::size_t i = 0; i < input.size() - 1; ++i) {
-        m_external_nodes.push_back(m_dp_ops.gen_new_node(true, static_cast<int>(i + 1)));
-        if (i % reBalanceInterval == 0) {
-            reBalance = true;
+    append_chunk_(input.data(), input.size());
+    finish_chunks_();
+}
+
+template <typename VType>
+dp_array<VType>::dp_array(const VType* input, std::size_t n, mmap_node_storage<VType>* storage) : m_dp_ops(storage) {
+    append_chunk_(input, n);
+    finish_chunks_();
+}
+
+template <typename VType>
+dp_array<VType>::dp_array(const std::function<bool(VType&)>& next, mmap_node_storage<VType>* storage)
+    : m_dp_ops(storage) {
+    std::vector<VType> chunk(stream_chunk_size);
+    std::size_t n;
+    do {
+        n = 0;
+        while (n < stream_chunk_size && next(chunk[n])) {
+            ++n;
+        }
+        append_chunk_(chunk.data(), n);
+    } while (n == stream_chunk_size);
+    finish_chunks_();
+}
+
+template <typename VType>
+dp_array<VType>::dp_array(const std::string& filename, dp_array_file_format format, bool& ok,
+                          mmap_node_storage<VType>* storage)
+    : m_dp_ops(storage) {
+    std::ifstream in(filename, format == dp_array_file_format::binary ? std::ios::binary : std::ios::in);
+    ok = static_cast<bool>(in);
+    std::vector<VType> chunk(stream_chunk_size);
+    while (ok && in.good()) {
+        std::size_t n = 0;
+        if (format == dp_array_file_format::binary) {
+            in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(stream_chunk_size * sizeof(VType)));
+            auto bytes = static_cast<std::size_t>(in.gcount());
+            ok = bytes % sizeof(VType) == 0;
+            n = bytes / sizeof(VType);
         } else {
-            reBalance = false;
+            // Whatever is left after whitespace must read as a whole cost, the last one of the file included.
+            while (n < stream_chunk_size && !(in >> std::ws).eof()) {
+                if (!(in >> chunk[n])) {
+                    ok = false;
+                    break;
+                }
+                ++n;
+            }
         }
-        m_root = m_dp_ops.concatenate(m_root, m_external_nodes[i + 1], input[i], reBalance);
+        append_chunk_(chunk.data(), n);
     }
-    m_external_nodes.push_back(m_dp_ops.gen_new_node(true, static_cast<int>(input.size())));
-    m_root = m_dp_ops.concatenate(m_root, m_external_nodes[input.size()], input[input.size() - 1]);
+
+    if (!ok) {
+        clear_();
+        m_external_nodes.clear();
+    }
+    finish_chunks_();
 }
 
 template <typename VType>
@@ -46,137 +97,631 @@ dp_array<VType>::~dp_array() {
     m_dp_ops.clearall(m_root);
 }
 
+template <typename VType>
+dp_array<VType>::dp_array(dp_array&& other) : m_mode(other.m_mode), m_dp_ops(other.m_dp_ops.storage()) {
+    take_(other);
+    m_tracking = other.m_tracking;
+    m_changed.swap(other.m_changed);
+    other.track_changes(false);
+}
+
+template <typename VType>
+dp_array<VType>& dp_array<VType>::operator=(dp_array&& other) {
+    if (&other != this) {
+        clear_();
+        m_mode = other.m_mode;
+        m_dp_ops = dynamic_path_ops<VType>(other.m_dp_ops.storage());
+        take_(other);
+        m_tracking = other.m_tracking;
+        m_changed.swap(other.m_changed);
+        other.track_changes(false);
+    }
+    return *this;
+}
+
 template <typename VType>
 std::optional<VType> dp_array<VType>::edge_cost(int i_k) const {
-    if (!m_root || i_k < 0 || i_k >= m_external_nodes.size() - 1) {
+    DP_TRACE_SPAN(dp_trace_op::array_edge_cost);
+
+    if (i_k < 0 || i_k >= edge_num()) {
         return {};
     }
 
-    return m_dp_ops.pcost_after(m_external_nodes[i_k]);
+    if (m_mode == dp_array_mode::segment_tree) {
+        return m_segment_tree.get(i_k);
+    }
+
+    return m_dp_ops.pcost_after(vertex_(i_k));
 }
 
 template <typename VType>
 void dp_array<VType>::update_constant(int i_k, VType w) {
-    if (!m_root || i_k < 0 || i_k >= m_external_nodes.size() - 1) {
+    DP_TRACE_SPAN(dp_trace_op::array_update_constant);
+
+    if (i_k < 0 || i_k >= edge_num()) {
+        return;
+    }
+
+    if (m_transaction) {
+        log_undo_(undo_record::kind::update, i_k, static_cast<int>(edge_num()), 0, w);
+    }
+    mark_changed_(i_k, edge_num());
+    if (m_mode == dp_array_mode::segment_tree) {
+        m_segment_tree.add(i_k, edge_num(), w);
         return;
     }
 
     TreeNode<VType>* p = nullptr;
     TreeNode<VType>* q = nullptr;
     VType x;
-    m_dp_ops.split_before(m_external_nodes[i_k], p, q, x);
+    m_dp_ops.split_before(vertex_(i_k), p, q, x);
     m_dp_ops.pupdate(q, w);
     m_root = m_dp_ops.concatenate(p, q, x);
 }
 
 template <typename VType>
 void dp_array<VType>::update_constant(int i_k, int i_l, VType w) {
-    if (!m_root || i_k >= i_l || i_k < 0 || i_l >= m_external_nodes.size()) {
+    DP_TRACE_SPAN(dp_trace_op::array_update_constant);
+
+    if (i_k >= i_l || i_k < 0 || i_l >= vertex_num()) {
         return;
     }
 
-    TreeNode<VType>* p1 = nullptr;
-    TreeNode<VType>* p2 = nullptr;
-    TreeNode<VType>* p3 = nullptr;
-    VType x12;
-    VType x23;
-    m_dp_ops.split_before(m_external_nodes[i_k], p1, p2, x12);
-    m_dp_ops.split_after(m_external_nodes[i_l], p2, p3, x23);
-    m_dp_ops.pupdate(p2, w);
-    m_root = m_dp_ops.concatenate(p1, p2, x12);
-    m_root = m_dp_ops.concatenate(m_root, p3, x23);
+    if (m_transaction) {
+        log_undo_(undo_record::kind::update, i_k, i_l, 0, w);
+    }
+    mark_changed_(i_k, i_l);
+    if (m_mode == dp_array_mode::segment_tree) {
+        m_segment_tree.add(i_k, i_l, w);
+        return;
+    }
+
+    update_range_(i_k, i_l, [&](TreeNode<VType>* p) { m_dp_ops.pupdate(p, w); });
+}
+
+template <typename VType>
+bool dp_array<VType>::assign_range(int i_k, int i_l, VType c) {
+    if (m_mode == dp_array_mode::segment_tree || m_transaction || i_k >= i_l || i_k < 0 || i_l >= vertex_num()) {
+        return false;
+    }
+
+    update_range_(i_k, i_l, [&](TreeNode<VType>* p) { m_dp_ops.passign(p, c); });
+    mark_changed_(i_k, i_l);
+    return true;
+}
+
+template <typename VType>
+bool dp_array<VType>::affine_range(int i_k, int i_l, VType a, VType b) {
+    if (m_mode == dp_array_mode::segment_tree || m_transaction || !(a > VType(0)) || i_k >= i_l || i_k < 0 ||
+        i_l >= vertex_num()) {
+        return false;
+    }
+
+    update_range_(i_k, i_l, [&](TreeNode<VType>* p) { m_dp_ops.paffine(p, a, b); });
+    mark_changed_(i_k, i_l);
+    return true;
 }
 
 template <typename VType>
 std::optional<VType> dp_array<VType>::min_cost_first(int i_k, int& min_index) {
-    if (!m_root || i_k < 0 || i_k >= m_external_nodes.size() - 1) {
+    DP_TRACE_SPAN(dp_trace_op::array_min_cost_first);
+
+    if (i_k < 0 || i_k >= edge_num()) {
         return {};
     }
 
+    if (m_mode == dp_array_mode::segment_tree) {
+        std::size_t index;
+        VType cost = m_segment_tree.min_first(i_k, edge_num(), index);
+        min_index = static_cast<int>(index);
+        return cost;
+    }
+
     TreeNode<VType>* p = nullptr;
     TreeNode<VType>* q = nullptr;
     VType x;
-    m_dp_ops.split_before(m_external_nodes[i_k], p, q, x);
+    m_dp_ops.split_before(vertex_(i_k), p, q, x);
     VType cost;
     assert(q);
     TreeNode<VType>* minNode = m_dp_ops.pmincost_before(q);
     cost = m_dp_ops.pcost_before(minNode);
     m_root = m_dp_ops.concatenate(p, q, x);
-    min_index = minNode->node_index - 1;
+    min_index = index_(minNode) - 1;
 
     return cost;
 }
 
 template <typename VType>
 std::optional<VType> dp_array<VType>::min_cost_first(int i_k, int i_l, int& min_index) {
-    if (!m_root || i_k >= i_l || i_k < 0 || i_l >= m_external_nodes.size()) {
+    DP_TRACE_SPAN(dp_trace_op::array_min_cost_first);
+
+    if (i_k >= i_l || i_k < 0 || i_l >= vertex_num()) {
         return {};
     }
 
+    if (m_mode == dp_array_mode::segment_tree) {
+        std::size_t index;
+        VType cost = m_segment_tree.min_first(i_k, i_l, index);
+        min_index = static_cast<int>(index);
+        return cost;
+    }
+
     TreeNode<VType>* p1 = nullptr;
     TreeNode<VType>* p2 = nullptr;
     TreeNode<VType>* p3 = nullptr;
     VType x12;
     VType x23;
-    m_dp_ops.split_before(m_external_nodes[i_k], p1, p2, x12);
-    m_dp_ops.split_after(m_external_nodes[i_l], p2, p3, x23);
+    // Both vertices are looked up before the path is split.
+    TreeNode<VType>* head = vertex_(i_k);
+    TreeNode<VType>* tail = vertex_(i_l);
+    m_dp_ops.split_before(head, p1, p2, x12);
+    m_dp_ops.split_after(tail, p2, p3, x23);
     VType cost;
     assert(p2);
     TreeNode<VType>* minNode = m_dp_ops.pmincost_before(p2);
     cost = m_dp_ops.pcost_before(minNode);
     m_root = m_dp_ops.concatenate(p2, p3, x23);
     m_root = m_dp_ops.concatenate(p1, m_root, x12);
-    min_index = minNode->node_index - 1;
+    min_index = index_(minNode) - 1;
 
     return cost;
 }
 
 template <typename VType>
 std::optional<VType> dp_array<VType>::min_cost_last(int i_k, int& min_index) {
-    if (!m_root || i_k < 0 || i_k >= m_external_nodes.size() - 1) {
+    DP_TRACE_SPAN(dp_trace_op::array_min_cost_last);
+
+    if (i_k < 0 || i_k >= edge_num()) {
         return {};
     }
 
+    if (m_mode == dp_array_mode::segment_tree) {
+        std::size_t index;
+        VType cost = m_segment_tree.min_last(i_k, edge_num(), index);
+        min_index = static_cast<int>(index);
+        return cost;
+    }
+
     TreeNode<VType>* p = nullptr;
     TreeNode<VType>* q = nullptr;
     VType x;
-    m_dp_ops.split_before(m_external_nodes[i_k], p, q, x);
+    m_dp_ops.split_before(vertex_(i_k), p, q, x);
     VType cost;
     assert(q);
     TreeNode<VType>* minNode = m_dp_ops.pmincost_after(q);
     cost = m_dp_ops.pcost_after(minNode);
     m_root = m_dp_ops.concatenate(p, q, x);
-    min_index = minNode->node_index;
+    min_index = index_(minNode);
 
     return cost;
 }
 
 template <typename VType>
 std::optional<VType> dp_array<VType>::min_cost_last(int i_k, int i_l, int& min_index) {
-    if (!m_root || i_k >= i_l || i_k < 0 || i_l >= m_external_nodes.size()) {
+    DP_TRACE_SPAN(dp_trace_op::array_min_cost_last);
+
+    if (i_k >= i_l || i_k < 0 || i_l >= vertex_num()) {
         return {};
     }
 
+    if (m_mode == dp_array_mode::segment_tree) {
+        std::size_t index;
+        VType cost = m_segment_tree.min_last(i_k, i_l, index);
+        min_index = static_cast<int>(index);
+        return cost;
+    }
+
     TreeNode<VType>* p1 = nullptr;
     TreeNode<VType>* p2 = nullptr;
     TreeNode<VType>* p3 = nullptr;
     VType x12;
     VType x23;
-    m_dp_ops.split_before(m_external_nodes[i_k], p1, p2, x12);
-    m_dp_ops.split_after(m_external_nodes[i_l], p2, p3, x23);
+    // Both vertices are looked up before the path is split.
+    TreeNode<VType>* head = vertex_(i_k);
+    TreeNode<VType>* tail = vertex_(i_l);
+    m_dp_ops.split_before(head, p1, p2, x12);
+    m_dp_ops.split_after(tail, p2, p3, x23);
     VType cost;
     assert(p2);
     TreeNode<VType>* minNode = m_dp_ops.pmincost_after(p2);
     cost = m_dp_ops.pcost_after(minNode);
     m_root = m_dp_ops.concatenate(p2, p3, x23);
     m_root = m_dp_ops.concatenate(p1, m_root, x12);
-    min_index = minNode->node_index;
+    min_index = index_(minNode);
 
     return cost;
 }
 
+template <typename VType>
+bool dp_array<VType>::edges_below(int i_k, VType threshold, std::vector<std::pair<int, VType>>& edges) {
+    return edges_below(i_k, static_cast<int>(edge_num()), threshold, edges);
+}
+
+template <typename VType>
+bool dp_array<VType>::edges_below(int i_k, int i_l, VType threshold, std::vector<std::pair<int, VType>>& edges) {
+    DP_TRACE_SPAN(dp_trace_op::array_edges_below);
+
+    if (i_k >= i_l || i_k < 0 || i_l >= vertex_num()) {
+        return false;
+    }
+
+    edges.clear();
+    if (m_mode == dp_array_mode::segment_tree) {
+        m_position_buffer.clear();
+        m_segment_tree.below(i_k, i_l, threshold, m_position_buffer);
+        for (const auto& position : m_position_buffer) {
+            edges.emplace_back(static_cast<int>(position.first), position.second);
+        }
+        return true;
+    }
+
+    TreeNode<VType>* p1 = nullptr;
+    TreeNode<VType>* p2 = nullptr;
+    TreeNode<VType>* p3 = nullptr;
+    VType x12;
+    VType x23;
+    // Both vertices are looked up before the path is split.
+    TreeNode<VType>* head = vertex_(i_k);
+    TreeNode<VType>* tail = vertex_(i_l);
+    m_dp_ops.split_before(head, p1, p2, x12);
+    m_dp_ops.split_after(tail, p2, p3, x23);
+    m_dp_ops.pcost_below(p2, threshold, m_edge_buffer);
+    m_root = m_dp_ops.concatenate(p2, p3, x23);
+    m_root = m_dp_ops.concatenate(p1, m_root, x12);
+    for (const auto& edge : m_edge_buffer) {
+        edges.emplace_back(index_(edge.first), edge.second);
+    }
+
+    return true;
+}
+
+template <typename VType>
+bool dp_array<VType>::min_cost_k(int i_k, std::size_t k, std::vector<std::pair<int, VType>>& edges) {
+    return min_cost_k(i_k, static_cast<int>(edge_num()), k, edges);
+}
+
+template <typename VType>
+bool dp_array<VType>::min_cost_k(int i_k, int i_l, std::size_t k, std::vector<std::pair<int, VType>>& edges) {
+    DP_TRACE_SPAN(dp_trace_op::array_min_cost_k);
+
+    if (i_k >= i_l || i_k < 0 || i_l >= vertex_num()) {
+        return false;
+    }
+
+    edges.clear();
+    if (m_mode == dp_array_mode::segment_tree) {
+        m_position_buffer.clear();
+        m_segment_tree.smallest(i_k, i_l, k, m_position_buffer);
+        for (const auto& position : m_position_buffer) {
+            edges.emplace_back(static_cast<int>(position.first), position.second);
+        }
+        return true;
+    }
+
+    TreeNode<VType>* p1 = nullptr;
+    TreeNode<VType>* p2 = nullptr;
+    TreeNode<VType>* p3 = nullptr;
+    VType x12;
+    VType x23;
+    // Both vertices are looked up before the path is split.
+    TreeNode<VType>* head = vertex_(i_k);
+    TreeNode<VType>* tail = vertex_(i_l);
+    m_dp_ops.split_before(head, p1, p2, x12);
+    m_dp_ops.split_after(tail, p2, p3, x23);
+    m_dp_ops.pmincost_k(p2, k, m_edge_buffer);
+    m_root = m_dp_ops.concatenate(p2, p3, x23);
+    m_root = m_dp_ops.concatenate(p1, m_root, x12);
+    for (const auto& edge : m_edge_buffer) {
+        edges.emplace_back(index_(edge.first), edge.second);
+    }
+
+    return true;
+}
+
+template <typename VType>
+bool dp_array<VType>::push_back(VType w) {
+    DP_TRACE_SPAN(dp_trace_op::array_push_back);
+
+    if (m_mode == dp_array_mode::segment_tree) {
+        return false;
+    }
+
+    if (!m_root) {
+        m_base = 0;
+        m_root = m_dp_ops.gen_new_node(true, m_base);
+        index_back_(m_root);
+    }
+
+    bool indexed = m_indexed_num == vertex_num();
+    TreeNode<VType>* v = m_dp_ops.gen_new_node(true, indexed ? m_base + static_cast<int>(m_indexed_num) : -1);
+    m_dp_ops.set_balance(dynamic_path_balance::deferred);
+    m_root = m_dp_ops.concatenate(m_root, v, w);
+    m_dp_ops.set_balance(dynamic_path_balance::eager);
+    if (indexed) {
+        index_back_(v);
+    }
+    mark_changed_(edge_num() - 1, edge_num());
+    if (m_transaction) {
+        log_undo_(undo_record::kind::push_back, 0, 0, 0, w);
+    }
+    return true;
+}
+
+template <typename VType>
+bool dp_array<VType>::push_front(VType w) {
+    DP_TRACE_SPAN(dp_trace_op::array_push_front);
+
+    if (m_mode == dp_array_mode::segment_tree) {
+        return false;
+    }
+
+    if (!m_root) {
+        m_base = 0;
+        m_root = m_dp_ops.gen_new_node(true, m_base);
+        index_back_(m_root);
+    }
+
+    // The head vertex is always indexed.
+    TreeNode<VType>* v = m_dp_ops.gen_new_node(true, m_base - 1);
+    m_dp_ops.set_balance(dynamic_path_balance::deferred);
+    m_root = m_dp_ops.concatenate(v, m_root, w);
+    m_dp_ops.set_balance(dynamic_path_balance::eager);
+    m_external_nodes.push_front(v);
+    --m_base;
+    ++m_indexed_num;
+    mark_changed_from_(0);
+    if (m_transaction) {
+        log_undo_(undo_record::kind::push_front, 0, 0, 0, w);
+    }
+    return true;
+}
+
+template <typename VType>
+std::optional<VType> dp_array<VType>::pop_back() {
+    DP_TRACE_SPAN(dp_trace_op::array_pop_back);
+
+    if (m_mode == dp_array_mode::segment_tree || vertex_num() < 2) {
+        return {};
+    }
+
+    // The index entry of the tail vertex is left for the next push_back to overwrite.
+    if (m_indexed_num == vertex_num()) {
+        --m_indexed_num;
+    }
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    VType x;
+    m_dp_ops.set_balance(dynamic_path_balance::deferred);
+    m_dp_ops.split_before(m_dp_ops.tail(m_root), p, q, x);
+    m_dp_ops.set_balance(dynamic_path_balance::eager);
+    m_dp_ops.clearall(q);
+    m_root = p;
+    if (vertex_num() == 1) {
+        clear_();
+    }
+    mark_changed_from_(edge_num());
+    if (m_transaction) {
+        log_undo_(undo_record::kind::pop_back, 0, 0, 0, x);
+    }
+
+    return x;
+}
+
+template <typename VType>
+std::optional<VType> dp_array<VType>::pop_front() {
+    DP_TRACE_SPAN(dp_trace_op::array_pop_front);
+
+    if (m_mode == dp_array_mode::segment_tree || vertex_num() < 2) {
+        return {};
+    }
+
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    VType y;
+    m_dp_ops.set_balance(dynamic_path_balance::deferred);
+    m_dp_ops.split_after(m_dp_ops.head(m_root), p, q, y);
+    m_dp_ops.set_balance(dynamic_path_balance::eager);
+    m_dp_ops.clearall(p);
+    if (m_indexed_num > 0) {
+        m_external_nodes.pop_front();
+        ++m_base;
+        --m_indexed_num;
+    }
+    m_root = q;
+    if (vertex_num() == 1) {
+        clear_();
+    }
+    mark_changed_from_(0);
+    if (m_transaction) {
+        log_undo_(undo_record::kind::pop_front, 0, 0, 0, y);
+    }
+
+    return y;
+}
+
+template <typename VType>
+bool dp_array<VType>::insert(int i_k, VType w) {
+    if (m_mode == dp_array_mode::segment_tree || i_k < 0 || i_k > edge_num()) {
+        return false;
+    }
+
+    if (i_k == 0) {
+        return push_front(w);
+    }
+    if (i_k == edge_num()) {
+        return push_back(w);
+    }
+
+    DP_TRACE_SPAN(dp_trace_op::array_insert);
+
+    TreeNode<VType>* u = vertex_(i_k);
+    unindex_from_(i_k + 1);
+
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    VType y;
+    m_dp_ops.split_after(u, p, q, y);
+    m_root = m_dp_ops.concatenate(p, m_dp_ops.gen_new_node(true, -1), w);
+    m_root = m_dp_ops.concatenate(m_root, q, y);
+    mark_changed_from_(i_k);
+    if (m_transaction) {
+        log_undo_(undo_record::kind::insert, i_k, 0, 0, w);
+    }
+    return true;
+}
+
+template <typename VType>
+std::optional<VType> dp_array<VType>::erase(int i_k) {
+    if (m_mode == dp_array_mode::segment_tree || i_k < 0 || i_k >= edge_num()) {
+        return {};
+    }
+
+    if (i_k == 0) {
+        return pop_front();
+    }
+    if (i_k == edge_num() - 1) {
+        return pop_back();
+    }
+
+    DP_TRACE_SPAN(dp_trace_op::array_erase);
+
+    TreeNode<VType>* v = vertex_(i_k + 1);
+    unindex_from_(i_k + 1);
+
+    // p ends at vertex i_k, q is v alone and r starts at vertex i_k + 2.
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    TreeNode<VType>* r = nullptr;
+    VType x;
+    VType y;
+    m_dp_ops.split_before(v, p, q, x);
+    m_dp_ops.split_after(v, q, r, y);
+    m_dp_ops.clearall(q);
+    m_root = m_dp_ops.concatenate(p, r, y);
+    mark_changed_from_(i_k);
+    if (m_transaction) {
+        log_undo_(undo_record::kind::erase, i_k, 0, 0, x);
+    }
+    return x;
+}
+
+template <typename VType>
+bool dp_array<VType>::move_range(int i_k, int i_l, int i_m, VType x, VType y, VType z) {
+    DP_TRACE_SPAN(dp_trace_op::array_move_range);
+
+    if (m_mode == dp_array_mode::segment_tree || i_k < 0 || i_k > i_l || i_l >= vertex_num() || i_m < -1 ||
+        i_m >= static_cast<int>(vertex_num()) || (i_k <= i_m && i_m <= i_l)) {
+        return false;
+    }
+
+    if (m_transaction) {
+        // The costs of the edges the move deletes: (i_m, i_m + 1), (i_k - 1, i_k) and (i_l, i_l + 1).
+        log_undo_(undo_record::kind::move_range, i_k, i_l, i_m, edge_cost(i_m).value_or(VType(0)),
+                  edge_cost(i_k - 1).value_or(VType(0)), edge_cost(i_l).value_or(VType(0)));
+    }
+    TreeNode<VType>* u = vertex_(i_k);
+    TreeNode<VType>* v = vertex_(i_l);
+    TreeNode<VType>* w = i_m < 0 ? nullptr : vertex_(i_m);
+    unindex_from_(std::min(i_k, i_m + 1));
+
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    m_dp_ops.splice(u, v, w, x, y, z, p, q);
+    m_root = w ? p : m_dp_ops.concatenate(p, q, z);
+    // The vertices from min(i_k, i_m + 1) to max(i_l, i_m) move, and so do their edges.
+    std::size_t first = static_cast<std::size_t>(std::min(i_k, i_m + 1));
+    mark_changed_(first > 0 ? first - 1 : 0, std::min<std::size_t>(edge_num(), std::max(i_l, i_m) + 1));
+    return true;
+}
+
+template <typename VType>
+bool dp_array<VType>::append(dp_array&& other, VType w) {
+    DP_TRACE_SPAN(dp_trace_op::array_append);
+
+    if (&other == this || m_mode == dp_array_mode::segment_tree || other.m_mode == dp_array_mode::segment_tree ||
+        m_dp_ops.storage() != other.m_dp_ops.storage() || m_transaction || other.m_transaction) {
+        return false;
+    }
+
+    if (!other.m_root) {
+        return push_back(w);
+    }
+
+    if (!m_root) {
+        // The other path keeps its indexing.
+        take_(other);
+        other.mark_changed_from_(0);
+        return push_front(w);
+    }
+
+    // The indexed vertices of this path keep their index, those of the other path are indexed by their position.
+    // The other dp_array keeps the memory of its index until it is reused or destroyed.
+    TreeNode<VType>* q = other.m_root;
+    m_dp_ops.adopt(other.m_dp_ops, q);
+    other.m_root = nullptr;
+    other.clear_();
+    other.mark_changed_from_(0);
+    std::size_t first = edge_num();
+    m_root = m_dp_ops.concatenate(m_root, q, w);
+    mark_changed_from_(first);
+    return true;
+}
+
+template <typename VType>
+std::optional<VType> dp_array<VType>::split_off(int i_k, dp_array& tail) {
+    DP_TRACE_SPAN(dp_trace_op::array_split_off);
+
+    if (&tail == this || m_mode == dp_array_mode::segment_tree || tail.m_mode == dp_array_mode::segment_tree ||
+        i_k < 0 || i_k >= edge_num() || tail.m_dp_ops.storage() != m_dp_ops.storage() || m_transaction ||
+        tail.m_transaction) {
+        return {};
+    }
+
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    VType x;
+    m_dp_ops.split_after(vertex_(i_k), p, q, x);
+    tail.clear_();
+    tail.m_dp_ops.adopt(m_dp_ops, q);
+    tail.m_root = q;
+    if (tail.vertex_num() == 1) {
+        tail.clear_();
+    }
+
+    // The vertices up to i_k keep their index.
+    m_root = p;
+    unindex_from_(i_k + 1);
+    if (vertex_num() == 1) {
+        clear_();
+    }
+    mark_changed_from_(edge_num());
+    tail.mark_changed_from_(0);
+
+    return x;
+}
+
+template <typename VType>
+bool dp_array<VType>::relayout() {
+    if (m_mode == dp_array_mode::segment_tree || !m_root) {
+        return false;
+    }
+
+    m_root = m_dp_ops.relayout(m_root);
+    return true;
+}
+
 template <typename VType>
 bool dp_array<VType>::vectorize(std::vector<VType>& output) const {
+    DP_TRACE_SPAN(dp_trace_op::array_vectorize);
+
+    if (m_mode == dp_array_mode::segment_tree) {
+        if (m_segment_tree.size() == 0) {
+            return false;
+        }
+        m_segment_tree.vectorize(output);
+        return true;
+    }
+
     if (!m_root) {
         return false;
     }
@@ -187,18 +732,316 @@ bool dp_array<VType>::vectorize(std::vector<VType>& output) const {
     return true;
 }
 
+template <typename VType>
+void dp_array<VType>::track_changes(bool enabled) {
+    m_tracking = enabled;
+    m_changed.clear();
+    mark_changed_from_(0);
+}
+
+template <typename VType>
+bool dp_array<VType>::export_delta(std::vector<std::pair<int, int>>& runs, std::vector<VType>& costs) {
+    runs.clear();
+    costs.clear();
+    if (!m_tracking) {
+        return false;
+    }
+
+    m_range_buffer.assign(m_changed.begin(), m_changed.end());
+    for (const auto& run : m_range_buffer) {
+        runs.emplace_back(static_cast<int>(run.first), static_cast<int>(run.second));
+        if (m_mode == dp_array_mode::segment_tree) {
+            for (std::size_t i = run.first; i < run.second; ++i) {
+                costs.push_back(m_segment_tree.get(i));
+            }
+        }
+    }
+    if (m_mode == dp_array_mode::dynamic) {
+        m_dp_ops.vectorize_ranges(m_root, m_range_buffer, costs);
+    }
+    m_changed.clear();
+    return true;
+}
+
 template <typename VType>
 std::size_t dp_array<VType>::edge_num() const {
-    if (m_external_nodes.empty()) {
+    if (m_mode == dp_array_mode::segment_tree) {
+        return m_segment_tree.size();
+    }
+
+    if (!m_root) {
         return 0;
     }
 
-    return m_external_nodes.size() - 1;
+    return m_root->size - 1;
 }
 
 template <typename VType>
 std::size_t dp_array<VType>::vertex_num() const {
-    return m_external_nodes.size();
+    if (m_mode == dp_array_mode::segment_tree) {
+        return m_segment_tree.size() == 0 ? 0 : m_segment_tree.size() + 1;
+    }
+
+    return m_root ? m_root->size : 0;
+}
+
+template <typename VType>
+dp_array_mode dp_array<VType>::mode() const {
+    return m_mode;
+}
+
+template <typename VType>
+bool dp_array<VType>::save(const std::string& filename) const {
+    if (m_mode == dp_array_mode::segment_tree) {
+        return false;
+    }
+
+    return m_dp_ops.save(m_root, filename);
+}
+
+template <typename VType>
+bool dp_array<VType>::load(const std::string& filename) {
+    if (m_mode == dp_array_mode::segment_tree || m_transaction) {
+        return false;
+    }
+
+    std::vector<TreeNode<VType>*> external_nodes;
+    bool ok;
+    TreeNode<VType>* root = m_dp_ops.load(filename, external_nodes, ok);
+    if (!ok) {
+        return false;
+    }
+
+    // The vertices keep being indexed by node_index as long as it counts their positions from the head, i.e. up to
+    // the first edge inserted or erased in the middle of the saved dp_array.
+    clear_();
+    m_root = root;
+    m_base = external_nodes.empty() ? 0 : external_nodes[0]->node_index;
+    while (m_indexed_num < external_nodes.size() &&
+           external_nodes[m_indexed_num]->node_index == m_base + static_cast<int>(m_indexed_num)) {
+        ++m_indexed_num;
+    }
+    m_external_nodes.assign(external_nodes.begin(), external_nodes.begin() + m_indexed_num);
+    mark_changed_from_(0);
+    return true;
+}
+
+template <typename VType>
+dynamic_path_shape dp_array<VType>::tree_shape() const {
+    if (m_mode == dp_array_mode::segment_tree) {
+        return dynamic_path_shape();
+    }
+
+    return m_dp_ops.tree_shape(m_root);
+}
+
+template <typename VType>
+const dynamic_path_stats& dp_array<VType>::stats() const {
+    return m_dp_ops.stats();
+}
+
+#pragma mark Transactions
+
+template <typename VType>
+std::size_t dp_array<VType>::begin_transaction() {
+    m_transaction = true;
+    return m_undo_log.size();
+}
+
+template <typename VType>
+std::size_t dp_array<VType>::savepoint() const {
+    return m_undo_log.size();
+}
+
+template <typename VType>
+bool dp_array<VType>::rollback(std::size_t savepoint) {
+    if (!m_transaction || savepoint > m_undo_log.size()) {
+        return false;
+    }
+
+    // The inverse edits are not logged in turn.
+    m_transaction = false;
+    while (m_undo_log.size() > savepoint) {
+        const undo_record record = m_undo_log.back();
+        m_undo_log.pop_back();
+        if (record.op == undo_record::kind::update) {
+            update_constant(record.i, record.j, VType(0) - record.x);
+        } else if (record.op == undo_record::kind::push_back) {
+            pop_back();
+        } else if (record.op == undo_record::kind::push_front) {
+            pop_front();
+        } else if (record.op == undo_record::kind::pop_back) {
+            push_back(record.x);
+        } else if (record.op == undo_record::kind::pop_front) {
+            push_front(record.x);
+        } else if (record.op == undo_record::kind::insert) {
+            erase(record.i);
+        } else if (record.op == undo_record::kind::erase) {
+            insert(record.i, record.x);
+        } else {
+            // Move the (sub-)path back after the vertex that was before it, from its new indices.
+            int i_k = record.i;
+            int i_l = record.j;
+            int i_m = record.k;
+            int length = i_l - i_k + 1;
+            if (i_m > i_l) {
+                move_range(i_m - length + 1, i_m, i_k - 1, record.x, record.y, record.z);
+            } else {
+                move_range(i_m + 1, i_m + length, i_k - 1 > i_m ? i_k - 1 + length : i_m, record.x, record.y, record.z);
+            }
+        }
+    }
+    m_transaction = true;
+    return true;
+}
+
+template <typename VType>
+void dp_array<VType>::commit() {
+    m_transaction = false;
+    m_undo_log.clear();
+}
+
+template <typename VType>
+bool dp_array<VType>::in_transaction() const {
+    return m_transaction;
+}
+
+#pragma mark Private functions
+
+template <typename VType>
+template <typename F>
+void dp_array<VType>::update_range_(int i_k, int i_l, F&& update) {
+    TreeNode<VType>* p1 = nullptr;
+    TreeNode<VType>* p2 = nullptr;
+    TreeNode<VType>* p3 = nullptr;
+    VType x12;
+    VType x23;
+    // Both vertices are looked up before the path is split.
+    TreeNode<VType>* head = vertex_(i_k);
+    TreeNode<VType>* tail = vertex_(i_l);
+    m_dp_ops.split_before(head, p1, p2, x12);
+    m_dp_ops.split_after(tail, p2, p3, x23);
+    update(p2);
+    m_root = m_dp_ops.concatenate(p1, p2, x12);
+    m_root = m_dp_ops.concatenate(m_root, p3, x23);
+}
+
+template <typename VType>
+void dp_array<VType>::mark_changed_(std::size_t i_k, std::size_t i_l) {
+    if (!m_tracking || i_k >= i_l) {
+        return;
+    }
+
+    // Merge the ranges overlapping or touching [i_k, i_l) into it.
+    auto it = m_changed.upper_bound(i_k);
+    if (it != m_changed.begin() && std::prev(it)->second >= i_k) {
+        --it;
+        i_k = it->first;
+    }
+    while (it != m_changed.end() && it->first <= i_l) {
+        i_l = std::max(i_l, it->second);
+        it = m_changed.erase(it);
+    }
+    m_changed.emplace(i_k, i_l);
+}
+
+template <typename VType>
+void dp_array<VType>::mark_changed_from_(std::size_t i_k) {
+    if (!m_tracking) {
+        return;
+    }
+
+    std::size_t n = edge_num();
+    m_changed.erase(m_changed.lower_bound(std::min(i_k, n)), m_changed.end());
+    if (!m_changed.empty()) {
+        auto last = std::prev(m_changed.end());
+        last->second = std::min(last->second, n);
+    }
+    mark_changed_(i_k, n);
+}
+
+template <typename VType>
+void dp_array<VType>::log_undo_(typename undo_record::kind op, int i, int j, int k, VType x, VType y, VType z) {
+    m_undo_log.push_back({op, i, j, k, x, y, z});
+}
+
+template <typename VType>
+TreeNode<VType>* dp_array<VType>::vertex_(int i) const {
+    return static_cast<std::size_t>(i) < m_indexed_num ? m_external_nodes[i] : m_dp_ops.vertex_at(m_root, i);
+}
+
+template <typename VType>
+int dp_array<VType>::index_(TreeNode<VType>* v) const {
+    // The node_index of the vertices that are not indexed any more is stale.
+    std::size_t i = static_cast<std::size_t>(v->node_index - m_base);
+    return i < m_indexed_num && m_external_nodes[i] == v ? static_cast<int>(i) : static_cast<int>(m_dp_ops.position(v));
+}
+
+template <typename VType>
+void dp_array<VType>::index_back_(TreeNode<VType>* v) {
+    if (m_external_nodes.size() > m_indexed_num) {
+        m_external_nodes[m_indexed_num] = v;
+    } else {
+        m_external_nodes.push_back(v);
+    }
+    ++m_indexed_num;
+}
+
+template <typename VType>
+void dp_array<VType>::unindex_from_(std::size_t i) {
+    // The entries from i on are left in m_external_nodes, to be overwritten or released with it.
+    m_indexed_num = std::min(m_indexed_num, i);
+}
+
+template <typename VType>
+void dp_array<VType>::clear_() {
+    m_dp_ops.clearall(m_root);
+    m_root = nullptr;
+    m_indexed_num = 0;
+    m_base = 0;
+}
+
+template <typename VType>
+void dp_array<VType>::take_(dp_array& other) {
+    assert(!m_root && m_dp_ops.storage() == other.m_dp_ops.storage());
+    m_dp_ops.adopt(other.m_dp_ops, other.m_root);
+    m_root = other.m_root;
+    m_indexed_num = other.m_indexed_num;
+    m_external_nodes.swap(other.m_external_nodes);
+    m_base = other.m_base;
+    m_segment_tree = std::move(other.m_segment_tree);
+    other.m_segment_tree = eytzinger_segment_tree<VType>();
+    other.m_root = nullptr;
+    other.clear_();
+    commit();
+    other.commit();
+}
+
+template <typename VType>
+void dp_array<VType>::append_chunk_(const VType* costs, std::size_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    m_dp_ops.set_balance(dynamic_path_balance::deferred);
+    if (!m_root) {
+        m_root = m_dp_ops.gen_new_node(true, 0);
+        m_external_nodes.push_back(m_root);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        TreeNode<VType>* v = m_dp_ops.gen_new_node(true, static_cast<int>(m_external_nodes.size()));
+        m_external_nodes.push_back(v);
+        m_root = m_dp_ops.concatenate(m_root, v, costs[i]);
+    }
+}
+
+template <typename VType>
+void dp_array<VType>::finish_chunks_() {
+    m_indexed_num = m_external_nodes.size();
+    if (m_root) {
+        m_root = m_dp_ops.rebuild(m_root);
+    }
+    m_dp_ops.set_balance(dynamic_path_balance::eager);
 }
 
 #pragma mark Instantiations
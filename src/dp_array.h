@@ -11,14 +11,49 @@ Date Created: Oct. 27, 2016.
 #pragma once
 
 #include "dynamic_path.h"
+#include "mmap_node_storage.h"
+#include "segment_tree.h"
 
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <map>
 #include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
+/**
+ * \brief Backing data structure of a dp_array.
+ */
+enum class dp_array_mode {
+    // Dynamic path tree: every method is available.
+    dynamic,
+    // Implicit lazy segment tree for arrays whose vertex order never changes: `update_constant`, `min_cost_*`,
+    // `edge_cost` and `vectorize` give the same results without the split / concatenate machinery, while the methods
+    // that need the tree (`save`, `load`, `tree_shape`) fail.
+    segment_tree,
+};
+
+/**
+ * \brief Format of a file of edge costs read by the streaming constructor of dp_array.
+ */
+enum class dp_array_file_format {
+    // Costs back to back in the native binary representation of VType, e.g. as written by `fwrite`.
+    binary,
+    // Costs as text separated by whitespace, e.g. one per line.
+    text,
+};
+
 /**
  * \brief Concrete dynamic path class containing both states and operations.
  *
  * \note This is just one exemplary implementation of a concrete dynamic path class to illustrate the use of the operations.
+ * Vertices are indexed by their position from the head of the path, so `push_front` and `pop_front` shift the indices
+ * of all the other vertices by one, and `insert` and `erase` those of the vertices after the inserted or erased edge.
+ * Indices map to vertices through a flat array in O(1) for the vertices before the first `insert`, `erase` or
+ * `move_range` in the middle of the path, and through a rank / select search of the tree in O(log n) for the others,
+ * including the vertices of appended paths.
  */
 template <typename VType>
 class dp_array {
@@ -28,8 +63,95 @@ class dp_array {
      * The generated dynamic path is (0, 1, ..., input.size()), where edge (i, i+1) has cost input[i].
      *
      * \param[in] input Raw input vector to initialize the dynamic path data structure from.
+     * \param[in] storage Optional out-of-core storage for the TreeNodes. Must outlive the dp_array.
+     */
+    dp_array(const std::vector<VType>& input, mmap_node_storage<VType>* storage = nullptr);
+
+    /**
+     * \brief Initialize a dp_array backed by the given data structure from the raw input vector.
+     *
+     * \param[in] input Raw input vector to initialize the dp_array from.
+     * \param[in] mode Backing data structure, fixed for the lifetime of the dp_array.
+     * \param[in] storage Optional out-of-core storage for the TreeNodes of the dynamic mode. Must outlive the dp_array.
      */
-    dp_array(const std::vector<VType>& input);
+    dp_array(const std::vector<VType>& input, dp_array_mode mode, mmap_node_storage<VType>* storage = nullptr);
+
+    /**
+     * \brief Initialize a dynamic path data structure from a raw input array that is not held by a std::vector, e.g. a
+     * memory-mapped file, without copying it. The generated dynamic path is (0, 1, ..., n), where edge (i, i+1) has
+     * cost input[i].
+     *
+     * \param[in] input Raw input array of n costs.
+     * \param[in] n Number of costs.
+     * \param[in] storage Optional out-of-core storage for the TreeNodes. Must outlive the dp_array.
+     */
+    dp_array(const VType* input, std::size_t n, mmap_node_storage<VType>* storage = nullptr);
+
+    /**
+     * \brief Initialize a dynamic path data structure from the costs produced one at a time by a generator, which are
+     * appended in chunks of `stream_chunk_size` without ever holding the whole input. The generated dynamic path is
+     * (0, 1, ..., n), where edge (i, i+1) has the i-th cost produced.
+     *
+     * \param[in] next Generator writing the next cost into its argument, returning False once there is none left.
+     * \param[in] storage Optional out-of-core storage for the TreeNodes. Must outlive the dp_array.
+     */
+    dp_array(const std::function<bool(VType&)>& next, mmap_node_storage<VType>* storage = nullptr);
+
+    /**
+     * \brief Initialize a dynamic path data structure from the costs of an input iterator range, read once in order
+     * and appended in chunks as with a generator.
+     *
+     * \param[in] first Iterator to the cost of edge (0, 1).
+     * \param[in] last Iterator past the last cost.
+     * \param[in] storage Optional out-of-core storage for the TreeNodes. Must outlive the dp_array.
+     */
+    template <typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+    dp_array(InputIt first, InputIt last, mmap_node_storage<VType>* storage = nullptr)
+        : dp_array(std::function<bool(VType&)>([&first, &last](VType& cost) {
+                       if (first == last) {
+                           return false;
+                       }
+                       cost = *first;
+                       ++first;
+                       return true;
+                   }),
+                   storage) {}
+
+    /**
+     * \brief Initialize a dynamic path data structure from a file of edge costs, read in buffered chunks of
+     * `stream_chunk_size` costs, so that the file is never resident as a whole.
+     *
+     * \param[in] filename Path of the file of costs.
+     * \param[in] format Binary or text representation of the costs.
+     * \param[out] ok True if the whole file is read. False if it cannot be opened, if a binary file ends with a partial
+     * cost, or if a text file holds something else than costs after whitespace (the dp_array is then left empty).
+     * \param[in] storage Optional out-of-core storage for the TreeNodes. Must outlive the dp_array.
+     */
+    dp_array(const std::string& filename, dp_array_file_format format, bool& ok,
+             mmap_node_storage<VType>* storage = nullptr);
+
+    // Number of costs read at a time by the streaming constructors.
+    static constexpr std::size_t stream_chunk_size = 4096;
+
+    /**
+     * \brief Take over the path of another dp_array without copying it. The other dp_array is left empty.
+     *
+     * \param[in] other dp_array to take the path from.
+     */
+    dp_array(dp_array&& other);
+
+    /**
+     * \brief Release the path and take over the one of another dp_array without copying it. The other dp_array is
+     * left empty.
+     *
+     * \param[in] other dp_array to take the path from.
+     * \return This dp_array.
+     */
+    dp_array& operator=(dp_array&& other);
+
+    // The TreeNodes cannot be shared.
+    dp_array(const dp_array&) = delete;
+    dp_array& operator=(const dp_array&) = delete;
 
     /**
      * \brief Destructor to release all memory.
@@ -61,6 +183,33 @@ class dp_array {
      */
     void update_constant(int i_k, int i_l, VType w);
 
+    /**
+     * \brief Set the costs of all edges in the (sub-)path (i_k, i_l) to a constant c.
+     *
+     * \note O(log n): the (sub-)path is split out, assigned lazily with `dynamic_path_ops::passign` and put back.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] c New cost of every edge of the (sub-)path.
+     * \return True if the costs are set, False if the (sub-)path (i_k, i_l) is not valid, during a transaction and in
+     * segment_tree mode.
+     */
+    bool assign_range(int i_k, int i_l, VType c);
+
+    /**
+     * \brief Replace the cost x of all edges in the (sub-)path (i_k, i_l) by a * x + b with a > 0.
+     *
+     * \note O(log n): the (sub-)path is split out, updated lazily with `dynamic_path_ops::paffine` and put back.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] a Positive factor.
+     * \param[in] b Constant (no restriction in sign) added after the scaling.
+     * \return True if the costs are updated, False if the (sub-)path (i_k, i_l) is not valid, if a is not positive,
+     * during a transaction and in segment_tree mode.
+     */
+    bool affine_range(int i_k, int i_l, VType a, VType b);
+
     /**
      * \brief Get the minimum edge cost of all edges in the (sub-)path (i_k, tail),
      * and the first edge (closest to path head) achieving the minimum.
@@ -111,6 +260,212 @@ class dp_array {
      */
     std::optional<VType> min_cost_last(int i_k, int i_l, int& min_index);
 
+    /**
+     * \brief Report all edges in the (sub-)path (i_k, tail) with a cost below a threshold, in path order.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] threshold Edges with a cost strictly smaller than the threshold are reported.
+     * \param[out] edges Pairs of edge index (edge (i, i + 1) has index i) and cost. Cleared first.
+     * \return True if the edges are reported, False if input i_k is not valid.
+     */
+    bool edges_below(int i_k, VType threshold, std::vector<std::pair<int, VType>>& edges);
+
+    /**
+     * \brief Report all edges in the (sub-)path (i_k, i_l) with a cost below a threshold, in path order.
+     *
+     * \note Output-sensitive: subtrees whose minimum is not below the threshold are never visited.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] threshold Edges with a cost strictly smaller than the threshold are reported.
+     * \param[out] edges Pairs of edge index (edge (i, i + 1) has index i) and cost. Cleared first.
+     * \return True if the edges are reported, False if input (sub-)path (i_k, i_l) is not valid.
+     */
+    bool edges_below(int i_k, int i_l, VType threshold, std::vector<std::pair<int, VType>>& edges);
+
+    /**
+     * \brief Report the k edges in the (sub-)path (i_k, tail) with the smallest costs, by increasing cost.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] k Number of edges to report. All edges are reported if the (sub-)path has fewer.
+     * \param[out] edges Pairs of edge index (edge (i, i + 1) has index i) and cost. Cleared first.
+     * \return True if the edges are reported, False if input i_k is not valid.
+     */
+    bool min_cost_k(int i_k, std::size_t k, std::vector<std::pair<int, VType>>& edges);
+
+    /**
+     * \brief Report the k edges in the (sub-)path (i_k, i_l) with the smallest costs, by increasing cost.
+     *
+     * \note Among edges of equal cost, the order (and the selection at the k-th cost) is unspecified.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] k Number of edges to report. All edges are reported if the (sub-)path has fewer.
+     * \param[out] edges Pairs of edge index (edge (i, i + 1) has index i) and cost. Cleared first.
+     * \return True if the edges are reported, False if input (sub-)path (i_k, i_l) is not valid.
+     */
+    bool min_cost_k(int i_k, int i_l, std::size_t k, std::vector<std::pair<int, VType>>& edges);
+
+    /**
+     * \brief Append an edge of cost w and a new tail vertex. An empty dp_array becomes the path (0, 1).
+     *
+     * \note The appends are rebalanced in the deferred balance mode, i.e. in amortized O(1).
+     *
+     * \param[in] w Cost of the new edge.
+     * \return True if the edge is appended, False in segment_tree mode.
+     */
+    bool push_back(VType w);
+
+    /**
+     * \brief Prepend an edge of cost w and a new head vertex. An empty dp_array becomes the path (0, 1).
+     *
+     * \note The prepends are rebalanced in the deferred balance mode, i.e. in amortized O(1).
+     *
+     * \param[in] w Cost of the new edge.
+     * \return True if the edge is prepended, False in segment_tree mode.
+     */
+    bool push_front(VType w);
+
+    /**
+     * \brief Remove the tail vertex and its edge. Removing the last edge leaves an empty dp_array.
+     *
+     * \note Only the right spine of the tree is updated, in O(log n).
+     *
+     * \return Cost of the removed edge. NaN (Not-A-Number) if there is no edge, and in segment_tree mode.
+     */
+    std::optional<VType> pop_back();
+
+    /**
+     * \brief Remove the head vertex and its edge. Removing the last edge leaves an empty dp_array.
+     *
+     * \note Only the left spine of the tree is updated, in O(log n).
+     *
+     * \return Cost of the removed edge. NaN (Not-A-Number) if there is no edge, and in segment_tree mode.
+     */
+    std::optional<VType> pop_front();
+
+    /**
+     * \brief Insert an edge of cost w at index i_k: edge (i_k, i_k + 1) gets cost w and the edges from i_k on move
+     * one index up. A new vertex is inserted after vertex i_k, connected to the former vertex i_k + 1 by the former
+     * edge (i_k, i_k + 1).
+     *
+     * \note O(log n): one split and two concatenations. `insert(0, w)` and `insert(edge_num(), w)` are equivalent to
+     * `push_front(w)` and `push_back(w)`.
+     *
+     * \param[in] i_k Index of the new edge, from 0 to edge_num().
+     * \param[in] w Cost of the new edge.
+     * \return True if the edge is inserted, False if input i_k is not valid and in segment_tree mode.
+     */
+    bool insert(int i_k, VType w);
+
+    /**
+     * \brief Erase the edge (i_k, i_k + 1): the edges after it move one index down. Vertex i_k + 1 is removed and
+     * vertex i_k is connected to the former vertex i_k + 2 by the former edge (i_k + 1, i_k + 2).
+     * Erasing the last edge leaves an empty dp_array.
+     *
+     * \note O(log n): two splits and one concatenation. `erase(0)` and `erase(edge_num() - 1)` are equivalent to
+     * `pop_front()` and `pop_back()`.
+     *
+     * \param[in] i_k Index of the edge, from 0 to edge_num() - 1.
+     * \return Cost of the erased edge. NaN (Not-A-Number) if input i_k is not valid, and in segment_tree mode.
+     */
+    std::optional<VType> erase(int i_k);
+
+    /**
+     * \brief Move the (sub-)path (i_k, i_l) after vertex i_m, with new costs for the edges around it.
+     * Vertices i_k - 1 and i_l + 1 are connected by an edge of cost x, and the (sub-)path by the edges (i_m, i_k) of
+     * cost y and (i_l, i_m + 1) of cost z. With i_m == -1, the (sub-)path moves to the head of the path, connected to
+     * the rest by the edge (i_l, head) of cost z. The indices are those before the move.
+     *
+     * \note O(log n) with one `dynamic_path_ops::splice`, instead of three splits and three concatenations.
+     *
+     * \param[in] i_k Index of the head vertex of the moved (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the moved (sub-)path, not smaller than i_k.
+     * \param[in] i_m Index of the vertex to move the (sub-)path after, outside of it, or -1 to move it to the head.
+     * \param[in] x Cost of the edge (i_k - 1, i_l + 1). Unused if either does not exist or if i_m == i_k - 1.
+     * \param[in] y Cost of the edge (i_m, i_k). Unused if i_m == -1.
+     * \param[in] z Cost of the edge (i_l, i_m + 1). Unused if i_m is the tail.
+     * \return True if the (sub-)path is moved, False if the input indices are not valid and in segment_tree mode.
+     */
+    bool move_range(int i_k, int i_l, int i_m, VType x, VType y, VType z);
+
+    /**
+     * \brief Append the path of another dp_array, connected to the tail by an edge of cost w, taking over its
+     * TreeNodes without copying them. The other dp_array is left empty. An empty dp_array counts as a single vertex,
+     * so appending an empty dp_array is `push_back(w)`.
+     *
+     * \note O(log n): one concatenation. The appended vertices are indexed by their position in the tree, unless
+     * this dp_array was empty.
+     *
+     * \param[in] other dp_array to append, on the same storage.
+     * \param[in] w Cost of the edge between the tail and the head of the other dp_array.
+     * \return True if the path is appended, False if both dp_arrays are the same, on different storages or if either
+     * is in segment_tree mode.
+     */
+    bool append(dp_array&& other, VType w);
+
+    /**
+     * \brief Split the path after vertex i_k, moving the vertices after it to another dp_array without copying them.
+     * The former content of the other dp_array is released. A part left with a single vertex becomes empty, as
+     * with `pop_back`, so `append(std::move(tail), w)` with the returned cost restores the path.
+     *
+     * \note O(log n): one split. The moved vertices are indexed by their position in the tree.
+     *
+     * \param[in] i_k Index of the new tail vertex, from 0 to edge_num() - 1.
+     * \param[out] tail dp_array receiving the vertices from i_k + 1 on, on the same storage.
+     * \return Cost of the deleted edge (i_k, i_k + 1). NaN (Not-A-Number) if input i_k is not valid, if both
+     * dp_arrays are the same, on different storages or if either is in segment_tree mode.
+     */
+    std::optional<VType> split_off(int i_k, dp_array& tail);
+
+    /**
+     * \brief Start a transaction: from now on, the edits (`update_constant`, `push_back`, `push_front`, `pop_back`,
+     * `pop_front`, `insert`, `erase` and `move_range`) log their inverse by index until `commit`, so that `rollback`
+     * undoes each of them in O(log n) without copying the path. If a transaction is open, it goes on.
+     *
+     * \note `assign_range`, `affine_range`, `append`, `split_off` and `load` fail during a transaction, and moving a
+     * dp_array ends its transaction. Costs of floating-point types are restored up to the rounding of the inverse
+     * updates, and the vertices after the undone edits may be indexed by their position in the tree, as after
+     * `insert`.
+     *
+     * \return Savepoint of the current state, see `rollback`.
+     */
+    std::size_t begin_transaction();
+
+    /**
+     * \brief Savepoint of the current state: the number of logged edits of the open transaction.
+     */
+    std::size_t savepoint() const;
+
+    /**
+     * \brief Undo the edits logged after a savepoint, from the last one. The transaction stays open at the
+     * savepoint, so that later savepoints are no longer valid.
+     *
+     * \param[in] savepoint Savepoint returned by `begin_transaction` or `savepoint` during the open transaction.
+     * \return True if the edits are undone, False if no transaction is open or the savepoint is not valid.
+     */
+    bool rollback(std::size_t savepoint);
+
+    /**
+     * \brief End the open transaction, keeping its edits and clearing its log.
+     */
+    void commit();
+
+    /**
+     * \brief Whether a transaction is open.
+     */
+    bool in_transaction() const;
+
+    /**
+     * \brief Rebalance the dynamic path and lay out its TreeNodes in van Emde Boas order, to restore the query speed
+     * of a dp_array aged by many updates. See `dynamic_path_ops::relayout`.
+     *
+     * \note O(n). The vertices keep their index.
+     *
+     * \return True if the path is laid out, False if it is empty or in segment_tree mode.
+     */
+    bool relayout();
+
     /**
      * \brief Vectorize the internal dynamic path data structure to an std::vector.
      *
@@ -119,6 +474,35 @@ class dp_array {
      */
     bool vectorize(std::vector<VType>& output) const;
 
+    /**
+     * \brief Start or stop tracking the edges whose cost or index changes, for `export_delta`. Tracking starts with
+     * every edge changed, so that the first export covers the whole path.
+     *
+     * \note The changed edges are kept as merged index ranges, updated in O(log r) for r ranges by every edit:
+     * the updated range for `update_constant`, `assign_range` and `affine_range`, and every edge from the first one
+     * whose index moves for the edits that shift indices (`push_front`, `pop_front`, `insert`, `erase`,
+     * `move_range`, `append` and `split_off`).
+     *
+     * Moving a dp_array moves its tracked changes.
+     *
+     * \param[in] enabled Whether to track the changes. Stopping drops the tracked ranges.
+     */
+    void track_changes(bool enabled = true);
+
+    /**
+     * \brief Export the costs of the edges changed since the previous export, and clear the changes.
+     * Copying the runs into a copy of the path resized to `edge_num()` edges gives the current costs.
+     *
+     * \note O(c + r log n) for c changed edges in r runs, with one read-only descent of the tree that only visits
+     * the subtrees overlapping the runs (`dynamic_path_ops::vectorize_ranges`). O(c log n) in segment_tree mode.
+     *
+     * \param[out] runs Changed (sub-)paths (i_k, i_l), i.e. the edges from i_k to i_l - 1, in increasing order.
+     * Cleared first.
+     * \param[out] costs Costs of the edges of the runs, one run after another. Cleared first.
+     * \return True if the changes are exported, False if the changes are not tracked.
+     */
+    bool export_delta(std::vector<std::pair<int, int>>& runs, std::vector<VType>& costs);
+
     /**
      * \brief Get number of edges in the dynamic path.
      *
@@ -133,9 +517,103 @@ class dp_array {
      */
     std::size_t vertex_num() const;
 
+    /**
+     * \brief Backing data structure chosen at construction.
+     */
+    dp_array_mode mode() const;
+
+    /**
+     * \brief Save the dynamic path to a binary snapshot file.
+     *
+     * \param[in] filename Path of the snapshot file to write.
+     * \return True if the snapshot is written successfully, False otherwise (always in segment_tree mode).
+     */
+    bool save(const std::string& filename) const;
+
+    /**
+     * \brief Replace the dynamic path by the one stored in a binary snapshot file written by `save`.
+     * The exact tree is restored without rebalancing.
+     *
+     * \param[in] filename Path of the snapshot file to read.
+     * \return True if the snapshot is loaded successfully, False otherwise (the dynamic path is then left unchanged).
+     * Always False in segment_tree mode.
+     */
+    bool load(const std::string& filename);
+
+    /**
+     * \brief Shape of the underlying tree, computed in O(n).
+     *
+     * \return Numbers of vertices and edges, height and ideal height of the tree. All zero in segment_tree mode.
+     */
+    dynamic_path_shape tree_shape() const;
+
+    /**
+     * \brief Structural counters of the underlying dynamic path operations.
+     *
+     * \note All zero unless the library is built with DYNAMIC_PATH_STATS.
+     */
+    const dynamic_path_stats& stats() const;
+
   private:
+    // Vertex at index i, and index of a vertex.
+    TreeNode<VType>* vertex_(int i) const;
+    int index_(TreeNode<VType>* v) const;
+    // Index a vertex appended after the indexed ones.
+    void index_back_(TreeNode<VType>* v);
+    // Index the vertices from position i on by their position in the tree, as their positions are about to change.
+    void unindex_from_(std::size_t i);
+    // Release all the vertices, leaving an empty dynamic path.
+    void clear_();
+    // Take over the path of another dp_array on the same storage, leaving it empty. This dp_array must be empty.
+    void take_(dp_array& other);
+
+    // Append the vertices of a chunk of costs to the path of a constructor, without rebalancing every step, and
+    // balance the path once all the chunks are appended.
+    void append_chunk_(const VType* costs, std::size_t n);
+    void finish_chunks_();
+
+    // Track the edges from i_k to i_l - 1 as changed.
+    void mark_changed_(std::size_t i_k, std::size_t i_l);
+    // Track every edge from i_k on as changed, and drop the changed edges past the tail.
+    void mark_changed_from_(std::size_t i_k);
+
+    // Split out the (sub-)path (i_k, i_l), apply an update to its root and put it back.
+    template <typename F>
+    void update_range_(int i_k, int i_l, F&& update);
+
+    // Logged edit of a transaction, as its inverse edit: see `rollback`.
+    struct undo_record {
+        enum class kind : uint8_t { update, push_back, push_front, pop_back, pop_front, insert, erase, move_range } op;
+        int i;
+        int j;
+        int k;
+        VType x;
+        VType y;
+        VType z;
+    };
+    void log_undo_(typename undo_record::kind op, int i, int j, int k, VType x, VType y = VType(0), VType z = VType(0));
+
     // Data field
-    std::vector<TreeNode<VType>*> m_external_nodes;
+    dp_array_mode m_mode = dp_array_mode::dynamic;
+    // Number of leading vertices indexed by m_external_nodes and their node_index. Lowered by the edits in the middle
+    // of the path, after which the following vertices are indexed by their position in the tree.
+    std::size_t m_indexed_num = 0;
+    // Vertex i for i < m_indexed_num. The entries after it are stale, and kept to reuse their memory.
+    std::deque<TreeNode<VType>*> m_external_nodes;
+    // node_index of the head vertex: indexed vertex i has node_index m_base + i, moved by push_front and pop_front.
+    int m_base = 0;
     TreeNode<VType>* m_root = nullptr;
     dynamic_path_ops<VType> m_dp_ops;
+    // Edge costs in segment_tree mode.
+    eytzinger_segment_tree<VType> m_segment_tree;
+    // Scratch buffers of the enumeration queries and of export_delta, kept to reuse their memory.
+    std::vector<std::pair<TreeNode<VType>*, VType>> m_edge_buffer;
+    std::vector<std::pair<std::size_t, VType>> m_position_buffer;
+    std::vector<std::pair<std::size_t, std::size_t>> m_range_buffer;
+    // Changed edges since the last export, as merged ranges [first, second) keyed by their first edge.
+    bool m_tracking = false;
+    std::map<std::size_t, std::size_t> m_changed;
+    // Inverse edits of the open transaction.
+    bool m_transaction = false;
+    std::vector<undo_record> m_undo_log;
 };
@@ -0,0 +1,837 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in dp_multi_array.h
+*/
+
+#include "dp_multi_array.h"
+
+#include "block_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Lane kernels: one pass over the contiguous lanes of a node, vectorized by the compiler.
+template <typename VType>
+static inline void lanes_add(VType* __restrict a, const VType* __restrict b, std::size_t n) {
+    for (std::size_t l = 0; l < n; ++l) {
+        a[l] += b[l];
+    }
+}
+
+template <typename VType>
+static inline void lanes_sub(VType* __restrict a, const VType* __restrict b, std::size_t n) {
+    for (std::size_t l = 0; l < n; ++l) {
+        a[l] -= b[l];
+    }
+}
+
+template <typename VType>
+static inline void lanes_min(VType* __restrict a, const VType* __restrict b, std::size_t n) {
+    for (std::size_t l = 0; l < n; ++l) {
+        a[l] = b[l] < a[l] ? b[l] : a[l];
+    }
+}
+
+// a = min(a, b + c)
+template <typename VType>
+static inline void lanes_min_sum(VType* __restrict a, const VType* __restrict b, const VType* __restrict c,
+                                 std::size_t n) {
+    for (std::size_t l = 0; l < n; ++l) {
+        VType s = b[l] + c[l];
+        a[l] = s < a[l] ? s : a[l];
+    }
+}
+
+// Start of a rotation: old grossmins of the root and the new root, and grosscost of the root as the first candidate
+// of its new grossmin.
+template <typename VType>
+static inline void rotation_begin(const VType* __restrict root_netmin, const VType* __restrict root_netcost,
+                                  const VType* __restrict new_root_netmin, VType* __restrict root_grossmin,
+                                  VType* __restrict new_root_grossmin, VType* __restrict root_grossmin_new,
+                                  std::size_t n) {
+    for (std::size_t l = 0; l < n; ++l) {
+        root_grossmin[l] = root_netmin[l];
+        new_root_grossmin[l] = root_netmin[l] + new_root_netmin[l];
+        root_grossmin_new[l] = root_netcost[l] + root_netmin[l];
+    }
+}
+
+// End of a rotation: netmins and netcosts of the root and the new root from their old and new grossmins.
+template <typename VType>
+static inline void rotation_end(VType* __restrict root_netmin, VType* __restrict root_netcost,
+                                VType* __restrict new_root_netmin, VType* __restrict new_root_netcost,
+                                const VType* __restrict root_grossmin, const VType* __restrict new_root_grossmin,
+                                const VType* __restrict root_grossmin_new, std::size_t n) {
+    for (std::size_t l = 0; l < n; ++l) {
+        VType new_root_grossmin_new = std::min(new_root_grossmin[l], root_grossmin_new[l]);
+        new_root_netcost[l] = new_root_netcost[l] + new_root_grossmin[l] - new_root_grossmin_new;
+        new_root_netmin[l] = new_root_grossmin_new;
+        root_netcost[l] = root_netcost[l] + root_grossmin[l] - root_grossmin_new[l];
+        root_netmin[l] = root_grossmin_new[l] - new_root_grossmin_new;
+    }
+}
+
+#pragma mark Public functions
+
+template <typename VType>
+dp_multi_array<VType>::dp_multi_array(std::size_t lanes) : m_lanes(lanes), m_scratch(3 * lanes) {
+    // Whole vectors of lanes after the links.
+    std::size_t bytes = lane_offset + 2 * lanes * sizeof(VType);
+    m_node_bytes = (bytes + lane_offset - 1) / lane_offset * lane_offset;
+}
+
+template <typename VType>
+dp_multi_array<VType>::dp_multi_array(const std::vector<std::vector<VType>>& inputs) : dp_multi_array(inputs.size()) {
+    if (inputs.empty() || inputs[0].empty()) {
+        return;
+    }
+    for (const auto& input : inputs) {
+        if (input.size() != inputs[0].size()) {
+            return;
+        }
+    }
+
+    std::vector<VType> column(m_lanes);
+    m_root = build_(inputs, 0, inputs[0].size(), column.data());
+}
+
+template <typename VType>
+dp_multi_array<VType>::dp_multi_array(dp_multi_array&& other)
+    : m_lanes(other.m_lanes), m_node_bytes(other.m_node_bytes), m_root(other.m_root), m_free_list(other.m_free_list),
+      m_free_num(other.m_free_num), m_scratch(other.m_scratch) {
+    other.m_root = nullptr;
+    other.m_free_list = nullptr;
+    other.m_free_num = 0;
+}
+
+template <typename VType>
+dp_multi_array<VType>& dp_multi_array<VType>::operator=(dp_multi_array&& other) {
+    if (&other != this) {
+        clear_();
+        m_lanes = other.m_lanes;
+        m_node_bytes = other.m_node_bytes;
+        m_root = other.m_root;
+        m_free_list = other.m_free_list;
+        m_free_num = other.m_free_num;
+        m_scratch = other.m_scratch;
+        other.m_root = nullptr;
+        other.m_free_list = nullptr;
+        other.m_free_num = 0;
+    }
+    return *this;
+}
+
+template <typename VType>
+dp_multi_array<VType>::~dp_multi_array() {
+    clear_();
+}
+
+template <typename VType>
+std::size_t dp_multi_array<VType>::lanes() const {
+    return m_lanes;
+}
+
+template <typename VType>
+std::optional<VType> dp_multi_array<VType>::edge_cost(std::size_t lane, int i_k) const {
+    if (lane >= m_lanes || i_k < 0 || i_k >= edge_num()) {
+        return {};
+    }
+
+    const node* u = m_root;
+    VType gm = netmin_(u)[lane];
+    uint32_t i = static_cast<uint32_t>(i_k);
+    while (true) {
+        uint32_t left_edges = edges_(u->left);
+        if (i == left_edges) {
+            return gm + netcost_(u)[lane];
+        }
+        if (i < left_edges) {
+            u = u->left;
+        } else {
+            i -= left_edges + 1;
+            u = u->right;
+        }
+        gm += netmin_(u)[lane];
+    }
+}
+
+template <typename VType>
+void dp_multi_array<VType>::update_constant(std::size_t lane, int i_k, int i_l, VType w) {
+    if (!valid_range_(lane, i_k, i_l)) {
+        return;
+    }
+
+    update_(m_root, static_cast<uint32_t>(i_k), static_cast<uint32_t>(i_l), &w, lane, lane + 1);
+}
+
+template <typename VType>
+void dp_multi_array<VType>::update_constant(int i_k, int i_l, const std::vector<VType>& w) {
+    if (w.size() != m_lanes || !valid_range_(0, i_k, i_l)) {
+        return;
+    }
+
+    update_(m_root, static_cast<uint32_t>(i_k), static_cast<uint32_t>(i_l), w.data(), 0, m_lanes);
+}
+
+template <typename VType>
+std::optional<VType> dp_multi_array<VType>::min_cost_first(std::size_t lane, int i_k, int i_l, int& min_index) const {
+    if (!valid_range_(lane, i_k, i_l)) {
+        return {};
+    }
+
+    // The minimum, then the first edge within the tie tolerance of it.
+    VType gm = netmin_(m_root)[lane];
+    uint32_t a = static_cast<uint32_t>(i_k);
+    uint32_t b = static_cast<uint32_t>(i_l);
+    VType cost = range_min_(m_root, gm, lane, a, b);
+    min_index = static_cast<int>(find_first_(m_root, gm, lane, a, b, cost + block_tie_tolerance<VType>()));
+    return cost;
+}
+
+template <typename VType>
+std::optional<VType> dp_multi_array<VType>::min_cost_last(std::size_t lane, int i_k, int i_l, int& min_index) const {
+    if (!valid_range_(lane, i_k, i_l)) {
+        return {};
+    }
+
+    VType gm = netmin_(m_root)[lane];
+    uint32_t a = static_cast<uint32_t>(i_k);
+    uint32_t b = static_cast<uint32_t>(i_l);
+    VType cost = range_min_(m_root, gm, lane, a, b);
+    min_index = static_cast<int>(find_last_(m_root, gm, lane, a, b, cost + block_tie_tolerance<VType>()));
+    return cost;
+}
+
+template <typename VType>
+bool dp_multi_array<VType>::edges_below(std::size_t lane, int i_k, int i_l, VType threshold,
+                                        std::vector<std::pair<int, VType>>& edges) const {
+    if (!valid_range_(lane, i_k, i_l)) {
+        return false;
+    }
+
+    edges.clear();
+    below_(m_root, netmin_(m_root)[lane], lane, static_cast<uint32_t>(i_k), static_cast<uint32_t>(i_l), 0, threshold,
+           edges);
+    return true;
+}
+
+template <typename VType>
+bool dp_multi_array<VType>::append(dp_multi_array&& other, const std::vector<VType>& w) {
+    if (&other == this || other.m_lanes != m_lanes || w.size() != m_lanes) {
+        return false;
+    }
+
+    m_root = join_(m_root, other.m_root, w.data());
+    other.m_root = nullptr;
+    return true;
+}
+
+template <typename VType>
+bool dp_multi_array<VType>::split_off(int i_k, dp_multi_array& tail, std::vector<VType>& x) {
+    if (&tail == this || tail.m_lanes != m_lanes || i_k < 0 || i_k >= edge_num()) {
+        return false;
+    }
+
+    release_tree_(tail.m_root);
+    x.resize(m_lanes);
+    split_(m_root, static_cast<uint32_t>(i_k), m_root, tail.m_root, x.data());
+    return true;
+}
+
+template <typename VType>
+bool dp_multi_array<VType>::vectorize(std::size_t lane, std::vector<VType>& output) const {
+    if (lane >= m_lanes || !m_root) {
+        return false;
+    }
+
+    output.clear();
+    vectorize_(m_root, netmin_(m_root)[lane], lane, output);
+    return true;
+}
+
+template <typename VType>
+std::size_t dp_multi_array<VType>::edge_num() const {
+    return m_root ? m_root->edges : 0;
+}
+
+template <typename VType>
+std::size_t dp_multi_array<VType>::vertex_num() const {
+    return m_root ? m_root->edges + 1 : 0;
+}
+
+template <typename VType>
+int dp_multi_array<VType>::height() const {
+    return m_root ? m_root->height : 0;
+}
+
+template <typename VType>
+std::size_t dp_multi_array<VType>::memory_bytes() const {
+    return (edge_num() + m_free_num) * m_node_bytes;
+}
+
+#pragma mark Private functions
+
+template <typename VType>
+VType* dp_multi_array<VType>::netmin_(node* u) {
+    return reinterpret_cast<VType*>(reinterpret_cast<char*>(u) + lane_offset);
+}
+
+template <typename VType>
+const VType* dp_multi_array<VType>::netmin_(const node* u) {
+    return reinterpret_cast<const VType*>(reinterpret_cast<const char*>(u) + lane_offset);
+}
+
+template <typename VType>
+VType* dp_multi_array<VType>::netcost_(node* u) const {
+    return netmin_(u) + m_lanes;
+}
+
+template <typename VType>
+const VType* dp_multi_array<VType>::netcost_(const node* u) const {
+    return netmin_(u) + m_lanes;
+}
+
+template <typename VType>
+int dp_multi_array<VType>::height_(const node* u) {
+    return u ? u->height : 1;
+}
+
+template <typename VType>
+uint32_t dp_multi_array<VType>::edges_(const node* u) {
+    return u ? u->edges : 0;
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::alloc_() {
+    if (m_free_list) {
+        node* u = m_free_list;
+        m_free_list = u->left;
+        --m_free_num;
+        return u;
+    }
+
+    return static_cast<node*>(::operator new(m_node_bytes, std::align_val_t(lane_offset)));
+}
+
+template <typename VType>
+void dp_multi_array<VType>::free_(node* u) {
+    u->left = m_free_list;
+    m_free_list = u;
+    ++m_free_num;
+}
+
+template <typename VType>
+void dp_multi_array<VType>::release_(node* u) {
+    ::operator delete(u, std::align_val_t(lane_offset));
+}
+
+template <typename VType>
+void dp_multi_array<VType>::release_tree_(node* u) {
+    if (!u) {
+        return;
+    }
+
+    release_tree_(u->left);
+    release_tree_(u->right);
+    release_(u);
+}
+
+template <typename VType>
+void dp_multi_array<VType>::clear_() {
+    release_tree_(m_root);
+    m_root = nullptr;
+    while (m_free_list) {
+        node* u = m_free_list;
+        m_free_list = u->left;
+        release_(u);
+    }
+    m_free_num = 0;
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::build_(const std::vector<std::vector<VType>>& inputs,
+                                                                    std::size_t lo, std::size_t hi, VType* column) {
+    if (lo == hi) {
+        return nullptr;
+    }
+
+    std::size_t mid = lo + (hi - lo) / 2;
+    node* v = build_(inputs, lo, mid, column);
+    node* w = build_(inputs, mid + 1, hi, column);
+    for (std::size_t l = 0; l < m_lanes; ++l) {
+        column[l] = inputs[l][mid];
+    }
+    return construct_(v, w, column);
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::construct_(node* v, node* w, const VType* x) {
+    node* root = alloc_();
+    root->left = v;
+    root->right = w;
+    root->edges = edges_(v) + edges_(w) + 1;
+    root->height = std::max(height_(v), height_(w)) + 1;
+
+    // Compute grossmin in the netmin of the root.
+    VType* gross_min = netmin_(root);
+    VType* net_cost = netcost_(root);
+    std::copy(x, x + m_lanes, gross_min);
+    if (v) {
+        lanes_min(gross_min, netmin_(v), m_lanes);
+    }
+    if (w) {
+        lanes_min(gross_min, netmin_(w), m_lanes);
+    }
+    std::copy(x, x + m_lanes, net_cost);
+    lanes_sub(net_cost, gross_min, m_lanes);
+
+    // Update fields of v and w
+    if (v) {
+        lanes_sub(netmin_(v), gross_min, m_lanes);
+    }
+    if (w) {
+        lanes_sub(netmin_(w), gross_min, m_lanes);
+    }
+
+    return root;
+}
+
+template <typename VType>
+void dp_multi_array<VType>::destroy_(node* root, node*& v, node*& w, VType* x) {
+    v = root->left;
+    w = root->right;
+    const VType* net_min = netmin_(root);
+    const VType* net_cost = netcost_(root);
+    for (std::size_t l = 0; l < m_lanes; ++l) {
+        x[l] = net_cost[l] + net_min[l];
+    }
+
+    // Update netmin to grossmin for the new root nodes.
+    if (v) {
+        lanes_add(netmin_(v), net_min, m_lanes);
+    }
+    if (w) {
+        lanes_add(netmin_(w), net_min, m_lanes);
+    }
+
+    free_(root);
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::rotateleft_(node* root) {
+    // Make sure the root has an internal right child
+    if (!root || !root->right) {
+        return nullptr;
+    }
+
+    node* new_root = root->right;
+
+    // Change the shape
+    root->right = new_root->left;
+    new_root->left = root;
+    node* p = root->left;
+    node* q = root->right;
+    node* r = new_root->right;
+
+    // Same arithmetic as leafless_path::rotateleft_, one pass per child over the lanes: old grossmins of the root
+    // and the new root, and new grossmin of the root.
+    const std::size_t lanes = m_lanes;
+    VType* root_grossmin = m_scratch.data();
+    VType* new_root_grossmin = root_grossmin + lanes;
+    VType* root_grossmin_new = new_root_grossmin + lanes;
+    VType* root_netmin = netmin_(root);
+    VType* root_netcost = netcost_(root);
+    VType* new_root_netmin = netmin_(new_root);
+    VType* new_root_netcost = netcost_(new_root);
+    rotation_begin(root_netmin, root_netcost, new_root_netmin, root_grossmin, new_root_grossmin, root_grossmin_new,
+                   lanes);
+    if (p) {
+        lanes_min_sum(root_grossmin_new, root_grossmin, netmin_(p), lanes);
+    }
+    if (q) {
+        lanes_min_sum(root_grossmin_new, new_root_grossmin, netmin_(q), lanes);
+    }
+
+    if (p) {
+        lanes_add(netmin_(p), root_grossmin, lanes);
+        lanes_sub(netmin_(p), root_grossmin_new, lanes);
+    }
+    if (q) {
+        lanes_add(netmin_(q), new_root_grossmin, lanes);
+        lanes_sub(netmin_(q), root_grossmin_new, lanes);
+    }
+    if (r) {
+        VType* r_netmin = netmin_(r);
+        for (std::size_t l = 0; l < lanes; ++l) {
+            VType new_root_grossmin_new = std::min(new_root_grossmin[l], root_grossmin_new[l]);
+            r_netmin[l] = new_root_grossmin[l] + r_netmin[l] - new_root_grossmin_new;
+        }
+    }
+
+    rotation_end(root_netmin, root_netcost, new_root_netmin, new_root_netcost, root_grossmin, new_root_grossmin,
+                 root_grossmin_new, lanes);
+
+    // Update the sizes and heights
+    root->edges = edges_(p) + edges_(q) + 1;
+    new_root->edges = root->edges + edges_(r) + 1;
+    root->height = std::max(height_(p), height_(q)) + 1;
+    new_root->height = std::max(root->height, height_(r)) + 1;
+
+    return new_root;
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::rotateright_(node* root) {
+    // Make sure the root has an internal left child
+    if (!root || !root->left) {
+        return nullptr;
+    }
+
+    node* new_root = root->left;
+
+    // Change the shape
+    root->left = new_root->right;
+    new_root->right = root;
+    node* p = new_root->left;
+    node* q = root->left;
+    node* r = root->right;
+
+    // Same arithmetic as leafless_path::rotateright_, see rotateleft_.
+    const std::size_t lanes = m_lanes;
+    VType* root_grossmin = m_scratch.data();
+    VType* new_root_grossmin = root_grossmin + lanes;
+    VType* root_grossmin_new = new_root_grossmin + lanes;
+    VType* root_netmin = netmin_(root);
+    VType* root_netcost = netcost_(root);
+    VType* new_root_netmin = netmin_(new_root);
+    VType* new_root_netcost = netcost_(new_root);
+    rotation_begin(root_netmin, root_netcost, new_root_netmin, root_grossmin, new_root_grossmin, root_grossmin_new,
+                   lanes);
+    if (q) {
+        lanes_min_sum(root_grossmin_new, new_root_grossmin, netmin_(q), lanes);
+    }
+    if (r) {
+        lanes_min_sum(root_grossmin_new, root_grossmin, netmin_(r), lanes);
+    }
+
+    if (p) {
+        VType* p_netmin = netmin_(p);
+        for (std::size_t l = 0; l < lanes; ++l) {
+            VType new_root_grossmin_new = std::min(new_root_grossmin[l], root_grossmin_new[l]);
+            p_netmin[l] = new_root_grossmin[l] + p_netmin[l] - new_root_grossmin_new;
+        }
+    }
+    if (q) {
+        lanes_add(netmin_(q), new_root_grossmin, lanes);
+        lanes_sub(netmin_(q), root_grossmin_new, lanes);
+    }
+    if (r) {
+        lanes_add(netmin_(r), root_grossmin, lanes);
+        lanes_sub(netmin_(r), root_grossmin_new, lanes);
+    }
+
+    rotation_end(root_netmin, root_netcost, new_root_netmin, new_root_netcost, root_grossmin, new_root_grossmin,
+                 root_grossmin_new, lanes);
+
+    // Update the sizes and heights
+    root->edges = edges_(q) + edges_(r) + 1;
+    new_root->edges = edges_(p) + root->edges + 1;
+    root->height = std::max(height_(q), height_(r)) + 1;
+    new_root->height = std::max(height_(p), root->height) + 1;
+
+    return new_root;
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::top_down_balance_(node* root) {
+    if (!root) {
+        return root;
+    }
+
+    node* p = root->left;
+    node* q = root->right;
+
+    // Exit rule
+    if (abs(height_(p) - height_(q)) <= 1) {
+        return root;
+    }
+
+    // Recursively balance both subtrees, each temporarily carrying its grossmin.
+    if (p) {
+        lanes_add_(p, root);
+        p = top_down_balance_(p);
+        root->left = p;
+        lanes_sub_(p, root);
+    }
+    if (q) {
+        lanes_add_(q, root);
+        q = top_down_balance_(q);
+        root->right = q;
+        lanes_sub_(q, root);
+    }
+    root->height = std::max(height_(p), height_(q)) + 1;
+
+    // Balance the top level.
+    if (height_(p) >= height_(q) + 2) {  // Right rotation is required.
+        // Make sure the right sub-tree of p has a smaller height
+        if (height_(p->left) < height_(p->right)) {
+            lanes_add_(p, root);
+            p = rotateleft_(p);
+            root->left = p;
+            lanes_sub_(p, root);
+        }
+
+        return rotateright_(root);
+    }
+
+    if (height_(q) >= height_(p) + 2) {  // Left rotation is required.
+        // Make sure the left sub-tree of q has a smaller height
+        if (height_(q->right) < height_(q->left)) {
+            lanes_add_(q, root);
+            q = rotateright_(q);
+            root->right = q;
+            lanes_sub_(q, root);
+        }
+
+        return rotateleft_(root);
+    }
+
+    return root;
+}
+
+template <typename VType>
+typename dp_multi_array<VType>::node* dp_multi_array<VType>::join_(node* p, node* q, const VType* x) {
+    return top_down_balance_(construct_(p, q, x));
+}
+
+template <typename VType>
+void dp_multi_array<VType>::split_(node* root, uint32_t i, node*& p, node*& q, VType* x) {
+    // Ancestors of the deleted edge, from the root down.
+    m_path.clear();
+    for (node* u = root;;) {
+        m_path.push_back(u);
+        uint32_t left_edges = edges_(u->left);
+        if (i == left_edges) {
+            break;
+        }
+        if (i < left_edges) {
+            u = u->left;
+        } else {
+            i -= left_edges + 1;
+            u = u->right;
+        }
+    }
+
+    m_p_list.clear();
+    m_q_list.clear();
+    m_p_costs.clear();
+    m_q_costs.clear();
+
+    node* temp_v;
+    node* temp_w;
+    // From root to the parent of the edge
+    for (std::size_t k = 0; k + 1 < m_path.size(); ++k) {
+        bool from_left = m_path[k]->left == m_path[k + 1];
+        std::vector<VType>& costs = from_left ? m_q_costs : m_p_costs;
+        costs.resize(costs.size() + m_lanes);
+        destroy_(m_path[k], temp_v, temp_w, costs.data() + costs.size() - m_lanes);
+        if (from_left) {
+            m_q_list.push_back(temp_w);
+        } else {
+            m_p_list.push_back(temp_v);
+        }
+    }
+
+    destroy_(m_path.back(), temp_v, temp_w, x);
+    m_p_list.push_back(temp_v);
+    m_q_list.push_back(temp_w);
+
+    // Generate p
+    p = m_p_list[0];
+    for (std::size_t k = 1; k < m_p_list.size(); ++k) {
+        p = join_(p, m_p_list[k], m_p_costs.data() + (k - 1) * m_lanes);
+    }
+
+    // Generate q
+    q = m_q_list.back();
+    for (std::size_t k = m_q_list.size() - 1; k-- > 0;) {
+        q = join_(q, m_q_list[k], m_q_costs.data() + k * m_lanes);
+    }
+}
+
+template <typename VType>
+void dp_multi_array<VType>::update_(node* u, uint32_t a, uint32_t b, const VType* w, std::size_t l0, std::size_t l1) {
+    VType* net_min = netmin_(u);
+    if (a == 0 && b == u->edges) {
+        for (std::size_t l = l0; l < l1; ++l) {
+            net_min[l] += w[l - l0];
+        }
+        return;
+    }
+
+    uint32_t left_edges = edges_(u->left);
+    if (a < left_edges) {
+        update_(u->left, a, std::min(b, left_edges), w, l0, l1);
+    }
+    VType* net_cost = netcost_(u);
+    if (a <= left_edges && left_edges < b) {
+        for (std::size_t l = l0; l < l1; ++l) {
+            net_cost[l] += w[l - l0];
+        }
+    }
+    if (b > left_edges + 1) {
+        update_(u->right, std::max(a, left_edges + 1) - left_edges - 1, b - left_edges - 1, w, l0, l1);
+    }
+
+    // The grossmin of u moves by the smallest of its netcost and the netmins of its children.
+    VType* delta = m_scratch.data();
+    std::copy(net_cost + l0, net_cost + l1, delta + l0);
+    if (u->left) {
+        lanes_min(delta + l0, netmin_(u->left) + l0, l1 - l0);
+    }
+    if (u->right) {
+        lanes_min(delta + l0, netmin_(u->right) + l0, l1 - l0);
+    }
+    lanes_add(net_min + l0, delta + l0, l1 - l0);
+    lanes_sub(net_cost + l0, delta + l0, l1 - l0);
+    if (u->left) {
+        lanes_sub(netmin_(u->left) + l0, delta + l0, l1 - l0);
+    }
+    if (u->right) {
+        lanes_sub(netmin_(u->right) + l0, delta + l0, l1 - l0);
+    }
+}
+
+template <typename VType>
+void dp_multi_array<VType>::lanes_sub_(node* child, const node* root) {
+    lanes_sub(netmin_(child), netmin_(root), m_lanes);
+}
+
+template <typename VType>
+void dp_multi_array<VType>::lanes_add_(node* child, const node* root) {
+    lanes_add(netmin_(child), netmin_(root), m_lanes);
+}
+
+template <typename VType>
+VType dp_multi_array<VType>::range_min_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b) const {
+    if (a == 0 && b == u->edges) {
+        return gm;
+    }
+
+    uint32_t left_edges = edges_(u->left);
+    bool found = false;
+    VType cost = VType(0);
+    if (a < left_edges) {
+        cost = range_min_(u->left, gm + netmin_(u->left)[lane], lane, a, std::min(b, left_edges));
+        found = true;
+    }
+    if (a <= left_edges && left_edges < b) {
+        VType c = gm + netcost_(u)[lane];
+        cost = found && cost < c ? cost : c;
+        found = true;
+    }
+    if (b > left_edges + 1) {
+        VType c = range_min_(u->right, gm + netmin_(u->right)[lane], lane, std::max(a, left_edges + 1) - left_edges - 1,
+                             b - left_edges - 1);
+        cost = found && cost < c ? cost : c;
+    }
+    return cost;
+}
+
+template <typename VType>
+int64_t dp_multi_array<VType>::find_first_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b,
+                                           VType t) const {
+    if (gm > t) {
+        return -1;
+    }
+
+    uint32_t left_edges = edges_(u->left);
+    if (a < left_edges) {
+        int64_t i = find_first_(u->left, gm + netmin_(u->left)[lane], lane, a, std::min(b, left_edges), t);
+        if (i >= 0) {
+            return i;
+        }
+    }
+    if (a <= left_edges && left_edges < b && gm + netcost_(u)[lane] <= t) {
+        return left_edges;
+    }
+    if (b > left_edges + 1) {
+        int64_t i = find_first_(u->right, gm + netmin_(u->right)[lane], lane, std::max(a, left_edges + 1) - left_edges - 1,
+                                b - left_edges - 1, t);
+        if (i >= 0) {
+            return i + left_edges + 1;
+        }
+    }
+    return -1;
+}
+
+template <typename VType>
+int64_t dp_multi_array<VType>::find_last_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b,
+                                          VType t) const {
+    if (gm > t) {
+        return -1;
+    }
+
+    uint32_t left_edges = edges_(u->left);
+    if (b > left_edges + 1) {
+        int64_t i = find_last_(u->right, gm + netmin_(u->right)[lane], lane, std::max(a, left_edges + 1) - left_edges - 1,
+                               b - left_edges - 1, t);
+        if (i >= 0) {
+            return i + left_edges + 1;
+        }
+    }
+    if (a <= left_edges && left_edges < b && gm + netcost_(u)[lane] <= t) {
+        return left_edges;
+    }
+    if (a < left_edges) {
+        return find_last_(u->left, gm + netmin_(u->left)[lane], lane, a, std::min(b, left_edges), t);
+    }
+    return -1;
+}
+
+template <typename VType>
+void dp_multi_array<VType>::below_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b, uint32_t offset,
+                                   VType threshold, std::vector<std::pair<int, VType>>& edges) const {
+    if (!(gm < threshold)) {
+        return;
+    }
+
+    uint32_t left_edges = edges_(u->left);
+    if (a < left_edges) {
+        below_(u->left, gm + netmin_(u->left)[lane], lane, a, std::min(b, left_edges), offset, threshold, edges);
+    }
+    VType cost = gm + netcost_(u)[lane];
+    if (a <= left_edges && left_edges < b && cost < threshold) {
+        edges.emplace_back(static_cast<int>(offset + left_edges), cost);
+    }
+    if (b > left_edges + 1) {
+        below_(u->right, gm + netmin_(u->right)[lane], lane, std::max(a, left_edges + 1) - left_edges - 1,
+               b - left_edges - 1, offset + left_edges + 1, threshold, edges);
+    }
+}
+
+template <typename VType>
+void dp_multi_array<VType>::vectorize_(const node* u, VType gm, std::size_t lane, std::vector<VType>& output) const {
+    if (u->left) {
+        vectorize_(u->left, gm + netmin_(u->left)[lane], lane, output);
+    }
+    output.push_back(gm + netcost_(u)[lane]);
+    if (u->right) {
+        vectorize_(u->right, gm + netmin_(u->right)[lane], lane, output);
+    }
+}
+
+template <typename VType>
+bool dp_multi_array<VType>::valid_range_(std::size_t lane, int i_k, int i_l) const {
+    return lane < m_lanes && i_k >= 0 && i_k < i_l && i_l < static_cast<int>(vertex_num());
+}
+
+#pragma mark Instantiations
+
+template class dp_multi_array<double>;
+template class dp_multi_array<float>;
+template class dp_multi_array<uint32_t>;
+template class dp_multi_array<int>;
@@ -0,0 +1,270 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the multi-lane dynamic path implementation of arrays
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief K arrays of edge costs that always go through the same splits and concatenations, sharing one tree.
+ *
+ * \note Same balanced binary tree as dynamic_path_ops, with the vertices left implicit as in leafless_path: an
+ * internal node is an edge, and a missing child a vertex. Every node stores the netmin and netcost of all K lanes
+ * contiguously after its links, so the tree shape is built and rebalanced once for all lanes, and `construct_`,
+ * `destroy_` and the rotations update the lanes in loops over contiguous values, vectorized by the compiler (with AVX2
+ * when the library is built for it, see DYNAMIC_PATH_NATIVE).
+ * Vertices and edges are indexed by their position from the head of the path, as in dp_array. The queries of one lane
+ * are read-only descents of the shared tree.
+ */
+template <typename VType>
+class dp_multi_array {
+  public:
+    /**
+     * \brief Initialize an empty multi-array of the given number of lanes.
+     *
+     * \param[in] lanes Number of cost arrays, fixed for the lifetime of the multi-array.
+     */
+    explicit dp_multi_array(std::size_t lanes);
+
+    /**
+     * \brief Initialize a multi-array from one raw input vector per lane, as the balanced path (0, 1, ..., n) where
+     * edge (i, i+1) has cost inputs[lane][i] in each lane.
+     *
+     * \param[in] inputs Raw input vectors, all of the same size n. The multi-array is left empty otherwise.
+     */
+    explicit dp_multi_array(const std::vector<std::vector<VType>>& inputs);
+
+    /**
+     * \brief Take over the path of another multi-array without copying it. The other multi-array is left empty.
+     *
+     * \param[in] other Multi-array to take the path from.
+     */
+    dp_multi_array(dp_multi_array&& other);
+
+    /**
+     * \brief Release the path and take over the one of another multi-array without copying it, with its lanes. The
+     * other multi-array is left empty.
+     *
+     * \param[in] other Multi-array to take the path from.
+     * \return This multi-array.
+     */
+    dp_multi_array& operator=(dp_multi_array&& other);
+
+    // The nodes cannot be shared.
+    dp_multi_array(const dp_multi_array&) = delete;
+    dp_multi_array& operator=(const dp_multi_array&) = delete;
+
+    /**
+     * \brief Destructor to release all memory.
+     */
+    ~dp_multi_array();
+
+    /**
+     * \brief Number of lanes.
+     */
+    std::size_t lanes() const;
+
+    /**
+     * \brief Cost of edge (i_k, i_k + 1) in one lane.
+     *
+     * \param[in] lane Lane of the cost.
+     * \param[in] i_k Head index of the edge.
+     * \return cost of edge (i_k, i_k+1). NaN (Not-A-Number) if input lane or i_k is not valid.
+     */
+    std::optional<VType> edge_cost(std::size_t lane, int i_k) const;
+
+    /**
+     * \brief Update costs of all edges in the (sub-)path (i_k, i_l) of one lane by a constant w.
+     *
+     * \param[in] lane Lane of the costs.
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] w Constant (no restriction in sign) to be added to every edge of the (sub-)path.
+     */
+    void update_constant(std::size_t lane, int i_k, int i_l, VType w);
+
+    /**
+     * \brief Update costs of all edges in the (sub-)path (i_k, i_l) of every lane by the constant of the lane.
+     *
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] w One constant per lane (no restriction in sign) to be added to every edge of the (sub-)path.
+     */
+    void update_constant(int i_k, int i_l, const std::vector<VType>& w);
+
+    /**
+     * \brief Get the minimum edge cost of all edges in the (sub-)path (i_k, i_l) of one lane,
+     * and the first edge (closest to path head) achieving the minimum.
+     *
+     * \param[in] lane Lane of the costs.
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[out] min_index Index of the first edge, closest to path head,
+     * such that (min_index, min_index + 1) achieving the minimum.
+     * \return Minimum edge cost of all edges in the (sub-)path (i_k, i_l).
+     * NaN (Not-A-Number) if input lane or (sub-)path (i_k, i_l) is not valid.
+     */
+    std::optional<VType> min_cost_first(std::size_t lane, int i_k, int i_l, int& min_index) const;
+
+    /**
+     * \brief Get the minimum edge cost of all edges in the (sub-)path (i_k, i_l) of one lane,
+     * and the last edge (closest to path tail) achieving the minimum.
+     *
+     * \param[in] lane Lane of the costs.
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[out] min_index Index of the last edge, closest to path tail,
+     * such that (min_index, min_index + 1) achieving the minimum.
+     * \return Minimum edge cost of all edges in the (sub-)path (i_k, i_l).
+     * NaN (Not-A-Number) if input lane or (sub-)path (i_k, i_l) is not valid.
+     */
+    std::optional<VType> min_cost_last(std::size_t lane, int i_k, int i_l, int& min_index) const;
+
+    /**
+     * \brief Report all edges in the (sub-)path (i_k, i_l) of one lane with a cost below a threshold, in path order.
+     *
+     * \note Output-sensitive: subtrees whose minimum in the lane is not below the threshold are never visited.
+     *
+     * \param[in] lane Lane of the costs.
+     * \param[in] i_k Index of the head vertex of the (sub-)path.
+     * \param[in] i_l Index of the tail vertex of the (sub-)path.
+     * \param[in] threshold Edges with a cost strictly smaller than the threshold are reported.
+     * \param[out] edges Pairs of edge index (edge (i, i + 1) has index i) and cost. Cleared first.
+     * \return True if the edges are reported, False if input lane or (sub-)path (i_k, i_l) is not valid.
+     */
+    bool edges_below(std::size_t lane, int i_k, int i_l, VType threshold, std::vector<std::pair<int, VType>>& edges) const;
+
+    /**
+     * \brief Append the path of another multi-array, connected to the tail by an edge of cost w[lane] in each lane,
+     * taking over its nodes without copying them. The other multi-array is left empty. An empty multi-array counts as
+     * a single vertex.
+     *
+     * \note O(log n): one concatenation for all lanes.
+     *
+     * \param[in] other Multi-array to append, with the same number of lanes.
+     * \param[in] w Cost of the edge between the tail and the head of the other multi-array, one per lane.
+     * \return True if the path is appended, False if both multi-arrays are the same, or if their lanes or the size
+     * of w differ.
+     */
+    bool append(dp_multi_array&& other, const std::vector<VType>& w);
+
+    /**
+     * \brief Split the path after vertex i_k, moving the vertices after it to another multi-array without copying
+     * them. The former content of the other multi-array is released. A part left with a single vertex becomes empty,
+     * so `append(std::move(tail), x)` with the returned costs restores the path.
+     *
+     * \note O(log n): one split for all lanes.
+     *
+     * \param[in] i_k Index of the new tail vertex, from 0 to edge_num() - 1.
+     * \param[out] tail Multi-array receiving the vertices from i_k + 1 on, with the same number of lanes.
+     * \param[out] x Costs of the deleted edge (i_k, i_k + 1), one per lane.
+     * \return True if the path is split, False if input i_k is not valid, if both multi-arrays are the same or if
+     * their lanes differ.
+     */
+    bool split_off(int i_k, dp_multi_array& tail, std::vector<VType>& x);
+
+    /**
+     * \brief Vectorize the costs of one lane to an std::vector.
+     *
+     * \param[in] lane Lane of the costs.
+     * \param[out] output std::vector to hold the vectorized results.
+     * \return True if the vectorization is successful, False if input lane is not valid or the multi-array is empty.
+     */
+    bool vectorize(std::size_t lane, std::vector<VType>& output) const;
+
+    /**
+     * \brief Get number of edges in the dynamic path.
+     */
+    std::size_t edge_num() const;
+
+    /**
+     * \brief Get the number of vertices in the dynamic path.
+     */
+    std::size_t vertex_num() const;
+
+    /**
+     * \brief Height of the shared tree, vertices included. 0 if the multi-array is empty.
+     */
+    int height() const;
+
+    /**
+     * \brief Bytes of the nodes of the path and of the released nodes kept for reuse.
+     */
+    std::size_t memory_bytes() const;
+
+  private:
+    // Internal node, i.e. edge, followed at `lane_offset` bytes by the netmin and then the netcost of every lane.
+    struct node {
+        node* left;  // nullptr for a vertex.
+        node* right;
+        uint32_t edges;  // Number of edges of the subtree.
+        int height;
+    };
+
+    static constexpr std::size_t lane_offset = 32;
+
+    static VType* netmin_(node* u);
+    static const VType* netmin_(const node* u);
+    VType* netcost_(node* u) const;
+    const VType* netcost_(const node* u) const;
+    static int height_(const node* u);
+    static uint32_t edges_(const node* u);
+
+    // Node pool management. Released nodes are chained through their left child.
+    node* alloc_();
+    void free_(node* u);
+    // Return a node, the nodes of a tree, and all the nodes of this multi-array to the allocator.
+    static void release_(node* u);
+    static void release_tree_(node* u);
+    void clear_();
+    // Balanced tree of the edges [lo, hi) of the inputs. `column` holds the lanes of one edge.
+    node* build_(const std::vector<std::vector<VType>>& inputs, std::size_t lo, std::size_t hi, VType* column);
+    // Same operations as leafless_path on nodes whose children may be vertices (nullptr), over all lanes.
+    node* construct_(node* v, node* w, const VType* x);
+    void destroy_(node* root, node*& v, node*& w, VType* x);
+    node* rotateleft_(node* root);
+    node* rotateright_(node* root);
+    node* top_down_balance_(node* root);
+    node* join_(node* p, node* q, const VType* x);
+    // Split the tree at edge i: p gets the edges before it, q those after it, and x its costs.
+    void split_(node* root, uint32_t i, node*& p, node*& q, VType* x);
+    // Add w[l - l0] to the lanes [l0, l1) of the edges [a, b) of the subtree of u, a < b.
+    void update_(node* u, uint32_t a, uint32_t b, const VType* w, std::size_t l0, std::size_t l1);
+    // A child moved under (resp. out of) a root is expressed relative to (resp. made independent of) its grossmin.
+    void lanes_sub_(node* child, const node* root);
+    void lanes_add_(node* child, const node* root);
+
+    // Read-only queries of one lane on the subtree of u of grossmin gm, restricted to its edges [a, b), a < b.
+    VType range_min_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b) const;
+    // Position of the first (resp. last) edge of cost at most t, -1 if there is none.
+    int64_t find_first_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b, VType t) const;
+    int64_t find_last_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b, VType t) const;
+    void below_(const node* u, VType gm, std::size_t lane, uint32_t a, uint32_t b, uint32_t offset, VType threshold,
+                std::vector<std::pair<int, VType>>& edges) const;
+    void vectorize_(const node* u, VType gm, std::size_t lane, std::vector<VType>& output) const;
+    // Whether (i_k, i_l) is a valid non-empty (sub-)path and lane a valid lane.
+    bool valid_range_(std::size_t lane, int i_k, int i_l) const;
+
+    // Data field
+    std::size_t m_lanes = 0;
+    // Bytes of one node with its lanes.
+    std::size_t m_node_bytes = 0;
+    node* m_root = nullptr;
+    node* m_free_list = nullptr;
+    std::size_t m_free_num = 0;
+    // Lanes of the temporary grossmins of the rotations and of `update_`.
+    std::vector<VType> m_scratch;
+    // Nodes and costs of the parts of a split, kept to reuse their memory.
+    std::vector<node*> m_path;
+    std::vector<node*> m_p_list;
+    std::vector<node*> m_q_list;
+    std::vector<VType> m_p_costs;
+    std::vector<VType> m_q_costs;
+};
@@ -0,0 +1,194 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in dp_trace.h
+*/
+
+#include "dp_trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+const char* dp_trace_op_name(dp_trace_op op) {
+    static const char* const names[] = {
+        "path",
+        "before",
+        "after",
+        "pcost_before",
+        "pcost_after",
+        "pmincost_before",
+        "pmincost_after",
+        "pupdate",
+        "concatenate",
+        "split_before",
+        "split_after",
+        "vectorize",
+        "pcost_below",
+        "pmincost_k",
+        "rebuild",
+        "vertex_at",
+        "position",
+        "splice",
+        "relayout",
+        "relayout_step",
+        "dp_array::edge_cost",
+        "dp_array::update_constant",
+        "dp_array::min_cost_first",
+        "dp_array::min_cost_last",
+        "dp_array::vectorize",
+        "dp_array::edges_below",
+        "dp_array::min_cost_k",
+        "dp_array::push_back",
+        "dp_array::push_front",
+        "dp_array::pop_back",
+        "dp_array::pop_front",
+        "dp_array::insert",
+        "dp_array::erase",
+        "dp_array::move_range",
+        "dp_array::append",
+        "dp_array::split_off",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<std::size_t>(dp_trace_op::count),
+                  "Every dp_trace_op needs a name");
+    return op < dp_trace_op::count ? names[static_cast<std::size_t>(op)] : "unknown";
+}
+
+#pragma mark dp_latency_histogram
+
+std::size_t dp_latency_histogram::bucket_index(uint64_t ns) {
+    // Values below 2^(kSubBucketBits + 1) are exact, larger ones keep their top kSubBucketBits + 1 bits.
+    if (ns < (uint64_t(2) << kSubBucketBits)) {
+        return static_cast<std::size_t>(ns);
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - kSubBucketBits;
+    return (static_cast<std::size_t>(shift + 1) << kSubBucketBits) + static_cast<std::size_t>(ns >> shift) -
+           (std::size_t(1) << kSubBucketBits);
+}
+
+uint64_t dp_latency_histogram::bucket_value(std::size_t index) {
+    if (index < (std::size_t(2) << kSubBucketBits)) {
+        return index;
+    }
+    std::size_t shift = (index >> kSubBucketBits) - 1;
+    uint64_t mantissa = (index & ((std::size_t(1) << kSubBucketBits) - 1)) + (uint64_t(1) << kSubBucketBits);
+    return mantissa << shift;
+}
+
+void dp_latency_histogram::record(uint64_t ns) {
+    ++m_buckets[bucket_index(ns)];
+    ++m_count;
+    m_max = std::max(m_max, ns);
+    m_sum += static_cast<double>(ns);
+}
+
+uint64_t dp_latency_histogram::count() const {
+    return m_count;
+}
+
+uint64_t dp_latency_histogram::max() const {
+    return m_max;
+}
+
+double dp_latency_histogram::mean() const {
+    return m_count == 0 ? 0.0 : m_sum / static_cast<double>(m_count);
+}
+
+uint64_t dp_latency_histogram::percentile(double q) const {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(m_count - 1));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBucketNum; ++i) {
+        seen += m_buckets[i];
+        if (seen > rank) {
+            return std::min(bucket_value(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+void dp_latency_histogram::reset() {
+    m_buckets.fill(0);
+    m_count = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+#pragma mark dp_tracer
+
+dp_tracer::dp_tracer() : m_epoch(std::chrono::steady_clock::now()), m_ring(1 << 16) {}
+
+dp_tracer& dp_tracer::instance() {
+    static dp_tracer tracer;
+    return tracer;
+}
+
+void dp_tracer::set_enabled(bool enabled) {
+    m_enabled = enabled;
+}
+
+void dp_tracer::set_ring_capacity(std::size_t capacity) {
+    m_ring.assign(capacity, dp_trace_event());
+    m_ring_next = 0;
+    m_ring_full = false;
+}
+
+const dp_latency_histogram& dp_tracer::histogram(dp_trace_op op) const {
+    return m_histograms[static_cast<std::size_t>(op)];
+}
+
+void dp_tracer::record_event(dp_trace_op op, bool begin, uint64_t timestamp_ns) {
+    if (m_ring.empty()) {
+        return;
+    }
+
+    m_ring[m_ring_next] = {timestamp_ns, op, begin};
+    if (++m_ring_next == m_ring.size()) {
+        m_ring_next = 0;
+        m_ring_full = true;
+    }
+}
+
+std::vector<dp_trace_event> dp_tracer::events() const {
+    std::vector<dp_trace_event> events;
+    if (m_ring_full) {
+        events.insert(events.end(), m_ring.begin() + static_cast<std::ptrdiff_t>(m_ring_next), m_ring.end());
+    }
+    events.insert(events.end(), m_ring.begin(), m_ring.begin() + static_cast<std::ptrdiff_t>(m_ring_next));
+    return events;
+}
+
+bool dp_tracer::dump_trace(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        return false;
+    }
+
+    // Timestamps are in microseconds in the Chrome trace event format. Three fixed decimals keep the
+    // nanosecond resolution, where the default precision of six significant digits would not.
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const dp_trace_event& event : events()) {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+        out << "{\"name\":\"" << dp_trace_op_name(event.op) << "\",\"ph\":\"" << (event.begin ? 'B' : 'E')
+            << "\",\"ts\":" << static_cast<double>(event.timestamp_ns) / 1000.0 << ",\"pid\":0,\"tid\":0}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    return static_cast<bool>(out.flush());
+}
+
+void dp_tracer::reset() {
+    for (dp_latency_histogram& histogram : m_histograms) {
+        histogram.reset();
+    }
+    m_ring_next = 0;
+    m_ring_full = false;
+}
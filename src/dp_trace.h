@@ -0,0 +1,231 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the latency histograms and trace spans of the dynamic path operations
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Operations instrumented by the tracer.
+ */
+enum class dp_trace_op : uint8_t {
+    path,
+    before,
+    after,
+    pcost_before,
+    pcost_after,
+    pmincost_before,
+    pmincost_after,
+    pupdate,
+    concatenate,
+    split_before,
+    split_after,
+    vectorize,
+    pcost_below,
+    pmincost_k,
+    rebuild,
+    vertex_at,
+    position,
+    splice,
+    relayout,
+    relayout_step,
+    array_edge_cost,
+    array_update_constant,
+    array_min_cost_first,
+    array_min_cost_last,
+    array_vectorize,
+    array_edges_below,
+    array_min_cost_k,
+    array_push_back,
+    array_push_front,
+    array_pop_back,
+    array_pop_front,
+    array_insert,
+    array_erase,
+    array_move_range,
+    array_append,
+    array_split_off,
+    count
+};
+
+/**
+ * \brief Name of an instrumented operation.
+ */
+const char* dp_trace_op_name(dp_trace_op op);
+
+/**
+ * \brief HDR-style latency histogram: log-linear buckets with 16 sub-buckets per power of two (~6% precision).
+ */
+class dp_latency_histogram {
+  public:
+    /**
+     * \brief Record one latency sample.
+     *
+     * \param[in] ns Latency in nanoseconds.
+     */
+    void record(uint64_t ns);
+
+    /**
+     * \brief Number of recorded samples.
+     */
+    uint64_t count() const;
+
+    /**
+     * \brief Largest recorded sample in nanoseconds.
+     */
+    uint64_t max() const;
+
+    /**
+     * \brief Mean of the recorded samples in nanoseconds.
+     */
+    double mean() const;
+
+    /**
+     * \brief Latency at the given quantile, as the lower bound of the bucket holding it.
+     *
+     * \param[in] q Quantile in [0, 1].
+     * \return Latency in nanoseconds. 0 if no sample is recorded.
+     */
+    uint64_t percentile(double q) const;
+
+    /**
+     * \brief Drop all samples.
+     */
+    void reset();
+
+  private:
+    static const int kSubBucketBits = 4;
+    static const std::size_t kBucketNum = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+    static std::size_t bucket_index(uint64_t ns);
+    static uint64_t bucket_value(std::size_t index);
+
+    std::array<uint64_t, kBucketNum> m_buckets{};
+    uint64_t m_count = 0;
+    uint64_t m_max = 0;
+    double m_sum = 0;
+};
+
+/**
+ * \brief Begin or end event of a trace span.
+ */
+struct dp_trace_event {
+    uint64_t timestamp_ns;
+    dp_trace_op op;
+    bool begin;
+};
+
+/**
+ * \brief Process-wide tracer: one latency histogram per operation and a ring buffer of trace events.
+ *
+ * \note Instrumentation is compiled in only with DYNAMIC_PATH_TRACE (CMake option of the same name), and then
+ * disabled until `set_enabled(true)`. A disabled tracer costs one flag test per call. Not thread-safe.
+ */
+class dp_tracer {
+  public:
+    /**
+     * \brief The process-wide tracer.
+     */
+    static dp_tracer& instance();
+
+    /**
+     * \brief Enable or disable recording.
+     */
+    void set_enabled(bool enabled);
+
+    bool enabled() const { return m_enabled; }
+
+    /**
+     * \brief Resize the trace event ring buffer, dropping recorded events.
+     *
+     * \param[in] capacity Number of events kept; the oldest events are overwritten first. 0 disables trace events.
+     */
+    void set_ring_capacity(std::size_t capacity);
+
+    /**
+     * \brief Latency histogram of an operation.
+     */
+    const dp_latency_histogram& histogram(dp_trace_op op) const;
+
+    /**
+     * \brief Recorded trace events, oldest first.
+     */
+    std::vector<dp_trace_event> events() const;
+
+    /**
+     * \brief Write the recorded trace events in the Chrome trace event format (chrome://tracing, Perfetto).
+     *
+     * \param[in] filename Path of the JSON file to write.
+     * \return True if the file is written successfully, False otherwise.
+     */
+    bool dump_trace(const std::string& filename) const;
+
+    /**
+     * \brief Drop all histogram samples and trace events.
+     */
+    void reset();
+
+    // Called by dp_trace_span.
+    uint64_t now_ns() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count());
+    }
+    void record_event(dp_trace_op op, bool begin, uint64_t timestamp_ns);
+    void record_latency(dp_trace_op op, uint64_t ns) { m_histograms[static_cast<std::size_t>(op)].record(ns); }
+
+  private:
+    dp_tracer();
+
+    bool m_enabled = false;
+    std::chrono::steady_clock::time_point m_epoch;
+    std::array<dp_latency_histogram, static_cast<std::size_t>(dp_trace_op::count)> m_histograms;
+    std::vector<dp_trace_event> m_ring;
+    std::size_t m_ring_next = 0;
+    bool m_ring_full = false;
+};
+
+/**
+ * \brief RAII span: records a begin and an end event and the latency of the enclosing scope when tracing is enabled.
+ */
+class dp_trace_span {
+  public:
+    explicit dp_trace_span(dp_trace_op op) : m_op(op) {
+        dp_tracer& tracer = dp_tracer::instance();
+        if (tracer.enabled()) {
+            m_active = true;
+            m_start_ns = tracer.now_ns();
+            tracer.record_event(op, true, m_start_ns);
+        }
+    }
+
+    ~dp_trace_span() {
+        if (m_active) {
+            dp_tracer& tracer = dp_tracer::instance();
+            uint64_t end_ns = tracer.now_ns();
+            tracer.record_event(m_op, false, end_ns);
+            tracer.record_latency(m_op, end_ns - m_start_ns);
+        }
+    }
+
+    dp_trace_span(const dp_trace_span&) = delete;
+    dp_trace_span& operator=(const dp_trace_span&) = delete;
+
+  private:
+    dp_trace_op m_op;
+    bool m_active = false;
+    uint64_t m_start_ns = 0;
+};
+
+#ifdef DYNAMIC_PATH_TRACE
+#define DP_TRACE_SPAN(op) dp_trace_span dp_trace_span_guard_(op)
+#else
+#define DP_TRACE_SPAN(op)
+#endif
@@ -6,42 +6,235 @@ Implementation of the functions in dynamic_path.h
 
 #include "dynamic_path.h"
 
+#include "dp_trace.h"
+#include "mmap_node_storage.h"
+
 #include <cassert>
+#include <climits>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <new>
 #include <utility>
 
+#ifdef DYNAMIC_PATH_STATS
+#define DP_STAT(statement) statement
+#else
+#define DP_STAT(statement)
+#endif
+
 template <typename VType>
 static bool close_to_zero(VType x) {
     return fabs(x) < 1e-6;
 }
 
+// First and last vertices of a (sub-)tree.
+template <typename VType>
+static TreeNode<VType>* subtree_head(TreeNode<VType>* p) {
+    return p->external ? p : p->bhead;
+}
+
+template <typename VType>
+static TreeNode<VType>* subtree_tail(TreeNode<VType>* p) {
+    return p->external ? p : p->btail;
+}
+
+// Whether the links of a vertex of a (sub-)tree are swapped by the pending reversals between them, see TreeNode.
+template <typename VType>
+static bool links_swapped(TreeNode<VType>* v, TreeNode<VType>* p) {
+    bool swapped = false;
+    if (p->external || !p->reversed_below) return swapped;
+    for (; v != p; v = v->bparent) {
+        swapped = swapped != v->bparent->reversed;
+    }
+    return swapped;
+}
+
+// Links to the previous / next vertex of a vertex of a (sub-)tree without any pending reversal above it.
+template <typename VType>
+static TreeNode<VType>*& prev_link(TreeNode<VType>* v, TreeNode<VType>* p) {
+    return links_swapped(v, p) ? v->btail : v->bhead;
+}
+
+template <typename VType>
+static TreeNode<VType>*& next_link(TreeNode<VType>* v, TreeNode<VType>* p) {
+    return links_swapped(v, p) ? v->bhead : v->btail;
+}
+
+// Minimum height of a tree with the given number of vertices: ceil(log2(vertices)) + 1.
+static int ideal_height(std::size_t vertices) {
+    int height = 1;
+    while ((std::size_t(1) << (height - 1)) < vertices) {
+        ++height;
+    }
+    return height;
+}
+
+// Whether the height of a tree exceeds twice its ideal height, that is whether ideal_height(size) <= k for the
+// largest k with 2k < height, without computing the logarithm.
+template <typename VType>
+static bool drifted(const TreeNode<VType>* u) {
+    int k = (u->height - 1) / 2;
+    return k >= 1 && (k > 63 || (std::size_t(1) << (k - 1)) >= static_cast<std::size_t>(u->size));
+}
+
+// Whether a bottom-up walk from a vertex, without pending reversals, only goes up along the spine of its first step,
+// i.e. whether the vertex is the head (first step from a left child) or the tail (from a right child) of the path.
+template <typename VType>
+static bool on_end_spine(const std::vector<TreeNode<VType>*>& walk) {
+    bool right = walk[1]->bright == walk[0];
+    for (std::size_t i = 1; i + 1 < walk.size(); ++i) {
+        if ((walk[i + 1]->bright == walk[i]) != right) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the descent of pmincost_before stops at u. Ties within the tolerance go to the edges closest to the head.
+template <typename VType>
+static bool pmincost_condition_before(TreeNode<VType>* u) {
+    if (!close_to_zero(u->netcost)) return false;
+    if ((u->bleft->external) || (u->bleft->netmin > 0)) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+template <typename VType>
+static bool pmincost_condition_after(TreeNode<VType>* u) {
+    if (!close_to_zero(u->netcost)) return false;
+    if ((u->bright->external) || (u->bright->netmin > 0)) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Recompute the minimum cost edges cached in an internal TreeNode from its children, with the same choices as
+// the descents of pmincost_before / pmincost_after. The children of a reversed node are still in their original
+// order, and its first and last edges are swapped like bhead / btail.
+template <typename VType>
+static void refresh_min(TreeNode<VType>* u) {
+    TreeNode<VType>* left = u->bleft;
+    TreeNode<VType>* right = u->bright;
+    if (pmincost_condition_before(u)) {
+        u->bminfirst = u;
+    } else if ((!left->external) && (close_to_zero(left->netmin))) {
+        u->bminfirst = left->bminfirst;
+    } else {
+        u->bminfirst = right->external ? u : right->bminfirst;
+    }
+
+    if (pmincost_condition_after(u)) {
+        u->bminlast = u;
+    } else if ((!right->external) && (close_to_zero(right->netmin))) {
+        u->bminlast = right->bminlast;
+    } else {
+        u->bminlast = left->external ? u : left->bminlast;
+    }
+
+    if (u->reversed) {
+        std::swap(u->bminfirst, u->bminlast);
+    }
+    u->reversed_below = u->reversed || (!left->external && left->reversed_below) ||
+                        (!right->external && right->reversed_below);
+}
+
 #pragma mark Public functions
 
+template <typename VType>
+dynamic_path_ops<VType>::dynamic_path_ops(mmap_node_storage<VType>* storage) : m_storage(storage) {}
+
 template <typename VType>
 TreeNode<VType>* dynamic_path_ops<VType>::gen_new_node(bool is_external, int node_index) const {
-    TreeNode<VType>* p = new TreeNode<VType>();
+    TreeNode<VType>* p = nullptr;
+    if (m_storage) {
+        p = m_storage->allocate();
+    }
+    p = p ? new (p) TreeNode<VType>() : new TreeNode<VType>();
+    DP_STAT(++m_stats.node_allocations);
+    DP_STAT(m_stats.node_bytes += sizeof(TreeNode<VType>));
     p->external = is_external;
     p->node_index = node_index;
     p->bparent = nullptr;
     p->netmin = VType(0);
     p->netcost = VType(0);
+    p->scale = VType(1);
     p->bhead = nullptr;
     p->bleft = nullptr;
     p->bright = nullptr;
     p->btail = nullptr;
+    p->bminfirst = nullptr;
+    p->bminlast = nullptr;
+    p->reversed = false;
+    p->reversed_below = false;
     p->height = 1;
+    p->size = 1;
     return p;
 }
 
+template <typename VType>
+void dynamic_path_ops<VType>::adopt(const dynamic_path_ops& from, TreeNode<VType>* p) const {
+    assert(from.m_storage == m_storage);
+
+    if (!p) {
+        return;
+    }
+
+    // Vertices and edges.
+    std::size_t nodes = 2 * p->size - 1;
+    DP_STAT(m_stats.node_allocations += nodes);
+    DP_STAT(m_stats.node_bytes += nodes * sizeof(TreeNode<VType>));
+    DP_STAT(from.m_stats.node_frees += nodes);
+    DP_STAT(from.m_stats.node_bytes -= nodes * sizeof(TreeNode<VType>));
+    (void)nodes;
+
+    if (from.m_pending_reversals == 0 && from.m_pending_scalings == 0) {
+        return;
+    }
+    std::vector<TreeNode<VType>*> stack{p};
+    while (!stack.empty()) {
+        TreeNode<VType>* u = stack.back();
+        stack.pop_back();
+        if (u->external) continue;
+        if (u->reversed) {
+            --from.m_pending_reversals;
+            ++m_pending_reversals;
+        }
+        if (!(u->scale == VType(1))) {
+            --from.m_pending_scalings;
+            ++m_pending_scalings;
+        }
+        stack.push_back(u->bleft);
+        stack.push_back(u->bright);
+    }
+}
+
+template <typename VType>
+mmap_node_storage<VType>* dynamic_path_ops<VType>::storage() const {
+    return m_storage;
+}
+
 template <typename VType>
 TreeNode<VType>* dynamic_path_ops<VType>::path(TreeNode<VType>* v) const {
+    DP_TRACE_SPAN(dp_trace_op::path);
+
     if (!v) {
         return nullptr;
     }
 
+    std::size_t steps = 0;
     while (v->bparent != nullptr) {
         v = v->bparent;
+        ++steps;
     }
+    record_root_walk_(steps);
 
     return v;
 }
@@ -80,70 +273,91 @@ TreeNode<VType>* dynamic_path_ops<VType>::tail(TreeNode<VType>* p) const {
 
 template <typename VType>
 TreeNode<VType>* dynamic_path_ops<VType>::before(TreeNode<VType>* v) const {
+    DP_TRACE_SPAN(dp_trace_op::before);
+
     if (!v) {
         return nullptr;
     }
 
     // Must be an external vertex node.
     assert(v->external);
-
-    TreeNode<VType>* w = v;
-    TreeNode<VType>* w_parent = w->bparent;
-    TreeNode<VType>* u = nullptr;
-    while (w_parent != nullptr) {
-        if (w == w_parent->bright) {
-            u = w_parent->bleft;
-            break;
-        }
-        w = w_parent;
-        w_parent = w->bparent;
+    // The links are in path order once no reversal is pending above v.
+    if (m_pending_reversals > 0) {
+        push_path_(v);
     }
 
-    if (u == nullptr) {
+    return v->bhead;
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::after(TreeNode<VType>* v) const {
+    DP_TRACE_SPAN(dp_trace_op::after);
+
+    if (!v) {
         return nullptr;
     }
 
-    if (u->external) {
-        return u;
+    // Must be an external vertex node.
+    assert(v->external);
+    if (m_pending_reversals > 0) {
+        push_path_(v);
     }
 
-    return u->btail;
+    return v->btail;
 }
 
 template <typename VType>
-TreeNode<VType>* dynamic_path_ops<VType>::after(TreeNode<VType>* v) const {
-    if (!v) {
+TreeNode<VType>* dynamic_path_ops<VType>::vertex_at(TreeNode<VType>* p, std::size_t i) const {
+    DP_TRACE_SPAN(dp_trace_op::vertex_at);
+
+    if (!p || i >= static_cast<std::size_t>(p->size)) {
         return nullptr;
     }
 
-    // Must be an external vertex node.
-    assert(v->external);
+    // Must be a root node.
+    assert(!p->bparent);
 
-    TreeNode<VType>* w = v;
-    TreeNode<VType>* w_parent = w->bparent;
-    TreeNode<VType>* u = nullptr;
-    while (w_parent != nullptr) {
-        if (w == w_parent->bleft) {
-            u = w_parent->bright;
-            break;
+    // `flip` tells whether the ancestors of p have pending reversals, as in `vectorize_internal`.
+    bool flip = false;
+    while (!p->external) {
+        flip = flip != p->reversed;
+        TreeNode<VType>* left = flip ? p->bright : p->bleft;
+        if (i < static_cast<std::size_t>(left->size)) {
+            p = left;
+        } else {
+            i -= left->size;
+            p = flip ? p->bleft : p->bright;
         }
-        w = w_parent;
-        w_parent = w->bparent;
     }
 
-    if (u == nullptr) {
-        return nullptr;
-    }
+    return p;
+}
+
+template <typename VType>
+std::size_t dynamic_path_ops<VType>::position(TreeNode<VType>* v) const {
+    DP_TRACE_SPAN(dp_trace_op::position);
 
-    if (u->external) {
-        return u;
+    // Must be an external vertex node.
+    assert(v && v->external);
+    push_path_(v);
+
+    std::size_t i = 0;
+    std::size_t steps = 0;
+    for (TreeNode<VType>* w = v; w->bparent != nullptr; w = w->bparent) {
+        ++steps;
+        if (w == w->bparent->bright) {
+            i += w->bparent->bleft->size;
+        }
     }
+    record_root_walk_(steps);
 
-    return u->bhead;
+    return i;
 }
 
 template <typename VType>
 VType dynamic_path_ops<VType>::pcost_before(TreeNode<VType>* v) const {
+    DP_TRACE_SPAN(dp_trace_op::pcost_before);
+
     if (!v) {
         return static_cast<VType>(NAN);
     }
@@ -151,6 +365,8 @@ VType dynamic_path_ops<VType>::pcost_before(TreeNode<VType>* v) const {
     // Must be an external vertex node.
     assert(v->external);
 
+    push_path_(v);
+
     // Check if v is the head of path(v)
     if (v == head(path(v))) return static_cast<VType>(NAN);
 
@@ -162,6 +378,7 @@ VType dynamic_path_ops<VType>::pcost_before(TreeNode<VType>* v) const {
         backup_nodes.push_back(v);
         v = v->bparent;
     }
+    record_root_walk_(backup_nodes.size() - 1);
 
     // Compute grossmin values
     std::vector<VType> grossmin(backup_nodes.size(), 0);
@@ -186,6 +403,8 @@ VType dynamic_path_ops<VType>::pcost_before(TreeNode<VType>* v) const {
 
 template <typename VType>
 VType dynamic_path_ops<VType>::pcost_after(TreeNode<VType>* v) const {
+    DP_TRACE_SPAN(dp_trace_op::pcost_after);
+
     if (!v) {
         return static_cast<VType>(NAN);
     }
@@ -193,6 +412,8 @@ VType dynamic_path_ops<VType>::pcost_after(TreeNode<VType>* v) const {
     // Must be an external vertex node.
     assert(v->external);
 
+    push_path_(v);
+
     // Check if v is the tail of path(v)
     if (v == tail(path(v))) return static_cast<VType>(NAN);
 
@@ -204,6 +425,7 @@ VType dynamic_path_ops<VType>::pcost_after(TreeNode<VType>* v) const {
         backup_nodes.push_back(v);
         v = v->bparent;
     }
+    record_root_walk_(backup_nodes.size() - 1);
 
     // Compute grossmin values
     std::vector<VType> grossmin(backup_nodes.size(), 0);
@@ -227,77 +449,92 @@ VType dynamic_path_ops<VType>::pcost_after(TreeNode<VType>* v) const {
 }
 
 template <typename VType>
-static bool pmincost_condition_before(TreeNode<VType>* u) {
-    if (!close_to_zero(u->netcost)) return false;
-    if ((u->bleft->external) || (u->bleft->netmin > 0)) {
-        return true;
-    } else {
-        return false;
+TreeNode<VType>* dynamic_path_ops<VType>::pmincost_before(TreeNode<VType>* p) const {
+    DP_TRACE_SPAN(dp_trace_op::pmincost_before);
+
+    if (!p || p->external) return nullptr;
+
+    // Must be a root node.
+    assert(!p->bparent);
+
+    // The vertex right after the cached edge, whose children are in order once the reversals above it are pushed.
+    TreeNode<VType>* u = p->bminfirst;
+    if (p->reversed_below) {
+        push_path_(u);
     }
+    return subtree_head(u->bright);
 }
 
 template <typename VType>
-TreeNode<VType>* dynamic_path_ops<VType>::pmincost_before(TreeNode<VType>* p) const {
+TreeNode<VType>* dynamic_path_ops<VType>::pmincost_after(TreeNode<VType>* p) const {
+    DP_TRACE_SPAN(dp_trace_op::pmincost_after);
+
     if (!p || p->external) return nullptr;
 
     // Must be a root node.
     assert(!p->bparent);
 
-    TreeNode<VType>* u = p;
-    while (!pmincost_condition_before(u)) {
-        if ((!u->bleft->external) && (close_to_zero(u->bleft->netmin))) {
-            u = u->bleft;
-        } else { // u->netcost > 0
-            assert(u->netcost > 0);
-            u = u->bright;
-        }
-    }
-
-    if (u->bright->external) {
-        return u->btail;
-    } else {
-        return u->bright->bhead;
+    TreeNode<VType>* u = p->bminlast;
+    if (p->reversed_below) {
+        push_path_(u);
     }
+    return subtree_tail(u->bleft);
 }
 
 template <typename VType>
-static bool pmincost_condition_after(TreeNode<VType>* u) {
-    if (!close_to_zero(u->netcost)) return false;
-    if ((u->bright->external) || (u->bright->netmin > 0)) {
-        return true;
-    } else {
-        return false;
+void dynamic_path_ops<VType>::pupdate(TreeNode<VType>* p, VType x) const {
+    DP_TRACE_SPAN(dp_trace_op::pupdate);
+
+    if (!p) {
+        return;
+    }
+
+    // Must be a root node.
+    assert(!p->bparent);
+    // Must not be an external (vertex) node.
+    assert(!p->external);
+
+    p->netmin = p->netmin + x;
+    if (m_transaction && !p->external) {
+        log_undo_(undo_record::kind::update, head(p), nullptr, x);
     }
 }
 
 template <typename VType>
-TreeNode<VType>* dynamic_path_ops<VType>::pmincost_after(TreeNode<VType>* p) const {
-    if (!p || p->external) return nullptr;
+void dynamic_path_ops<VType>::reverse(TreeNode<VType>* p) const {
+    if (!p) {
+        return;
+    }
 
     // Must be a root node.
     assert(!p->bparent);
 
-    TreeNode<VType>* u = p;
-    while (!pmincost_condition_after(u)) {
-        if ((!u->bright->external) && (close_to_zero(u->bright->netmin))) {
-            u = u->bright;
-        } else { // u->netcost > 0
-            assert(u->netcost > 0);
-            u = u->bleft;
-        }
+    reverse_(p);
+    if (m_transaction && !p->external) {
+        log_undo_(undo_record::kind::reverse, head(p), nullptr, VType(0));
     }
+}
 
-    if (u->bleft->external) {
-        return u->bhead;
-    } else {
-        return u->bleft->btail;
+template <typename VType>
+bool dynamic_path_ops<VType>::passign(TreeNode<VType>* p, VType c) const {
+    if (!p || m_transaction) {
+        return false;
     }
+
+    // Must be a root node.
+    assert(!p->bparent);
+    // Must not be an external (vertex) node.
+    assert(!p->external);
+
+    p->netmin = c;
+    scale_(p, VType(0));
+    return true;
 }
 
 template <typename VType>
-void dynamic_path_ops<VType>::pupdate(TreeNode<VType>* p, VType x) const {
-    if (!p) {
-        return;
+bool dynamic_path_ops<VType>::paffine(TreeNode<VType>* p, VType a, VType b) const {
+    if (!p || !(a > VType(0)) || m_transaction) {
+        return false;
     }
 
     // Must be a root node.
@@ -305,11 +542,23 @@ void dynamic_path_ops<VType>::pupdate(TreeNode<VType>* p, VType x) const {
     // Must not be an external (vertex) node.
     assert(!p->external);
 
-    p->netmin = p->netmin + x;
+    p->netmin = p->netmin * a + b;
+    scale_(p, a);
+    return true;
 }
 
 template <typename VType>
 TreeNode<VType>* dynamic_path_ops<VType>::concatenate(TreeNode<VType>* p, TreeNode<VType>* q, VType x, bool reBalance) const {
+    if (m_transaction && p && q) {
+        log_undo_(undo_record::kind::concatenate, tail(p), nullptr, x);
+    }
+    return concatenate_(p, q, x, reBalance);
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::concatenate_(TreeNode<VType>* p, TreeNode<VType>* q, VType x, bool reBalance) const {
+    DP_TRACE_SPAN(dp_trace_op::concatenate);
+
     if (p == nullptr) {
         return q;
     } else if (q == nullptr) {
@@ -317,14 +566,135 @@ TreeNode<VType>* dynamic_path_ops<VType>::concatenate(TreeNode<VType>* p, TreeNo
     }
 
     TreeNode<VType>* root = construct_(p, q, x);
-    if (reBalance) {
+    if (m_balance == dynamic_path_balance::deferred) {
+        root = settle_(root);
+    } else if (reBalance) {
         root = top_down_balance_(root);
     }
     return root;
 }
 
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::rebuild(TreeNode<VType>* p) const {
+    DP_TRACE_SPAN(dp_trace_op::rebuild);
+
+    if (!p || p->external) {
+        return p;
+    }
+
+    return rebuild_(p, false);
+}
+
+template <typename VType>
+static void veb_order(TreeNode<VType>* u, int levels, int limit, std::vector<TreeNode<VType>*>& order);
+
+// Lay out the subtrees `depth` levels below u, from left to right.
+template <typename VType>
+static void veb_bottom(TreeNode<VType>* u, int depth, int levels, int limit, std::vector<TreeNode<VType>*>& order) {
+    if (u->size <= limit) return;
+    if (depth == 0) {
+        veb_order(u, levels, limit, order);
+        return;
+    }
+    veb_bottom(u->bleft, depth - 1, levels, limit, order);
+    veb_bottom(u->bright, depth - 1, levels, limit, order);
+}
+
+// Append the internal TreeNodes of the top `levels` levels of the subtree of u in van Emde Boas order, leaving out
+// the subtrees of at most `limit` vertices.
+template <typename VType>
+static void veb_order(TreeNode<VType>* u, int levels, int limit, std::vector<TreeNode<VType>*>& order) {
+    if (u->size <= limit || levels == 0) return;
+    if (levels == 1) {
+        order.push_back(u);
+        return;
+    }
+    int top = levels / 2;
+    veb_order(u, top, limit, order);
+    veb_bottom(u, top, levels - top, limit, order);
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::relayout(TreeNode<VType>* p) const {
+    DP_TRACE_SPAN(dp_trace_op::relayout);
+
+    if (!p || p->external) {
+        return p;
+    }
+
+    // Must be a root node.
+    assert(!p->bparent);
+
+    p = rebuild_(p, false);
+    p->bparent = nullptr;
+    if (m_storage) {
+        return p;
+    }
+
+    std::vector<TreeNode<VType>*> order;
+    veb_order(p, p->height - 1, 1, order);
+    return pack_(order);
+}
+
+template <typename VType>
+bool dynamic_path_ops<VType>::relayout_step(TreeNode<VType>*& p, std::size_t& cursor, std::size_t budget) const {
+    DP_TRACE_SPAN(dp_trace_op::relayout_step);
+
+    if (!p || p->external) {
+        return true;
+    }
+
+    // Must be a root node.
+    assert(!p->bparent);
+
+    // The largest subtrees of at most `budget` internal TreeNodes from the cursor on, as long as the budget lasts.
+    // A vertex alone counts as one TreeNode.
+    int limit = static_cast<int>(std::min<std::size_t>(std::max<std::size_t>(budget, 1), INT_MAX - 1)) + 1;
+    std::size_t moved = 0;
+    while (cursor < static_cast<std::size_t>(p->size)) {
+        TreeNode<VType>* u = vertex_at(p, cursor);
+        while (u->bparent && u->bparent->size <= limit) {
+            u = u->bparent;
+        }
+        std::size_t nodes = std::max(u->size - 1, 1);
+        if (moved > 0 && moved + nodes > static_cast<std::size_t>(limit - 1)) {
+            return false;
+        }
+        cursor += u->size;
+        moved += nodes;
+        if (!u->external) {
+            u = relayout_subtree_(u);
+            if (!u->bparent) {
+                p = u;
+            }
+        }
+    }
+
+    // The TreeNodes above the subtrees.
+    p = rebuild_(p, false, limit);
+    p->bparent = nullptr;
+    if (!m_storage) {
+        std::vector<TreeNode<VType>*> order;
+        veb_order(p, p->height - 1, limit, order);
+        if (!order.empty()) {
+            p = pack_(order);
+        }
+    }
+    return true;
+}
+
 template <typename VType>
 void dynamic_path_ops<VType>::split_before(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& x) const {
+    split_before_(v, p, q, x);
+    if (m_transaction && v && p && q) {
+        log_undo_(undo_record::kind::split, tail(p), head(q), x);
+    }
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::split_before_(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& x) const {
+    DP_TRACE_SPAN(dp_trace_op::split_before);
+
     if (!v) {
         return;
     }
@@ -332,6 +702,8 @@ void dynamic_path_ops<VType>::split_before(TreeNode<VType>* v, TreeNode<VType>*&
     // Must be an external vertex node.
     assert(v->external);
 
+    push_path_(v);
+
     // Similar to the code of pcost_before, we need to first locate the tree node corresponding to the edge [head(v), v]
     if (v == head(path(v))) {
         p = nullptr;
@@ -349,6 +721,7 @@ void dynamic_path_ops<VType>::split_before(TreeNode<VType>* v, TreeNode<VType>*&
         backup_nodes.push_back(v);
         v = v->bparent;
     }
+    record_root_walk_(backup_nodes.size() - 1);
 
     // Find the deepest node w that is the right child of its parent.
     // Here w is guaranteed to be non-null!
@@ -361,6 +734,13 @@ void dynamic_path_ops<VType>::split_before(TreeNode<VType>* v, TreeNode<VType>*&
     }
     assert(edge_index > 0);
 
+    // Splitting off the tail vertex only shortens the right spine.
+    if (edge_index == 1 && on_end_spine(backup_nodes)) {
+        q = backup_nodes[0];
+        p = detach_end_(backup_nodes, x);
+        return;
+    }
+
     // Start to split the path
     // Initialization: Note that we do not free existing memories pointed by p and q.
     p = nullptr;
@@ -390,6 +770,9 @@ void dynamic_path_ops<VType>::split_before(TreeNode<VType>* v, TreeNode<VType>*&
     }
 
     destroy_(backup_nodes[edge_index], temp_v, temp_w, temp_x);
+    DP_STAT(++m_stats.splits);
+    DP_STAT(m_stats.split_destroys += backup_nodes.size() - edge_index);
+    DP_STAT(m_stats.split_constructs += p_list.size() + q_list.size());
     x = temp_x;
     p_list.push_back(temp_v);
     q_list.push_back(temp_w);
@@ -397,19 +780,35 @@ void dynamic_path_ops<VType>::split_before(TreeNode<VType>* v, TreeNode<VType>*&
     // Generate p
     p = p_list[0];
     for (std::size_t i = 1; i < p_list.size(); ++i) {
-        p = concatenate(p, p_list[i], p_cost_list[i - 1]);
+        p = concatenate_(p, p_list[i], p_cost_list[i - 1]);
     }
 
     // Generate q
     auto q_list_size = static_cast<int>(q_list.size());
     q = q_list[q_list_size - 1];
     for (int i = q_list_size - 2; i >= 0; --i) {
-        q = concatenate(q, q_list[i], q_cost_list[i]);
+        q = concatenate_(q, q_list[i], q_cost_list[i]);
+    }
+
+    // A part made of a single subtree has not been concatenated, and may be as unbalanced as the subtree.
+    if (m_balance == dynamic_path_balance::deferred) {
+        p = settle_(p);
+        q = settle_(q);
     }
 }
 
 template <typename VType>
 void dynamic_path_ops<VType>::split_after(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& y) const {
+    split_after_(v, p, q, y);
+    if (m_transaction && v && p && q) {
+        log_undo_(undo_record::kind::split, tail(p), head(q), y);
+    }
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::split_after_(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& y) const {
+    DP_TRACE_SPAN(dp_trace_op::split_after);
+
     if (!v) {
         return;
     }
@@ -417,6 +816,8 @@ void dynamic_path_ops<VType>::split_after(TreeNode<VType>* v, TreeNode<VType>*&
     // Must be an external vertex node.
     assert(v->external);
 
+    push_path_(v);
+
     // Similar to the code of pcost_after, we need to first locate the tree node corresponding to the edge [v, after(v)]
     if (v == tail(path(v))) {
         p = path(v);
@@ -434,6 +835,7 @@ void dynamic_path_ops<VType>::split_after(TreeNode<VType>* v, TreeNode<VType>*&
         backup_nodes.push_back(v);
         v = v->bparent;
     }
+    record_root_walk_(backup_nodes.size() - 1);
 
     // Find the deepest node w that is the left child of its parent.
     // Here w is guaranteed to be non-null!
@@ -446,6 +848,13 @@ void dynamic_path_ops<VType>::split_after(TreeNode<VType>* v, TreeNode<VType>*&
     }
     assert(edge_index > 0);
 
+    // Splitting off the head vertex only shortens the left spine.
+    if (edge_index == 1 && on_end_spine(backup_nodes)) {
+        p = backup_nodes[0];
+        q = detach_end_(backup_nodes, y);
+        return;
+    }
+
     // Start to split the path
     // Initialization: Note that we do not free existing memories pointed by p and q.
     p = nullptr;
@@ -475,6 +884,9 @@ void dynamic_path_ops<VType>::split_after(TreeNode<VType>* v, TreeNode<VType>*&
     }
 
     destroy_(backup_nodes[edge_index], temp_v, temp_w, temp_y);
+    DP_STAT(++m_stats.splits);
+    DP_STAT(m_stats.split_destroys += backup_nodes.size() - edge_index);
+    DP_STAT(m_stats.split_constructs += p_list.size() + q_list.size());
     y = temp_y;
     p_list.push_back(temp_v);
     q_list.push_back(temp_w);
@@ -482,39 +894,324 @@ void dynamic_path_ops<VType>::split_after(TreeNode<VType>* v, TreeNode<VType>*&
     // Generate p
     p = p_list[0];
     for (std::size_t i = 1; i < p_list.size(); ++i) {
-        p = concatenate(p, p_list[i], p_cost_list[i - 1]);
+        p = concatenate_(p, p_list[i], p_cost_list[i - 1]);
     }
 
     // Generate q
     auto q_list_size = static_cast<int>(q_list.size());
     q = q_list[q_list_size - 1];
     for (int i = q_list_size - 2; i >= 0; --i) {
-        q = concatenate(q, q_list[i], q_cost_list[i]);
+        q = concatenate_(q, q_list[i], q_cost_list[i]);
+    }
+
+    // A part made of a single subtree has not been concatenated, and may be as unbalanced as the subtree.
+    if (m_balance == dynamic_path_balance::deferred) {
+        p = settle_(p);
+        q = settle_(q);
     }
 }
 
+// `basemin` is the gross minimum of the parent of p, `scale` the product of the pending scalings of the ancestors of p
+// and `flip` tells whether they have pending reversals, as in `vectorize_internal`.
 template <typename VType>
-static void vectorize_internal(TreeNode<VType>* p, VType basemin, std::vector<VType>& vector_path) {
+static void pcost_below_internal(TreeNode<VType>* p, VType basemin, VType scale, bool flip, VType threshold,
+                                 std::vector<std::pair<TreeNode<VType>*, VType>>& edges) {
     if (!p || (p->external)) return;
-    vectorize_internal(p->bleft, p->netmin + basemin, vector_path);
-    VType grossmin = p->netmin + basemin;
-    vector_path.push_back(p->netcost + grossmin);
-    vectorize_internal(p->bright, p->netmin + basemin, vector_path);
+    VType grossmin = p->netmin * scale + basemin;
+    if (!(grossmin < threshold)) return;
+
+    scale = scale * p->scale;
+    flip = flip != p->reversed;
+    TreeNode<VType>* left = flip ? p->bright : p->bleft;
+    pcost_below_internal(left, grossmin, scale, flip, threshold, edges);
+    VType cost = p->netcost * scale + grossmin;
+    if (cost < threshold) {
+        edges.emplace_back(flip ? subtree_head(left) : subtree_tail(left), cost);
+    }
+    pcost_below_internal(flip ? p->bleft : p->bright, grossmin, scale, flip, threshold, edges);
 }
 
 template <typename VType>
-void dynamic_path_ops<VType>::vectorize(TreeNode<VType>* p, std::vector<VType>& vector_path) const {
-    if (!p) {
-        return;
-    }
+void dynamic_path_ops<VType>::pcost_below(TreeNode<VType>* p, VType threshold, std::vector<std::pair<TreeNode<VType>*, VType>>& edges) const {
+    DP_TRACE_SPAN(dp_trace_op::pcost_below);
+
+    edges.clear();
+    pcost_below_internal(p, VType(0), VType(1), false, threshold, edges);
+}
+
+namespace {
+
+// Entry of the frontier heap of `pmincost_k`: a subtree keyed by its gross minimum, or a single edge keyed by its cost.
+template <typename VType>
+struct frontier_entry {
+    VType key;
+    // Root of the subtree, or vertex v of the edge (v, after(v)).
+    TreeNode<VType>* node;
+    // Pending scalings and reversals of the ancestors of the subtree.
+    VType scale;
+    bool flip;
+    bool edge;
+
+    bool operator>(const frontier_entry& other) const { return key > other.key; }
+};
+
+}  // namespace
+
+template <typename VType>
+void dynamic_path_ops<VType>::pmincost_k(TreeNode<VType>* p, std::size_t k, std::vector<std::pair<TreeNode<VType>*, VType>>& edges) const {
+    DP_TRACE_SPAN(dp_trace_op::pmincost_k);
+
+    edges.clear();
+    if (!p || p->external || k == 0) {
+        return;
+    }
+
+    std::vector<frontier_entry<VType>> frontier;
+    frontier.push_back({p->netmin, p, VType(1), false, false});
+    auto later = std::greater<frontier_entry<VType>>();
+    while (!frontier.empty() && edges.size() < k) {
+        std::pop_heap(frontier.begin(), frontier.end(), later);
+        frontier_entry<VType> top = frontier.back();
+        frontier.pop_back();
+        if (top.edge) {
+            edges.emplace_back(top.node, top.key);
+            continue;
+        }
+
+        TreeNode<VType>* u = top.node;
+        VType grossmin = top.key;
+        VType scale = top.scale * u->scale;
+        bool flip = top.flip != u->reversed;
+        TreeNode<VType>* left = flip ? u->bright : u->bleft;
+        frontier.push_back(
+            {u->netcost * scale + grossmin, flip ? subtree_head(left) : subtree_tail(left), VType(1), false, true});
+        std::push_heap(frontier.begin(), frontier.end(), later);
+        for (TreeNode<VType>* child : {u->bleft, u->bright}) {
+            if (!child->external) {
+                frontier.push_back({child->netmin * scale + grossmin, child, scale, flip, false});
+                std::push_heap(frontier.begin(), frontier.end(), later);
+            }
+        }
+    }
+}
+
+// TreeNodes of the edges (before(v), v) and (v, after(v)) of a vertex whose ancestors have no pending reversal.
+// nullptr if v is the head, resp. the tail, of its path.
+template <typename VType>
+static TreeNode<VType>* edge_before(TreeNode<VType>* v) {
+    for (; v->bparent != nullptr; v = v->bparent) {
+        if (v->bparent->bright == v) return v->bparent;
+    }
+    return nullptr;
+}
+
+template <typename VType>
+static TreeNode<VType>* edge_after(TreeNode<VType>* v) {
+    for (; v->bparent != nullptr; v = v->bparent) {
+        if (v->bparent->bleft == v) return v->bparent;
+    }
+    return nullptr;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::splice(TreeNode<VType>* u, TreeNode<VType>* v, TreeNode<VType>* w, VType x, VType y, VType z,
+                                     TreeNode<VType>*& p, TreeNode<VType>*& q) const {
+    DP_TRACE_SPAN(dp_trace_op::splice);
+
+    // Must be external vertex nodes.
+    assert(u && u->external && v && v->external && (!w || w->external));
+
+    if (m_transaction) {
+        // Enough to put the sub-path back between before(u) and after(v), and to join w to after(w) again.
+        undo_record record{undo_record::kind::splice, u, v, w, before(u), after(v), w ? after(w) : nullptr,
+                           VType(0), VType(0), VType(0)};
+        if (record.d) record.x = pcost_before(u);
+        if (record.e) record.y = pcost_after(v);
+        if (record.f) record.z = pcost_after(w);
+        m_undo_log.push_back(record);
+    }
+
+    push_path_(u);
+    push_path_(v);
+    push_path_(w);
+    TreeNode<VType>* source = path(u);
+    TreeNode<VType>* target = w ? path(w) : nullptr;
+    assert(path(v) == source && position(u) <= position(v));
+
+    // Take apart the source path (and the target path if another one) around the deleted edges.
+    TreeNode<VType>* edge_u = edge_before(u);
+    TreeNode<VType>* edge_v = edge_after(v);
+    TreeNode<VType>* edge_w = w ? edge_after(w) : nullptr;
+    std::vector<TreeNode<VType>*> items;
+    std::vector<TreeNode<VType>*> edges;
+    std::vector<VType> costs;
+    cut_(source, {edge_u, edge_v, target == source ? edge_w : nullptr}, items, edges, costs);
+    std::size_t source_items = items.size();
+    if (target && target != source) {
+        cut_(target, {edge_w}, items, edges, costs);
+        // No edge between the last item of the source and the first one of the target.
+        edges.insert(edges.begin() + (source_items - 1), nullptr);
+        costs.insert(costs.begin() + (source_items - 1), VType(0));
+    }
+    DP_STAT(++m_stats.splices);
+    DP_STAT(m_stats.splice_nodes += edges.size() - (target && target != source ? 1 : 0));
+
+    // The deleted edges are recycled for the new ones.
+    std::vector<TreeNode<VType>*> spare;
+    for (TreeNode<VType>* edge : {edge_u, edge_v, edge_w}) {
+        if (edge && std::find(spare.begin(), spare.end(), edge) == spare.end()) {
+            spare.push_back(edge);
+        }
+    }
+
+    // Parts are ranges [first, last] of items in path order, keeping the edges between their items:
+    // A = [0, i_u] and B = [i_v + 1, source_end] around the sub-path M = [m_first, i_v] in the source, and the
+    // target split after w at i_w.
+    auto index_of = [&](TreeNode<VType>* edge) {
+        return static_cast<std::size_t>(std::find(edges.begin(), edges.end(), edge) - edges.begin());
+    };
+    std::size_t source_end = source_items - 1;
+    std::size_t i_u = edge_u ? index_of(edge_u) : 0;
+    std::size_t m_first = edge_u ? i_u + 1 : 0;
+    std::size_t i_v = edge_v ? index_of(edge_v) : source_end;
+    std::size_t i_w = edge_w ? index_of(edge_w) : (target == source ? source_end : items.size() - 1);
+
+    std::vector<TreeNode<VType>*> part_items;
+    std::vector<TreeNode<VType>*> part_edges;
+    std::vector<VType> part_costs;
+    // Append a part to the path being assembled, after a new edge of the given cost. Empty parts are skipped.
+    auto append = [&](std::size_t first, std::size_t last, VType cost) {
+        if (first > last) return;
+        if (!part_items.empty()) {
+            TreeNode<VType>* edge = spare.empty() ? gen_new_node(false, 0) : spare.back();
+            if (!spare.empty()) spare.pop_back();
+            part_edges.push_back(edge);
+            part_costs.push_back(cost);
+        }
+        for (std::size_t i = first; i <= last; ++i) {
+            part_items.push_back(items[i]);
+            if (i < last) {
+                part_edges.push_back(edges[i]);
+                part_costs.push_back(costs[i]);
+            }
+        }
+    };
+    auto append_a = [&](VType cost) {
+        if (edge_u) append(0, i_u, cost);
+    };
+    auto finish = [&]() {
+        TreeNode<VType>* root = part_items.empty() ? nullptr : assemble_(part_items, part_edges, part_costs);
+        part_items.clear();
+        part_edges.clear();
+        part_costs.clear();
+        if (!root || root->external) return root;
+        return m_balance == dynamic_path_balance::deferred ? settle_(root) : top_down_balance_(root);
+    };
+
+    if (!w) {
+        append(m_first, i_v, y);
+        p = finish();
+        append_a(x);
+        append(i_v + 1, source_end, x);
+        q = finish();
+    } else if (target != source) {
+        append_a(x);
+        append(i_v + 1, source_end, x);
+        q = finish();
+        append(source_items, i_w, y);
+        append(m_first, i_v, y);
+        append(i_w + 1, items.size() - 1, z);
+        p = finish();
+    } else if (edge_u && i_w <= i_u) {
+        // A1 - M - A2 - B, where A2 is empty if w is before(u).
+        append(0, i_w, y);
+        append(m_first, i_v, y);
+        append(i_w + 1, i_u, z);
+        append(i_v + 1, source_end, i_w == i_u ? z : x);
+        p = finish();
+        q = nullptr;
+    } else {
+        // A - B1 - M - B2.
+        assert(i_w > i_v);
+        append_a(x);
+        append(i_v + 1, i_w, x);
+        append(m_first, i_v, y);
+        append(i_w + 1, source_end, z);
+        p = finish();
+        q = nullptr;
+    }
+
+    for (TreeNode<VType>* edge : spare) {
+        free_node_(edge);
+    }
+}
+
+// `flip` tells whether the ancestors of p have pending reversals that p does not know of yet, and `scale` is the
+// product of their pending scalings.
+template <typename VType>
+static void vectorize_internal(TreeNode<VType>* p, VType basemin, VType scale, bool flip, std::vector<VType>& vector_path) {
+    if (!p || (p->external)) return;
+    VType grossmin = p->netmin * scale + basemin;
+    scale = scale * p->scale;
+    flip = flip != p->reversed;
+    vectorize_internal(flip ? p->bright : p->bleft, grossmin, scale, flip, vector_path);
+    vector_path.push_back(p->netcost * scale + grossmin);
+    vectorize_internal(flip ? p->bleft : p->bright, grossmin, scale, flip, vector_path);
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::vectorize(TreeNode<VType>* p, std::vector<VType>& vector_path) const {
+    DP_TRACE_SPAN(dp_trace_op::vectorize);
+
+    if (!p) {
+        return;
+    }
 
     vector_path.clear();
 
-    vectorize_internal(p, VType(0), vector_path);
+    vectorize_internal(p, VType(0), VType(1), false, vector_path);
 }
 
+// Same traversal as `vectorize_internal`, skipping the subtrees outside of the ranges. The edges of p are at positions
+// first, first + 1, ..., and ranges[range] is the first range that may still hold some of them.
 template <typename VType>
-static void vectorize_internal(TreeNode<VType>* p, std::vector<int>& vector_vertices) {
+static void vectorize_ranges_internal(TreeNode<VType>* p, VType basemin, VType scale, bool flip, std::size_t first,
+                                      const std::vector<std::pair<std::size_t, std::size_t>>& ranges,
+                                      std::size_t& range, std::vector<VType>& vector_path) {
+    if (!p || (p->external)) return;
+    while (range < ranges.size() && ranges[range].second <= first) {
+        ++range;
+    }
+    if (range == ranges.size() || ranges[range].first >= first + p->size - 1) return;
+
+    VType grossmin = p->netmin * scale + basemin;
+    scale = scale * p->scale;
+    flip = flip != p->reversed;
+    TreeNode<VType>* left = flip ? p->bright : p->bleft;
+    vectorize_ranges_internal(left, grossmin, scale, flip, first, ranges, range, vector_path);
+    std::size_t edge = first + left->size - 1;
+    while (range < ranges.size() && ranges[range].second <= edge) {
+        ++range;
+    }
+    if (range < ranges.size() && ranges[range].first <= edge) {
+        vector_path.push_back(p->netcost * scale + grossmin);
+    }
+    vectorize_ranges_internal(flip ? p->bleft : p->bright, grossmin, scale, flip, edge + 1, ranges, range, vector_path);
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::vectorize_ranges(TreeNode<VType>* p,
+                                               const std::vector<std::pair<std::size_t, std::size_t>>& ranges,
+                                               std::vector<VType>& vector_path) const {
+    DP_TRACE_SPAN(dp_trace_op::vectorize);
+
+    vector_path.clear();
+    std::size_t range = 0;
+    vectorize_ranges_internal(p, VType(0), VType(1), false, 0, ranges, range, vector_path);
+}
+
+template <typename VType>
+static void vectorize_internal(TreeNode<VType>* p, bool flip, std::vector<int>& vector_vertices) {
     if (!p) return;
 
     if (p->external) {
@@ -522,8 +1219,9 @@ static void vectorize_internal(TreeNode<VType>* p, std::vector<int>& vector_vert
         return;
     }
 
-    vectorize_internal(p->bleft, vector_vertices);
-    vectorize_internal(p->bright, vector_vertices);
+    flip = flip != p->reversed;
+    vectorize_internal(flip ? p->bright : p->bleft, flip, vector_vertices);
+    vectorize_internal(flip ? p->bleft : p->bright, flip, vector_vertices);
 }
 
 template <typename VType>
@@ -534,7 +1232,7 @@ void dynamic_path_ops<VType>::vectorizeVertex(TreeNode<VType>* p, std::vector<in
 
     vector_vertices.clear();
 
-    vectorize_internal(p, vector_vertices);
+    vectorize_internal(p, false, vector_vertices);
 }
 
 template <typename VType>
@@ -549,16 +1247,606 @@ void dynamic_path_ops<VType>::clearall(TreeNode<VType>* p) const {
         clearall(p->bright);
     }
 
-    delete p;
+    free_node_(p);
+}
+
+template <typename VType>
+dynamic_path_shape dynamic_path_ops<VType>::tree_shape(TreeNode<VType>* p) const {
+    dynamic_path_shape shape;
+    if (!p) {
+        return shape;
+    }
+
+    shape.height = p->height;
+    std::vector<TreeNode<VType>*> stack = {p};
+    while (!stack.empty()) {
+        TreeNode<VType>* u = stack.back();
+        stack.pop_back();
+        if (u->external) {
+            ++shape.vertices;
+            continue;
+        }
+        ++shape.edges;
+        stack.push_back(u->bleft);
+        stack.push_back(u->bright);
+    }
+
+    shape.ideal_height = ideal_height(shape.vertices);
+    return shape;
+}
+
+template <typename VType>
+const dynamic_path_stats& dynamic_path_ops<VType>::stats() const {
+    return m_stats;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::reset_stats() const {
+    dynamic_path_stats fresh;
+    fresh.node_allocations = m_stats.live_nodes();
+    fresh.node_bytes = m_stats.node_bytes;
+    m_stats = fresh;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::set_balance(dynamic_path_balance balance) {
+    m_balance = balance;
+}
+
+template <typename VType>
+dynamic_path_balance dynamic_path_ops<VType>::balance() const {
+    return m_balance;
+}
+
+#pragma mark Transactions
+
+template <typename VType>
+std::size_t dynamic_path_ops<VType>::begin_transaction() {
+    m_transaction = true;
+    return m_undo_log.size();
+}
+
+template <typename VType>
+std::size_t dynamic_path_ops<VType>::savepoint() const {
+    return m_undo_log.size();
+}
+
+template <typename VType>
+bool dynamic_path_ops<VType>::rollback(std::size_t savepoint) {
+    if (!m_transaction || savepoint > m_undo_log.size()) {
+        return false;
+    }
+
+    // The inverses go through the unlogged bodies, so that they are not logged in turn.
+    while (m_undo_log.size() > savepoint) {
+        undo_(m_undo_log.back());
+        m_undo_log.pop_back();
+    }
+    return true;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::commit() {
+    m_transaction = false;
+    m_undo_log.clear();
+}
+
+template <typename VType>
+bool dynamic_path_ops<VType>::in_transaction() const {
+    return m_transaction;
+}
+
+#pragma mark Snapshot
+
+namespace {
+
+const char kSnapshotMagic[8] = {'D', 'P', 'A', 'T', 'H', 'S', 'N', 'P'};
+const uint32_t kSnapshotVersion = 1;
+const std::size_t kSnapshotChunkSize = 1 << 20;
+const uint8_t kSnapshotExternal = 0x1;
+const uint8_t kSnapshotReversed = 0x2;
+
+template <typename VType>
+uint32_t snapshot_value_tag() {
+    // Encode the value type as (is_integer, is_signed, size).
+    return (std::numeric_limits<VType>::is_integer ? 0x200u : 0u) |
+           (std::numeric_limits<VType>::is_signed ? 0x100u : 0u) |
+           static_cast<uint32_t>(sizeof(VType));
+}
+
+#pragma pack(push, 1)
+struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t value_tag;
+    uint64_t node_count;
+    uint64_t vertex_count;
+    uint64_t payload_bytes;
+    uint64_t checksum;
+};
+#pragma pack(pop)
+
+// FNV-1a over 64-bit little words, independent of how the payload is chunked.
+class snapshot_checksum {
+  public:
+    void update(const char* data, std::size_t n) {
+        while (n > 0 && m_pending_bytes > 0) {
+            push_byte(*data++);
+            --n;
+        }
+        while (n >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            mix(word);
+            data += 8;
+            n -= 8;
+        }
+        while (n > 0) {
+            push_byte(*data++);
+            --n;
+        }
+    }
+
+    uint64_t value() const {
+        uint64_t h = m_hash;
+        if (m_pending_bytes > 0) {
+            h = (h ^ m_pending) * kPrime;
+        }
+        return (h ^ static_cast<uint64_t>(m_pending_bytes)) * kPrime;
+    }
+
+  private:
+    static const uint64_t kPrime = 1099511628211ULL;
+
+    void mix(uint64_t word) { m_hash = (m_hash ^ word) * kPrime; }
+
+    void push_byte(char c) {
+        m_pending |= static_cast<uint64_t>(static_cast<uint8_t>(c)) << (8 * m_pending_bytes);
+        if (++m_pending_bytes == 8) {
+            mix(m_pending);
+            m_pending = 0;
+            m_pending_bytes = 0;
+        }
+    }
+
+    uint64_t m_hash = 14695981039346656037ULL;
+    uint64_t m_pending = 0;
+    unsigned m_pending_bytes = 0;
+};
+
+class snapshot_writer {
+  public:
+    explicit snapshot_writer(std::ofstream& out) : m_out(out) { m_buffer.reserve(kSnapshotChunkSize); }
+
+    template <typename T>
+    void write(const T& value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(T));
+        if (m_buffer.size() >= kSnapshotChunkSize) {
+            flush();
+        }
+    }
+
+    void flush() {
+        m_checksum.update(m_buffer.data(), m_buffer.size());
+        m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        m_bytes += m_buffer.size();
+        m_buffer.clear();
+    }
+
+    uint64_t bytes() const { return m_bytes; }
+    uint64_t checksum() const { return m_checksum.value(); }
+
+  private:
+    std::ofstream& m_out;
+    std::vector<char> m_buffer;
+    snapshot_checksum m_checksum;
+    uint64_t m_bytes = 0;
+};
+
+class snapshot_reader {
+  public:
+    snapshot_reader(std::ifstream& in, uint64_t payload_bytes) : m_in(in), m_remaining(payload_bytes) {
+        m_buffer.resize(kSnapshotChunkSize);
+    }
+
+    template <typename T>
+    bool read(T& value) {
+        char* bytes = reinterpret_cast<char*>(&value);
+        std::size_t n = sizeof(T);
+        while (n > 0) {
+            if (m_pos == m_end && !refill()) {
+                return false;
+            }
+            std::size_t step = std::min(n, m_end - m_pos);
+            memcpy(bytes, m_buffer.data() + m_pos, step);
+            bytes += step;
+            m_pos += step;
+            n -= step;
+        }
+        return true;
+    }
+
+    // The whole payload has been consumed.
+    bool exhausted() const { return m_pos == m_end && m_remaining == 0; }
+    uint64_t checksum() const { return m_checksum.value(); }
+
+  private:
+    bool refill() {
+        if (m_remaining == 0) {
+            return false;
+        }
+        std::size_t step = static_cast<std::size_t>(std::min<uint64_t>(m_remaining, m_buffer.size()));
+        if (!m_in.read(m_buffer.data(), static_cast<std::streamsize>(step))) {
+            return false;
+        }
+        m_checksum.update(m_buffer.data(), step);
+        m_remaining -= step;
+        m_pos = 0;
+        m_end = step;
+        return true;
+    }
+
+    std::ifstream& m_in;
+    std::vector<char> m_buffer;
+    snapshot_checksum m_checksum;
+    uint64_t m_remaining;
+    std::size_t m_pos = 0;
+    std::size_t m_end = 0;
+};
+
+}  // namespace
+
+template <typename VType>
+bool dynamic_path_ops<VType>::save(TreeNode<VType>* p, const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    snapshot_header header;
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.value_tag = snapshot_value_tag<VType>();
+    header.node_count = 0;
+    header.vertex_count = 0;
+    header.payload_bytes = 0;
+    header.checksum = 0;
+    // Placeholder, rewritten once the payload is known.
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Preorder traversal with an explicit stack, since trees built without rebalancing can be deep.
+    snapshot_writer writer(out);
+    std::vector<TreeNode<VType>*> stack;
+    if (p) {
+        stack.push_back(p);
+    }
+    while (!stack.empty()) {
+        TreeNode<VType>* u = stack.back();
+        stack.pop_back();
+        ++header.node_count;
+        if (u->external) {
+            ++header.vertex_count;
+            writer.write(kSnapshotExternal);
+            writer.write(static_cast<int32_t>(u->node_index));
+            continue;
+        }
+        // The snapshot format has no scalings: they are pushed down on the way.
+        push_scale_(u);
+        writer.write(u->reversed ? kSnapshotReversed : uint8_t(0));
+        writer.write(u->netmin);
+        writer.write(u->netcost);
+        writer.write(static_cast<int32_t>(u->height));
+        stack.push_back(u->bright);
+        stack.push_back(u->bleft);
+    }
+    writer.flush();
+
+    header.payload_bytes = writer.bytes();
+    header.checksum = writer.checksum();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(out.flush());
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::load(const std::string& filename, std::vector<TreeNode<VType>*>& external_nodes, bool& ok) const {
+    ok = false;
+    external_nodes.clear();
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return nullptr;
+    }
+
+    snapshot_header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return nullptr;
+    }
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 || header.version != kSnapshotVersion ||
+        header.value_tag != snapshot_value_tag<VType>()) {
+        return nullptr;
+    }
+    // The counts are not covered by the checksum: check them against the payload they describe, and the
+    // payload against the file, before allocating anything for them.
+    const std::streamoff payload_start = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff file_end = in.tellg();
+    in.seekg(payload_start);
+    if (!in || file_end < payload_start || header.payload_bytes > static_cast<uint64_t>(file_end - payload_start)) {
+        return nullptr;
+    }
+    const uint64_t external_bytes = sizeof(uint8_t) + sizeof(int32_t);
+    const uint64_t internal_bytes = sizeof(uint8_t) + 2 * sizeof(VType) + sizeof(int32_t);
+    // A path of n vertices is a full binary tree of 2n - 1 nodes.
+    if (header.vertex_count > header.payload_bytes / external_bytes ||
+        header.node_count != (header.vertex_count == 0 ? 0 : 2 * header.vertex_count - 1) ||
+        header.payload_bytes != header.vertex_count * external_bytes +
+                                    (header.node_count - header.vertex_count) * internal_bytes) {
+        return nullptr;
+    }
+    external_nodes.reserve(static_cast<std::size_t>(header.vertex_count));
+
+    // Rebuild in preorder: `pending` is the deepest internal node still waiting for a child.
+    snapshot_reader reader(in, header.payload_bytes);
+    TreeNode<VType>* root = nullptr;
+    TreeNode<VType>* pending = nullptr;
+    bool valid = true;
+    bool reversals = false;
+    for (uint64_t i = 0; i < header.node_count; ++i) {
+        uint8_t flags;
+        if (!reader.read(flags) || (root && !pending)) {
+            valid = false;
+            break;
+        }
+
+        TreeNode<VType>* u;
+        if (flags & kSnapshotExternal) {
+            int32_t node_index;
+            if (!reader.read(node_index)) {
+                valid = false;
+                break;
+            }
+            u = gen_new_node(true, node_index);
+            external_nodes.push_back(u);
+        } else {
+            u = gen_new_node(false, 0);
+            u->reversed = (flags & kSnapshotReversed) != 0;
+            if (u->reversed) {
+                ++m_pending_reversals;
+                reversals = true;
+            }
+            int32_t height;
+            if (!reader.read(u->netmin) || !reader.read(u->netcost) || !reader.read(height)) {
+                free_node_(u);
+                valid = false;
+                break;
+            }
+            u->height = height;
+        }
+
+        if (!root) {
+            root = u;
+        } else {
+            u->bparent = pending;
+            if (!pending->bleft) {
+                pending->bleft = u;
+            } else {
+                pending->bright = u;
+            }
+        }
+
+        if (!u->external) {
+            pending = u;
+            continue;
+        }
+
+        // A completed right child completes its parent, possibly all the way up.
+        TreeNode<VType>* w = u;
+        while (w->bparent && w->bparent->bright == w) {
+            w = w->bparent;
+            // The children of a reversed node are stored in their original order.
+            w->bhead = w->reversed ? subtree_tail(w->bright) : subtree_head(w->bleft);
+            w->btail = w->reversed ? subtree_head(w->bleft) : subtree_tail(w->bright);
+            w->size = w->bleft->size + w->bright->size;
+            refresh_min(w);
+        }
+        pending = w->bparent;
+    }
+
+    if (!valid || pending || external_nodes.size() != header.vertex_count || !reader.exhausted() ||
+        reader.checksum() != header.checksum) {
+        // Incomplete nodes only have null children, so the partial tree can be freed as is.
+        clearall(root);
+        external_nodes.clear();
+        return nullptr;
+    }
+
+    if (reversals) {
+        // The vertices were stored in the original order of the children of reversed nodes. Push the reversals down,
+        // so that the vertices are listed and linked from head to tail.
+        external_nodes.clear();
+        std::vector<TreeNode<VType>*> stack{root};
+        while (!stack.empty()) {
+            TreeNode<VType>* u = stack.back();
+            stack.pop_back();
+            if (u->external) {
+                external_nodes.push_back(u);
+                continue;
+            }
+            push_(u);
+            stack.push_back(u->bright);
+            stack.push_back(u->bleft);
+        }
+    }
+    for (std::size_t i = 1; i < external_nodes.size(); ++i) {
+        external_nodes[i - 1]->btail = external_nodes[i];
+        external_nodes[i]->bhead = external_nodes[i - 1];
+    }
+
+    ok = true;
+    return root;
 }
 
 #pragma mark Private functions
 
+template <typename VType>
+void dynamic_path_ops<VType>::log_undo_(typename undo_record::kind op, TreeNode<VType>* a, TreeNode<VType>* b, VType x) const {
+    m_undo_log.push_back({op, a, b, nullptr, nullptr, nullptr, nullptr, x, VType(0), VType(0)});
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::undo_(const undo_record& record) const {
+    // The vertex order and the costs are those right after the logged operation, so the logged vertices lead to the
+    // paths it produced.
+    TreeNode<VType>* p = nullptr;
+    TreeNode<VType>* q = nullptr;
+    VType cost;
+    if (record.op == undo_record::kind::update) {
+        p = path(record.a);
+        p->netmin = p->netmin - record.x;
+    } else if (record.op == undo_record::kind::reverse) {
+        reverse_(path(record.a));
+    } else if (record.op == undo_record::kind::concatenate) {
+        split_after_(record.a, p, q, cost);
+    } else if (record.op == undo_record::kind::split) {
+        concatenate_(path(record.a), path(record.b), record.x);
+    } else {
+        // a..f are u, v, w, before(u), after(v) and after(w) before the splice. Take the sub-path out again, join w to
+        // after(w) unless it was u, and put the sub-path back between before(u) and after(v).
+        split_before_(record.a, p, q, cost);
+        split_after_(record.b, p, q, cost);
+        if (record.c && record.f && record.f != record.a) {
+            concatenate_(path(record.c), path(record.f), record.z);
+        }
+        TreeNode<VType>* m = path(record.a);
+        if (record.d) {
+            split_after_(record.d, p, q, cost);
+            m = concatenate_(path(record.d), m, record.x);
+        }
+        if (record.e) {
+            concatenate_(m, path(record.e), record.y);
+        }
+    }
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::push_(TreeNode<VType>* p) const {
+    if (p->external) return;
+    push_scale_(p);
+    if (!p->reversed) return;
+
+    std::swap(p->bleft, p->bright);
+    reverse_(p->bleft);
+    reverse_(p->bright);
+    p->reversed = false;
+    --m_pending_reversals;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::reverse_(TreeNode<VType>* p) const {
+    // A vertex is reversed with its links.
+    std::swap(p->bhead, p->btail);
+    if (p->external) return;
+    std::swap(p->bminfirst, p->bminlast);
+    p->reversed = !p->reversed;
+    p->reversed_below = true;
+    if (p->reversed) {
+        ++m_pending_reversals;
+    } else {
+        --m_pending_reversals;
+    }
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::push_scale_(TreeNode<VType>* p) const {
+    if (p->scale == VType(1)) return;
+    p->netcost = p->netcost * p->scale;
+    for (TreeNode<VType>* child : {p->bleft, p->bright}) {
+        if (!child->external) {
+            child->netmin = child->netmin * p->scale;
+            scale_(child, p->scale);
+        }
+    }
+    p->scale = VType(1);
+    --m_pending_scalings;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::scale_(TreeNode<VType>* p, VType a) const {
+    if (p->external) return;
+    bool pending = !(p->scale == VType(1));
+    p->scale = p->scale * a;
+    if (a == VType(0)) {
+        // All costs are equal: the edges of minimum cost are the ones next to the head and the tail vertices.
+        p->bminfirst = p->bhead->bparent;
+        p->bminlast = p->btail->bparent;
+    }
+    if (pending && p->scale == VType(1)) {
+        --m_pending_scalings;
+    } else if (!pending && !(p->scale == VType(1))) {
+        ++m_pending_scalings;
+    }
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::push_path_(TreeNode<VType>* v) const {
+    // Nothing to push while this object holds no pending reversal or scaling.
+    if (!v || (m_pending_reversals == 0 && m_pending_scalings == 0)) return;
+
+    // From the root down, without recursion: trees in the deferred balance mode can be deep.
+    m_push_path.clear();
+    for (; v != nullptr; v = v->bparent) {
+        m_push_path.push_back(v);
+    }
+    for (auto it = m_push_path.rbegin(); it != m_push_path.rend(); ++it) {
+        push_(*it);
+    }
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::record_root_walk_(std::size_t steps) const {
+    DP_STAT(++m_stats.root_walks);
+    DP_STAT(m_stats.root_walk_steps += steps);
+    DP_STAT(m_stats.root_walk_max = std::max<uint64_t>(m_stats.root_walk_max, steps));
+    (void)steps;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::free_node_(TreeNode<VType>* p) const {
+    DP_STAT(++m_stats.node_frees);
+    DP_STAT(m_stats.node_bytes -= sizeof(TreeNode<VType>));
+    if (!p->external && p->reversed) {
+        --m_pending_reversals;
+    }
+    if (!p->external && !(p->scale == VType(1))) {
+        --m_pending_scalings;
+    }
+    if (p->packed) {
+        // The block is released with its last TreeNode.
+        TreeNode<VType>* block = p - p->node_index;
+        if (--block->size == 0) {
+            delete[] block;
+        }
+    } else if (m_storage && m_storage->owns(p)) {
+        m_storage->release(p);
+    } else {
+        delete p;
+    }
+}
+
 template <typename VType>
 TreeNode<VType>* dynamic_path_ops<VType>::construct_(TreeNode<VType>* v, TreeNode<VType>* w, VType x) const {
     if (!v || !w) return nullptr;
 
+    DP_STAT(++m_stats.constructs);
     TreeNode<VType>* root = gen_new_node(false, 0);
+    link_(root, v, w, x);
+    return root;
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::link_(TreeNode<VType>* root, TreeNode<VType>* v, TreeNode<VType>* w, VType x) const {
     // Compute grossmin
     VType gross_min = x;
     if (!v->external) {
@@ -571,11 +1859,19 @@ TreeNode<VType>* dynamic_path_ops<VType>::construct_(TreeNode<VType>* v, TreeNod
             gross_min = w->netmin;
     }
 
+    // A recycled edge comes pushed, which keeps the counts of pending reversals and scalings right.
+    assert(!root->reversed && root->scale == VType(1));
     root->netcost = x - gross_min;
     root->netmin = gross_min;
+    root->scale = VType(1);
+    root->reversed = false;
+    root->bparent = nullptr;
 
     root->bleft = v;
     root->bright = w;
+    // Link the neighboring vertices across the new edge.
+    next_link(subtree_tail(v), v) = subtree_head(w);
+    prev_link(subtree_head(w), w) = subtree_tail(v);
 
     if (v->external) {
         root->bhead = v;
@@ -599,16 +1895,19 @@ TreeNode<VType>* dynamic_path_ops<VType>::construct_(TreeNode<VType>* v, TreeNod
         w->netmin = w->netmin - gross_min;
     }
 
+    refresh_min(root);
+
     // Update the height
     root->height = std::max(v->height, w->height) + 1;
-
-    return root;
+    root->size = v->size + w->size;
 }
 
 template <typename VType>
 void dynamic_path_ops<VType>::destroy_(TreeNode<VType>* root, TreeNode<VType>*& v, TreeNode<VType>*& w, VType& x) const {
     if (!root || (root->external)) return;
 
+    DP_STAT(++m_stats.destroys);
+    push_(root);
     v = root->bleft;
     v->bparent = nullptr;
 
@@ -626,7 +1925,11 @@ void dynamic_path_ops<VType>::destroy_(TreeNode<VType>* root, TreeNode<VType>*&
 
     x = root->netcost + root->netmin;
 
-    delete root;
+    // Unlink the vertices of the deleted edge.
+    next_link(subtree_tail(v), v) = nullptr;
+    prev_link(subtree_head(w), w) = nullptr;
+
+    free_node_(root);
 }
 
 template <typename VType>
@@ -638,7 +1941,10 @@ TreeNode<VType>* dynamic_path_ops<VType>::rotateleft_(TreeNode<VType>* root) con
         return nullptr;
     }
 
+    DP_STAT(++m_stats.rotate_left);
+    push_(root);
     TreeNode<VType>* new_root = root->bright;
+    push_(new_root);
 
     // Update the fields
     // Change the shape
@@ -705,9 +2011,14 @@ TreeNode<VType>* dynamic_path_ops<VType>::rotateleft_(TreeNode<VType>* root) con
         new_root->bhead = p->bhead;
     }
 
+    refresh_min(root);
+    refresh_min(new_root);
+
     // Update the height
     root->height = std::max(p->height, q->height) + 1;
     new_root->height = std::max(root->height, r->height) + 1;
+    root->size = p->size + q->size;
+    new_root->size = root->size + r->size;
 
     return new_root;
 }
@@ -721,7 +2032,10 @@ TreeNode<VType>* dynamic_path_ops<VType>::rotateright_(TreeNode<VType>* root) co
         return nullptr;
     }
 
+    DP_STAT(++m_stats.rotate_right);
+    push_(root);
     TreeNode<VType>* new_root = root->bleft;
+    push_(new_root);
 
     // Update the fields
     // Change the shape
@@ -788,9 +2102,14 @@ TreeNode<VType>* dynamic_path_ops<VType>::rotateright_(TreeNode<VType>* root) co
         new_root->btail = r->btail;
     }
 
+    refresh_min(root);
+    refresh_min(new_root);
+
     // Update the height
     root->height = std::max(q->height, r->height) + 1;
     new_root->height = std::max(p->height, root->height) + 1;
+    root->size = q->size + r->size;
+    new_root->size = p->size + root->size;
 
     return new_root;
 }
@@ -801,6 +2120,17 @@ TreeNode<VType>* dynamic_path_ops<VType>::top_down_balance_(TreeNode<VType>* roo
         return root;
     }
 
+#ifdef DYNAMIC_PATH_STATS
+    ++m_stats.balance_calls;
+    ++m_balance_depth;
+    m_stats.balance_max_depth = std::max(m_stats.balance_max_depth, m_balance_depth);
+    struct depth_guard {
+        uint64_t& depth;
+        ~depth_guard() { --depth; }
+    } guard{m_balance_depth};
+#endif
+
+    push_(root);
     TreeNode<VType>* p = root->bleft;
     TreeNode<VType>* q = root->bright;
 
@@ -821,10 +2151,13 @@ TreeNode<VType>* dynamic_path_ops<VType>::top_down_balance_(TreeNode<VType>* roo
     q->bparent = root;
     root->bright = q;
     q->netmin = q->netmin - root->netmin;
+    refresh_min(root);
+    root->height = std::max(p->height, q->height) + 1;
 
     // Balance the top level.
     if (p->height >= q->height + 2) {  // Right rotation is required.
         // Make sure the right sub-tree of p has a smaller height
+        push_(p);
         if (p->bleft->height < p->bright->height) {
             // First make a rotation in p
             p->netmin = p->netmin + root->netmin;  // Take it as a separate tree
@@ -840,6 +2173,7 @@ TreeNode<VType>* dynamic_path_ops<VType>::top_down_balance_(TreeNode<VType>* roo
 
     if (q->height >= p->height + 2) {  // Left rotation is required.
         // Make sure the left sub-tree of q has a smaller height
+        push_(q);
         if (q->bright->height < q->bleft->height) {
             // First make a rotation in q
             q->netmin = q->netmin + root->netmin;
@@ -856,6 +2190,271 @@ TreeNode<VType>* dynamic_path_ops<VType>::top_down_balance_(TreeNode<VType>* roo
     return root;
 }
 
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::detach_end_(const std::vector<TreeNode<VType>*>& walk, VType& x) const {
+    TreeNode<VType>* v = walk[0];
+    TreeNode<VType>* u = walk[1];
+    bool tail = u->bright == v;
+    DP_STAT(++m_stats.splits);
+    DP_STAT(++m_stats.split_destroys);
+
+    // Gross minima of the edges on the walk, from the root down.
+    std::vector<VType> gross(walk.size());
+    gross.back() = walk.back()->netmin;
+    for (std::size_t i = walk.size() - 2; i >= 1; --i) {
+        gross[i] = gross[i + 1] + walk[i]->netmin;
+    }
+    x = u->netcost + gross[1];
+
+    // Replace the edge by the rest of its subtree.
+    TreeNode<VType>* s = tail ? u->bleft : u->bright;
+    TreeNode<VType>* g = walk.size() > 2 ? walk[2] : nullptr;
+    s->bparent = g;
+    if (!s->external) {
+        s->netmin = s->netmin + gross[1] - (g ? gross[2] : VType(0));
+    }
+    if (g) {
+        (tail ? g->bright : g->bleft) = s;
+    }
+    // Unlink the vertices of the deleted edge.
+    if (tail) {
+        next_link(subtree_tail(s), s) = nullptr;
+        v->bhead = nullptr;
+    } else {
+        prev_link(subtree_head(s), s) = nullptr;
+        v->btail = nullptr;
+    }
+    v->bparent = nullptr;
+    free_node_(u);
+
+    // Refresh the ancestors bottom-up. The netmin of their children are still relative to their old gross minima.
+    for (std::size_t i = 2; i < walk.size(); ++i) {
+        TreeNode<VType>* a = walk[i];
+        VType cost = a->netcost + gross[i];
+        VType grossmin = cost;
+        if (!a->bleft->external && gross[i] + a->bleft->netmin < grossmin) {
+            grossmin = gross[i] + a->bleft->netmin;
+        }
+        if (!a->bright->external && gross[i] + a->bright->netmin < grossmin) {
+            grossmin = gross[i] + a->bright->netmin;
+        }
+        VType delta = grossmin - gross[i];
+        a->netcost = cost - grossmin;
+        a->netmin = a->netmin + delta;
+        if (!a->bleft->external) {
+            a->bleft->netmin = a->bleft->netmin - delta;
+        }
+        if (!a->bright->external) {
+            a->bright->netmin = a->bright->netmin - delta;
+        }
+        if (tail) {
+            a->btail = subtree_tail(a->bright);
+        } else {
+            a->bhead = subtree_head(a->bleft);
+        }
+        a->height = std::max(a->bleft->height, a->bright->height) + 1;
+        a->size = a->bleft->size + a->bright->size;
+        refresh_min(a);
+    }
+
+    TreeNode<VType>* root = g ? walk.back() : s;
+    return m_balance == dynamic_path_balance::deferred ? settle_(root) : top_down_balance_(root);
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::settle_(TreeNode<VType>* root) const {
+    if (!root || root->external || !drifted(root)) {
+        return root;
+    }
+
+    root = rebuild_(root, true);
+    // The kept subtrees may still be too high when they make up most of a small tree.
+    if (drifted(root)) {
+        root = rebuild_(root, false);
+    }
+    return root;
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::rebuild_(TreeNode<VType>* root, bool keep_balanced, int keep_size) const {
+    // Flatten the tree in path order into subtrees (vertices, or nearly balanced subtrees if kept) with gross netmin,
+    // separated by the TreeNodes of the edges between them and the gross costs of these edges.
+    std::vector<TreeNode<VType>*> items;
+    std::vector<TreeNode<VType>*> edges;
+    std::vector<VType> costs;
+    std::vector<std::pair<TreeNode<VType>*, VType>> stack;
+    auto descend = [&](TreeNode<VType>* u, VType basemin) {
+        while (!u->external) {
+            VType grossmin = u->netmin + basemin;
+            if (u->size <= keep_size || (keep_balanced && u->height <= ideal_height(u->size) + 2)) {
+                u->netmin = grossmin;
+                break;
+            }
+            push_(u);
+            stack.emplace_back(u, grossmin);
+            u = u->bleft;
+            basemin = grossmin;
+        }
+        items.push_back(u);
+    };
+    descend(root, VType(0));
+    while (!stack.empty()) {
+        TreeNode<VType>* u = stack.back().first;
+        VType grossmin = stack.back().second;
+        stack.pop_back();
+        edges.push_back(u);
+        costs.push_back(u->netcost + grossmin);
+        descend(u->bright, grossmin);
+    }
+
+    DP_STAT(++m_stats.rebuilds);
+    DP_STAT(m_stats.rebuild_nodes += edges.size());
+    return assemble_(items, edges, costs);
+}
+
+template <typename VType>
+void dynamic_path_ops<VType>::cut_(TreeNode<VType>* root, std::initializer_list<TreeNode<VType>*> cuts,
+                                   std::vector<TreeNode<VType>*>& items, std::vector<TreeNode<VType>*>& edges,
+                                   std::vector<VType>& costs) const {
+    std::vector<TreeNode<VType>*> taken;
+    for (TreeNode<VType>* edge : cuts) {
+        for (TreeNode<VType>* u = edge; u != nullptr; u = u->bparent) {
+            taken.push_back(u);
+        }
+    }
+    std::sort(taken.begin(), taken.end());
+    taken.erase(std::unique(taken.begin(), taken.end()), taken.end());
+
+    std::function<void(TreeNode<VType>*, VType)> take = [&](TreeNode<VType>* u, VType basemin) {
+        if (!std::binary_search(taken.begin(), taken.end(), u)) {
+            if (!u->external) {
+                u->netmin = u->netmin + basemin;
+            }
+            u->bparent = nullptr;
+            items.push_back(u);
+            return;
+        }
+
+        push_(u);
+        VType grossmin = u->netmin + basemin;
+        // Unlink the vertices of the edge, as `destroy_` does.
+        next_link(subtree_tail(u->bleft), u->bleft) = nullptr;
+        prev_link(subtree_head(u->bright), u->bright) = nullptr;
+        take(u->bleft, grossmin);
+        edges.push_back(u);
+        costs.push_back(u->netcost + grossmin);
+        take(u->bright, grossmin);
+    };
+    take(root, VType(0));
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::assemble_(const std::vector<TreeNode<VType>*>& items,
+                                                    const std::vector<TreeNode<VType>*>& edges,
+                                                    const std::vector<VType>& costs) const {
+    if (edges.empty()) {
+        return items[0];
+    }
+
+    // Split every range of items at the edge that halves its vertices the best.
+    std::vector<std::size_t> prefix(items.size() + 1, 0);
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        prefix[i + 1] = prefix[i] + items[i]->size;
+    }
+    std::function<TreeNode<VType>*(std::size_t, std::size_t)> build = [&](std::size_t l, std::size_t r) {
+        if (l == r) {
+            return items[l];
+        }
+        std::size_t half = prefix[l] + (prefix[r + 1] - prefix[l]) / 2;
+        // Left part l..m: the first prefix[m + 1] not below half, or the one just before if closer.
+        std::size_t m = std::lower_bound(prefix.begin() + l + 1, prefix.begin() + r, half) - prefix.begin() - 1;
+        if (m > l && prefix[m + 1] >= half && half - prefix[m] < prefix[m + 1] - half) {
+            --m;
+        }
+        TreeNode<VType>* left = build(l, m);
+        TreeNode<VType>* right = build(m + 1, r);
+        link_(edges[m], left, right, costs[m]);
+        return edges[m];
+    };
+    return build(0, items.size() - 1);
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::relayout_subtree_(TreeNode<VType>* u) const {
+    push_path_(u);
+    TreeNode<VType>* parent = u->bparent;
+    bool left = parent && parent->bleft == u;
+    u = rebuild_(u, false);
+    u->bparent = parent;
+    if (parent) {
+        (left ? parent->bleft : parent->bright) = u;
+    }
+
+    if (!m_storage) {
+        std::vector<TreeNode<VType>*> order;
+        veb_order(u, u->height - 1, 1, order);
+        u = pack_(order);
+    }
+
+    // Only the heights of the ancestors may change: the rebuild keeps the edges of minimum cost.
+    for (TreeNode<VType>* a = parent; a; a = a->bparent) {
+        a->height = std::max(a->bleft->height, a->bright->height) + 1;
+    }
+    return u;
+}
+
+template <typename VType>
+TreeNode<VType>* dynamic_path_ops<VType>::pack_(const std::vector<TreeNode<VType>*>& order) const {
+    // The first TreeNode of the block heads it: its size counts the TreeNodes of the block still in use.
+    TreeNode<VType>* block = new TreeNode<VType>[order.size() + 1];
+    block->size = static_cast<int>(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        TreeNode<VType>* u = order[i];
+        TreeNode<VType>* v = block + i + 1;
+        *v = *u;
+        v->packed = true;
+        v->node_index = static_cast<int>(i + 1);
+        // Until it is freed, the moved TreeNode forwards to its copy, and height 0 tells it apart. The copy holds its
+        // pending reversal and scaling.
+        u->bparent = v;
+        u->height = 0;
+        u->reversed = false;
+        u->scale = VType(1);
+    }
+    DP_STAT(++m_stats.relayouts);
+    DP_STAT(m_stats.relayout_nodes += order.size());
+    DP_STAT(m_stats.node_allocations += order.size());
+    DP_STAT(m_stats.node_bytes += order.size() * sizeof(TreeNode<VType>));
+
+    // Every TreeNode after the first one has its parent earlier in the order: link the copies top-down, then fix the
+    // parents of the vertices and subtrees left out and the edges of minimum cost bottom-up.
+    TreeNode<VType>* root = block + 1;
+    for (std::size_t i = 1; i < order.size(); ++i) {
+        TreeNode<VType>* v = block + i + 1;
+        v->bparent = v->bparent->bparent;
+        (v->bparent->bleft == order[i] ? v->bparent->bleft : v->bparent->bright) = v;
+    }
+    for (std::size_t i = order.size(); i > 0; --i) {
+        TreeNode<VType>* v = block + i;
+        v->bleft->bparent = v;
+        v->bright->bparent = v;
+        refresh_min(v);
+    }
+    if (TreeNode<VType>* a = root->bparent) {
+        (a->bleft == order[0] ? a->bleft : a->bright) = root;
+    }
+    auto forward = [](TreeNode<VType>* u) { return u->height == 0 ? u->bparent : u; };
+    for (TreeNode<VType>* a = root->bparent; a; a = a->bparent) {
+        a->bminfirst = forward(a->bminfirst);
+        a->bminlast = forward(a->bminlast);
+    }
+
+    for (TreeNode<VType>* u : order) {
+        free_node_(u);
+    }
+    return root;
+}
+
 #pragma mark Instantiations
 
 template class dynamic_path_ops<double>;
@@ -12,32 +12,131 @@ Date Created: Oct. 24, 2016.
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <utility>
 #include <vector>
 
 // Tree node structure for dynamic path
 template <typename VType>
 struct TreeNode {
     bool external = false;
+    // Lazy reverse bit of internal nodes: the children are still to be swapped and reversed,
+    // while bhead/btail already reflect the reversal.
+    bool reversed = false;
+    // Internal nodes moved into a block by `relayout`: node_index is then their offset in the block.
+    bool packed = false;
+    // Whether the subtree of an internal node may hold a pending reversal, its root included: set by a reversal, and
+    // recomputed from the children whenever they change.
+    bool reversed_below = false;
     int node_index;  // Valid only for "external" nodes
     TreeNode* bparent;
     VType netmin;
     VType netcost;
+    // Lazy scaling factor of internal nodes: netcost and the netmin of the children are still to be multiplied by it.
+    // 0 after an assignment, when the whole subtree has the same cost.
+    VType scale;
+    // Internal nodes: first and last vertices of the subtree.
+    // External nodes: previous and next vertices on the path (nullptr at the ends), kept by construct_ / destroy_.
+    // They are swapped while the ancestors hold an odd number of pending reversals, and get swapped back as
+    // these are pushed down to the vertex.
     TreeNode* bhead;
     TreeNode* bleft;
     TreeNode* bright;
     TreeNode* btail;
+    // Internal nodes: edges of the subtree with the minimum cost closest to its head / tail, as found by the
+    // descents of pmincost_before / pmincost_after. nullptr for external nodes.
+    TreeNode* bminfirst;
+    TreeNode* bminlast;
     // For tree balance
     int height;
+    // Number of vertices (external TreeNodes) of the subtree.
+    int size;
 };
 
+/**
+ * \brief Structural performance counters of a dynamic_path_ops object.
+ *
+ * \note Counters are only updated when the library is built with DYNAMIC_PATH_STATS (CMake option of the same name),
+ * otherwise they stay zero and counting costs nothing.
+ */
+struct dynamic_path_stats {
+    uint64_t node_allocations = 0;
+    uint64_t node_frees = 0;
+    uint64_t node_bytes = 0;  // Bytes of the currently live TreeNodes.
+    uint64_t rotate_left = 0;
+    uint64_t rotate_right = 0;
+    uint64_t balance_calls = 0;  // `top_down_balance_` calls, recursive ones included.
+    uint64_t balance_max_depth = 0;  // Deepest `top_down_balance_` recursion.
+    uint64_t constructs = 0;
+    uint64_t destroys = 0;
+    uint64_t splits = 0;
+    uint64_t split_constructs = 0;  // `construct_` calls made by splits.
+    uint64_t split_destroys = 0;  // `destroy_` calls made by splits.
+    uint64_t root_walks = 0;  // Bottom-up walks from a TreeNode towards the root.
+    uint64_t root_walk_steps = 0;
+    uint64_t root_walk_max = 0;
+    uint64_t rebuilds = 0;  // Subtrees rebuilt by the deferred balance mode or `rebuild`.
+    uint64_t rebuild_nodes = 0;  // Internal TreeNodes relinked by the rebuilds.
+    uint64_t splices = 0;
+    uint64_t splice_nodes = 0;  // Internal TreeNodes taken apart by the splices.
+    uint64_t relayouts = 0;  // Blocks of TreeNodes laid out by `relayout` and `relayout_step`.
+    uint64_t relayout_nodes = 0;  // Internal TreeNodes moved into the blocks.
+
+    uint64_t live_nodes() const { return node_allocations - node_frees; }
+};
+
+/**
+ * \brief Shape of a dynamic path tree.
+ */
+struct dynamic_path_shape {
+    std::size_t vertices = 0;  // External TreeNodes.
+    std::size_t edges = 0;  // Internal TreeNodes.
+    int height = 0;  // Height of the root, an external TreeNode has height 1.
+    int ideal_height = 0;  // Minimum height of a tree with the same number of vertices: ceil(log2(vertices)) + 1.
+};
+
+/**
+ * \brief Balancing policy of the concatenations of a dynamic_path_ops object.
+ */
+enum class dynamic_path_balance {
+    // Rebalance top-down after every concatenation (unless asked not to).
+    eager,
+    // Skip the per-operation rebalancing. Once the height of a concatenated tree exceeds twice its ideal height,
+    // its unbalanced part is rebuilt in time linear in its size, keeping nearly balanced subtrees as they are.
+    // Meant for append-heavy phases, e.g. building a path vertex by vertex.
+    deferred,
+};
+
+template <typename VType>
+class mmap_node_storage;
+
 /**
  * \brief Interface of dynamic path operations.
  *
- * \note This interface does not hold any dynamic path states.
+ * \note The paths themselves live in their TreeNodes. Besides its settings, statistics and transaction log, an object
+ * only counts the pending reversals and scalings of the TreeNodes it operates on: the TreeNodes of a path must be
+ * operated on by the object that generated them, or that took them over with `adopt`.
  */
 template <typename VType>
 class dynamic_path_ops {
   public:
+    /**
+     * \brief Operations on TreeNodes allocated on the heap.
+     */
+    dynamic_path_ops() = default;
+
+    /**
+     * \brief Operations on TreeNodes allocated from an out-of-core storage.
+     *
+     * \note New TreeNodes fall back to the heap once the storage is full.
+     *
+     * \param[in] storage Storage for new TreeNodes. Must outlive all TreeNodes allocated by this object.
+     */
+    explicit dynamic_path_ops(mmap_node_storage<VType>* storage);
+
     /**
      * \brief Generate a new tree node.
      *
@@ -47,6 +146,24 @@ class dynamic_path_ops {
      */
     TreeNode<VType>* gen_new_node(bool is_external, int node_index) const;
 
+    /**
+     * \brief Take over a (sub-)tree whose TreeNodes were generated by another object, which must not operate on it
+     * afterwards. The TreeNodes themselves stay in place: only their accounting moves, in O(1) unless the other
+     * object has pending reversals or scalings, which are then counted in the (sub-)tree.
+     *
+     * \note Both objects must allocate from the same storage, since TreeNodes are released to the storage of the
+     * object releasing them.
+     *
+     * \param[in] from Object that generated the TreeNodes.
+     * \param[in] p Root TreeNode of the (sub-)tree.
+     */
+    void adopt(const dynamic_path_ops& from, TreeNode<VType>* p) const;
+
+    /**
+     * \brief Out-of-core storage of new TreeNodes, nullptr if they are allocated on the heap.
+     */
+    mmap_node_storage<VType>* storage() const;
+
     /**
      * \brief Return the root node of the dynamic path containing the input TreeNode.
      *
@@ -74,6 +191,9 @@ class dynamic_path_ops {
     /**
      * \brief Return the TreeNode of path vertex u before TreeNode of path vertex v on `path(v)`.
      *
+     * \note O(1) through the links between neighboring vertices while this object holds no pending reversal;
+     * otherwise the pending reversals above v are first pushed down in O(log n).
+     *
      * \param[in] v External TreeNode for a path vertex v.
      * \return External TreeNode that is "before" vertex v in the path. nullptr if v is the head of the path.
      */
@@ -82,11 +202,35 @@ class dynamic_path_ops {
     /**
      * \brief Return the TreeNode of path vertex u after TreeNode of path vertex v on `path(v)`.
      *
+     * \note O(1) through the links between neighboring vertices while this object holds no pending reversal;
+     * otherwise the pending reversals above v are first pushed down in O(log n).
+     *
      * \param[in] v External TreeNode for a path vertex v.
      * \return External TreeNode that is "after" vertex v in the path. nullptr if v is the tail of the path.
      */
     TreeNode<VType>* after(TreeNode<VType>* v) const;
 
+    /**
+     * \brief Return the TreeNode of the path vertex at a given position of a path, counting from its head.
+     *
+     * \note O(log n) descent guided by the number of vertices in every subtree.
+     *
+     * \param[in] p Root TreeNode of the path.
+     * \param[in] i Position of the vertex: 0 for the head, `vertices - 1` for the tail.
+     * \return External TreeNode at position i. nullptr if the path has no vertex at position i.
+     */
+    TreeNode<VType>* vertex_at(TreeNode<VType>* p, std::size_t i) const;
+
+    /**
+     * \brief Return the position of a path vertex on `path(v)`, counting from its head: the inverse of `vertex_at`.
+     *
+     * \note O(log n) walk up to the root.
+     *
+     * \param[in] v External TreeNode for a path vertex v.
+     * \return Number of vertices before v in the path.
+     */
+    std::size_t position(TreeNode<VType>* v) const;
+
     /**
      * \brief Return the cost of edge (before(v), v), for the input external TreeNode of a path vertex v.
      *
@@ -106,6 +250,9 @@ class dynamic_path_ops {
     /**
      * \brief Return the external TreeNode v in p such that (before(v), v) is the minimum cost edge closest to head(p).
      *
+     * \note O(1) from the minimum cost edges cached in every internal TreeNode while the path holds no pending
+     * reversal; otherwise the pending reversals above the cached edge are first pushed down in O(log n).
+     *
      * \param[in] p Root TreeNode of the path.
      * \return External TreeNode v such that (before(v), v) is the minimum cost edge closest to head(p). nullptr if the input root TreeNode is external (for path vertices).
      */
@@ -114,11 +261,38 @@ class dynamic_path_ops {
     /**
      * \brief Return the external TreeNode v in p such that (v, after(v)) is the minimum cost edge closest to tail(p).
      *
+     * \note O(1) from the minimum cost edges cached in every internal TreeNode while the path holds no pending
+     * reversal; otherwise the pending reversals above the cached edge are first pushed down in O(log n).
+     *
      * \param[in] p Root TreeNode of the path.
      * \return External TreeNode v such that (v, after(v)) is the minimum cost edge closest to tail(p). nullptr if the input root TreeNode is external (for path vertices).
      */
     TreeNode<VType>* pmincost_after(TreeNode<VType>* p) const;
 
+    /**
+     * \brief Report every edge of a path with a cost below a threshold, from head to tail.
+     *
+     * \note Subtrees whose minimum is not below the threshold are skipped, so only the ancestors of the k reported
+     * edges are visited: O(k log n) on a balanced tree, however long the path.
+     *
+     * \param[in] p Root TreeNode of the path.
+     * \param[in] threshold Edges with a cost strictly smaller than the threshold are reported.
+     * \param[out] edges Reported edges (v, after(v)), as the external TreeNode v and the cost. Cleared first.
+     */
+    void pcost_below(TreeNode<VType>* p, VType threshold, std::vector<std::pair<TreeNode<VType>*, VType>>& edges) const;
+
+    /**
+     * \brief Report the k edges of a path with the smallest costs, by increasing cost.
+     *
+     * \note A heap of frontier subtrees keyed by their minimum only expands the subtrees holding a reported edge.
+     * Among edges of equal cost, the order (and the selection at the k-th cost) is unspecified.
+     *
+     * \param[in] p Root TreeNode of the path.
+     * \param[in] k Number of edges to report. All edges are reported if the path has fewer.
+     * \param[out] edges Reported edges (v, after(v)), as the external TreeNode v and the cost. Cleared first.
+     */
+    void pmincost_k(TreeNode<VType>* p, std::size_t k, std::vector<std::pair<TreeNode<VType>*, VType>>& edges) const;
+
     /**
      * \brief Add a constant value to every edge of a path.
      *
@@ -129,16 +303,104 @@ class dynamic_path_ops {
      */
     void pupdate(TreeNode<VType>* p, VType x) const;
 
+    /**
+     * \brief Set every edge of a path to the same cost.
+     *
+     * \note O(1): the assignment is lazy like the reversal, a scaling of the costs by 0, and composes with `pupdate`
+     * and `paffine`. The edges of minimum cost become the first and the last edge of the path.
+     *
+     * \param[in] p Root TreeNode of the path, with at least one edge.
+     * \param[in] c New cost of every edge of the path.
+     * \return True if the costs are set, False during a transaction, as the assignment cannot be undone.
+     */
+    bool passign(TreeNode<VType>* p, VType c) const;
+
+    /**
+     * \brief Replace the cost x of every edge of a path by a * x + b with a > 0.
+     *
+     * \note O(1): the scaling is lazy like the reversal, pushed down to the children of the TreeNodes visited by later
+     * operations, and composes with `pupdate` and `passign`. It keeps the edges of minimum cost, up to the tolerance
+     * of the ties of floating-point costs.
+     *
+     * \param[in] p Root TreeNode of the path, with at least one edge.
+     * \param[in] a Positive factor.
+     * \param[in] b Constant (no restriction in sign) added after the scaling.
+     * \return True if the costs are updated, False if a is not positive or during a transaction, as the update
+     * cannot be undone exactly.
+     */
+    bool paffine(TreeNode<VType>* p, VType a, VType b) const;
+
+    /**
+     * \brief Reverse a path in O(1): head and tail swap and every edge (u, w) becomes (w, u) with the same cost.
+     *
+     * \note The reversal is lazy, and pushed down to the children of the TreeNodes visited by later operations.
+     *
+     * \param[in] p Root TreeNode of the path. It can be a singleton vertex (external TreeNode).
+     */
+    void reverse(TreeNode<VType>* p) const;
+
     /**
      * \brief Concatenate paths p and q by adding the edge (tail(p), head(q)) of cost x.
      *
      * \param[in] p Root TreeNode of path p. It can be a singleton vertex (external TreeNode).
      * \param[in] q Root TreeNode of path q. It can be a singleton vertex (external TreeNode).
      * \param[in] x Cost of edge (tail(p), head(q)).
+     * \param[in] reBalance Whether to rebalance in the eager balance mode. Ignored in the deferred balance mode.
      * \return Root TreeNode of the concatenated new path. If q is nullptr, returns p; if p is nullptr, returns q.
      */
     TreeNode<VType>* concatenate(TreeNode<VType>* p, TreeNode<VType>* q, VType x, bool reBalance = true) const;
 
+    /**
+     * \brief Rebuild the tree of a path perfectly balanced in O(n), reusing its TreeNodes.
+     *
+     * \param[in] p Root TreeNode of the path. It can be a singleton vertex (external TreeNode).
+     * \return Root TreeNode of the rebuilt tree.
+     */
+    TreeNode<VType>* rebuild(TreeNode<VType>* p) const;
+
+    /**
+     * \brief Rebuild the tree of a path perfectly balanced, as `rebuild`, and move its internal TreeNodes into one
+     * contiguous block in van Emde Boas order: the top half of the levels first, then each subtree hanging below
+     * them, laid out the same way. Walks between the root and the vertices then read O(log n / log B) blocks of B
+     * TreeNodes for any B, instead of TreeNodes scattered over the heap by a long history of splits and
+     * concatenations.
+     *
+     * \note O(n). The external TreeNodes (the vertex handles) stay in place. A block is released with its last
+     * TreeNode. TreeNodes of an out-of-core storage are only rebalanced.
+     *
+     * \param[in] p Root TreeNode of the path. It can be a singleton vertex (external TreeNode).
+     * \return Root TreeNode of the relaid out tree.
+     */
+    TreeNode<VType>* relayout(TreeNode<VType>* p) const;
+
+    /**
+     * \brief One time slice of an incremental `relayout`. Each slice rebuilds and moves the next subtrees in path
+     * order, of at most `budget` internal TreeNodes each, into blocks of their own. Once the cursor reaches the tail,
+     * the last slice rebalances and moves the TreeNodes above these subtrees. Other operations may run on the path
+     * between the slices: the subtrees they change are only laid out less well.
+     *
+     * \note O(budget + log n) per slice, but for the last one, which moves O(n / budget) TreeNodes when the slices
+     * are not interleaved with other operations.
+     *
+     * \param[in,out] p Root TreeNode of the path, replaced by the new root.
+     * \param[in,out] cursor Position of the first vertex of the next slice. 0 to start a relayout.
+     * \param[in] budget Number of internal TreeNodes moved by a slice, at least 1.
+     * \return True if the relayout is complete, False if more slices are needed.
+     */
+    bool relayout_step(TreeNode<VType>*& p, std::size_t& cursor, std::size_t budget) const;
+
+    /**
+     * \brief Set the balancing policy of the following concatenations (and of the splits, which concatenate).
+     *
+     * \note Trees built in either mode can be used in the other one.
+     */
+    void set_balance(dynamic_path_balance balance);
+
+    /**
+     * \brief Balancing policy of the concatenations, eager by default.
+     */
+    dynamic_path_balance balance() const;
+
     /**
      * \brief Split `path(v)` into (up to) two parts by deleting the edge (before(v), v).
      *
@@ -163,6 +425,67 @@ class dynamic_path_ops {
      */
     void split_after(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& y) const;
 
+    /**
+     * \brief Move the sub-path from vertex u to vertex v out of `path(u)`, and insert it between vertex w and after(w).
+     * The gap left in `path(u)` is closed by the edge (before(u), after(v)) of cost x; the sub-path is connected by the
+     * edges (w, u) of cost y and (v, after(w)) of cost z.
+     *
+     * \note One pass instead of the equivalent splits and concatenations: only the ancestors of the (up to three)
+     * deleted edges are taken apart, and every resulting path is rebuilt once from the subtrees left whole, reusing
+     * the TreeNodes of the deleted edges for the new ones. O(log n).
+     *
+     * \param[in] u External TreeNode of the head vertex of the moved sub-path.
+     * \param[in] v External TreeNode of the tail vertex of the moved sub-path: u, or a vertex after u on `path(u)`.
+     * \param[in] w External TreeNode of the vertex to insert the sub-path after, on `path(u)` but not in the sub-path,
+     * or on another path. nullptr to make the sub-path a path of its own.
+     * \param[in] x Cost of the edge (before(u), after(v)). Unused if u is the head or v the tail of `path(u)`, or if w
+     * is before(u).
+     * \param[in] y Cost of the edge (w, u). Unused if w is nullptr.
+     * \param[in] z Cost of the edge (v, after(w)). Unused if w is nullptr or the tail of its path.
+     * \param[out] p Root TreeNode of the path containing the moved sub-path.
+     * \param[out] q Root TreeNode of the rest of the original `path(u)` if it is not part of p, nullptr otherwise.
+     */
+    void splice(TreeNode<VType>* u, TreeNode<VType>* v, TreeNode<VType>* w, VType x, VType y, VType z,
+                TreeNode<VType>*& p, TreeNode<VType>*& q) const;
+
+    /**
+     * \brief Start a transaction: from now on, `pupdate`, `reverse`, `concatenate`, `split_before`, `split_after` and
+     * `splice` log just enough to undo them in O(log n) each (the vertices around the changed edges and their costs),
+     * until `commit`. Nothing is copied. If a transaction is open, it goes on.
+     *
+     * \note `passign` and `paffine` fail during a transaction. Vertices are logged by their external TreeNodes, which
+     * must not be released before the end of the transaction. Rolling back restores the vertex order and the edge
+     * costs of every path, but not the tree shapes: the roots held by the caller are then stale and must be found
+     * again with `path`. Costs of floating-point types are restored up to the rounding of the inverse updates.
+     *
+     * \return Savepoint of the current state, see `rollback`.
+     */
+    std::size_t begin_transaction();
+
+    /**
+     * \brief Savepoint of the current state: the number of logged operations of the open transaction.
+     */
+    std::size_t savepoint() const;
+
+    /**
+     * \brief Undo the operations logged after a savepoint, from the last one. The transaction stays open at the
+     * savepoint, so that later savepoints are no longer valid.
+     *
+     * \param[in] savepoint Savepoint returned by `begin_transaction` or `savepoint` during the open transaction.
+     * \return True if the operations are undone, False if no transaction is open or the savepoint is not valid.
+     */
+    bool rollback(std::size_t savepoint);
+
+    /**
+     * \brief End the open transaction, keeping its operations and clearing its log.
+     */
+    void commit();
+
+    /**
+     * \brief Whether a transaction is open.
+     */
+    bool in_transaction() const;
+
     /**
      * \brief Inorder traversal of a (sub-)tree to serialize the respective (sub-)path, and the edge costs are surfaced.
      *
@@ -171,6 +494,20 @@ class dynamic_path_ops {
      */
     void vectorize(TreeNode<VType>* p, std::vector<VType>& vector_path) const;
 
+    /**
+     * \brief Serialize the edge costs of given ranges of positions of a path, where edge (v, after(v)) is at
+     * `position(v)`.
+     *
+     * \note Read-only descent that only visits the subtrees overlapping the ranges: O(k + r log n) for k edges in r
+     * ranges.
+     *
+     * \param[in] p Root TreeNode of the path.
+     * \param[in] ranges Disjoint ranges [first, second) of edge positions, in increasing order.
+     * \param[out] vector_path Edge costs of the ranges, one range after another.
+     */
+    void vectorize_ranges(TreeNode<VType>* p, const std::vector<std::pair<std::size_t, std::size_t>>& ranges,
+                          std::vector<VType>& vector_path) const;
+
     /**
      * \brief Inorder traversal of a (sub)-tree to serialize the respective (sub-)path, and the vertex indices are surfaced.
      *
@@ -186,14 +523,131 @@ class dynamic_path_ops {
      */
     void clearall(TreeNode<VType>* p) const;
 
+    /**
+     * \brief Write the (sub-)tree to a binary snapshot file.
+     * The snapshot stores the exact tree shape together with netmin/netcost/height, behind a header carrying
+     * a format version and a checksum of the payload. Values are stored in the native byte order.
+     *
+     * \param[in] p Root TreeNode of the (sub-)tree. It can be nullptr (empty snapshot).
+     * \param[in] filename Path of the snapshot file to write.
+     * \return True if the snapshot is written successfully, False otherwise.
+     */
+    bool save(TreeNode<VType>* p, const std::string& filename) const;
+
+    /**
+     * \brief Rebuild a (sub-)tree from a binary snapshot file written by `save`.
+     * The exact tree shape is restored with sequential reads, no rebalancing is performed.
+     *
+     * \param[in] filename Path of the snapshot file to read.
+     * \param[out] external_nodes External TreeNodes (path vertices) of the restored tree, from head to tail.
+     * \param[out] ok True if the snapshot is read successfully (an empty snapshot is valid), False otherwise.
+     * \return Root TreeNode of the restored tree. nullptr if the snapshot is empty or invalid.
+     */
+    TreeNode<VType>* load(const std::string& filename, std::vector<TreeNode<VType>*>& external_nodes, bool& ok) const;
+
+    /**
+     * \brief Compute the shape of a (sub-)tree in O(n).
+     *
+     * \param[in] p Root TreeNode of the (sub-)tree.
+     * \return Numbers of vertices and edges, height and ideal height of the (sub-)tree.
+     */
+    dynamic_path_shape tree_shape(TreeNode<VType>* p) const;
+
+    /**
+     * \brief Structural counters accumulated since the construction or the last `reset_stats`.
+     *
+     * \note All zero unless the library is built with DYNAMIC_PATH_STATS.
+     */
+    const dynamic_path_stats& stats() const;
+
+    /**
+     * \brief Reset the structural counters. Live node count and bytes are kept.
+     */
+    void reset_stats() const;
+
   private:
+    // Apply a pending scaling and reversal of an internal TreeNode to its children.
+    void push_(TreeNode<VType>*) const;
+    // Apply the pending scaling of an internal TreeNode to its cost and its children.
+    void push_scale_(TreeNode<VType>*) const;
+    // Scale the costs of a (sub-)tree by a >= 0 in O(1), the netmin of its root excepted.
+    void scale_(TreeNode<VType>*, VType a) const;
+    // Reverse a (sub-)tree in O(1): an internal TreeNode gets a pending reversal, a vertex swaps its links.
+    void reverse_(TreeNode<VType>*) const;
+    // Push the pending reversals and scalings of a TreeNode and of all its ancestors, from the root down.
+    void push_path_(TreeNode<VType>*) const;
+    // Account for a bottom-up walk of the given number of parent steps.
+    void record_root_walk_(std::size_t steps) const;
+    // Release a TreeNode generated by `gen_new_node`.
+    void free_node_(TreeNode<VType>*) const;
     // Both input trees must be non-empty.
     TreeNode<VType>* construct_(TreeNode<VType>*, TreeNode<VType>*, VType) const;
+    // Make an internal TreeNode the root over two trees and the edge of the given cost between them.
+    void link_(TreeNode<VType>* root, TreeNode<VType>* v, TreeNode<VType>* w, VType x) const;
     // Split a non-empty tree.
     void destroy_(TreeNode<VType>*, TreeNode<VType>*&, TreeNode<VType>*&, VType&) const;
+    // Remove the edge of the head or tail vertex of a path, given the bottom-up walk from the vertex to the root,
+    // fixing the ancestors in place. Return the root of the rest of the path and the cost of the edge.
+    TreeNode<VType>* detach_end_(const std::vector<TreeNode<VType>*>& walk, VType& x) const;
     // The input TreeNode may not be a root node. Additional assumption applies though, see comment inside.
     TreeNode<VType>* rotateleft_(TreeNode<VType>*) const;
     // The input TreeNode may not be a root node. Additional assumption applies though, see comment inside.
     TreeNode<VType>* rotateright_(TreeNode<VType>*) const;
     TreeNode<VType>* top_down_balance_(TreeNode<VType>*) const;
+    // Rebuild a tree whose height drifted too far from the ideal one, in the deferred balance mode.
+    TreeNode<VType>* settle_(TreeNode<VType>*) const;
+    // Rebuild a tree balanced by vertex count. Nearly balanced subtrees are kept as they are if asked to, and so are
+    // the subtrees of at most keep_size vertices.
+    TreeNode<VType>* rebuild_(TreeNode<VType>*, bool keep_balanced, int keep_size = 1) const;
+    // Take apart the ancestors of the given edge TreeNodes, appending in path order the subtrees left whole (roots with
+    // gross netmin) to items, and the TreeNodes and gross costs of the edges between them to edges and costs.
+    void cut_(TreeNode<VType>* root, std::initializer_list<TreeNode<VType>*> cuts, std::vector<TreeNode<VType>*>& items,
+              std::vector<TreeNode<VType>*>& edges, std::vector<VType>& costs) const;
+    // Link subtrees in path order into a tree balanced by vertex count, edges[i] joining items[i] and items[i + 1].
+    TreeNode<VType>* assemble_(const std::vector<TreeNode<VType>*>& items, const std::vector<TreeNode<VType>*>& edges,
+                               const std::vector<VType>& costs) const;
+    // Rebuild the subtree of an internal TreeNode balanced in place and move it into a block. Return its new root.
+    TreeNode<VType>* relayout_subtree_(TreeNode<VType>*) const;
+    // Move internal TreeNodes, the top of a subtree listed from its root, into a new block in that order, fixing the
+    // pointers of the other TreeNodes to them. Return the new root of the subtree.
+    TreeNode<VType>* pack_(const std::vector<TreeNode<VType>*>& order) const;
+
+    // Unlogged bodies of concatenate, split_before and split_after, also used by the splits and the rollbacks.
+    TreeNode<VType>* concatenate_(TreeNode<VType>* p, TreeNode<VType>* q, VType x, bool reBalance = true) const;
+    void split_before_(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& x) const;
+    void split_after_(TreeNode<VType>* v, TreeNode<VType>*& p, TreeNode<VType>*& q, VType& y) const;
+
+    // Logged operation of a transaction, with the vertices and costs to undo it: see `rollback`.
+    struct undo_record {
+        enum class kind : uint8_t { update, reverse, concatenate, split, splice } op;
+        TreeNode<VType>* a;
+        TreeNode<VType>* b;
+        TreeNode<VType>* c;
+        TreeNode<VType>* d;
+        TreeNode<VType>* e;
+        TreeNode<VType>* f;
+        VType x;
+        VType y;
+        VType z;
+    };
+    // Log an operation that needs up to two vertices and one cost to be undone.
+    void log_undo_(typename undo_record::kind op, TreeNode<VType>* a, TreeNode<VType>* b, VType x) const;
+    // Undo one logged operation.
+    void undo_(const undo_record& record) const;
+
+    mmap_node_storage<VType>* m_storage = nullptr;
+    dynamic_path_balance m_balance = dynamic_path_balance::eager;
+    bool m_transaction = false;
+    mutable std::vector<undo_record> m_undo_log;
+    // Internal TreeNodes operated on by this object with a pending reversal. While there are none, the links of every
+    // vertex are in path order.
+    mutable std::size_t m_pending_reversals = 0;
+    // Internal TreeNodes operated on by this object with a pending scaling. While there are no pending reversals or
+    // scalings either, `push_path_` has nothing to do.
+    mutable std::size_t m_pending_scalings = 0;
+    // Scratch list of the ancestors pushed by `push_path_`.
+    mutable std::vector<TreeNode<VType>*> m_push_path;
+    // Always present, so that the layout does not depend on DYNAMIC_PATH_STATS.
+    mutable dynamic_path_stats m_stats;
+    mutable uint64_t m_balance_depth = 0;
 };
@@ -0,0 +1,260 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in euler_tour_forest.h
+*/
+
+#include "euler_tour_forest.h"
+
+#include <utility>
+
+#pragma mark Public functions
+
+template <typename VType>
+euler_tour_forest<VType>::euler_tour_forest(const std::vector<VType>& values) {
+    m_tokens.resize(2 * values.size());
+    for (std::size_t v = 0; v < values.size(); ++v) {
+        // Isolated vertex: the tour v v', whose only edge holds the value of v.
+        m_tokens[2 * v] = m_ops.gen_new_node(true, static_cast<int>(v));
+        m_tokens[2 * v + 1] = m_ops.gen_new_node(true, static_cast<int>(v));
+        m_ops.concatenate(m_tokens[2 * v], m_tokens[2 * v + 1], values[v]);
+    }
+}
+
+template <typename VType>
+euler_tour_forest<VType>::~euler_tour_forest() {
+    // Collect the trees first: the walks to their roots go through the nodes being freed.
+    std::vector<TreeNode<VType>*> roots;
+    for (std::size_t v = 0; v < vertex_num(); ++v) {
+        TreeNode<VType>* root = m_ops.path(m_tokens[2 * v]);
+        if (m_ops.head(root) == m_tokens[2 * v]) {
+            roots.push_back(root);
+        }
+    }
+    for (TreeNode<VType>* root : roots) {
+        m_ops.clearall(root);
+    }
+}
+
+template <typename VType>
+std::size_t euler_tour_forest<VType>::vertex_num() const {
+    return m_tokens.size() / 2;
+}
+
+template <typename VType>
+bool euler_tour_forest<VType>::link(int u, int v) {
+    if (!valid_(u) || !valid_(v) || connected(u, v)) {
+        return false;
+    }
+
+    // Tour of u, then (u -> v), the tour of v and (v -> u), from root u.
+    VType value_u = m_ops.pcost_after(m_tokens[2 * u]);
+    VType value_v = m_ops.pcost_after(m_tokens[2 * v]);
+    TreeNode<VType>* tour_u = reroot_(u);
+    TreeNode<VType>* tour_v = reroot_(v);
+    TreeNode<VType>* down = m_ops.gen_new_node(true, v);
+    TreeNode<VType>* up = m_ops.gen_new_node(true, u);
+    m_arcs[arc_key_(u, v)] = down;
+    m_arcs[arc_key_(v, u)] = up;
+
+    TreeNode<VType>* tour = m_ops.concatenate(tour_u, down, value_u);
+    tour = m_ops.concatenate(tour, tour_v, value_v);
+    m_ops.concatenate(tour, up, value_v);
+    return true;
+}
+
+template <typename VType>
+bool euler_tour_forest<VType>::cut(int u, int v) {
+    TreeNode<VType>* first = arc_(u, v);
+    TreeNode<VType>* second = arc_(v, u);
+    if (!first || !second) {
+        return false;
+    }
+    if (m_ops.position(first) > m_ops.position(second)) {
+        std::swap(first, second);
+    }
+
+    // [A, first, B, second, C]: B is the tour of the far side, and A and C the two halves of the tour of the near side,
+    // joined by an edge with the value of the near end, as the one before first.
+    TreeNode<VType>* A;
+    TreeNode<VType>* B;
+    TreeNode<VType>* C;
+    TreeNode<VType>* rest;
+    TreeNode<VType>* arc;
+    VType x;
+    VType ignored;
+    m_ops.split_before(first, A, rest, x);
+    m_ops.split_after(first, arc, B, ignored);
+    m_ops.split_before(second, B, rest, ignored);
+    m_ops.split_after(second, arc, C, ignored);
+    m_ops.concatenate(A, C, x);
+    // B holds the tour of the far side, but as a rotation starting at the arc after first: start it at its vertex.
+    reroot_(first->node_index);
+
+    m_arcs.erase(arc_key_(u, v));
+    m_arcs.erase(arc_key_(v, u));
+    m_ops.clearall(first);
+    m_ops.clearall(second);
+    return true;
+}
+
+template <typename VType>
+bool euler_tour_forest<VType>::connected(int u, int v) const {
+    return valid_(u) && valid_(v) && m_ops.path(m_tokens[2 * u]) == m_ops.path(m_tokens[2 * v]);
+}
+
+template <typename VType>
+int euler_tour_forest<VType>::root(int v) const {
+    if (!valid_(v)) {
+        return -1;
+    }
+    return m_ops.head(m_ops.path(m_tokens[2 * v]))->node_index;
+}
+
+template <typename VType>
+bool euler_tour_forest<VType>::reroot(int v) {
+    if (!valid_(v)) {
+        return false;
+    }
+    reroot_(v);
+    return true;
+}
+
+template <typename VType>
+std::size_t euler_tour_forest<VType>::tree_size(int v) const {
+    if (!valid_(v)) {
+        return 0;
+    }
+    // 2 tokens per vertex and 2 per edge.
+    return (m_ops.path(m_tokens[2 * v])->size + 2) / 4;
+}
+
+template <typename VType>
+std::optional<VType> euler_tour_forest<VType>::value(int v) const {
+    if (!valid_(v)) {
+        return std::nullopt;
+    }
+    return m_ops.pcost_after(m_tokens[2 * v]);
+}
+
+template <typename VType>
+std::optional<VType> euler_tour_forest<VType>::subtree_min(int v, int p, int& min_vertex) {
+    TreeNode<VType>* A;
+    TreeNode<VType>* S;
+    TreeNode<VType>* C;
+    VType x;
+    VType y;
+    if (!split_subtree_(v, p, A, S, C, x, y)) {
+        return std::nullopt;
+    }
+
+    TreeNode<VType>* w = m_ops.pmincost_after(S);
+    min_vertex = w->node_index;
+    VType min_value = m_ops.pcost_after(w);
+    join_subtree_(A, S, C, x, y);
+    return min_value;
+}
+
+template <typename VType>
+bool euler_tour_forest<VType>::subtree_add(int v, int p, VType x) {
+    TreeNode<VType>* A;
+    TreeNode<VType>* S;
+    TreeNode<VType>* C;
+    VType y;
+    VType z;
+    if (!split_subtree_(v, p, A, S, C, y, z)) {
+        return false;
+    }
+
+    m_ops.pupdate(S, x);
+    join_subtree_(A, S, C, y, z);
+    return true;
+}
+
+template <typename VType>
+void euler_tour_forest<VType>::euler_tour(int v, std::vector<int>& tour) const {
+    tour.clear();
+    if (!valid_(v)) {
+        return;
+    }
+    m_ops.vectorizeVertex(m_ops.path(m_tokens[2 * v]), tour);
+}
+
+#pragma mark Private functions
+
+template <typename VType>
+bool euler_tour_forest<VType>::valid_(int v) const {
+    return v >= 0 && v < static_cast<int>(vertex_num());
+}
+
+template <typename VType>
+TreeNode<VType>* euler_tour_forest<VType>::reroot_(int v) {
+    TreeNode<VType>* token = m_tokens[2 * v];
+    TreeNode<VType>* tour = m_ops.path(token);
+    if (m_ops.head(tour) == token) {
+        return tour;
+    }
+
+    // Close the tour into a cycle with an edge holding the value of the vertex it ends at (the root, unless it is
+    // the far side of a cut that starts from an arc), and open it before v.
+    VType closing = m_ops.pcost_after(m_tokens[2 * m_ops.tail(tour)->node_index]);
+    TreeNode<VType>* p;
+    TreeNode<VType>* q;
+    VType x;
+    m_ops.split_before(token, p, q, x);
+    return m_ops.concatenate(q, p, closing);
+}
+
+template <typename VType>
+TreeNode<VType>* euler_tour_forest<VType>::arc_(int u, int v) const {
+    if (!valid_(u) || !valid_(v)) {
+        return nullptr;
+    }
+    auto arc = m_arcs.find(arc_key_(u, v));
+    return arc == m_arcs.end() ? nullptr : arc->second;
+}
+
+template <typename VType>
+uint64_t euler_tour_forest<VType>::arc_key_(int u, int v) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v);
+}
+
+template <typename VType>
+bool euler_tour_forest<VType>::split_subtree_(int v, int p, TreeNode<VType>*& A, TreeNode<VType>*& S,
+                                              TreeNode<VType>*& C, VType& x, VType& y) {
+    A = nullptr;
+    C = nullptr;
+    if (!valid_(v)) {
+        return false;
+    }
+    if (p == -1) {
+        S = m_ops.path(m_tokens[2 * v]);
+        return true;
+    }
+
+    TreeNode<VType>* down = arc_(p, v);
+    TreeNode<VType>* up = arc_(v, p);
+    if (!down || !up) {
+        return false;
+    }
+
+    // From root p, (p -> v) comes first and the tour of the subtree is [(p -> v), ..., (v -> p)].
+    reroot_(p);
+    TreeNode<VType>* rest;
+    m_ops.split_before(down, A, rest, x);
+    m_ops.split_after(up, S, C, y);
+    return true;
+}
+
+template <typename VType>
+void euler_tour_forest<VType>::join_subtree_(TreeNode<VType>* A, TreeNode<VType>* S, TreeNode<VType>* C, VType x,
+                                             VType y) {
+    m_ops.concatenate(m_ops.concatenate(A, S, x), C, y);
+}
+
+#pragma mark Instantiations
+
+template class euler_tour_forest<double>;
+template class euler_tour_forest<float>;
+template class euler_tour_forest<uint32_t>;
+template class euler_tour_forest<int>;
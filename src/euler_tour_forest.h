@@ -0,0 +1,163 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the Euler-tour tree layer of dynamic forests on top of dynamic paths
+*/
+
+#pragma once
+
+#include "dynamic_path.h"
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief Forest of n vertices with a value each, under link and cut of tree edges, answering connectivity and
+ * subtree minimum / addition queries in O(log n).
+ *
+ * \note Every tree is stored as one dynamic path of dynamic_path_ops: its Euler tour from the current root, where
+ * vertex v takes the two consecutive tokens v and v', and every tree edge (u, v) the arc tokens (u -> v) and (v -> u),
+ * so that the tour of the subtree of v below its parent p runs from (p -> v) to (v -> p), with v v' between the tours
+ * of two of its children. The path edge after a token holds the value of the vertex where the token ends, i.e. v for
+ * v, v' and (u -> v): every path edge of the tour of a subtree holds the value of a vertex of the subtree, and every
+ * copy of the value of a vertex of the subtree is in there. Subtree minima are then `pmincost_after` and subtree additions
+ * `pupdate` on that sub-path, split out and put back. Rerooting rotates the tour with one split and one
+ * concatenation, which is all `link` and `cut` need besides the arc tokens.
+ */
+template <typename VType>
+class euler_tour_forest {
+  public:
+    /**
+     * \brief Initialize a forest of isolated vertices 0, 1, ..., values.size() - 1.
+     *
+     * \param[in] values Initial value of every vertex.
+     */
+    explicit euler_tour_forest(const std::vector<VType>& values);
+
+    // The TreeNodes cannot be shared.
+    euler_tour_forest(const euler_tour_forest&) = delete;
+    euler_tour_forest& operator=(const euler_tour_forest&) = delete;
+
+    /**
+     * \brief Destructor to release all memory.
+     */
+    ~euler_tour_forest();
+
+    /**
+     * \brief Number of vertices.
+     */
+    std::size_t vertex_num() const;
+
+    /**
+     * \brief Add the tree edge (u, v), joining the trees of u and v.
+     *
+     * \note Both trees are rerooted, at u and v.
+     *
+     * \param[in] u One vertex of the edge.
+     * \param[in] v Other vertex of the edge.
+     * \return True if the edge was added. False if u or v is not valid, or if u and v are already connected.
+     */
+    bool link(int u, int v);
+
+    /**
+     * \brief Delete the tree edge (u, v), splitting its tree in two.
+     *
+     * \param[in] u One vertex of the edge.
+     * \param[in] v Other vertex of the edge.
+     * \return True if the edge was deleted. False if there is no tree edge (u, v).
+     */
+    bool cut(int u, int v);
+
+    /**
+     * \brief Whether u and v are in the same tree.
+     *
+     * \param[in] u First vertex.
+     * \param[in] v Second vertex.
+     * \return True if u and v are connected. False otherwise, or if u or v is not valid.
+     */
+    bool connected(int u, int v) const;
+
+    /**
+     * \brief Current root of the tree of v: the vertex its Euler tour starts from.
+     *
+     * \param[in] v Vertex of the tree.
+     * \return Root vertex, the same for all the vertices of a tree until the next `link`, `cut`, `reroot` or subtree
+     * query. -1 if v is not valid.
+     */
+    int root(int v) const;
+
+    /**
+     * \brief Make v the root of its tree.
+     *
+     * \param[in] v New root.
+     * \return True if v is valid. False otherwise.
+     */
+    bool reroot(int v);
+
+    /**
+     * \brief Number of vertices of the tree of v.
+     *
+     * \param[in] v Vertex of the tree.
+     * \return Number of vertices. 0 if v is not valid.
+     */
+    std::size_t tree_size(int v) const;
+
+    /**
+     * \brief Value of vertex v.
+     *
+     * \param[in] v Vertex.
+     * \return Value of v. NaN (Not-A-Number) if v is not valid.
+     */
+    std::optional<VType> value(int v) const;
+
+    /**
+     * \brief Minimum value over the subtree of v away from its neighbour p: the vertices that stay connected to v when
+     * the edge (v, p) is cut. The whole tree of v if p is -1.
+     *
+     * \note The tree is rerooted at p.
+     *
+     * \param[in] v Root of the subtree.
+     * \param[in] p Neighbour of v outside the subtree, or -1.
+     * \param[out] min_vertex Vertex of the subtree with the minimum value.
+     * \return Minimum value. NaN (Not-A-Number) if v is not valid, or if there is no tree edge (v, p).
+     */
+    std::optional<VType> subtree_min(int v, int p, int& min_vertex);
+
+    /**
+     * \brief Add a constant x to the value of every vertex of the subtree of v away from its neighbour p, as in
+     * `subtree_min`.
+     *
+     * \param[in] v Root of the subtree.
+     * \param[in] p Neighbour of v outside the subtree, or -1 for the whole tree of v.
+     * \param[in] x Constant (no restriction in sign) to be added to every value of the subtree.
+     * \return True if the values were updated. False if v is not valid, or if there is no tree edge (v, p).
+     */
+    bool subtree_add(int v, int p, VType x);
+
+    /**
+     * \brief Euler tour of the tree of v, as the vertex each token ends at.
+     *
+     * \param[in] v Vertex of the tree.
+     * \param[out] tour Vertex of every token from the root: v for the tokens v and v' and the arc (u -> v).
+     */
+    void euler_tour(int v, std::vector<int>& tour) const;
+
+  private:
+    bool valid_(int v) const;
+    // Path root of the tree of v, rotated to start at v.
+    TreeNode<VType>* reroot_(int v);
+    // Arc token (u -> v), nullptr if there is no tree edge (u, v).
+    TreeNode<VType>* arc_(int u, int v) const;
+    static uint64_t arc_key_(int u, int v);
+    // Split the tour of the subtree of v away from p out of its tree, rerooted at p: [A, S, C], with the costs x and
+    // y of the edges between them. S is the whole tree and A and C are nullptr if p is -1.
+    bool split_subtree_(int v, int p, TreeNode<VType>*& A, TreeNode<VType>*& S, TreeNode<VType>*& C, VType& x, VType& y);
+    void join_subtree_(TreeNode<VType>* A, TreeNode<VType>* S, TreeNode<VType>* C, VType x, VType y);
+
+    dynamic_path_ops<VType> m_ops;
+    // Tokens v and v' of every vertex v, at 2 v and 2 v + 1.
+    std::vector<TreeNode<VType>*> m_tokens;
+    std::unordered_map<uint64_t, TreeNode<VType>*> m_arcs;
+};
@@ -0,0 +1,1033 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in leafless_path.h
+*/
+
+#include "leafless_path.h"
+
+#include "block_kernels.h"
+
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+
+template <typename VType>
+static bool close_to_zero(VType x) {
+    return fabs(x) < 1e-6;
+}
+
+#pragma mark Public functions
+
+template <typename VType>
+leafless_path<VType>::leafless_path(uint32_t num_vertices) : m_vertex_parent(num_vertices, null_ref) {
+    assert(num_vertices < vertex_tag);
+    // A path of n vertices has n - 1 edges.
+    m_nodes.reserve(num_vertices);
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::add_vertex() {
+    assert(m_vertex_parent.size() < vertex_tag - 1);
+    m_vertex_parent.push_back(null_ref);
+    if (m_flat_threshold > 0 || !m_vertex_slot.empty()) {
+        m_vertex_slot.push_back(0);
+    }
+    return static_cast<uint32_t>(m_vertex_parent.size() - 1);
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::num_vertices() const {
+    return static_cast<uint32_t>(m_vertex_parent.size());
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::path(uint32_t v) const {
+    if (v >= m_vertex_parent.size()) {
+        return null_ref;
+    }
+
+    ref r = vertex_ref(v);
+    ref parent = m_vertex_parent[v];
+    if (is_flat(parent)) {
+        return parent;
+    }
+    while (parent != null_ref) {
+        r = parent;
+        parent = m_nodes[r].parent;
+    }
+
+    return r;
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::head(ref p) const {
+    if (p == null_ref) {
+        return null_vertex;
+    } else if (is_flat(p)) {
+        return flat_vertices_(m_flats[p - flat_tag])[0];
+    }
+
+    // Must be a root node.
+    assert(parent_(p) == null_ref);
+
+    return subtree_head_(p);
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::tail(ref p) const {
+    if (p == null_ref) {
+        return null_vertex;
+    } else if (is_flat(p)) {
+        const flat& f = m_flats[p - flat_tag];
+        return flat_vertices_(f)[f.count];
+    }
+
+    // Must be a root node.
+    assert(parent_(p) == null_ref);
+
+    return subtree_tail_(p);
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::before(uint32_t v) const {
+    if (v >= m_vertex_parent.size()) {
+        return null_vertex;
+    }
+
+    ref w = vertex_ref(v);
+    ref w_parent = m_vertex_parent[v];
+    if (is_flat(w_parent)) {
+        int slot = m_vertex_slot[v];
+        return slot == 0 ? null_vertex : flat_vertices_(m_flats[w_parent - flat_tag])[slot - 1];
+    }
+    while (w_parent != null_ref) {
+        const node& parent = m_nodes[w_parent];
+        if (w == parent.right) {
+            return subtree_tail_(parent.left);
+        }
+        w = w_parent;
+        w_parent = parent.parent;
+    }
+
+    return null_vertex;
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::after(uint32_t v) const {
+    if (v >= m_vertex_parent.size()) {
+        return null_vertex;
+    }
+
+    ref w = vertex_ref(v);
+    ref w_parent = m_vertex_parent[v];
+    if (is_flat(w_parent)) {
+        const flat& f = m_flats[w_parent - flat_tag];
+        int slot = m_vertex_slot[v];
+        return slot == f.count ? null_vertex : flat_vertices_(f)[slot + 1];
+    }
+    while (w_parent != null_ref) {
+        const node& parent = m_nodes[w_parent];
+        if (w == parent.left) {
+            return subtree_head_(parent.right);
+        }
+        w = w_parent;
+        w_parent = parent.parent;
+    }
+
+    return null_vertex;
+}
+
+template <typename VType>
+VType leafless_path<VType>::pcost_before(uint32_t v) const {
+    if (v >= m_vertex_parent.size()) {
+        return static_cast<VType>(NAN);
+    }
+
+    // Find the deepest ancestor reached from its right child: it holds the edge (before(v), v).
+    ref w = vertex_ref(v);
+    ref edge = m_vertex_parent[v];
+    if (is_flat(edge)) {
+        const flat& f = m_flats[edge - flat_tag];
+        int slot = m_vertex_slot[v];
+        return slot == 0 ? static_cast<VType>(NAN) : flat_costs_(f)[slot - 1] + f.add;
+    }
+    while (edge != null_ref && m_nodes[edge].right != w) {
+        w = edge;
+        edge = m_nodes[edge].parent;
+    }
+    if (edge == null_ref) {
+        // v is the head of path(v).
+        return static_cast<VType>(NAN);
+    }
+
+    // Accumulate its grossmin up to the root.
+    VType cost = m_nodes[edge].netcost;
+    for (ref u = edge; u != null_ref; u = m_nodes[u].parent) {
+        cost += m_nodes[u].netmin;
+    }
+    return cost;
+}
+
+template <typename VType>
+VType leafless_path<VType>::pcost_after(uint32_t v) const {
+    if (v >= m_vertex_parent.size()) {
+        return static_cast<VType>(NAN);
+    }
+
+    // Find the deepest ancestor reached from its left child: it holds the edge (v, after(v)).
+    ref w = vertex_ref(v);
+    ref edge = m_vertex_parent[v];
+    if (is_flat(edge)) {
+        const flat& f = m_flats[edge - flat_tag];
+        int slot = m_vertex_slot[v];
+        return slot == f.count ? static_cast<VType>(NAN) : flat_costs_(f)[slot] + f.add;
+    }
+    while (edge != null_ref && m_nodes[edge].left != w) {
+        w = edge;
+        edge = m_nodes[edge].parent;
+    }
+    if (edge == null_ref) {
+        // v is the tail of path(v).
+        return static_cast<VType>(NAN);
+    }
+
+    VType cost = m_nodes[edge].netcost;
+    for (ref u = edge; u != null_ref; u = m_nodes[u].parent) {
+        cost += m_nodes[u].netmin;
+    }
+    return cost;
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::pmincost_before(ref p) const {
+    if (p == null_ref || is_vertex(p)) return null_vertex;
+
+    if (is_flat(p)) {
+        // First cost within the tie tolerance of the minimum, as the descent below.
+        const flat& f = m_flats[p - flat_tag];
+        const VType* costs = flat_costs_(f);
+        VType min = block_min(costs, f.count);
+        return flat_vertices_(f)[block_find_first_le(costs, f.count, min + block_tie_tolerance<VType>()) + 1];
+    }
+
+    // Must be a root node.
+    assert(parent_(p) == null_ref);
+
+    // Same descent as dynamic_path_ops::pmincost_before.
+    const node* u = &m_nodes[p];
+    while (!(close_to_zero(u->netcost) && (is_vertex(u->left) || m_nodes[u->left].netmin > 0))) {
+        if (!is_vertex(u->left) && close_to_zero(m_nodes[u->left].netmin)) {
+            u = &m_nodes[u->left];
+        } else { // u->netcost > 0
+            assert(u->netcost > 0);
+            u = &m_nodes[u->right];
+        }
+    }
+
+    return subtree_head_(u->right);
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::pmincost_after(ref p) const {
+    if (p == null_ref || is_vertex(p)) return null_vertex;
+
+    if (is_flat(p)) {
+        const flat& f = m_flats[p - flat_tag];
+        const VType* costs = flat_costs_(f);
+        VType min = block_min(costs, f.count);
+        return flat_vertices_(f)[block_find_last_le(costs, f.count, min + block_tie_tolerance<VType>())];
+    }
+
+    // Must be a root node.
+    assert(parent_(p) == null_ref);
+
+    // Same descent as dynamic_path_ops::pmincost_after.
+    const node* u = &m_nodes[p];
+    while (!(close_to_zero(u->netcost) && (is_vertex(u->right) || m_nodes[u->right].netmin > 0))) {
+        if (!is_vertex(u->right) && close_to_zero(m_nodes[u->right].netmin)) {
+            u = &m_nodes[u->right];
+        } else { // u->netcost > 0
+            assert(u->netcost > 0);
+            u = &m_nodes[u->left];
+        }
+    }
+
+    return subtree_tail_(u->left);
+}
+
+template <typename VType>
+void leafless_path<VType>::pupdate(ref p, VType x) {
+    if (p == null_ref) {
+        return;
+    } else if (is_flat(p)) {
+        m_flats[p - flat_tag].add += x;
+        return;
+    }
+
+    // Must be a root node.
+    assert(parent_(p) == null_ref);
+    // Must not be a singleton vertex.
+    assert(!is_vertex(p));
+
+    m_nodes[p].netmin += x;
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::concatenate(ref p, ref q, VType x, bool reBalance) {
+    if (p == null_ref) {
+        return q;
+    } else if (q == null_ref) {
+        return p;
+    }
+
+    // Flat paths and vertices short enough together make a flat path. Trees stay trees.
+    bool p_tree = !is_vertex(p) && !is_flat(p);
+    bool q_tree = !is_vertex(q) && !is_flat(q);
+    if (!p_tree && !q_tree) {
+        int p_edges = edge_count_(p, flat_max_edges);
+        int q_edges = edge_count_(q, flat_max_edges);
+        if (p_edges + q_edges + 1 <= m_flat_threshold) {
+            if (is_flat(p) && (2 << m_flats[p - flat_tag].level) >= p_edges + q_edges + 1) {
+                // Room left in the flat path p: only the vertices of q move.
+                flat& f = m_flats[p - flat_tag];
+                VType* costs = flat_costs_(f);
+                uint32_t* vertices = flat_vertices_(f);
+                costs[p_edges] = x - f.add;
+                if (is_vertex(q)) {
+                    vertices[p_edges + 1] = vertex_id(q);
+                } else {
+                    const flat& g = m_flats[q - flat_tag];
+                    for (int i = 0; i < q_edges; ++i) {
+                        costs[p_edges + 1 + i] = flat_costs_(g)[i] + g.add - f.add;
+                    }
+                    std::copy(flat_vertices_(g), flat_vertices_(g) + q_edges + 1, vertices + p_edges + 1);
+                    free_flat_(q);
+                }
+                for (int i = p_edges + 1; i <= p_edges + q_edges + 1; ++i) {
+                    m_vertex_parent[vertices[i]] = p;
+                    m_vertex_slot[vertices[i]] = static_cast<uint8_t>(i);
+                }
+                f.count = static_cast<uint8_t>(p_edges + q_edges + 1);
+                m_live_nodes += q_edges + 1;
+                return p;
+            }
+
+            uint32_t vertices[flat_max_edges + 1];
+            VType costs[flat_max_edges];
+            int n = 0;
+            for (ref r : {p, q}) {
+                if (n > 0) {
+                    costs[n - 1] = x;
+                }
+                if (is_vertex(r)) {
+                    vertices[n++] = vertex_id(r);
+                    continue;
+                }
+                const flat& f = m_flats[r - flat_tag];
+                std::copy(flat_vertices_(f), flat_vertices_(f) + f.count + 1, vertices + n);
+                for (int i = 0; i < f.count; ++i) {
+                    costs[n + i] = flat_costs_(f)[i] + f.add;
+                }
+                n += f.count + 1;
+                free_flat_(r);
+            }
+            return make_flat_(vertices, costs, n - 1);
+        }
+    }
+
+    return join_(promote_(p), promote_(q), x, reBalance);
+}
+
+template <typename VType>
+void leafless_path<VType>::split_before(uint32_t v, ref& p, ref& q, VType& x) {
+    split_(v, true, p, q, x);
+}
+
+template <typename VType>
+void leafless_path<VType>::split_after(uint32_t v, ref& p, ref& q, VType& y) {
+    split_(v, false, p, q, y);
+}
+
+template <typename VType>
+void leafless_path<VType>::vectorize(ref p, std::vector<VType>& vector_path) const {
+    if (p == null_ref) {
+        return;
+    }
+
+    vector_path.clear();
+    if (is_flat(p)) {
+        const flat& f = m_flats[p - flat_tag];
+        for (int i = 0; i < f.count; ++i) {
+            vector_path.push_back(flat_costs_(f)[i] + f.add);
+        }
+        return;
+    }
+
+    // Iterative inorder traversal carrying the grossmin of the parent.
+    std::vector<std::pair<ref, VType>> stack;
+    ref u = p;
+    VType basemin = 0;
+    while (!stack.empty() || !is_vertex(u)) {
+        if (!is_vertex(u)) {
+            stack.emplace_back(u, basemin);
+            basemin += m_nodes[u].netmin;
+            u = m_nodes[u].left;
+        } else {
+            ref top = stack.back().first;
+            VType grossmin = stack.back().second + m_nodes[top].netmin;
+            stack.pop_back();
+            vector_path.push_back(m_nodes[top].netcost + grossmin);
+            u = m_nodes[top].right;
+            basemin = grossmin;
+        }
+    }
+}
+
+template <typename VType>
+void leafless_path<VType>::vectorizeVertex(ref p, std::vector<uint32_t>& vector_vertices) const {
+    if (p == null_ref) {
+        return;
+    }
+
+    vector_vertices.clear();
+    if (is_flat(p)) {
+        const flat& f = m_flats[p - flat_tag];
+        vector_vertices.assign(flat_vertices_(f), flat_vertices_(f) + f.count + 1);
+        return;
+    }
+
+    std::vector<ref> stack;
+    ref u = p;
+    while (true) {
+        if (!is_vertex(u)) {
+            stack.push_back(u);
+            u = m_nodes[u].left;
+            continue;
+        }
+        vector_vertices.push_back(vertex_id(u));
+        if (stack.empty()) {
+            break;
+        }
+        u = m_nodes[stack.back()].right;
+        stack.pop_back();
+    }
+}
+
+template <typename VType>
+void leafless_path<VType>::set_flat_threshold(int edges) {
+    m_flat_threshold = std::max(0, std::min(edges, flat_max_edges));
+    if (m_flat_threshold > 0) {
+        m_vertex_slot.resize(m_vertex_parent.size());
+        // Short paths need no node: release the pool reserved by the constructor for a forest of trees.
+        if (m_nodes.empty()) {
+            m_nodes.shrink_to_fit();
+        }
+    }
+}
+
+template <typename VType>
+int leafless_path<VType>::flat_threshold() const {
+    return m_flat_threshold;
+}
+
+template <typename VType>
+std::size_t leafless_path<VType>::live_nodes() const {
+    return m_live_nodes;
+}
+
+template <typename VType>
+std::size_t leafless_path<VType>::memory_bytes() const {
+    std::size_t bytes = m_nodes.capacity() * sizeof(node) + m_vertex_parent.capacity() * sizeof(ref) +
+                        m_flats.capacity() * sizeof(flat) + m_vertex_slot.capacity();
+    for (const flat_arena& arena : m_flat_arenas) {
+        bytes += arena.cost.capacity() * sizeof(VType) + arena.vertex.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+#pragma mark Private functions
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::parent_(ref r) const {
+    return is_vertex(r) ? m_vertex_parent[vertex_id(r)] : m_nodes[r].parent;
+}
+
+template <typename VType>
+void leafless_path<VType>::set_parent_(ref r, ref parent) {
+    if (is_vertex(r)) {
+        m_vertex_parent[vertex_id(r)] = parent;
+    } else {
+        m_nodes[r].parent = parent;
+    }
+}
+
+template <typename VType>
+int leafless_path<VType>::height_(ref r) const {
+    return is_vertex(r) ? 1 : m_nodes[r].height;
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::subtree_head_(ref r) const {
+    return is_vertex(r) ? vertex_id(r) : m_nodes[r].head;
+}
+
+template <typename VType>
+uint32_t leafless_path<VType>::subtree_tail_(ref r) const {
+    return is_vertex(r) ? vertex_id(r) : m_nodes[r].tail;
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::alloc_() {
+    ++m_live_nodes;
+    if (m_free_list != null_ref) {
+        ref r = m_free_list;
+        m_free_list = m_nodes[r].parent;
+        return r;
+    }
+
+    assert(m_nodes.size() < flat_tag);
+    m_nodes.emplace_back();
+    return static_cast<ref>(m_nodes.size() - 1);
+}
+
+template <typename VType>
+void leafless_path<VType>::free_(ref r) {
+    --m_live_nodes;
+    m_nodes[r].parent = m_free_list;
+    m_free_list = r;
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::construct_(ref v, ref w, VType x) {
+    if (v == null_ref || w == null_ref) return null_ref;
+
+    ref root_ref = alloc_();
+    node& root = m_nodes[root_ref];
+
+    // Compute grossmin
+    VType gross_min = x;
+    if (!is_vertex(v) && m_nodes[v].netmin < gross_min) {
+        gross_min = m_nodes[v].netmin;
+    }
+    if (!is_vertex(w) && m_nodes[w].netmin < gross_min) {
+        gross_min = m_nodes[w].netmin;
+    }
+
+    root.parent = null_ref;
+    root.netcost = x - gross_min;
+    root.netmin = gross_min;
+    root.left = v;
+    root.right = w;
+    root.head = subtree_head_(v);
+    root.tail = subtree_tail_(w);
+    root.height = std::max(height_(v), height_(w)) + 1;
+
+    // Update fields of v and w
+    set_parent_(v, root_ref);
+    if (!is_vertex(v)) {
+        m_nodes[v].netmin -= gross_min;
+    }
+    set_parent_(w, root_ref);
+    if (!is_vertex(w)) {
+        m_nodes[w].netmin -= gross_min;
+    }
+
+    return root_ref;
+}
+
+template <typename VType>
+void leafless_path<VType>::destroy_(ref root_ref, ref& v, ref& w, VType& x) {
+    if (root_ref == null_ref || is_vertex(root_ref)) return;
+
+    const node& root = m_nodes[root_ref];
+    v = root.left;
+    w = root.right;
+    x = root.netcost + root.netmin;
+
+    // Update netmin to grossmin for the new root nodes.
+    set_parent_(v, null_ref);
+    if (!is_vertex(v)) {
+        m_nodes[v].netmin += root.netmin;
+    }
+    set_parent_(w, null_ref);
+    if (!is_vertex(w)) {
+        m_nodes[w].netmin += root.netmin;
+    }
+
+    free_(root_ref);
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::rotateleft_(ref root_ref) {
+    if (root_ref == null_ref || is_vertex(root_ref)) return null_ref;
+
+    node& root = m_nodes[root_ref];
+    // Make sure the root has an internal right child
+    if (is_vertex(root.right)) {
+        return null_ref;
+    }
+
+    ref new_root_ref = root.right;
+    node& new_root = m_nodes[new_root_ref];
+
+    // Change the shape
+    root.right = new_root.left;
+    new_root.left = root_ref;
+    ref p = root.left;
+    ref q = root.right;
+    ref r = new_root.right;
+
+    root.parent = new_root_ref;
+    new_root.parent = null_ref;
+    set_parent_(q, root_ref);
+
+    // Old grosscost and grossmin, see dynamic_path_ops::rotateleft_.
+    VType root_grossmin = root.netmin;
+    VType root_grosscost = root.netcost + root_grossmin;
+    VType new_root_grossmin = root_grossmin + new_root.netmin;
+    VType new_root_grosscost = new_root.netcost + new_root_grossmin;
+    // New grosscost and grossmin
+    VType root_grossmin_new = root_grosscost;
+    if (!is_vertex(p)) {
+        root_grossmin_new = std::min(root_grossmin_new, root_grossmin + m_nodes[p].netmin);
+    }
+    if (!is_vertex(q)) {
+        root_grossmin_new = std::min(root_grossmin_new, new_root_grossmin + m_nodes[q].netmin);
+    }
+    VType new_root_grossmin_new = std::min(new_root_grossmin, root_grossmin_new);
+
+    if (!is_vertex(p)) {
+        m_nodes[p].netmin = root_grossmin + m_nodes[p].netmin - root_grossmin_new;
+    }
+    if (!is_vertex(q)) {
+        m_nodes[q].netmin = new_root_grossmin + m_nodes[q].netmin - root_grossmin_new;
+    }
+    if (!is_vertex(r)) {
+        m_nodes[r].netmin = new_root_grossmin + m_nodes[r].netmin - new_root_grossmin_new;
+    }
+
+    new_root.netmin = new_root_grossmin_new;
+    new_root.netcost = new_root_grosscost - new_root_grossmin_new;
+    root.netmin = root_grossmin_new - new_root_grossmin_new;
+    root.netcost = root_grosscost - root_grossmin_new;
+
+    // Head and tail
+    root.tail = subtree_tail_(q);
+    new_root.head = subtree_head_(p);
+
+    // Update the height
+    root.height = std::max(height_(p), height_(q)) + 1;
+    new_root.height = std::max(root.height, height_(r)) + 1;
+
+    return new_root_ref;
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::rotateright_(ref root_ref) {
+    if (root_ref == null_ref || is_vertex(root_ref)) return null_ref;
+
+    node& root = m_nodes[root_ref];
+    // Make sure the root has an internal left child
+    if (is_vertex(root.left)) {
+        return null_ref;
+    }
+
+    ref new_root_ref = root.left;
+    node& new_root = m_nodes[new_root_ref];
+
+    // Change the shape
+    root.left = new_root.right;
+    new_root.right = root_ref;
+    ref p = new_root.left;
+    ref q = root.left;
+    ref r = root.right;
+
+    root.parent = new_root_ref;
+    new_root.parent = null_ref;
+    set_parent_(q, root_ref);
+
+    // Old grosscost and grossmin, see dynamic_path_ops::rotateright_.
+    VType root_grossmin = root.netmin;
+    VType root_grosscost = root.netcost + root_grossmin;
+    VType new_root_grossmin = root_grossmin + new_root.netmin;
+    VType new_root_grosscost = new_root.netcost + new_root_grossmin;
+    // New grosscost and grossmin
+    VType root_grossmin_new = root_grosscost;
+    if (!is_vertex(q)) {
+        root_grossmin_new = std::min(root_grossmin_new, new_root_grossmin + m_nodes[q].netmin);
+    }
+    if (!is_vertex(r)) {
+        root_grossmin_new = std::min(root_grossmin_new, root_grossmin + m_nodes[r].netmin);
+    }
+    VType new_root_grossmin_new = std::min(new_root_grossmin, root_grossmin_new);
+
+    if (!is_vertex(p)) {
+        m_nodes[p].netmin = new_root_grossmin + m_nodes[p].netmin - new_root_grossmin_new;
+    }
+    if (!is_vertex(q)) {
+        m_nodes[q].netmin = new_root_grossmin + m_nodes[q].netmin - root_grossmin_new;
+    }
+    if (!is_vertex(r)) {
+        m_nodes[r].netmin = root_grossmin + m_nodes[r].netmin - root_grossmin_new;
+    }
+
+    new_root.netmin = new_root_grossmin_new;
+    new_root.netcost = new_root_grosscost - new_root_grossmin_new;
+    root.netmin = root_grossmin_new - new_root_grossmin_new;
+    root.netcost = root_grosscost - root_grossmin_new;
+
+    // Head and tail
+    root.head = subtree_head_(q);
+    new_root.tail = subtree_tail_(r);
+
+    // Update the height
+    root.height = std::max(height_(q), height_(r)) + 1;
+    new_root.height = std::max(height_(p), root.height) + 1;
+
+    return new_root_ref;
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::top_down_balance_(ref root) {
+    if (root == null_ref || is_vertex(root)) {
+        return root;
+    }
+
+    ref p = m_nodes[root].left;
+    ref q = m_nodes[root].right;
+
+    // Exit rule
+    if (abs(height_(p) - height_(q)) <= 1) {
+        return root;
+    }
+
+    // Recursively balance both subtrees, each temporarily carrying its grossmin.
+    if (!is_vertex(p)) {
+        m_nodes[p].netmin += m_nodes[root].netmin;
+        p = top_down_balance_(p);
+        m_nodes[p].parent = root;
+        m_nodes[root].left = p;
+        m_nodes[p].netmin -= m_nodes[root].netmin;
+    }
+    if (!is_vertex(q)) {
+        m_nodes[q].netmin += m_nodes[root].netmin;
+        q = top_down_balance_(q);
+        m_nodes[q].parent = root;
+        m_nodes[root].right = q;
+        m_nodes[q].netmin -= m_nodes[root].netmin;
+    }
+
+    // Balance the top level.
+    if (height_(p) >= height_(q) + 2) {  // Right rotation is required.
+        // Make sure the right sub-tree of p has a smaller height
+        if (height_(m_nodes[p].left) < height_(m_nodes[p].right)) {
+            m_nodes[p].netmin += m_nodes[root].netmin;
+            p = rotateleft_(p);
+            m_nodes[p].parent = root;
+            m_nodes[root].left = p;
+            m_nodes[p].netmin -= m_nodes[root].netmin;
+        }
+
+        return rotateright_(root);
+    }
+
+    if (height_(q) >= height_(p) + 2) {  // Left rotation is required.
+        // Make sure the left sub-tree of q has a smaller height
+        if (height_(m_nodes[q].right) < height_(m_nodes[q].left)) {
+            m_nodes[q].netmin += m_nodes[root].netmin;
+            q = rotateright_(q);
+            m_nodes[q].parent = root;
+            m_nodes[root].right = q;
+            m_nodes[q].netmin -= m_nodes[root].netmin;
+        }
+
+        return rotateleft_(root);
+    }
+
+    return root;
+}
+
+template <typename VType>
+void leafless_path<VType>::split_(uint32_t v, bool edge_on_right, ref& p, ref& q, VType& x) {
+    if (v >= m_vertex_parent.size()) {
+        return;
+    }
+
+    ref root = m_vertex_parent[v];
+    if (is_flat(root)) {
+        // Both parts of a flat path are flat paths (or vertices).
+        const flat& f = m_flats[root - flat_tag];
+        int edge = edge_on_right ? m_vertex_slot[v] - 1 : m_vertex_slot[v];
+        if (edge < 0 || edge == f.count) {
+            p = edge_on_right ? null_ref : root;
+            q = edge_on_right ? root : null_ref;
+            x = static_cast<VType>(NAN);
+            return;
+        }
+        // The head part stays in place, but for a single vertex.
+        uint32_t vertices[flat_max_edges + 1];
+        VType costs[flat_max_edges];
+        int count = f.count;
+        std::copy(flat_vertices_(f), flat_vertices_(f) + count + 1, vertices);
+        for (int i = 0; i < count; ++i) {
+            costs[i] = flat_costs_(f)[i] + f.add;
+        }
+        x = costs[edge];
+        if (edge == 0) {
+            free_flat_(root);
+            p = make_flat_(vertices, costs, 0);
+        } else {
+            m_flats[root - flat_tag].count = static_cast<uint8_t>(edge);
+            m_live_nodes -= count - edge;
+            p = root;
+        }
+        q = make_flat_(vertices + edge + 1, costs + edge + 1, count - edge - 1);
+        return;
+    }
+
+    // Back up the ancestors of v, and find the deepest one holding the deleted edge.
+    std::vector<ref> backup_nodes;
+    backup_nodes.push_back(vertex_ref(v));
+    std::size_t edge_index = 0;
+    for (ref u = m_vertex_parent[v]; u != null_ref; u = m_nodes[u].parent) {
+        const node& parent = m_nodes[u];
+        if (edge_index == 0 && (edge_on_right ? parent.right : parent.left) == backup_nodes.back()) {
+            edge_index = backup_nodes.size();
+        }
+        backup_nodes.push_back(u);
+    }
+
+    if (edge_index == 0) {
+        // v is the head (resp. tail) of path(v).
+        p = edge_on_right ? null_ref : backup_nodes.back();
+        q = edge_on_right ? backup_nodes.back() : null_ref;
+        x = static_cast<VType>(NAN);
+        return;
+    }
+
+    std::vector<ref> p_list;
+    std::vector<VType> p_cost_list;
+    std::vector<ref> q_list;
+    std::vector<VType> q_cost_list;
+
+    ref temp_v;
+    ref temp_w;
+    VType temp_x;
+    // From root to the parent of the edge
+    for (std::size_t i = backup_nodes.size() - 1; i > edge_index; --i) {
+        bool from_left = m_nodes[backup_nodes[i]].left == backup_nodes[i - 1];
+        destroy_(backup_nodes[i], temp_v, temp_w, temp_x);
+        if (from_left) {
+            q_list.push_back(temp_w);
+            q_cost_list.push_back(temp_x);
+        } else {
+            p_list.push_back(temp_v);
+            p_cost_list.push_back(temp_x);
+        }
+    }
+
+    destroy_(backup_nodes[edge_index], temp_v, temp_w, temp_x);
+    x = temp_x;
+    p_list.push_back(temp_v);
+    q_list.push_back(temp_w);
+
+    // Generate p
+    p = p_list[0];
+    for (std::size_t i = 1; i < p_list.size(); ++i) {
+        p = join_(p, p_list[i], p_cost_list[i - 1], true);
+    }
+
+    // Generate q
+    q = q_list.back();
+    for (std::size_t i = q_list.size() - 1; i-- > 0;) {
+        q = join_(q, q_list[i], q_cost_list[i], true);
+    }
+
+    if (m_flat_threshold > 0) {
+        p = demote_(p);
+        q = demote_(q);
+    }
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::join_(ref p, ref q, VType x, bool reBalance) {
+    ref root = construct_(p, q, x);
+    if (reBalance) {
+        root = top_down_balance_(root);
+    }
+    return root;
+}
+
+#pragma mark Flat paths
+
+template <typename VType>
+VType* leafless_path<VType>::flat_costs_(const flat& f) {
+    return m_flat_arenas[f.level].cost.data() + (std::size_t(f.slot) << (f.level + 1));
+}
+
+template <typename VType>
+const VType* leafless_path<VType>::flat_costs_(const flat& f) const {
+    return m_flat_arenas[f.level].cost.data() + (std::size_t(f.slot) << (f.level + 1));
+}
+
+template <typename VType>
+uint32_t* leafless_path<VType>::flat_vertices_(const flat& f) {
+    return m_flat_arenas[f.level].vertex.data() + std::size_t(f.slot) * ((2u << f.level) + 1);
+}
+
+template <typename VType>
+const uint32_t* leafless_path<VType>::flat_vertices_(const flat& f) const {
+    return m_flat_arenas[f.level].vertex.data() + std::size_t(f.slot) * ((2u << f.level) + 1);
+}
+
+template <typename VType>
+int leafless_path<VType>::edge_count_(ref p, int limit) const {
+    if (is_vertex(p)) {
+        return 0;
+    } else if (is_flat(p)) {
+        return m_flats[p - flat_tag].count;
+    } else if (height_(p) - 1 > limit) {
+        // At least one edge per level.
+        return limit + 1;
+    }
+
+    int count = 0;
+    std::vector<ref> stack(1, p);
+    while (!stack.empty() && count <= limit) {
+        const node& u = m_nodes[stack.back()];
+        stack.pop_back();
+        ++count;
+        for (ref child : {u.left, u.right}) {
+            if (!is_vertex(child)) {
+                stack.push_back(child);
+            }
+        }
+    }
+    return count;
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::make_flat_(const uint32_t* vertices, const VType* costs, int edges) {
+    assert(edges <= flat_max_edges);
+    if (edges == 0) {
+        m_vertex_parent[vertices[0]] = null_ref;
+        return vertex_ref(vertices[0]);
+    }
+
+    ref r;
+    if (m_flat_free_list != null_ref) {
+        r = m_flat_free_list;
+        m_flat_free_list = m_flats[r].slot;
+    } else {
+        assert(m_flats.size() < flat_tag);
+        r = static_cast<ref>(m_flats.size());
+        m_flats.emplace_back();
+    }
+    flat& f = m_flats[r];
+    f.level = 0;
+    while ((2 << f.level) < edges) {
+        ++f.level;
+    }
+    f.count = static_cast<uint8_t>(edges);
+    f.add = 0;
+    flat_arena& arena = m_flat_arenas[f.level];
+    std::size_t capacity = std::size_t(2) << f.level;
+    if (arena.free_list != UINT32_MAX) {
+        f.slot = arena.free_list;
+        arena.free_list = arena.vertex[f.slot * (capacity + 1)];
+    } else {
+        f.slot = static_cast<uint32_t>(arena.cost.size() / capacity);
+        arena.cost.resize(arena.cost.size() + capacity);
+        arena.vertex.resize(arena.vertex.size() + capacity + 1);
+    }
+
+    std::copy(costs, costs + edges, flat_costs_(f));
+    std::copy(vertices, vertices + edges + 1, flat_vertices_(f));
+    for (int i = 0; i <= edges; ++i) {
+        m_vertex_parent[vertices[i]] = r + flat_tag;
+        m_vertex_slot[vertices[i]] = static_cast<uint8_t>(i);
+    }
+    m_live_nodes += edges;
+    return r + flat_tag;
+}
+
+template <typename VType>
+void leafless_path<VType>::free_flat_(ref p) {
+    ref r = p - flat_tag;
+    flat& f = m_flats[r];
+    flat_arena& arena = m_flat_arenas[f.level];
+    arena.vertex[f.slot * ((std::size_t(2) << f.level) + 1)] = arena.free_list;
+    arena.free_list = f.slot;
+    m_live_nodes -= f.count;
+    f.slot = m_flat_free_list;
+    m_flat_free_list = r;
+}
+
+template <typename VType>
+void leafless_path<VType>::free_tree_(ref p) {
+    std::vector<ref> stack(1, p);
+    while (!stack.empty()) {
+        ref u = stack.back();
+        stack.pop_back();
+        for (ref child : {m_nodes[u].left, m_nodes[u].right}) {
+            if (!is_vertex(child)) {
+                stack.push_back(child);
+            }
+        }
+        free_(u);
+    }
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::promote_(ref p) {
+    if (!is_flat(p)) {
+        return p;
+    }
+
+    const flat& f = m_flats[p - flat_tag];
+    uint32_t vertices[flat_max_edges + 1];
+    VType costs[flat_max_edges];
+    int count = f.count;
+    std::copy(flat_vertices_(f), flat_vertices_(f) + count + 1, vertices);
+    for (int i = 0; i < count; ++i) {
+        costs[i] = flat_costs_(f)[i] + f.add;
+    }
+    free_flat_(p);
+
+    // Balanced by halving the vertices.
+    std::function<ref(int, int)> build = [&](int l, int r) {
+        if (l == r) {
+            return vertex_ref(vertices[l]);
+        }
+        int m = (l + r) / 2;
+        ref left = build(l, m);
+        ref right = build(m + 1, r);
+        return construct_(left, right, costs[m]);
+    };
+    return build(0, count);
+}
+
+template <typename VType>
+typename leafless_path<VType>::ref leafless_path<VType>::demote_(ref p) {
+    if (p == null_ref || is_vertex(p) || is_flat(p) || edge_count_(p, m_flat_threshold) > m_flat_threshold) {
+        return p;
+    }
+
+    std::vector<uint32_t> vertices;
+    std::vector<VType> costs;
+    vectorizeVertex(p, vertices);
+    vectorize(p, costs);
+    free_tree_(p);
+    return make_flat_(vertices.data(), costs.data(), static_cast<int>(costs.size()));
+}
+
+#pragma mark Instantiations
+
+template class leafless_path<double>;
+template class leafless_path<float>;
+template class leafless_path<uint32_t>;
+template class leafless_path<int>;
@@ -0,0 +1,300 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the leaf-less dynamic path representation
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Dynamic paths over vertex ids, without external TreeNodes.
+ *
+ * \note Same balanced binary tree as dynamic_path_ops, but the leaves are not materialized: an internal node
+ * references its children either as another internal node or, with the vertex tag bit set, directly as a vertex id.
+ * The parent of every vertex lives in a flat array indexed by vertex id, and internal nodes are pooled and addressed
+ * by 32-bit indices, so a path of n vertices costs n parent entries plus n - 1 pooled nodes.
+ * Unlike dynamic_path_ops, this class holds the states of all its paths.
+ *
+ * In the hybrid mode (see `set_flat_threshold`), the paths of up to a threshold of edges have no tree: they are
+ * flat arrays of costs and vertex ids with a lazy offset, referenced by a root tagged with `flat_tag`. Minimum
+ * searches are then one linear scan (see block_kernels.h) and `pupdate` one addition. A path is moved to a tree once
+ * a concatenation makes it longer than the threshold, and back to a flat array once a split makes it short enough.
+ */
+template <typename VType>
+class leafless_path {
+  public:
+    // Reference to a tree node: an internal node index, or a vertex id tagged with `vertex_tag`.
+    using ref = uint32_t;
+
+    static constexpr ref null_ref = UINT32_MAX;
+    static constexpr ref vertex_tag = 0x80000000u;
+    // Root reference of a flat path, in the hybrid mode.
+    static constexpr ref flat_tag = 0x40000000u;
+    // Largest flat path, in edges.
+    static constexpr int flat_max_edges = 64;
+    // Returned by the vertex queries when there is no such vertex.
+    static constexpr uint32_t null_vertex = UINT32_MAX;
+
+    static bool is_vertex(ref r) { return r != null_ref && (r & vertex_tag); }
+    static bool is_flat(ref r) { return !(r & vertex_tag) && (r & flat_tag); }
+    static ref vertex_ref(uint32_t v) { return v | vertex_tag; }
+    static uint32_t vertex_id(ref r) { return r & ~vertex_tag; }
+
+    /**
+     * \brief Create `num_vertices` singleton paths, with vertex ids 0, 1, ..., num_vertices - 1.
+     *
+     * \param[in] num_vertices Initial number of vertices. Must be less than 2^31.
+     */
+    explicit leafless_path(uint32_t num_vertices = 0);
+
+    /**
+     * \brief Add a new singleton path.
+     *
+     * \return Vertex id of the new vertex.
+     */
+    uint32_t add_vertex();
+
+    /**
+     * \brief Number of vertices.
+     */
+    uint32_t num_vertices() const;
+
+    /**
+     * \brief Return the root of the path containing vertex v.
+     *
+     * \param[in] v Vertex id.
+     * \return Root reference of `path(v)`; `vertex_ref(v)` if v is a singleton.
+     */
+    ref path(uint32_t v) const;
+
+    /**
+     * \brief Return the head vertex (first path vertex) of a path.
+     *
+     * \param[in] p Root reference of the path.
+     * \return Vertex id of the head of the path. `null_vertex` if p is `null_ref`.
+     */
+    uint32_t head(ref p) const;
+
+    /**
+     * \brief Return the tail vertex (last path vertex) of a path.
+     *
+     * \param[in] p Root reference of the path.
+     * \return Vertex id of the tail of the path. `null_vertex` if p is `null_ref`.
+     */
+    uint32_t tail(ref p) const;
+
+    /**
+     * \brief Return the vertex before v on `path(v)`.
+     *
+     * \param[in] v Vertex id.
+     * \return Vertex id before v. `null_vertex` if v is the head of the path.
+     */
+    uint32_t before(uint32_t v) const;
+
+    /**
+     * \brief Return the vertex after v on `path(v)`.
+     *
+     * \param[in] v Vertex id.
+     * \return Vertex id after v. `null_vertex` if v is the tail of the path.
+     */
+    uint32_t after(uint32_t v) const;
+
+    /**
+     * \brief Return the cost of edge (before(v), v).
+     *
+     * \param[in] v Vertex id.
+     * \return The cost of edge (before(v), v). Returns NaN (Not-A-Number) if v is the head of the path.
+     */
+    VType pcost_before(uint32_t v) const;
+
+    /**
+     * \brief Return the cost of edge (v, after(v)).
+     *
+     * \param[in] v Vertex id.
+     * \return The cost of edge (v, after(v)). Returns NaN (Not-A-Number) if v is the tail of the path.
+     */
+    VType pcost_after(uint32_t v) const;
+
+    /**
+     * \brief Return the vertex v in p such that (before(v), v) is the minimum cost edge closest to head(p).
+     *
+     * \param[in] p Root reference of the path.
+     * \return Vertex id v. `null_vertex` if p is a singleton vertex.
+     */
+    uint32_t pmincost_before(ref p) const;
+
+    /**
+     * \brief Return the vertex v in p such that (v, after(v)) is the minimum cost edge closest to tail(p).
+     *
+     * \param[in] p Root reference of the path.
+     * \return Vertex id v. `null_vertex` if p is a singleton vertex.
+     */
+    uint32_t pmincost_after(ref p) const;
+
+    /**
+     * \brief Add a constant value to every edge of a path.
+     *
+     * \note The path must have at least one edge.
+     *
+     * \param[in] p Root reference of the path.
+     * \param[in] x Constant (no restriction in sign) to be added to every edge of the path.
+     */
+    void pupdate(ref p, VType x);
+
+    /**
+     * \brief Concatenate paths p and q by adding the edge (tail(p), head(q)) of cost x.
+     *
+     * \param[in] p Root reference of path p. It can be a singleton vertex.
+     * \param[in] q Root reference of path q. It can be a singleton vertex.
+     * \param[in] x Cost of edge (tail(p), head(q)).
+     * \return Root reference of the concatenated new path. If q is `null_ref`, returns p; if p is `null_ref`, returns q.
+     */
+    ref concatenate(ref p, ref q, VType x, bool reBalance = true);
+
+    /**
+     * \brief Split `path(v)` into (up to) two parts by deleting the edge (before(v), v).
+     *
+     * \note If v == head(path(v)), p is `null_ref` and x is NaN (Not-A-Number).
+     *
+     * \param[in] v Vertex id pivoted for the split.
+     * \param[out] p Sub-path consisting of all vertices from head(path(v)) to before(v).
+     * \param[out] q Sub-path consisting of all vertices from v to tail(path(v)).
+     * \param[out] x Cost of the deleted edge (before(v), v).
+     */
+    void split_before(uint32_t v, ref& p, ref& q, VType& x);
+
+    /**
+     * \brief Split `path(v)` into (up to) two parts by deleting the edge (v, after(v)).
+     *
+     * \note If v == tail(path(v)), q is `null_ref` and y is NaN (Not-A-Number).
+     *
+     * \param[in] v Vertex id pivoted for the split.
+     * \param[out] p Sub-path consisting of all vertices from head(path(v)) to v.
+     * \param[out] q Sub-path consisting of all vertices from after(v) to tail(path(v)).
+     * \param[out] y Cost of the deleted edge (v, after(v)).
+     */
+    void split_after(uint32_t v, ref& p, ref& q, VType& y);
+
+    /**
+     * \brief Inorder traversal of a (sub-)tree to serialize the respective (sub-)path, and the edge costs are surfaced.
+     *
+     * \param[in] p Root reference of the (sub-)tree.
+     * \param[out] vector_path Serialized (sub-)path edge costs of the (sub-)tree.
+     */
+    void vectorize(ref p, std::vector<VType>& vector_path) const;
+
+    /**
+     * \brief Inorder traversal of a (sub-)tree to serialize the respective (sub-)path, and the vertex ids are surfaced.
+     *
+     * \param[in] p Root reference of the (sub-)tree.
+     * \param[out] vector_vertices Serialized (sub-)path vertex ids of the (sub-)tree.
+     */
+    void vectorizeVertex(ref p, std::vector<uint32_t>& vector_vertices) const;
+
+    /**
+     * \brief Set the hybrid mode: the paths built or split from now on are kept flat as long as they have at most
+     * `edges` edges. 0 (the default) keeps every path in a tree.
+     *
+     * \param[in] edges Threshold, from 0 to `flat_max_edges`.
+     */
+    void set_flat_threshold(int edges);
+
+    /**
+     * \brief Largest number of edges of the flat paths built or split from now on. 0 if the hybrid mode is off.
+     */
+    int flat_threshold() const;
+
+    /**
+     * \brief Number of path edges currently in use: internal nodes and edges of the flat paths.
+     */
+    std::size_t live_nodes() const;
+
+    /**
+     * \brief Bytes reserved by the node pool, the vertex parent array and the flat paths.
+     */
+    std::size_t memory_bytes() const;
+
+  private:
+    struct node {
+        ref parent;  // Internal node index, or `null_ref` for a root.
+        ref left;
+        ref right;
+        uint32_t head;  // Vertex ids of the first and last vertices of the subtree.
+        uint32_t tail;
+        int height;
+        VType netmin;
+        VType netcost;
+    };
+
+    // Flat path of `count` edges, in the slot `slot` of the arenas of capacity class `level`: costs (without the lazy
+    // offset `add`) and vertex ids in path order.
+    struct flat {
+        uint32_t slot;
+        uint8_t level;  // Capacity of 2 << level edges.
+        uint8_t count;
+        VType add;
+    };
+
+    // Arenas of the flat paths of one capacity class, slot after slot.
+    struct flat_arena {
+        std::vector<VType> cost;
+        std::vector<uint32_t> vertex;
+        // Released slots are chained through their first vertex id.
+        uint32_t free_list = UINT32_MAX;
+    };
+
+    ref parent_(ref r) const;
+    void set_parent_(ref r, ref parent);
+    int height_(ref r) const;
+    uint32_t subtree_head_(ref r) const;
+    uint32_t subtree_tail_(ref r) const;
+    // Node pool management. `alloc_` may reallocate the pool, so no node reference may be held across it.
+    ref alloc_();
+    void free_(ref r);
+    // Both input trees must be non-empty.
+    ref construct_(ref v, ref w, VType x);
+    // Split a tree rooted at an internal node.
+    void destroy_(ref root, ref& v, ref& w, VType& x);
+    // Same assumptions as the rotations of dynamic_path_ops: a non-root input carries its grossmin temporarily.
+    ref rotateleft_(ref root);
+    ref rotateright_(ref root);
+    ref top_down_balance_(ref root);
+    // Concatenation of trees or vertices, without flat paths.
+    ref join_(ref p, ref q, VType x, bool reBalance);
+    // Shared by split_before and split_after: `edge_on_right` selects the edge (before(v), v).
+    void split_(uint32_t v, bool edge_on_right, ref& p, ref& q, VType& x);
+
+    // Costs and vertex ids of a flat path, valid until the next allocation of a flat path.
+    VType* flat_costs_(const flat& f);
+    const VType* flat_costs_(const flat& f) const;
+    uint32_t* flat_vertices_(const flat& f);
+    const uint32_t* flat_vertices_(const flat& f) const;
+    // Number of edges of a path: flat, vertex or tree (counted up to limit + 1 only).
+    int edge_count_(ref p, int limit) const;
+    // Flat path of the given vertex ids and costs, or a vertex for a single vertex id.
+    ref make_flat_(const uint32_t* vertices, const VType* costs, int edges);
+    void free_flat_(ref p);
+    void free_tree_(ref p);
+    // Move a flat path into a balanced tree, and a short path into a flat path.
+    ref promote_(ref p);
+    ref demote_(ref p);
+
+    std::vector<node> m_nodes;
+    // Parent internal node of every vertex, `null_ref` for singletons.
+    std::vector<ref> m_vertex_parent;
+    // Released nodes are chained through their parent field.
+    ref m_free_list = null_ref;
+    std::size_t m_live_nodes = 0;
+
+    int m_flat_threshold = 0;
+    std::vector<flat> m_flats;
+    // Released flat paths are chained through their slot field.
+    ref m_flat_free_list = null_ref;
+    flat_arena m_flat_arenas[6];
+    // Position of every vertex in its flat path. Allocated with the hybrid mode.
+    std::vector<uint8_t> m_vertex_slot;
+};
@@ -0,0 +1,113 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in mmap_node_storage.h
+*/
+
+#include "mmap_node_storage.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#pragma mark Public functions
+
+template <typename VType>
+mmap_node_storage<VType>::mmap_node_storage(const std::string& filename, std::size_t capacity) : m_filename(filename) {
+    if (capacity == 0) {
+        return;
+    }
+
+    m_fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (m_fd < 0) {
+        return;
+    }
+
+    // The file stays sparse: disk blocks are only allocated for pages that are written.
+    std::size_t bytes = capacity * sizeof(TreeNode<VType>);
+    if (ftruncate(m_fd, static_cast<off_t>(bytes)) != 0) {
+        close(m_fd);
+        m_fd = -1;
+        std::remove(filename.c_str());
+        return;
+    }
+
+    void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (addr == MAP_FAILED) {
+        close(m_fd);
+        m_fd = -1;
+        std::remove(filename.c_str());
+        return;
+    }
+
+    m_nodes = static_cast<TreeNode<VType>*>(addr);
+    m_capacity = capacity;
+}
+
+template <typename VType>
+mmap_node_storage<VType>::~mmap_node_storage() {
+    if (m_nodes) {
+        munmap(m_nodes, m_capacity * sizeof(TreeNode<VType>));
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        std::remove(m_filename.c_str());
+    }
+}
+
+template <typename VType>
+bool mmap_node_storage<VType>::is_open() const {
+    return m_nodes != nullptr;
+}
+
+template <typename VType>
+TreeNode<VType>* mmap_node_storage<VType>::allocate() {
+    TreeNode<VType>* p = nullptr;
+    if (m_free_list) {
+        p = m_free_list;
+        m_free_list = p->bparent;
+    } else if (m_next < m_capacity) {
+        p = m_nodes + m_next;
+        ++m_next;
+    } else {
+        return nullptr;
+    }
+
+    ++m_size;
+    return p;
+}
+
+template <typename VType>
+void mmap_node_storage<VType>::release(TreeNode<VType>* p) {
+    if (!p) {
+        return;
+    }
+
+    p->bparent = m_free_list;
+    m_free_list = p;
+    --m_size;
+}
+
+template <typename VType>
+bool mmap_node_storage<VType>::owns(const TreeNode<VType>* p) const {
+    return p >= m_nodes && p < m_nodes + m_capacity;
+}
+
+template <typename VType>
+std::size_t mmap_node_storage<VType>::capacity() const {
+    return m_capacity;
+}
+
+template <typename VType>
+std::size_t mmap_node_storage<VType>::size() const {
+    return m_size;
+}
+
+#pragma mark Instantiations
+
+template class mmap_node_storage<double>;
+template class mmap_node_storage<float>;
+template class mmap_node_storage<uint32_t>;
+template class mmap_node_storage<int>;
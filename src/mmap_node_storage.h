@@ -0,0 +1,83 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for out-of-core TreeNode storage backed by a memory-mapped file
+*/
+
+#pragma once
+
+#include "dynamic_path.h"
+
+#include <cstddef>
+#include <string>
+
+/**
+ * \brief Fixed-capacity TreeNode storage inside a memory-mapped scratch file.
+ *
+ * \note The whole capacity is mapped once at a fixed address, so nodes keep plain TreeNode pointers and every
+ * dynamic_path_ops operation works unchanged, while the OS pages in only the nodes that are touched.
+ * The scratch file is removed when the storage is destroyed.
+ */
+template <typename VType>
+class mmap_node_storage {
+  public:
+    /**
+     * \brief Create the scratch file and map room for `capacity` TreeNodes.
+     *
+     * \param[in] filename Path of the scratch file. An existing file is truncated.
+     * \param[in] capacity Maximum number of TreeNodes held by the storage.
+     */
+    mmap_node_storage(const std::string& filename, std::size_t capacity);
+
+    /**
+     * \brief Unmap and remove the scratch file.
+     */
+    ~mmap_node_storage();
+
+    mmap_node_storage(const mmap_node_storage&) = delete;
+    mmap_node_storage& operator=(const mmap_node_storage&) = delete;
+
+    /**
+     * \brief Whether the scratch file is successfully created and mapped.
+     */
+    bool is_open() const;
+
+    /**
+     * \brief Allocate an uninitialized TreeNode slot.
+     *
+     * \return Pointer to the slot. nullptr if the storage is full or not open.
+     */
+    TreeNode<VType>* allocate();
+
+    /**
+     * \brief Return a TreeNode slot obtained by `allocate` to the storage.
+     *
+     * \param[in] p TreeNode to release.
+     */
+    void release(TreeNode<VType>* p);
+
+    /**
+     * \brief Whether the TreeNode lives in this storage.
+     */
+    bool owns(const TreeNode<VType>* p) const;
+
+    /**
+     * \brief Maximum number of TreeNodes held by the storage.
+     */
+    std::size_t capacity() const;
+
+    /**
+     * \brief Number of TreeNodes currently allocated from the storage.
+     */
+    std::size_t size() const;
+
+  private:
+    std::string m_filename;
+    int m_fd = -1;
+    TreeNode<VType>* m_nodes = nullptr;
+    std::size_t m_capacity = 0;
+    // Slots in [m_next, m_capacity) were never handed out; released slots are chained through bparent.
+    std::size_t m_next = 0;
+    std::size_t m_size = 0;
+    TreeNode<VType>* m_free_list = nullptr;
+};
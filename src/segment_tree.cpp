@@ -0,0 +1,279 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Implementation of the functions in segment_tree.h
+*/
+
+#include "segment_tree.h"
+
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+
+template <typename VType>
+static bool close_to_zero(VType x) {
+    return fabs(x) < 1e-6;
+}
+
+// Whether the minimum a of an earlier range wins over the minimum b of a later range, when looking for the first
+// minimum. Same rule as the descent of `dynamic_path_ops::pmincost_before`: a wins if it is within the tolerance.
+template <typename VType>
+static bool first_wins(VType a, VType b) {
+    return a <= b || close_to_zero(a - b);
+}
+
+#pragma mark Public functions
+
+template <typename VType>
+eytzinger_segment_tree<VType>::eytzinger_segment_tree(const std::vector<VType>& input) : m_size(input.size()) {
+    m_leaves = 1;
+    while (m_leaves < m_size) {
+        m_leaves *= 2;
+    }
+
+    // Padding leaves are never covered by a range, so they keep the largest value and their ancestors no offset.
+    m_min.assign(2 * m_leaves, std::numeric_limits<VType>::max());
+    m_add.assign(m_leaves, VType(0));
+    std::copy(input.begin(), input.end(), m_min.begin() + m_leaves);
+    for (std::size_t i = m_leaves - 1; i >= 1; --i) {
+        m_min[i] = std::min(m_min[2 * i], m_min[2 * i + 1]);
+    }
+}
+
+template <typename VType>
+std::size_t eytzinger_segment_tree<VType>::size() const {
+    return m_size;
+}
+
+template <typename VType>
+VType eytzinger_segment_tree<VType>::get(std::size_t i) const {
+    assert(i < m_size);
+
+    std::size_t node = m_leaves + i;
+    VType cost = m_min[node];
+    for (node /= 2; node >= 1; node /= 2) {
+        cost += m_add[node];
+    }
+    return cost;
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::add(std::size_t l, std::size_t r, VType w) {
+    if (l >= r) {
+        return;
+    }
+
+    assert(r <= m_size);
+    add_(1, 0, m_leaves, l, r, w);
+}
+
+template <typename VType>
+VType eytzinger_segment_tree<VType>::min_first(std::size_t l, std::size_t r, std::size_t& index) const {
+    assert(l < r && r <= m_size);
+
+    candidate c = query_(1, 0, m_leaves, l, r, VType(0), true);
+    index = c.index;
+    return c.cost;
+}
+
+template <typename VType>
+VType eytzinger_segment_tree<VType>::min_last(std::size_t l, std::size_t r, std::size_t& index) const {
+    assert(l < r && r <= m_size);
+
+    candidate c = query_(1, 0, m_leaves, l, r, VType(0), false);
+    index = c.index;
+    return c.cost;
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::vectorize(std::vector<VType>& output) const {
+    output.clear();
+    if (m_size == 0) {
+        return;
+    }
+
+    output.reserve(m_size);
+    vectorize_(1, VType(0), output);
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::below(std::size_t l, std::size_t r, VType threshold,
+                                          std::vector<std::pair<std::size_t, VType>>& output) const {
+    assert(r <= m_size);
+    if (l < r) {
+        below_(1, 0, m_leaves, l, r, VType(0), threshold, output);
+    }
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::smallest(std::size_t l, std::size_t r, std::size_t k,
+                                             std::vector<std::pair<std::size_t, VType>>& output) const {
+    assert(r <= m_size);
+    if (l >= r || k == 0) {
+        return;
+    }
+
+    // Heap of (minimum, node, offset of the ancestors). Leaves are reported when they reach the top.
+    std::vector<std::pair<std::size_t, VType>> nodes;
+    cover_(1, 0, m_leaves, l, r, VType(0), nodes);
+    std::vector<std::tuple<VType, std::size_t, VType>> frontier;
+    for (const auto& node : nodes) {
+        frontier.emplace_back(m_min[node.first] + node.second, node.first, node.second);
+    }
+    auto later = [](const std::tuple<VType, std::size_t, VType>& a, const std::tuple<VType, std::size_t, VType>& b) {
+        return std::get<0>(a) > std::get<0>(b);
+    };
+    std::make_heap(frontier.begin(), frontier.end(), later);
+    std::size_t reported = 0;
+    while (!frontier.empty() && reported < k) {
+        std::pop_heap(frontier.begin(), frontier.end(), later);
+        VType key = std::get<0>(frontier.back());
+        std::size_t node = std::get<1>(frontier.back());
+        VType base = std::get<2>(frontier.back());
+        frontier.pop_back();
+        if (node >= m_leaves) {
+            output.emplace_back(node - m_leaves, key);
+            ++reported;
+            continue;
+        }
+
+        // Covered nodes hold no padding leaves.
+        base += m_add[node];
+        for (std::size_t child : {2 * node, 2 * node + 1}) {
+            frontier.emplace_back(m_min[child] + base, child, base);
+            std::push_heap(frontier.begin(), frontier.end(), later);
+        }
+    }
+}
+
+#pragma mark Private functions
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::add_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r, VType w) {
+    if (r <= node_l || node_r <= l) {
+        return;
+    }
+
+    if (l <= node_l && node_r <= r) {
+        m_min[node] += w;
+        if (node < m_leaves) {
+            m_add[node] += w;
+        }
+        return;
+    }
+
+    std::size_t mid = (node_l + node_r) / 2;
+    add_(2 * node, node_l, mid, l, r, w);
+    add_(2 * node + 1, mid, node_r, l, r, w);
+    m_min[node] = std::min(m_min[2 * node], m_min[2 * node + 1]) + m_add[node];
+}
+
+template <typename VType>
+typename eytzinger_segment_tree<VType>::candidate eytzinger_segment_tree<VType>::query_(
+    std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r, VType base, bool first) const {
+    if (r <= node_l || node_r <= l) {
+        return candidate();
+    }
+
+    if (l <= node_l && node_r <= r) {
+        return descend_(node, base, first);
+    }
+
+    base += m_add[node];
+    std::size_t mid = (node_l + node_r) / 2;
+    candidate left = query_(2 * node, node_l, mid, l, r, base, first);
+    candidate right = query_(2 * node + 1, mid, node_r, l, r, base, first);
+    if (!left.found) return right;
+    if (!right.found) return left;
+
+    bool left_wins = first ? first_wins(left.min, right.min) : !first_wins(right.min, left.min);
+    candidate& winner = left_wins ? left : right;
+    winner.min = std::min(left.min, right.min);
+    return winner;
+}
+
+template <typename VType>
+typename eytzinger_segment_tree<VType>::candidate eytzinger_segment_tree<VType>::descend_(std::size_t node, VType base, bool first) const {
+    candidate c;
+    c.found = true;
+    c.min = m_min[node] + base;
+    while (node < m_leaves) {
+        base += m_add[node];
+        VType left = m_min[2 * node] + base;
+        VType right = m_min[2 * node + 1] + base;
+        bool left_wins = first ? first_wins(left, right) : !first_wins(right, left);
+        node = left_wins ? 2 * node : 2 * node + 1;
+    }
+    c.cost = m_min[node] + base;
+    c.index = node - m_leaves;
+    return c;
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::vectorize_(std::size_t node, VType base, std::vector<VType>& output) const {
+    if (node >= m_leaves) {
+        if (node - m_leaves < m_size) {
+            output.push_back(m_min[node] + base);
+        }
+        return;
+    }
+
+    // Subtrees starting beyond the last cost hold padding only.
+    std::size_t first_leaf = node;
+    while (first_leaf < m_leaves) {
+        first_leaf *= 2;
+    }
+    if (first_leaf - m_leaves >= m_size) {
+        return;
+    }
+
+    base += m_add[node];
+    vectorize_(2 * node, base, output);
+    vectorize_(2 * node + 1, base, output);
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::below_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r,
+                                           VType base, VType threshold, std::vector<std::pair<std::size_t, VType>>& output) const {
+    if (r <= node_l || node_r <= l || !(m_min[node] + base < threshold)) {
+        return;
+    }
+
+    if (node >= m_leaves) {
+        output.emplace_back(node - m_leaves, m_min[node] + base);
+        return;
+    }
+
+    base += m_add[node];
+    std::size_t mid = (node_l + node_r) / 2;
+    below_(2 * node, node_l, mid, l, r, base, threshold, output);
+    below_(2 * node + 1, mid, node_r, l, r, base, threshold, output);
+}
+
+template <typename VType>
+void eytzinger_segment_tree<VType>::cover_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r,
+                                           VType base, std::vector<std::pair<std::size_t, VType>>& nodes) const {
+    if (r <= node_l || node_r <= l) {
+        return;
+    }
+
+    if (l <= node_l && node_r <= r) {
+        nodes.emplace_back(node, base);
+        return;
+    }
+
+    base += m_add[node];
+    std::size_t mid = (node_l + node_r) / 2;
+    cover_(2 * node, node_l, mid, l, r, base, nodes);
+    cover_(2 * node + 1, mid, node_r, l, r, base, nodes);
+}
+
+#pragma mark Instantiations
+
+template class eytzinger_segment_tree<double>;
+template class eytzinger_segment_tree<float>;
+template class eytzinger_segment_tree<uint32_t>;
+template class eytzinger_segment_tree<int>;
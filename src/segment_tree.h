@@ -0,0 +1,108 @@
+/*
+Copyright 2016-2021, Cheng Lu, chenglu@berkeley.edu
+
+Header file for the implicit lazy segment tree backing the fixed-order mode of dp_array
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Lazy segment tree over a fixed array of edge costs, supporting range add and first/last range argmin.
+ *
+ * \note Nodes are laid out in BFS (Eytzinger) order in flat arrays: the root is 1 and the children of node i are
+ * 2i and 2i + 1, so there are no pointers to chase and the top levels share a few cache lines. Range adds are kept
+ * as per-node offsets that are never pushed down, which also makes all queries const.
+ * Ties are resolved with the same tolerance as the minimum queries of dynamic_path_ops.
+ */
+template <typename VType>
+class eytzinger_segment_tree {
+  public:
+    eytzinger_segment_tree() = default;
+
+    /**
+     * \brief Build the tree over the input costs in O(n).
+     */
+    explicit eytzinger_segment_tree(const std::vector<VType>& input);
+
+    /**
+     * \brief Number of costs.
+     */
+    std::size_t size() const;
+
+    /**
+     * \brief Cost at position i.
+     */
+    VType get(std::size_t i) const;
+
+    /**
+     * \brief Add w to the costs at positions [l, r).
+     */
+    void add(std::size_t l, std::size_t r, VType w);
+
+    /**
+     * \brief Position of the minimum cost in [l, r) closest to l. The range must not be empty.
+     *
+     * \param[out] index Position of the minimum.
+     * \return Cost at that position.
+     */
+    VType min_first(std::size_t l, std::size_t r, std::size_t& index) const;
+
+    /**
+     * \brief Position of the minimum cost in [l, r) closest to r. The range must not be empty.
+     *
+     * \param[out] index Position of the minimum.
+     * \return Cost at that position.
+     */
+    VType min_last(std::size_t l, std::size_t r, std::size_t& index) const;
+
+    /**
+     * \brief Append the positions in [l, r) with a cost strictly smaller than the threshold, in order.
+     *
+     * \param[out] output Pairs of position and cost.
+     */
+    void below(std::size_t l, std::size_t r, VType threshold, std::vector<std::pair<std::size_t, VType>>& output) const;
+
+    /**
+     * \brief Append the k positions in [l, r) with the smallest costs, by increasing cost. Ties in unspecified order.
+     *
+     * \param[out] output Pairs of position and cost.
+     */
+    void smallest(std::size_t l, std::size_t r, std::size_t k, std::vector<std::pair<std::size_t, VType>>& output) const;
+
+    /**
+     * \brief All the costs, in order.
+     */
+    void vectorize(std::vector<VType>& output) const;
+
+  private:
+    // Minimum of a covered range: value of the subtree minimum, and the selected position and its cost.
+    struct candidate {
+        bool found = false;
+        VType min;
+        VType cost;
+        std::size_t index;
+    };
+
+    void add_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r, VType w);
+    candidate query_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r, VType base, bool first) const;
+    // Descend from a fully covered node to its selected leaf.
+    candidate descend_(std::size_t node, VType base, bool first) const;
+    void vectorize_(std::size_t node, VType base, std::vector<VType>& output) const;
+    void below_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r, VType base,
+                VType threshold, std::vector<std::pair<std::size_t, VType>>& output) const;
+    // Nodes covering [l, r) exactly, with the offsets of their ancestors.
+    void cover_(std::size_t node, std::size_t node_l, std::size_t node_r, std::size_t l, std::size_t r, VType base,
+                std::vector<std::pair<std::size_t, VType>>& nodes) const;
+
+    std::size_t m_size = 0;
+    // Number of leaves: the smallest power of two not less than m_size.
+    std::size_t m_leaves = 0;
+    // m_min[i]: minimum of the subtree of node i, with the offsets of node i and below but not of its ancestors.
+    std::vector<VType> m_min;
+    // Offsets of the internal nodes.
+    std::vector<VType> m_add;
+};